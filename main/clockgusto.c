@@ -11,17 +11,43 @@
  *  idf.py -p /dev/ttyUSBO monitor */
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_event.h"
 #include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 #include "driver/rmt_tx.h"
+#include "nvs_flash.h"
+#include "sdkconfig.h"
 
 #include "clockgusto.h"
+#include "clockgusto_alarm.h"
+#include "clockgusto_boot.h"
+#include "clockgusto_calibration.h"
+#include "clockgusto_events.h"
+#include "clockgusto_group.h"
+#include "clockgusto_http.h"
+#include "clockgusto_log.h"
+#include "clockgusto_metrics.h"
+#include "clockgusto_mqtt.h"
+#include "clockgusto_night.h"
+#include "clockgusto_power.h"
+#include "clockgusto_preview.h"
+#include "clockgusto_realtime.h"
+#include "clockgusto_serial.h"
+#include "clockgusto_temperature.h"
+#include "clockgusto_time.h"
+#include "clockgusto_tz.h"
 #include "clockgusto_wifi.h"
+#include "dcf77_receiver.h"
 #include "led_strip_encoder.h"
 #include "rtc_ds3231.h"
 
@@ -29,30 +55,199 @@
 #define TAG "clock gusto"
 #define RMT_LED_STRIP_RESOLUTION_HZ 10000000 
 #define RMT_LED_STRIP_GPIO_NUM      4
+#define ALARM_GPIO_NUM              26      // DS3231 INT/SQW, an RTC GPIO so it can wake from deep sleep
 #define CLOCKGUSTO_CHASE_SPEED_MS   10
+#define CLOCKGUSTO_RMT_TIMEOUT_MS   100     // a frame takes 3.5 ms on the wire
+#define CLOCKGUSTO_CHASE_FRAME_MS   125     // one rainbow step
+#define CLOCKGUSTO_SUNRISE_FRAME_MS 50      // the ramp moves in small steps, a faster rate keeps it smooth
+#define CLOCKGUSTO_STATIC_FRAME_MS  1000    // faces that only change with the minute or the temperature
+#define CLOCKGUSTO_DEGRADED_HUE     30      // amber words instead of the rainbow while no time source answers
+#define CLOCKGUSTO_RESUME_MAGIC     0x434c4b48
 
 typedef struct _clockgusto_state_t
 {
     clock_board_t clock_board;
     uint8_t led_strip_pixels[CLOCKGUSTO_NUM_LEDS * CLOCKGUSTO_BYTES_PER_LED];
+    uint8_t realtime_pixels[CLOCKGUSTO_NUM_LEDS * CLOCKGUSTO_BYTES_PER_LED];  // received frame, thermal limit applied
+    const uint8_t* frame;               // last buffer on the strip, the face or a realtime frame
 
     rmt_transmit_config_t tx_config;
     rmt_channel_handle_t led_chan;
     rmt_encoder_handle_t led_encoder;
+
+    clockgusto_mode_t mode;
+    uint8_t brightness;
+    uint16_t start_rgb;
+
+    uint32_t render_errors;
+    uint32_t render_recoveries;
 } clockgusto_state_t;
 
 clockgusto_state_t* state = NULL;
 
+/** The last frame on the strip. RTC slow memory keeps it across every reset but a power on, so a
+ *  brownout, watchdog or panic reboot can put it straight back. The rainbow phase is not kept, it
+ *  follows the group time. */
+typedef struct _clockgusto_resume_t
+{
+    uint32_t magic;
+    uint8_t mode;
+    uint8_t brightness;
+    uint8_t pixels[CLOCKGUSTO_NUM_LEDS * CLOCKGUSTO_BYTES_PER_LED];
+    uint32_t crc;
+} clockgusto_resume_t;
+
+static RTC_NOINIT_ATTR clockgusto_resume_t s_resume;
+
+void clockgusto_set_mode(clockgusto_mode_t mode)
+{
+    if (mode < CLOCKGUSTO_MODE_COUNT)
+    {
+        state->mode = mode;
+        clockgusto_events_notify(CLOCKGUSTO_EVENTS_CONFIG);
+    }
+}
+
+clockgusto_mode_t clockgusto_get_mode()
+{
+    return state->mode;
+}
+
+void clockgusto_set_brightness(uint8_t brightness)
+{
+    state->brightness = brightness > 100 ? 100 : brightness;
+    clockgusto_events_notify(CLOCKGUSTO_EVENTS_CONFIG);
+}
+
+uint8_t clockgusto_get_brightness()
+{
+    return state->brightness;
+}
+
+uint32_t clockgusto_get_time_mask()
+{
+    return state->clock_board.time_mask;
+}
+
+void clockgusto_get_health(clockgusto_health_t* health)
+{
+    health->render_errors = state->render_errors;
+    health->render_recoveries = state->render_recoveries;
+    health->rtc_failures = clockgusto_time_get_rtc_failures();
+    health->degraded = clockgusto_time_is_degraded();
+}
+
+/** Output stage: the requested brightness scaled by every limiter. Only reads cached values. */
+static uint8_t clockgusto_get_output_level()
+{
+    return (uint8_t)((uint32_t)state->brightness * clockgusto_temperature_get_derating() *
+                     clockgusto_night_get_level() / 10000);
+}
+
+/** Frame period the current face needs. Between frames every task waits, so tickless idle puts the
+ *  chip into light sleep until the frame timer or a driver interrupt wakes it. */
+static uint32_t clockgusto_get_frame_period_ms()
+{
+    if (clockgusto_alarm_get_state() != CLOCKGUSTO_ALARM_IDLE)
+    {
+        return CLOCKGUSTO_SUNRISE_FRAME_MS;
+    }
+    if (state->mode == CLOCKGUSTO_MODE_TEMPERATURE || clockgusto_time_is_degraded())
+    {
+        return CLOCKGUSTO_STATIC_FRAME_MS;
+    }
+
+    return CLOCKGUSTO_CHASE_FRAME_MS;
+}
+
+/** Wakes the render task on the frame grid. */
+static void clockgusto_frame_timer_callback(void* arg)
+{
+    xTaskNotifyGive((TaskHandle_t)arg);
+}
+
+/** The channel is only enabled for the transfer. An enabled RMT channel holds its PM lock, which
+ *  would keep the APB clock up and the chip out of light sleep between frames. */
+static esp_err_t clockgusto_transmit(const uint8_t* pixels)
+{
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = rmt_enable(state->led_chan);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    ret = rmt_transmit(state->led_chan, 
+                       state->led_encoder, 
+                       pixels, 
+                       sizeof(state->led_strip_pixels), 
+                       &state->tx_config);
+    if (ret == ESP_OK)
+    {
+        ret = rmt_tx_wait_all_done(state->led_chan, CLOCKGUSTO_RMT_TIMEOUT_MS);
+        if (ret != ESP_OK)
+        {
+            // disabling aborts the stuck transaction, so the next frame starts clean
+            state->render_recoveries++;
+        }
+        else
+        {
+            state->frame = pixels;
+        }
+    }
+    rmt_disable(state->led_chan);
+    clockgusto_metrics_observe(CLOCKGUSTO_METRICS_RMT_TRANSMIT, (uint32_t)(esp_timer_get_time() - start_us));
+
+    return ret;
+}
+
+static void clockgusto_resume_save()
+{
+    s_resume.magic = CLOCKGUSTO_RESUME_MAGIC;
+    s_resume.mode = (uint8_t)state->mode;
+    s_resume.brightness = state->brightness;
+    memcpy(s_resume.pixels, state->led_strip_pixels, sizeof(s_resume.pixels));
+    s_resume.crc = esp_rom_crc32_le(0, (const uint8_t*)&s_resume, offsetof(clockgusto_resume_t, crc));
+}
+
+/** Takes the state over from the previous run. Garbage after a power on fails the magic or the crc,
+ *  a deep sleep blanked the face on purpose. */
+static bool clockgusto_resume_restore()
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (reason == ESP_RST_POWERON || reason == ESP_RST_DEEPSLEEP || s_resume.magic != CLOCKGUSTO_RESUME_MAGIC ||
+        s_resume.crc != esp_rom_crc32_le(0, (const uint8_t*)&s_resume, offsetof(clockgusto_resume_t, crc)) ||
+        s_resume.mode >= CLOCKGUSTO_MODE_COUNT || s_resume.brightness > 100)
+    {
+        return false;
+    }
+
+    state->mode = (clockgusto_mode_t)s_resume.mode;
+    state->brightness = s_resume.brightness;
+    memcpy(state->led_strip_pixels, s_resume.pixels, sizeof(state->led_strip_pixels));
+    return true;
+}
+
 static void led_strip_hsv2rgb(uint32_t h, uint32_t s, uint32_t v, uint32_t* r, uint32_t* g, uint32_t* b);
 static void clockgusto_set_board_time_mask();
+static void clockgusto_set_board_temperature_mask();
+static uint8_t clockgusto_get_output_level();
 
 void app_main(void)
 {
-    state = (clockgusto_state_t *)malloc(sizeof(clockgusto_state_t));
+    clockgusto_boot_mark(CLOCKGUSTO_BOOT_APP_MAIN);
+    clockgusto_log_init();
+
+    state = (clockgusto_state_t *)calloc(1, sizeof(clockgusto_state_t));
     if (!state)
     {
         ESP_LOGE(__FUNCTION__, "poor allocation. global structure cannot be created.");
+        return;
     }
+    state->mode = CLOCKGUSTO_MODE_CLOCK;
+    state->brightness = 100;
+
+    bool resumed = clockgusto_resume_restore();
 
     ESP_LOGI(TAG, "Create RMT TX channel");
     state->led_chan = NULL;
@@ -71,52 +266,182 @@ void app_main(void)
         .resolution = RMT_LED_STRIP_RESOLUTION_HZ,
     };
     ESP_ERROR_CHECK(rmt_new_led_strip_encoder(&encoder_config, &state->led_encoder));
-
-    ESP_LOGI(TAG, "Enable RMT TX channel");
-    ESP_ERROR_CHECK(rmt_enable(state->led_chan));
-
-    ESP_LOGI(TAG, "Start LED rainbow chase");
     state->tx_config = (rmt_transmit_config_t){
         .loop_count = 0,
     };
+    clockgusto_boot_mark(CLOCKGUSTO_BOOT_RMT);
+
+    if (resumed)
+    {
+        // the face comes back before anything else initialises, the main loop reconciles the time
+        esp_err_t resume_ret = clockgusto_transmit(state->led_strip_pixels);
+        ESP_LOGI(TAG, "Resume last frame: %s", esp_err_to_name(resume_ret));
+    }
+
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+    clockgusto_boot_mark(CLOCKGUSTO_BOOT_NVS);
+
+    ESP_LOGI(TAG, "Create event loop");
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+
+    ESP_LOGI(TAG, "Enable power management");
+    ret = clockgusto_power_init();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "power management: %s", esp_err_to_name(ret));
+    }
+
+    ESP_LOGI(TAG, "Start LED rainbow chase");
 
     ESP_LOGI(TAG, "Enable RTC DS3231");
     uint8_t sda_pin = 21;
     uint8_t scl_pin = 22;
-    ESP_ERROR_CHECK(rtc_ds3231_init(sda_pin, scl_pin, 100000));
+    ret = rtc_ds3231_init(sda_pin, scl_pin, 100000);
+    clockgusto_boot_mark(CLOCKGUSTO_BOOT_I2C);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "rtc unavailable: %s", esp_err_to_name(ret));
+    }
     
     ESP_LOGI(TAG, "Startup clockgusto");
     clockgusto_startup();
+    clockgusto_boot_mark(CLOCKGUSTO_BOOT_STARTUP);
    
-#if true
-    const char* compile_time = __TIME__;
-    uint8_t hours = (uint8_t)strtol(compile_time, NULL, 10);
-    uint8_t minutes = (uint8_t)strtol(compile_time + 3, NULL, 10);
-    uint8_t seconds = (uint8_t)strtol(compile_time + 6, NULL, 10);
-    ESP_ERROR_CHECK(rtc_ds3231_set_time(hours, minutes, seconds));
-#else
-    int8_t hours = 11;
-    int8_t minutes = 10;
-    int8_t seconds = 00;
-    ESP_ERROR_CHECK(rtc_ds3231_set_time(hours, minutes, seconds));
+    ESP_LOGI(TAG, "Load time zone");
+    ret = clockgusto_tz_init();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "time zone: %s", esp_err_to_name(ret));
+    }
+
+    /* None of the rtc steps may stop the boot. Whatever fails here is retried by the time task, the
+     * display runs from the system clock in the meantime. A DS3231 that lost its time is left alone
+     * until SNTP, DCF77 or a time set gives a real one to write back. */
+    ESP_LOGI(TAG, "Restore rtc calibration");
+    ret = clockgusto_calibration_init();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "rtc calibration: %s", esp_err_to_name(ret));
+    }
+
+    ESP_LOGI(TAG, "Seed system clock");
+    ESP_ERROR_CHECK(clockgusto_time_init());
+    clockgusto_boot_mark(CLOCKGUSTO_BOOT_RTC_READ);
+
+    ESP_LOGI(TAG, "Sample temperature");
+    ESP_ERROR_CHECK(clockgusto_temperature_start());
+
+    ESP_LOGI(TAG, "Compute night curve");
+    ret = clockgusto_night_start();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "night mode: %s", esp_err_to_name(ret));
+    }
+
+    ESP_LOGI(TAG, "Arm alarm");
+    ret = clockgusto_alarm_init(ALARM_GPIO_NUM);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "alarm: %s", esp_err_to_name(ret));
+    }
+
+#ifdef CONFIG_CLOCKGUSTO_DCF77
+    ESP_LOGI(TAG, "Listen for DCF77");
+    ret = dcf77_receiver_start(CONFIG_CLOCKGUSTO_DCF77_GPIO, false);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "dcf77: %s", esp_err_to_name(ret));
+    }
 #endif
 
-    state->clock_board.hours = hours;
-    state->clock_board.minutes = minutes;
-    state->clock_board.seconds = seconds;
+    ESP_LOGI(TAG, "Start event push");
+    ret = clockgusto_events_init();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "event push: %s", esp_err_to_name(ret));
+    }
+
+    ESP_LOGI(TAG, "Start mqtt");
+    ret = clockgusto_mqtt_init();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "mqtt: %s", esp_err_to_name(ret));
+    }
+
+    ESP_LOGI(TAG, "Listen for realtime pixels");
+    ret = clockgusto_realtime_init(xTaskGetCurrentTaskHandle());
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "realtime: %s", esp_err_to_name(ret));
+    }
+
+    ESP_LOGI(TAG, "Join clock group");
+    ret = clockgusto_group_init();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "clock group: %s", esp_err_to_name(ret));
+    }
+
+    ESP_LOGI(TAG, "Register REST API");
+    ret = clockgusto_http_init();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "rest api: %s", esp_err_to_name(ret));
+    }
+
+    ESP_LOGI(TAG, "Open serial control");
+    ret = clockgusto_serial_init();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "serial control: %s", esp_err_to_name(ret));
+    }
+
     ESP_LOGI(TAG, "Start clock");
+    bool network_started = false;
+    esp_timer_handle_t frame_timer = NULL;
+    esp_timer_create_args_t frame_timer_args = {
+        .callback = clockgusto_frame_timer_callback,
+        .arg = xTaskGetCurrentTaskHandle(),
+        .name = "clockgusto frame",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&frame_timer_args, &frame_timer));
     while (true) 
     {
-        ESP_LOGI(TAG, "Update clock");
+        int64_t frame_start_us = esp_timer_get_time();
         clockgusto_update();
-
-        ESP_LOGI(TAG, "Show clock");
         clockgusto_show();
+        clockgusto_metrics_observe(CLOCKGUSTO_METRICS_FRAME_RENDER, (uint32_t)(esp_timer_get_time() - frame_start_us));
+        clockgusto_boot_mark(CLOCKGUSTO_BOOT_FIRST_FRAME);
+
+        if (!network_started)
+        {
+            // the radio comes up behind the first frame, services follow CLOCKGUSTO_NET_EVENT
+            network_started = true;
+            ret = clockgusto_wifi_start();
+            if (ret != ESP_OK)
+            {
+                ESP_LOGW(TAG, "wifi: %s", esp_err_to_name(ret));
+            }
+        }
 
-        //ESP_LOGI(TAG, "Reset clock");
         //clockgusto_reset();
-        
-        vTaskDelay(pdMS_TO_TICKS(100));
+
+        uint32_t period_ms = clockgusto_get_frame_period_ms();
+        clockgusto_power_note_frame(state->mode, state->frame ? state->frame : state->led_strip_pixels,
+                                    sizeof(state->led_strip_pixels),
+                                    esp_timer_get_time() - frame_start_us, (int64_t)period_ms * 1000);
+
+        // frames fall on the group time grid, so clocks side by side flip and cycle together; a
+        // realtime frame wakes the loop early
+        esp_timer_start_once(frame_timer, clockgusto_group_get_frame_wait_us(period_ms));
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        esp_timer_stop(frame_timer);
     }
 }
 
@@ -240,10 +565,9 @@ void clockgusto_startup()
 
 void clockgusto_update()
 {
-    ESP_LOGI(__FUNCTION__, "invoked");
     clock_board_t* clock_board = &state->clock_board;
-    uint8_t hours, minutes, seconds; 
-    rtc_ds3231_get_time(&hours, &minutes, &seconds); 
+    uint8_t hours, minutes, seconds;
+    clockgusto_group_get_local_hms(&hours, &minutes, &seconds);
    
     if (clock_board->hours != hours || clock_board->minutes != minutes)
     {
@@ -253,7 +577,20 @@ void clockgusto_update()
         clock_board->seconds = seconds;
     }
 
-    clockgusto_set_board_time_mask();
+    uint32_t previous_mask = clock_board->time_mask;
+    if (state->mode == CLOCKGUSTO_MODE_TEMPERATURE)
+    {
+        clockgusto_set_board_temperature_mask();
+    }
+    else
+    {
+        clockgusto_set_board_time_mask();
+    }
+    if (clock_board->time_mask != previous_mask)
+    {
+        clock_board->flip = true;
+        clockgusto_events_notify(CLOCKGUSTO_EVENTS_TIME);
+    }
 
     for (uint16_t led_idx = 0; led_idx < CLOCKGUSTO_NUM_LEDS; ++led_idx)
     {
@@ -284,9 +621,35 @@ void clockgusto_show()
     static uint32_t green = 0;
     static uint32_t blue = 0;
     static uint16_t hue = 0;
-    static uint16_t start_rgb = 0;
 
-    ESP_LOGI(__FUNCTION__, "prob1");
+    bool realtime = false;
+    const uint8_t* realtime_frame = clockgusto_realtime_take_frame(&realtime);
+    if (realtime)
+    {
+        // an external host drives the face, it goes out as received, only the thermal limit applies
+        if (realtime_frame)
+        {
+            // the received frame belongs to the triple buffer, the limit goes into a copy
+            uint8_t derating = clockgusto_temperature_get_derating();
+            for (int byte_idx = 0; byte_idx < CLOCKGUSTO_NUM_LEDS * CLOCKGUSTO_BYTES_PER_LED; ++byte_idx)
+            {
+                state->realtime_pixels[byte_idx] = realtime_frame[byte_idx] * derating / 100;
+            }
+            if (clockgusto_transmit(state->realtime_pixels) != ESP_OK)
+            {
+                state->render_errors++;
+            }
+            else
+            {
+                clockgusto_realtime_note_shown();
+                clockgusto_preview_submit(state->realtime_pixels);
+                clockgusto_serial_submit(state->realtime_pixels);
+            }
+        }
+        state->clock_board.flip = true;     // the face is redrawn in full once the stream ends
+        return;
+    }
+
     if (state->clock_board.flip == true)
     {
         for (uint8_t mask_idx = 0; mask_idx < CLOCK_WORD_COUNT; ++mask_idx)
@@ -297,12 +660,11 @@ void clockgusto_show()
             if (mask_result > 0)
             {    
                 const clock_word_str_t word = clock_word_str[(uint32_t)mask_idx];
-                ESP_LOGI(__FUNCTION__, "%s", word.data);
+                ESP_LOGD(__FUNCTION__, "%s", word.data);
             }
         }
     }
    
-    ESP_LOGI(__FUNCTION__, "prob2");
     if (state->clock_board.flip == true)
     {
         for (int led_idx = 0; 
@@ -316,30 +678,66 @@ void clockgusto_show()
         }
     }
 
-    ESP_LOGI(__FUNCTION__, "prob3");
-    for (int led_idx = 0; led_idx < CLOCKGUSTO_NUM_LEDS; led_idx += 1) 
+    // the rainbow moves one step per chase frame of group time, in phase with the other clocks
+    state->start_rgb = clockgusto_group_get_phase(CLOCKGUSTO_CHASE_FRAME_MS);
+    uint8_t level = clockgusto_get_output_level();
+    bool degraded = clockgusto_time_is_degraded();
+    float celsius = 0.0f;
+    if (state->mode == CLOCKGUSTO_MODE_TEMPERATURE)
+    {
+        clockgusto_temperature_get(&celsius);
+    }
+    uint8_t sunrise[CLOCKGUSTO_BYTES_PER_LED];
+    if (clockgusto_alarm_get_sunrise(sunrise))
     {
-        if (state->clock_board.leds[led_idx].on == true)
+        // the whole face becomes the lamp, only the thermal limit applies
+        uint8_t derating = clockgusto_temperature_get_derating();
+        for (int byte_idx = 0; byte_idx < CLOCKGUSTO_NUM_LEDS * CLOCKGUSTO_BYTES_PER_LED; ++byte_idx)
         {
-            hue = led_idx * 360 / CLOCKGUSTO_NUM_LEDS + start_rgb;
-            led_strip_hsv2rgb(hue, 100, 100, &red, &green, &blue);
-            int color_offset = led_idx * CLOCKGUSTO_BYTES_PER_LED; 
-            state->led_strip_pixels[color_offset + 0] = green;
-            state->led_strip_pixels[color_offset + 1] = blue;
-            state->led_strip_pixels[color_offset + 2] = red;
+            state->led_strip_pixels[byte_idx] = sunrise[byte_idx % CLOCKGUSTO_BYTES_PER_LED] * derating / 100;
+        }
+        state->clock_board.flip = true;    // blanks the face again once the sunrise is over
+    }
+    else
+    {
+        for (int led_idx = 0; led_idx < CLOCKGUSTO_NUM_LEDS; led_idx += 1) 
+        {
+            if (state->clock_board.leds[led_idx].on == true)
+            {
+                if (state->mode == CLOCKGUSTO_MODE_TEMPERATURE)
+                {
+                    // blue at 15 C and below, red at 35 C and above
+                    float clamped = celsius < 15.0f ? 15.0f : (celsius > 35.0f ? 35.0f : celsius);
+                    hue = 240 - (uint16_t)((clamped - 15.0f) * 12.0f);
+                }
+                else if (degraded)
+                {
+                    hue = CLOCKGUSTO_DEGRADED_HUE;
+                }
+                else
+                {
+                    hue = led_idx * 360 / CLOCKGUSTO_NUM_LEDS + state->start_rgb;
+                }
+                led_strip_hsv2rgb(hue, 100, level, &red, &green, &blue);
+                int color_offset = led_idx * CLOCKGUSTO_BYTES_PER_LED; 
+                state->led_strip_pixels[color_offset + 0] = green;
+                state->led_strip_pixels[color_offset + 1] = blue;
+                state->led_strip_pixels[color_offset + 2] = red;
+            }
         }
     }
 
-    ESP_LOGI(__FUNCTION__, "prob4");
-    ESP_ERROR_CHECK(rmt_transmit(state->led_chan, 
-                                 state->led_encoder, 
-                                 state->led_strip_pixels, 
-                                 sizeof(state->led_strip_pixels), 
-                                 &state->tx_config));
-
-    ESP_ERROR_CHECK(rmt_tx_wait_all_done(state->led_chan, portMAX_DELAY));
-    vTaskDelay(pdMS_TO_TICKS(20));
-    start_rgb = (start_rgb + 1) % 256;
+    if (clockgusto_transmit(state->led_strip_pixels) != ESP_OK)
+    {
+        // the previous frame stays on the strip, the next one gets another chance
+        state->render_errors++;
+    }
+    else
+    {
+        clockgusto_resume_save();
+        clockgusto_preview_submit(state->led_strip_pixels);
+        clockgusto_serial_submit(state->led_strip_pixels);
+    }
 }
 
 void clockgusto_reset()
@@ -352,6 +750,19 @@ void clockgusto_reset()
     state->clock_board.flip = false;
 }
 
+esp_err_t clockgusto_sleep_until_alarm()
+{
+    // the strip latches the last frame, so it is blanked before the chip goes down
+    memset(state->led_strip_pixels, 0, sizeof(state->led_strip_pixels));
+    esp_err_t ret = clockgusto_transmit(state->led_strip_pixels);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    return clockgusto_alarm_sleep();
+}
+
 static void led_strip_hsv2rgb(uint32_t h, uint32_t s, uint32_t v, uint32_t* r, uint32_t* g, uint32_t* b)
 {
     h %= 360;
@@ -576,3 +987,55 @@ static void clockgusto_set_board_time_mask()
     }
 }
 
+static void clockgusto_set_board_temperature_mask()
+{
+    static const clock_word_t units[] = {
+        CLOCK_WORD_COUNT, CLOCK_WORD_EINS, CLOCK_WORD_ZWEI, CLOCK_WORD_DREI, CLOCK_WORD_VIER,
+        CLOCK_WORD_FUENF_2, CLOCK_WORD_SECHS, CLOCK_WORD_SIEBEN, CLOCK_WORD_ACHT, CLOCK_WORD_NEUN,
+    };
+
+    float celsius = 0.0f;
+    clockgusto_temperature_get(&celsius);
+    int32_t quarters = (int32_t)(celsius * 4.0f);
+    if (quarters < 0)
+    {
+        quarters = 0;
+    }
+    else if (quarters > 39 * 4 + 3)
+    {
+        quarters = 39 * 4 + 3;
+    }
+
+    uint8_t degrees = quarters / 4;
+    uint8_t tens = degrees / 10;
+    uint8_t unit = degrees % 10;
+
+    state->clock_board.time_mask = 0x0;
+    if (degrees == 10 || degrees == 11 || degrees == 12)
+    {
+        // ZEHN, ELF and ZWÖLF have words of their own in the hour rows
+        clock_word_t word = degrees == 10 ? CLOCK_WORD_ZEHN_2 : (degrees == 11 ? CLOCK_WORD_ELF : CLOCK_WORD_ZWOELF);
+        state->clock_board.time_mask |= 1 << word;
+    }
+    else
+    {
+        if (unit > 0)
+        {
+            state->clock_board.time_mask |= 1 << units[unit];
+        }
+        if (tens == 1 || tens == 3)
+        {
+            state->clock_board.time_mask |= 1 << CLOCK_WORD_ZEHN_1;
+        }
+        if (tens >= 2)
+        {
+            state->clock_board.time_mask |= 1 << CLOCK_WORD_ZWANZIG;
+        }
+    }
+
+    // the minute dots show the quarter degrees
+    for (uint8_t dot = 0; dot < quarters % 4; ++dot)
+    {
+        state->clock_board.time_mask |= 1 << (CLOCK_MINUTE_1 + dot);
+    }
+}
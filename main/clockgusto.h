@@ -1,5 +1,6 @@
 #pragma once
 
+#include "esp_err.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -78,6 +79,22 @@ static clock_word_str_t clock_word_str[] = {
     { .data = "min4", .size = 4 },
 };
 
+typedef enum _clockgusto_mode_t
+{
+    CLOCKGUSTO_MODE_CLOCK,
+    CLOCKGUSTO_MODE_TEMPERATURE,    // number words plus quarter degree dots, coloured by temperature
+
+    CLOCKGUSTO_MODE_COUNT
+} clockgusto_mode_t;
+
+typedef struct _clockgusto_health_t
+{
+    uint32_t render_errors;         // frames the led strip did not take
+    uint32_t render_recoveries;     // stuck transfers aborted
+    uint32_t rtc_failures;
+    bool degraded;                  // shown from the last known time, no source answers
+} clockgusto_health_t;
+
 typedef struct _clock_word_boundary_t
 {
     uint16_t index;
@@ -114,7 +131,23 @@ void clockgusto_show();
 /** */
 void clockgusto_reset();
 
+/** */
+void clockgusto_set_mode(clockgusto_mode_t mode);
 
+/** */
+clockgusto_mode_t clockgusto_get_mode();
+
+/** Brightness in percent before derating. */
+void clockgusto_set_brightness(uint8_t brightness);
 
+/** */
+uint8_t clockgusto_get_brightness();
 
+/** Words lit on the face, one bit per clock_word_t. */
+uint32_t clockgusto_get_time_mask();
+
+/** */
+void clockgusto_get_health(clockgusto_health_t* health);
 
+/** Blanks the face and deep sleeps until the DS3231 alarm fires. Only returns on failure. */
+esp_err_t clockgusto_sleep_until_alarm();
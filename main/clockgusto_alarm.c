@@ -0,0 +1,352 @@
+#include "clockgusto_alarm.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "driver/rtc_io.h"
+#include "nvs.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "clockgusto_events.h"
+#include "clockgusto_sunrise_table.h"
+#include "clockgusto_tz.h"
+#include "rtc_ds3231.h"
+
+#define CLOCKGUSTO_ALARM_NVS_NAMESPACE  "alarm"
+#define CLOCKGUSTO_ALARM_NVS_KEY        "config"
+#define CLOCKGUSTO_ALARM_SUNRISE_S      (30 * 60)
+#define CLOCKGUSTO_ALARM_RING_S         (30 * 60)   // daylight stays on this long unless dismissed
+#define CLOCKGUSTO_ALARM_CHECK_MS       10000       // state timeouts while a sunrise or alarm shows
+#define CLOCKGUSTO_ALARM_TASK_STACK     3072
+#define CLOCKGUSTO_ALARM_TASK_PRIORITY  (tskIDLE_PRIORITY + 2)
+
+static const char *TAG = "clockgusto alarm";
+
+static clockgusto_alarm_config_t s_config = {
+    .enabled = false,
+    .hour = 7,
+    .minute = 0,
+    .days = 0x3E,   // monday to friday
+    .sunrise = true,
+};
+static TaskHandle_t s_task = NULL;
+static gpio_num_t s_gpio;
+static volatile clockgusto_alarm_state_t s_state = CLOCKGUSTO_ALARM_IDLE;
+static volatile int64_t s_state_since_us = 0;
+static volatile bool s_rearm = false;
+
+static void clockgusto_alarm_isr(void* arg)
+{
+    (void)arg;
+    // the line stays low until the task clears the flags
+    gpio_intr_disable(s_gpio);
+
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(s_task, &woken);
+    if (woken)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+/** Next UTC instant the configured local alarm time comes round, honouring a DST switch in between. */
+static time_t clockgusto_alarm_next_utc(time_t now)
+{
+    int64_t local = (int64_t)now + clockgusto_tz_get_offset_s(now);
+    int64_t midnight = local - ((local % 86400) + 86400) % 86400;
+    int64_t alarm_local = midnight + s_config.hour * 3600 + s_config.minute * 60;
+    if (alarm_local <= local)
+    {
+        alarm_local += 86400;
+    }
+
+    time_t guess = (time_t)(alarm_local - clockgusto_tz_get_offset_s(now));
+    return (time_t)(alarm_local - clockgusto_tz_get_offset_s(guess));
+}
+
+static bool clockgusto_alarm_day_enabled(time_t alarm_utc)
+{
+    struct tm local_time;
+    clockgusto_tz_to_local(alarm_utc, &local_time);
+
+    return (s_config.days & (1 << local_time.tm_wday)) != 0;
+}
+
+/** Alarm 2 marks the alarm itself, alarm 1 the start of the sunrise. Both match daily, the weekday
+ *  filter runs when they fire. The rtc holds UTC, so they are reprogrammed after every alarm in case
+ *  a DST switch moved the local time. */
+static esp_err_t clockgusto_alarm_program()
+{
+    if (!s_config.enabled)
+    {
+        return rtc_ds3231_set_alarm_interrupts(false, false);
+    }
+
+    time_t now;
+    time(&now);
+    time_t alarm = clockgusto_alarm_next_utc(now);
+    time_t sunrise = alarm - CLOCKGUSTO_ALARM_SUNRISE_S;
+
+    struct tm alarm_time;
+    gmtime_r(&alarm, &alarm_time);
+    esp_err_t ret = rtc_ds3231_set_alarm2_daily(alarm_time.tm_hour, alarm_time.tm_min);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    struct tm sunrise_time;
+    gmtime_r(&sunrise, &sunrise_time);
+    ret = rtc_ds3231_set_alarm1_daily(sunrise_time.tm_hour, sunrise_time.tm_min, sunrise_time.tm_sec);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    return rtc_ds3231_set_alarm_interrupts(s_config.sunrise, true);
+}
+
+static void clockgusto_alarm_enter(clockgusto_alarm_state_t state)
+{
+    s_state_since_us = esp_timer_get_time();
+    s_state = state;
+    // the web UI shows the dismiss button while the alarm is on
+    clockgusto_events_notify(CLOCKGUSTO_EVENTS_CONFIG);
+}
+
+static void clockgusto_alarm_task(void* arg)
+{
+    (void)arg;
+    TickType_t wait = 0;
+
+    while (true)
+    {
+        // the first pass runs at once and catches an alarm that woke the chip from deep sleep
+        bool notified = ulTaskNotifyTake(pdTRUE, wait) > 0 || wait == 0;
+
+        uint8_t flags = 0;
+        if (notified)
+        {
+            if (rtc_ds3231_take_alarm_flags(&flags) != ESP_OK)
+            {
+                ESP_LOGW(TAG, "alarm flags unreadable");
+            }
+            gpio_intr_enable(s_gpio);
+        }
+
+        time_t now;
+        time(&now);
+        if ((flags & DS3231_STATUS_A1F) && s_config.enabled && s_config.sunrise &&
+            clockgusto_alarm_day_enabled(now + CLOCKGUSTO_ALARM_SUNRISE_S))
+        {
+            ESP_LOGI(TAG, "sunrise");
+            clockgusto_alarm_enter(CLOCKGUSTO_ALARM_SUNRISE);
+        }
+        if (flags & DS3231_STATUS_A2F)
+        {
+            if (s_config.enabled && clockgusto_alarm_day_enabled(now))
+            {
+                ESP_LOGI(TAG, "alarm");
+                clockgusto_alarm_enter(CLOCKGUSTO_ALARM_RINGING);
+            }
+            s_rearm = true;
+        }
+        if (s_rearm)
+        {
+            s_rearm = false;
+            if (clockgusto_alarm_program() != ESP_OK)
+            {
+                ESP_LOGW(TAG, "alarm not reprogrammed");
+            }
+        }
+
+        int64_t elapsed_us = esp_timer_get_time() - s_state_since_us;
+        if (s_state == CLOCKGUSTO_ALARM_SUNRISE && elapsed_us > (CLOCKGUSTO_ALARM_SUNRISE_S + 60) * 1000000LL)
+        {
+            // alarm 2 got lost on the bus, the sunrise still ends in daylight
+            clockgusto_alarm_enter(CLOCKGUSTO_ALARM_RINGING);
+        }
+        else if (s_state == CLOCKGUSTO_ALARM_RINGING && elapsed_us > CLOCKGUSTO_ALARM_RING_S * 1000000LL)
+        {
+            clockgusto_alarm_enter(CLOCKGUSTO_ALARM_IDLE);
+        }
+
+        wait = s_state == CLOCKGUSTO_ALARM_IDLE ? portMAX_DELAY : pdMS_TO_TICKS(CLOCKGUSTO_ALARM_CHECK_MS);
+    }
+}
+
+esp_err_t clockgusto_alarm_init(gpio_num_t int_gpio)
+{
+    s_gpio = int_gpio;
+
+    nvs_handle_t handle;
+    if (nvs_open(CLOCKGUSTO_ALARM_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK)
+    {
+        clockgusto_alarm_config_t config;
+        size_t size = sizeof(config);
+        if (nvs_get_blob(handle, CLOCKGUSTO_ALARM_NVS_KEY, &config, &size) == ESP_OK && size == sizeof(config))
+        {
+            s_config = config;
+        }
+        nvs_close(handle);
+    }
+
+    esp_err_t ret = clockgusto_alarm_program();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "alarm not programmed: %s", esp_err_to_name(ret));
+    }
+
+    gpio_config_t io_config = {
+        .pin_bit_mask = 1ULL << int_gpio,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,   // INT/SQW is open drain and active low
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_LOW_LEVEL,   // unlike an edge, a level also wakes from light sleep
+    };
+    ret = gpio_config(&io_config);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to configure gpio.\n");
+        return ret;
+    }
+
+    ret = gpio_wakeup_enable(int_gpio, GPIO_INTR_LOW_LEVEL);
+    if (ret == ESP_OK)
+    {
+        ret = esp_sleep_enable_gpio_wakeup();
+    }
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to enable light sleep wakeup.\n");
+        return ret;
+    }
+
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE)
+    {
+        ESP_LOGE(TAG, "Failed to install isr service.\n");
+        return ret;
+    }
+
+    if (xTaskCreate(clockgusto_alarm_task, "clockgusto alarm", CLOCKGUSTO_ALARM_TASK_STACK,
+                    NULL, CLOCKGUSTO_ALARM_TASK_PRIORITY, &s_task) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "%s %02u:%02u days 0x%02x%s", s_config.enabled ? "alarm" : "alarm off",
+             s_config.hour, s_config.minute, s_config.days, s_config.sunrise ? " with sunrise" : "");
+    return gpio_isr_handler_add(int_gpio, clockgusto_alarm_isr, NULL);
+}
+
+esp_err_t clockgusto_alarm_set_config(const clockgusto_alarm_config_t* config)
+{
+    if (config->hour > 23 || config->minute > 59 || config->days > 0x7F)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_config = *config;
+    clockgusto_events_notify(CLOCKGUSTO_EVENTS_CONFIG);
+    esp_err_t ret = clockgusto_alarm_program();
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    nvs_handle_t handle;
+    ret = nvs_open(CLOCKGUSTO_ALARM_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    ret = nvs_set_blob(handle, CLOCKGUSTO_ALARM_NVS_KEY, config, sizeof(*config));
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    return ret;
+}
+
+void clockgusto_alarm_get_config(clockgusto_alarm_config_t* config)
+{
+    *config = s_config;
+}
+
+clockgusto_alarm_state_t clockgusto_alarm_get_state()
+{
+    return s_state;
+}
+
+void clockgusto_alarm_dismiss()
+{
+    clockgusto_alarm_enter(CLOCKGUSTO_ALARM_IDLE);
+}
+
+void clockgusto_alarm_rearm()
+{
+    s_rearm = true;
+    if (s_task)
+    {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+bool clockgusto_alarm_get_sunrise(uint8_t* grb)
+{
+    clockgusto_alarm_state_t state = s_state;
+    if (state == CLOCKGUSTO_ALARM_IDLE)
+    {
+        return false;
+    }
+
+    // position on the curve in 1/256 steps between table entries
+    int64_t elapsed_ms = (esp_timer_get_time() - s_state_since_us) / 1000;
+    int64_t position = elapsed_ms * (CLOCKGUSTO_SUNRISE_TABLE_POINTS - 1) * 256 / (CLOCKGUSTO_ALARM_SUNRISE_S * 1000);
+    uint32_t index = (uint32_t)(position >> 8);
+    if (state == CLOCKGUSTO_ALARM_RINGING || index >= CLOCKGUSTO_SUNRISE_TABLE_POINTS - 1)
+    {
+        for (uint8_t channel = 0; channel < 3; ++channel)
+        {
+            grb[channel] = clockgusto_sunrise_table[CLOCKGUSTO_SUNRISE_TABLE_POINTS - 1][channel];
+        }
+        return true;
+    }
+
+    int32_t fraction = (int32_t)(position & 0xFF);
+    for (uint8_t channel = 0; channel < 3; ++channel)
+    {
+        int32_t from = clockgusto_sunrise_table[index][channel];
+        int32_t to = clockgusto_sunrise_table[index + 1][channel];
+        grb[channel] = (uint8_t)(from + (to - from) * fraction / 256);
+    }
+    return true;
+}
+
+esp_err_t clockgusto_alarm_sleep()
+{
+    if (!s_config.enabled)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    rtc_gpio_pullup_en(s_gpio);
+    rtc_gpio_pulldown_dis(s_gpio);
+    esp_err_t ret = esp_sleep_enable_ext0_wakeup(s_gpio, 0);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "sleeping until the next alarm");
+    esp_deep_sleep_start();
+
+    return ESP_OK;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct _clockgusto_alarm_config_t
+{
+    bool enabled;
+    uint8_t hour;           // local time
+    uint8_t minute;
+    uint8_t days;           // bit 0 sunday .. bit 6 saturday
+    bool sunrise;           // 30 minute ramp before the alarm
+} clockgusto_alarm_config_t;
+
+typedef enum _clockgusto_alarm_state_t
+{
+    CLOCKGUSTO_ALARM_IDLE,
+    CLOCKGUSTO_ALARM_SUNRISE,
+    CLOCKGUSTO_ALARM_RINGING,
+} clockgusto_alarm_state_t;
+
+/** Loads the configuration from NVS, programs the DS3231 alarms and waits for its INT/SQW line on
+ *  int_gpio, which has to be an RTC GPIO for clockgusto_alarm_sleep(). An alarm that woke the chip
+ *  is picked up right away. */
+esp_err_t clockgusto_alarm_init(gpio_num_t int_gpio);
+
+/** Programs the hardware alarms and persists config. */
+esp_err_t clockgusto_alarm_set_config(const clockgusto_alarm_config_t* config);
+
+/** */
+void clockgusto_alarm_get_config(clockgusto_alarm_config_t* config);
+
+/** */
+clockgusto_alarm_state_t clockgusto_alarm_get_state();
+
+/** Ends the sunrise or the ringing alarm, the next one stays programmed. */
+void clockgusto_alarm_dismiss();
+
+/** Has the alarm task program the DS3231 alarms again. They hold UTC, so this is due whenever the
+ *  clock was set or the time zone rule changed. Cheap, the bus work happens on the alarm task. */
+void clockgusto_alarm_rearm();
+
+/** Current sunrise colour in strip byte order, interpolated from the precomputed curve. Returns false
+ *  while no sunrise or alarm is showing. Cheap enough for every frame. */
+bool clockgusto_alarm_get_sunrise(uint8_t* grb);
+
+/** Deep sleeps until the DS3231 pulls its INT/SQW line, i.e. the next sunrise or alarm. */
+esp_err_t clockgusto_alarm_sleep();
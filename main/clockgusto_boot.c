@@ -0,0 +1,77 @@
+#include "clockgusto_boot.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "clockgusto boot";
+
+static const char* s_stage_names[CLOCKGUSTO_BOOT_STAGE_COUNT] = {
+    "app_main",
+    "rmt",
+    "nvs",
+    "i2c",
+    "startup",
+    "rtc read",
+    "first frame",
+};
+
+// 0 while a stage is not reached, the esp_timer is well past it by app_main
+static int64_t s_stage_us[CLOCKGUSTO_BOOT_STAGE_COUNT];
+static bool s_over_budget = false;
+
+static void clockgusto_boot_report()
+{
+    int64_t previous_us = 0;
+    for (uint8_t stage = 0; stage < CLOCKGUSTO_BOOT_STAGE_COUNT; ++stage)
+    {
+        if (s_stage_us[stage] == 0)
+        {
+            continue;
+        }
+        ESP_LOGI(TAG, "%-12s %7ld us  +%ld us", s_stage_names[stage], (long)s_stage_us[stage],
+                 (long)(s_stage_us[stage] - previous_us));
+        previous_us = s_stage_us[stage];
+    }
+
+    uint32_t total_ms = (uint32_t)(s_stage_us[CLOCKGUSTO_BOOT_FIRST_FRAME] / 1000);
+    s_over_budget = CONFIG_CLOCKGUSTO_BOOT_BUDGET_MS > 0 && total_ms > CONFIG_CLOCKGUSTO_BOOT_BUDGET_MS;
+    if (s_over_budget)
+    {
+        ESP_LOGW(TAG, "correct time after %lu ms, budget %d ms", (unsigned long)total_ms,
+                 CONFIG_CLOCKGUSTO_BOOT_BUDGET_MS);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "correct time after %lu ms", (unsigned long)total_ms);
+    }
+}
+
+void clockgusto_boot_mark(clockgusto_boot_stage_t stage)
+{
+    if (stage >= CLOCKGUSTO_BOOT_STAGE_COUNT || s_stage_us[stage] != 0)
+    {
+        return;
+    }
+
+    s_stage_us[stage] = esp_timer_get_time();
+    if (stage == CLOCKGUSTO_BOOT_FIRST_FRAME)
+    {
+        clockgusto_boot_report();
+    }
+}
+
+void clockgusto_boot_get_report(clockgusto_boot_report_t* report)
+{
+    for (uint8_t stage = 0; stage < CLOCKGUSTO_BOOT_STAGE_COUNT; ++stage)
+    {
+        report->stage_us[stage] = s_stage_us[stage] != 0 ? s_stage_us[stage] : -1;
+    }
+    report->budget_ms = CONFIG_CLOCKGUSTO_BOOT_BUDGET_MS;
+    report->over_budget = s_over_budget;
+}
+
+const char* clockgusto_boot_stage_name(clockgusto_boot_stage_t stage)
+{
+    return stage < CLOCKGUSTO_BOOT_STAGE_COUNT ? s_stage_names[stage] : "unknown";
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum _clockgusto_boot_stage_t
+{
+    CLOCKGUSTO_BOOT_APP_MAIN,       // bootloader and startup code done
+    CLOCKGUSTO_BOOT_RMT,            // channel and encoder created
+    CLOCKGUSTO_BOOT_NVS,
+    CLOCKGUSTO_BOOT_I2C,            // bus up, DS3231 registered
+    CLOCKGUSTO_BOOT_STARTUP,        // word table built
+    CLOCKGUSTO_BOOT_RTC_READ,       // system clock seeded
+    CLOCKGUSTO_BOOT_FIRST_FRAME,    // first frame with the correct time on the strip
+
+    CLOCKGUSTO_BOOT_STAGE_COUNT
+} clockgusto_boot_stage_t;
+
+typedef struct _clockgusto_boot_report_t
+{
+    int64_t stage_us[CLOCKGUSTO_BOOT_STAGE_COUNT];  // esp_timer time, the bootloader is not counted, -1 while not reached
+    uint32_t budget_ms;
+    bool over_budget;
+} clockgusto_boot_report_t;
+
+/** Records the first time a stage is reached. The first frame completes the boot, logs the report
+ *  and checks it against CONFIG_CLOCKGUSTO_BOOT_BUDGET_MS. */
+void clockgusto_boot_mark(clockgusto_boot_stage_t stage);
+
+/** */
+void clockgusto_boot_get_report(clockgusto_boot_report_t* report);
+
+/** */
+const char* clockgusto_boot_stage_name(clockgusto_boot_stage_t stage);
@@ -0,0 +1,217 @@
+#include "clockgusto_calibration.h"
+
+#include "esp_log.h"
+#include "nvs.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "clockgusto_drift.h"
+#include "rtc_ds3231.h"
+
+#define CLOCKGUSTO_CALIBRATION_NVS_NAMESPACE   "calibration"
+#define CLOCKGUSTO_CALIBRATION_NVS_KEY         "state"
+#define CLOCKGUSTO_CALIBRATION_VERSION         1
+#define CLOCKGUSTO_CALIBRATION_PPM_PER_LSB     0.1f
+#define CLOCKGUSTO_CALIBRATION_DEADBAND_PPM    0.15f
+#define CLOCKGUSTO_CALIBRATION_MAX_STEP_LSB    8
+#define CLOCKGUSTO_CALIBRATION_MIN_INTERVAL_S  (3 * 24 * 3600)
+#define CLOCKGUSTO_CALIBRATION_MAX_RESIDUAL_US 20000.0f
+#define CLOCKGUSTO_CALIBRATION_SYNC_DEFAULT_S  3600
+#define CLOCKGUSTO_CALIBRATION_SYNC_TRIMMED_S  (24 * 3600)
+#define CLOCKGUSTO_CALIBRATION_SAVE_SAMPLES    6        // kept samples between writes, a day at 4 h apart
+
+typedef struct _clockgusto_calibration_state_t
+{
+    uint32_t version;
+    int8_t aging_offset;
+    bool estimated;
+    bool trimmed;
+    uint32_t last_adjust_s;
+    int64_t rtc_step_us;
+    float ppm;
+    clockgusto_drift_t drift;
+} clockgusto_calibration_state_t;
+
+static const char *TAG = "clockgusto calibration";
+
+static clockgusto_calibration_state_t s_calibration;
+static uint8_t s_unsaved_samples = 0;
+
+static void clockgusto_calibration_save()
+{
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(CLOCKGUSTO_CALIBRATION_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "nvs open failed: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    ret = nvs_set_blob(handle, CLOCKGUSTO_CALIBRATION_NVS_KEY, &s_calibration, sizeof(s_calibration));
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(handle);
+    }
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "nvs write failed: %s", esp_err_to_name(ret));
+    }
+    nvs_close(handle);
+    s_unsaved_samples = 0;
+}
+
+static void clockgusto_calibration_restart_fit()
+{
+    clockgusto_drift_reset(&s_calibration.drift);
+    s_calibration.rtc_step_us = 0;
+    s_calibration.estimated = false;
+}
+
+/** Returns whether the aging register changed. */
+static bool clockgusto_calibration_adjust(uint32_t reference_s)
+{
+    if (reference_s - s_calibration.last_adjust_s < CLOCKGUSTO_CALIBRATION_MIN_INTERVAL_S ||
+        fabsf(s_calibration.ppm) < CLOCKGUSTO_CALIBRATION_DEADBAND_PPM)
+    {
+        return false;
+    }
+
+    int32_t step = lroundf(s_calibration.ppm / CLOCKGUSTO_CALIBRATION_PPM_PER_LSB);
+    if (step > CLOCKGUSTO_CALIBRATION_MAX_STEP_LSB)
+    {
+        step = CLOCKGUSTO_CALIBRATION_MAX_STEP_LSB;
+    }
+    else if (step < -CLOCKGUSTO_CALIBRATION_MAX_STEP_LSB)
+    {
+        step = -CLOCKGUSTO_CALIBRATION_MAX_STEP_LSB;
+    }
+
+    int32_t aging_offset = s_calibration.aging_offset + step;
+    if (aging_offset > INT8_MAX)
+    {
+        aging_offset = INT8_MAX;
+    }
+    else if (aging_offset < INT8_MIN)
+    {
+        aging_offset = INT8_MIN;
+    }
+    if (aging_offset == s_calibration.aging_offset)
+    {
+        return false;
+    }
+
+    esp_err_t ret = rtc_ds3231_set_aging_offset((int8_t)aging_offset);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "aging offset write failed: %s", esp_err_to_name(ret));
+        return false;
+    }
+
+    ESP_LOGI(TAG, "drift %.2f ppm, aging offset %d -> %ld",
+             s_calibration.ppm, s_calibration.aging_offset, (long)aging_offset);
+    s_calibration.aging_offset = (int8_t)aging_offset;
+    s_calibration.last_adjust_s = reference_s;
+    s_calibration.trimmed = false;
+
+    // the oscillator runs at a new rate, earlier samples no longer describe it
+    clockgusto_calibration_restart_fit();
+    return true;
+}
+
+esp_err_t clockgusto_calibration_init()
+{
+    memset(&s_calibration, 0, sizeof(s_calibration));
+
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(CLOCKGUSTO_CALIBRATION_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (ret == ESP_OK)
+    {
+        size_t size = sizeof(s_calibration);
+        ret = nvs_get_blob(handle, CLOCKGUSTO_CALIBRATION_NVS_KEY, &s_calibration, &size);
+        nvs_close(handle);
+        if (ret != ESP_OK || size != sizeof(s_calibration) ||
+            s_calibration.version != CLOCKGUSTO_CALIBRATION_VERSION)
+        {
+            memset(&s_calibration, 0, sizeof(s_calibration));
+        }
+    }
+    s_calibration.version = CLOCKGUSTO_CALIBRATION_VERSION;
+
+    int8_t aging_offset;
+    ret = rtc_ds3231_get_aging_offset(&aging_offset);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    if (aging_offset != s_calibration.aging_offset)
+    {
+        // the register falls back to zero when the backup supply is lost
+        ESP_LOGI(TAG, "restore aging offset %d (rtc holds %d)", s_calibration.aging_offset, aging_offset);
+        ret = rtc_ds3231_set_aging_offset(s_calibration.aging_offset);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+
+    ESP_LOGI(TAG, "aging offset %d, %u samples, %s",
+             s_calibration.aging_offset, s_calibration.drift.count,
+             s_calibration.trimmed ? "trimmed" : "untrimmed");
+    return ESP_OK;
+}
+
+void clockgusto_calibration_add_sample(uint32_t reference_s, int64_t rtc_offset_us)
+{
+    if (!clockgusto_drift_add(&s_calibration.drift, reference_s, (int32_t)(rtc_offset_us - s_calibration.rtc_step_us)))
+    {
+        return;
+    }
+
+    bool was_estimated = s_calibration.estimated;
+    bool was_trimmed = s_calibration.trimmed;
+    bool adjusted = false;
+    clockgusto_drift_estimate_t estimate;
+    s_calibration.estimated = clockgusto_drift_estimate(&s_calibration.drift, &estimate);
+    if (s_calibration.estimated)
+    {
+        s_calibration.ppm = estimate.ppm;
+        s_calibration.trimmed = fabsf(estimate.ppm) < CLOCKGUSTO_CALIBRATION_DEADBAND_PPM &&
+                                estimate.residual_us < CLOCKGUSTO_CALIBRATION_MAX_RESIDUAL_US;
+        ESP_LOGI(TAG, "drift %.3f ppm over %lu s, residual %.1f ms, %u used, %u rejected",
+                 estimate.ppm, (unsigned long)estimate.span_s, estimate.residual_us / 1000.0f,
+                 estimate.used, estimate.rejected);
+        adjusted = clockgusto_calibration_adjust(reference_s);
+    }
+
+    // the ring alone is worth a flash write only every few samples, losing them costs a day of fit
+    if (adjusted || was_estimated != s_calibration.estimated || was_trimmed != s_calibration.trimmed ||
+        ++s_unsaved_samples >= CLOCKGUSTO_CALIBRATION_SAVE_SAMPLES)
+    {
+        clockgusto_calibration_save();
+    }
+}
+
+void clockgusto_calibration_note_rtc_step(int64_t step_us)
+{
+    s_calibration.rtc_step_us += step_us;
+    clockgusto_calibration_save();
+}
+
+void clockgusto_calibration_discard()
+{
+    clockgusto_calibration_restart_fit();
+    clockgusto_calibration_save();
+}
+
+uint32_t clockgusto_calibration_get_sync_interval_s()
+{
+    return s_calibration.trimmed ? CLOCKGUSTO_CALIBRATION_SYNC_TRIMMED_S : CLOCKGUSTO_CALIBRATION_SYNC_DEFAULT_S;
+}
+
+bool clockgusto_calibration_get_ppm(float* ppm)
+{
+    *ppm = s_calibration.ppm;
+    return s_calibration.estimated;
+}
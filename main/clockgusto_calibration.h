@@ -0,0 +1,25 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Restores the calibration state from NVS and re-applies the aging offset if the DS3231 lost it. */
+esp_err_t clockgusto_calibration_init();
+
+/** Feeds an rtc minus reference offset measured at reference time reference_s. Refits the drift and
+ *  writes a new aging offset when the estimate is good and the rate limit allows it. NVS is written
+ *  when the aging offset or the fit state changes, otherwise every few samples. */
+void clockgusto_calibration_add_sample(uint32_t reference_s, int64_t rtc_offset_us);
+
+/** Records that the rtc was rewritten and moved by step_us, so the fit stays continuous. */
+void clockgusto_calibration_note_rtc_step(int64_t step_us);
+
+/** Drops the samples after an rtc write of unknown size. */
+void clockgusto_calibration_discard();
+
+/** Network sync interval the current estimate allows. Grows once the rtc is calibrated. */
+uint32_t clockgusto_calibration_get_sync_interval_s();
+
+/** */
+bool clockgusto_calibration_get_ppm(float* ppm);
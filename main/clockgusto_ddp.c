@@ -0,0 +1,86 @@
+#include "clockgusto_ddp.h"
+
+#define CLOCKGUSTO_DDP_TYPE_RGB         0x08    // TTT bits of the data type
+#define CLOCKGUSTO_DDP_TYPE_MASK        0x38
+#define CLOCKGUSTO_DDP_SIZE_8_BIT       0x03    // SSS bits
+#define CLOCKGUSTO_DDP_SIZE_MASK        0x07
+#define CLOCKGUSTO_DDP_CUSTOM_TYPE      0x80
+
+// strip byte for each RGB channel
+static const uint8_t s_channel_order[3] = { 2, 0, 1 };
+
+bool clockgusto_ddp_parse_header(const uint8_t* data, size_t size, clockgusto_ddp_header_t* header)
+{
+    if (size < CLOCKGUSTO_DDP_HEADER_SIZE)
+    {
+        return false;
+    }
+
+    header->flags = data[0];
+    header->sequence = data[1] & 0x0f;
+    header->data_type = data[2];
+    header->destination = data[3];
+    header->offset = (uint32_t)data[4] << 24 | (uint32_t)data[5] << 16 | (uint32_t)data[6] << 8 | data[7];
+    header->length = (uint16_t)(data[8] << 8 | data[9]);
+    header->size = header->flags & CLOCKGUSTO_DDP_FLAG_TIMECODE ? CLOCKGUSTO_DDP_MAX_HEADER_SIZE
+                                                                : CLOCKGUSTO_DDP_HEADER_SIZE;
+
+    if ((header->flags & CLOCKGUSTO_DDP_FLAG_VERSION_MASK) != CLOCKGUSTO_DDP_FLAG_VERSION_1 || size < header->size)
+    {
+        return false;
+    }
+    if (header->flags & (CLOCKGUSTO_DDP_FLAG_QUERY | CLOCKGUSTO_DDP_FLAG_REPLY | CLOCKGUSTO_DDP_FLAG_STORAGE))
+    {
+        return false;
+    }
+    if (header->destination != CLOCKGUSTO_DDP_ID_DISPLAY && header->destination != CLOCKGUSTO_DDP_ID_ALL)
+    {
+        return false;
+    }
+
+    uint8_t type = header->data_type & CLOCKGUSTO_DDP_TYPE_MASK;
+    uint8_t bits = header->data_type & CLOCKGUSTO_DDP_SIZE_MASK;
+    return !(header->data_type & CLOCKGUSTO_DDP_CUSTOM_TYPE) && (type == 0 || type == CLOCKGUSTO_DDP_TYPE_RGB) &&
+           (bits == 0 || bits == CLOCKGUSTO_DDP_SIZE_8_BIT);
+}
+
+void clockgusto_ddp_write(uint8_t* frame, size_t frame_size, uint32_t offset, const uint8_t* data, size_t length)
+{
+    if (offset >= frame_size)
+    {
+        return;
+    }
+    if (length > frame_size - offset)
+    {
+        length = frame_size - offset;
+    }
+
+    uint32_t pixel_start = offset - offset % 3;
+    uint8_t channel = offset % 3;
+    for (size_t idx = 0; idx < length; ++idx)
+    {
+        frame[pixel_start + s_channel_order[channel]] = data[idx];
+        if (++channel == 3)
+        {
+            channel = 0;
+            pixel_start += 3;
+        }
+    }
+}
+
+size_t clockgusto_ddp_build_header(uint8_t* data, uint8_t flags, uint8_t sequence, uint32_t offset,
+                                   uint16_t length)
+{
+    data[0] = CLOCKGUSTO_DDP_FLAG_VERSION_1 | (flags & ~CLOCKGUSTO_DDP_FLAG_VERSION_MASK & ~CLOCKGUSTO_DDP_FLAG_TIMECODE);
+    data[1] = sequence & 0x0f;
+    data[2] = CLOCKGUSTO_DDP_TYPE_RGB | CLOCKGUSTO_DDP_SIZE_8_BIT;
+    data[3] = CLOCKGUSTO_DDP_ID_DISPLAY;
+    data[4] = (uint8_t)(offset >> 24);
+    data[5] = (uint8_t)(offset >> 16);
+    data[6] = (uint8_t)(offset >> 8);
+    data[7] = (uint8_t)offset;
+    data[8] = (uint8_t)(length >> 8);
+    data[9] = (uint8_t)length;
+
+    return CLOCKGUSTO_DDP_HEADER_SIZE;
+}
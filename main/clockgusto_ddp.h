@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLOCKGUSTO_DDP_PORT             4048
+#define CLOCKGUSTO_DDP_HEADER_SIZE      10
+#define CLOCKGUSTO_DDP_TIMECODE_SIZE    4       // follows the header when the timecode flag is set
+#define CLOCKGUSTO_DDP_MAX_HEADER_SIZE  (CLOCKGUSTO_DDP_HEADER_SIZE + CLOCKGUSTO_DDP_TIMECODE_SIZE)
+
+#define CLOCKGUSTO_DDP_FLAG_VERSION_MASK 0xc0
+#define CLOCKGUSTO_DDP_FLAG_VERSION_1   0x40
+#define CLOCKGUSTO_DDP_FLAG_TIMECODE    0x10
+#define CLOCKGUSTO_DDP_FLAG_STORAGE     0x08
+#define CLOCKGUSTO_DDP_FLAG_REPLY       0x04
+#define CLOCKGUSTO_DDP_FLAG_QUERY       0x02
+#define CLOCKGUSTO_DDP_FLAG_PUSH        0x01    // the frame is complete, show it
+
+#define CLOCKGUSTO_DDP_ID_DISPLAY       1
+#define CLOCKGUSTO_DDP_ID_ALL           255
+
+/* Plain C without ESP-IDF dependencies, so the decoder can be tested over loopback on a host. */
+
+/** Distributed Display Protocol, http://www.3waylabs.com/ddp/ */
+typedef struct _clockgusto_ddp_header_t
+{
+    uint8_t flags;
+    uint8_t sequence;               // 1 .. 15, 0 when unused
+    uint8_t data_type;
+    uint8_t destination;
+    uint32_t offset;                // in bytes of RGB data
+    uint16_t length;
+    uint8_t size;                   // header bytes before the data
+} clockgusto_ddp_header_t;
+
+/** Reads the header from the first bytes of a packet. Only version 1 pixel data for the display is
+ *  accepted: 8 bit RGB, or an undefined type, which senders use for the same thing. */
+bool clockgusto_ddp_parse_header(const uint8_t* data, size_t size, clockgusto_ddp_header_t* header);
+
+/** Writes RGB data that starts at byte offset of the frame into a strip frame in green, blue, red
+ *  order, dropping whatever lies past frame_size. Called once per buffer of a chained packet. */
+void clockgusto_ddp_write(uint8_t* frame, size_t frame_size, uint32_t offset, const uint8_t* data, size_t length);
+
+/** Builds a header, for senders and tests. Returns its size. */
+size_t clockgusto_ddp_build_header(uint8_t* data, uint8_t flags, uint8_t sequence, uint32_t offset,
+                                   uint16_t length);
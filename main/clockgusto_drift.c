@@ -0,0 +1,169 @@
+#include "clockgusto_drift.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CLOCKGUSTO_DRIFT_REJECT_MADS     3.0
+#define CLOCKGUSTO_DRIFT_MAD_SCALE       1.4826  // MAD to standard deviation for normal noise
+#define CLOCKGUSTO_DRIFT_MIN_TOLERANCE   5000.0  // us, below this a residual is network jitter
+
+static const clockgusto_drift_sample_t* clockgusto_drift_at(const clockgusto_drift_t* drift, uint8_t idx)
+{
+    uint8_t first = (drift->head + CLOCKGUSTO_DRIFT_MAX_SAMPLES - drift->count) % CLOCKGUSTO_DRIFT_MAX_SAMPLES;
+    return &drift->samples[(first + idx) % CLOCKGUSTO_DRIFT_MAX_SAMPLES];
+}
+
+static bool clockgusto_drift_fit(const clockgusto_drift_t* drift, const bool* keep, double* slope, double* intercept)
+{
+    uint32_t origin_s = clockgusto_drift_at(drift, 0)->time_s;
+    double n = 0.0;
+    double sum_t = 0.0;
+    double sum_o = 0.0;
+    double sum_tt = 0.0;
+    double sum_to = 0.0;
+
+    for (uint8_t idx = 0; idx < drift->count; ++idx)
+    {
+        if (!keep[idx])
+        {
+            continue;
+        }
+        const clockgusto_drift_sample_t* sample = clockgusto_drift_at(drift, idx);
+        double t = (double)(sample->time_s - origin_s);
+        double o = (double)sample->offset_us;
+        n += 1.0;
+        sum_t += t;
+        sum_o += o;
+        sum_tt += t * t;
+        sum_to += t * o;
+    }
+
+    double denominator = n * sum_tt - sum_t * sum_t;
+    if (n < 2.0 || denominator <= 0.0)
+    {
+        return false;
+    }
+
+    *slope = (n * sum_to - sum_t * sum_o) / denominator;
+    *intercept = (sum_o - *slope * sum_t) / n;
+    return true;
+}
+
+static double clockgusto_drift_median(double* values, uint8_t count)
+{
+    // insertion sort, count is bounded by CLOCKGUSTO_DRIFT_MAX_SAMPLES
+    for (uint8_t i = 1; i < count; ++i)
+    {
+        double value = values[i];
+        int16_t j = i - 1;
+        while (j >= 0 && values[j] > value)
+        {
+            values[j + 1] = values[j];
+            --j;
+        }
+        values[j + 1] = value;
+    }
+
+    return (count % 2) ? values[count / 2] : 0.5 * (values[count / 2 - 1] + values[count / 2]);
+}
+
+void clockgusto_drift_reset(clockgusto_drift_t* drift)
+{
+    memset(drift, 0, sizeof(*drift));
+}
+
+bool clockgusto_drift_add(clockgusto_drift_t* drift, uint32_t time_s, int32_t offset_us)
+{
+    if (drift->count > 0 &&
+        time_s - clockgusto_drift_at(drift, drift->count - 1)->time_s < CLOCKGUSTO_DRIFT_MIN_INTERVAL_S)
+    {
+        return false;
+    }
+
+    drift->samples[drift->head] = (clockgusto_drift_sample_t){
+        .time_s = time_s,
+        .offset_us = offset_us,
+    };
+    drift->head = (drift->head + 1) % CLOCKGUSTO_DRIFT_MAX_SAMPLES;
+    if (drift->count < CLOCKGUSTO_DRIFT_MAX_SAMPLES)
+    {
+        ++drift->count;
+    }
+    return true;
+}
+
+bool clockgusto_drift_estimate(const clockgusto_drift_t* drift, clockgusto_drift_estimate_t* estimate)
+{
+    if (drift->count < CLOCKGUSTO_DRIFT_MIN_SAMPLES)
+    {
+        return false;
+    }
+
+    uint32_t origin_s = clockgusto_drift_at(drift, 0)->time_s;
+    uint32_t span_s = clockgusto_drift_at(drift, drift->count - 1)->time_s - origin_s;
+    if (span_s < CLOCKGUSTO_DRIFT_MIN_SPAN_S)
+    {
+        return false;
+    }
+
+    bool keep[CLOCKGUSTO_DRIFT_MAX_SAMPLES];
+    double residuals[CLOCKGUSTO_DRIFT_MAX_SAMPLES];
+    double deviations[CLOCKGUSTO_DRIFT_MAX_SAMPLES];
+    memset(keep, true, sizeof(keep));
+
+    double slope;
+    double intercept;
+    if (!clockgusto_drift_fit(drift, keep, &slope, &intercept))
+    {
+        return false;
+    }
+
+    for (uint8_t idx = 0; idx < drift->count; ++idx)
+    {
+        const clockgusto_drift_sample_t* sample = clockgusto_drift_at(drift, idx);
+        residuals[idx] = sample->offset_us - (intercept + slope * (double)(sample->time_s - origin_s));
+        deviations[idx] = residuals[idx];
+    }
+    double center = clockgusto_drift_median(deviations, drift->count);
+    for (uint8_t idx = 0; idx < drift->count; ++idx)
+    {
+        deviations[idx] = fabs(residuals[idx] - center);
+    }
+    double mad = clockgusto_drift_median(deviations, drift->count);
+    double tolerance = fmax(CLOCKGUSTO_DRIFT_REJECT_MADS * CLOCKGUSTO_DRIFT_MAD_SCALE * mad,
+                            CLOCKGUSTO_DRIFT_MIN_TOLERANCE);
+
+    uint8_t used = 0;
+    for (uint8_t idx = 0; idx < drift->count; ++idx)
+    {
+        keep[idx] = fabs(residuals[idx] - center) <= tolerance;
+        used += keep[idx];
+    }
+    if (used < CLOCKGUSTO_DRIFT_MIN_SAMPLES || !clockgusto_drift_fit(drift, keep, &slope, &intercept))
+    {
+        return false;
+    }
+
+    double square_sum = 0.0;
+    for (uint8_t idx = 0; idx < drift->count; ++idx)
+    {
+        if (keep[idx])
+        {
+            const clockgusto_drift_sample_t* sample = clockgusto_drift_at(drift, idx);
+            double residual = sample->offset_us - (intercept + slope * (double)(sample->time_s - origin_s));
+            square_sum += residual * residual;
+        }
+    }
+
+    // the slope is in us per s, which is ppm
+    *estimate = (clockgusto_drift_estimate_t){
+        .ppm = (float)slope,
+        .residual_us = (float)sqrt(square_sum / used),
+        .span_s = span_s,
+        .used = used,
+        .rejected = drift->count - used,
+    };
+    return true;
+}
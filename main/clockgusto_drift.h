@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CLOCKGUSTO_DRIFT_MAX_SAMPLES    48
+#define CLOCKGUSTO_DRIFT_MIN_SAMPLES    6
+#define CLOCKGUSTO_DRIFT_MIN_SPAN_S     (2 * 24 * 3600)
+#define CLOCKGUSTO_DRIFT_MIN_INTERVAL_S (4 * 3600)  // the ring covers 8 days of hourly syncs
+
+/* Plain C without ESP-IDF dependencies, so recorded drift traces can be replayed on a host. */
+
+typedef struct _clockgusto_drift_sample_t
+{
+    uint32_t time_s;        // reference time of the measurement
+    int32_t offset_us;      // rtc minus reference, with earlier rtc corrections added back
+} clockgusto_drift_sample_t;
+
+typedef struct _clockgusto_drift_t
+{
+    clockgusto_drift_sample_t samples[CLOCKGUSTO_DRIFT_MAX_SAMPLES];
+    uint8_t head;
+    uint8_t count;
+} clockgusto_drift_t;
+
+typedef struct _clockgusto_drift_estimate_t
+{
+    float ppm;              // positive when the rtc runs fast
+    float residual_us;      // rms residual of the samples kept in the fit
+    uint32_t span_s;
+    uint8_t used;
+    uint8_t rejected;
+} clockgusto_drift_estimate_t;
+
+/** */
+void clockgusto_drift_reset(clockgusto_drift_t* drift);
+
+/** Adds a sample, dropping the oldest one once the ring is full. Samples less than
+ *  CLOCKGUSTO_DRIFT_MIN_INTERVAL_S after the newest one are skipped; returns whether it was kept. */
+bool clockgusto_drift_add(clockgusto_drift_t* drift, uint32_t time_s, int32_t offset_us);
+
+/** Fits offset over time by least squares, rejects samples beyond 3 MAD of the first fit and fits
+ *  again. Returns false until enough samples over a long enough span are available. */
+bool clockgusto_drift_estimate(const clockgusto_drift_t* drift, clockgusto_drift_estimate_t* estimate);
@@ -0,0 +1,407 @@
+#include "clockgusto_events.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clockgusto.h"
+#include "clockgusto_log.h"
+#include "clockgusto_mqtt.h"
+
+#define CLOCKGUSTO_EVENTS_POLL_TIMEOUT_MS   25000   // below the idle timeouts of phones and proxies
+#define CLOCKGUSTO_EVENTS_KEEPALIVE_MS      25000   // finds dead streams without app traffic
+#define CLOCKGUSTO_EVENTS_COALESCE_MS       20      // a burst of log lines goes out as one message
+#define CLOCKGUSTO_EVENTS_MESSAGE_SIZE      1024
+#define CLOCKGUSTO_EVENTS_TAIL_SIZE         24
+#define CLOCKGUSTO_EVENTS_VALUE_SIZE        16
+#define CLOCKGUSTO_EVENTS_TASK_STACK        3072
+#define CLOCKGUSTO_EVENTS_TASK_PRIORITY     (tskIDLE_PRIORITY + 2)
+
+static const char *TAG = "clockgusto events";
+
+/** What a client has seen. The log entry is the last line it got. */
+typedef struct _clockgusto_events_snapshot_t
+{
+    uint32_t time_mask;
+    uint32_t config;
+    uint32_t log_seq;
+} clockgusto_events_snapshot_t;
+
+typedef struct _clockgusto_events_client_t
+{
+    bool used;                      // claimed by a handler
+    httpd_req_t* req;               // async copy, NULL until the task may serve it
+    bool stream;                    // server sent events, otherwise a single long poll answer
+    clockgusto_events_snapshot_t sent;
+    int64_t deadline_us;            // next keepalive, or the end of the long poll
+} clockgusto_events_client_t;
+
+static const char* s_mode_names[CLOCKGUSTO_MODE_COUNT] = {
+    "clock",
+    "temperature",
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_task = NULL;
+static uint32_t s_config_version = 1;
+static uint8_t s_client_count = 0;
+
+/* Handlers only claim slots, everything after that, sending included, happens on the push task. */
+static clockgusto_events_client_t s_clients[CLOCKGUSTO_EVENTS_MAX_CLIENTS];
+static char s_message[CLOCKGUSTO_EVENTS_MESSAGE_SIZE];
+static char s_line[CLOCKGUSTO_LOG_LINE_SIZE];
+
+static void clockgusto_events_get_snapshot(clockgusto_events_snapshot_t* snapshot)
+{
+    snapshot->time_mask = clockgusto_get_time_mask();
+    portENTER_CRITICAL(&s_lock);
+    snapshot->config = s_config_version;
+    portEXIT_CRITICAL(&s_lock);
+    snapshot->log_seq = clockgusto_log_get_seq();
+}
+
+static bool clockgusto_events_snapshot_equal(const clockgusto_events_snapshot_t* a,
+                                             const clockgusto_events_snapshot_t* b)
+{
+    return a->time_mask == b->time_mask && a->config == b->config && a->log_seq == b->log_seq;
+}
+
+/** Appends value as a JSON string, false when it does not fit. */
+static bool clockgusto_events_append_string(size_t* length, const char* value)
+{
+    size_t pos = *length;
+    if (pos >= sizeof(s_message))
+    {
+        return false;
+    }
+    s_message[pos++] = '"';
+    for (const char* c = value; *c; ++c)
+    {
+        // room for the longest escape and the closing quote
+        if (pos + 7 >= sizeof(s_message))
+        {
+            return false;
+        }
+        unsigned char ch = (unsigned char)*c;
+        if (ch == '"' || ch == '\\')
+        {
+            s_message[pos++] = '\\';
+            s_message[pos++] = (char)ch;
+        }
+        else if (ch < 0x20)
+        {
+            pos += snprintf(s_message + pos, sizeof(s_message) - pos, "\\u%04x", ch);
+        }
+        else
+        {
+            s_message[pos++] = (char)ch;
+        }
+    }
+    s_message[pos++] = '"';
+    *length = pos;
+    return true;
+}
+
+/** Formats what changed between sent and now, framed as an event for streams, and moves sent up to
+ *  what the message carries. Log lines that do not fit follow in the next message. */
+static int clockgusto_events_format(clockgusto_events_snapshot_t* sent, const clockgusto_events_snapshot_t* now,
+                                    bool stream)
+{
+    int length = snprintf(s_message, sizeof(s_message), "%s{\"mask\":%" PRIu32 ",\"config\":%" PRIu32,
+                          stream ? "data: " : "", now->time_mask, now->config);
+    if (now->config != sent->config)
+    {
+        length += snprintf(s_message + length, sizeof(s_message) - length, ",\"mode\":\"%s\",\"brightness\":%u",
+                           s_mode_names[clockgusto_get_mode()], clockgusto_get_brightness());
+    }
+
+    uint32_t log_seq = sent->log_seq;
+    if (now->log_seq != sent->log_seq)
+    {
+        // lines the ring has already dropped are skipped
+        uint32_t first = now->log_seq >= CLOCKGUSTO_LOG_LINES ? now->log_seq - CLOCKGUSTO_LOG_LINES + 1 : 1;
+        first = sent->log_seq + 1 > first ? sent->log_seq + 1 : first;
+
+        length += snprintf(s_message + length, sizeof(s_message) - length, ",\"lines\":[");
+        size_t pos = (size_t)length;
+        size_t list_start = pos;
+        for (uint32_t seq = first; seq <= now->log_seq; ++seq)
+        {
+            if (!clockgusto_log_get_line(seq, s_line, sizeof(s_line)))
+            {
+                log_seq = seq;  // overwritten meanwhile
+                continue;
+            }
+            size_t before = pos;
+            if (pos != list_start)
+            {
+                s_message[pos++] = ',';
+            }
+            // the tail keeps room for the log field, the closing brackets and the event's blank line
+            if (pos + CLOCKGUSTO_EVENTS_TAIL_SIZE >= sizeof(s_message) ||
+                !clockgusto_events_append_string(&pos, s_line) || pos + CLOCKGUSTO_EVENTS_TAIL_SIZE >= sizeof(s_message))
+            {
+                pos = before;
+                break;
+            }
+            log_seq = seq;
+        }
+        s_message[pos++] = ']';
+        length = (int)pos;
+    }
+
+    length += snprintf(s_message + length, sizeof(s_message) - length, ",\"log\":%" PRIu32 "}%s", log_seq,
+                       stream ? "\n\n" : "");
+
+    sent->time_mask = now->time_mask;
+    sent->config = now->config;
+    sent->log_seq = log_seq;
+    return length;
+}
+
+static void clockgusto_events_release(clockgusto_events_client_t* client, bool close)
+{
+    httpd_req_t* req = client->req;
+    httpd_handle_t server = req->handle;
+    int fd = httpd_req_to_sockfd(req);
+    httpd_req_async_handler_complete(req);
+    if (close)
+    {
+        httpd_sess_trigger_close(server, fd);
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    client->req = NULL;
+    client->used = false;
+    s_client_count--;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/** Sends one client whatever it has not seen yet. Returns false once the client is gone. */
+static bool clockgusto_events_serve(clockgusto_events_client_t* client, const clockgusto_events_snapshot_t* now,
+                                    int64_t now_us)
+{
+    bool changed = !clockgusto_events_snapshot_equal(&client->sent, now);
+    if (!client->stream)
+    {
+        if (!changed && now_us < client->deadline_us)
+        {
+            return true;
+        }
+
+        // a timed out poll gets the unchanged state, so the app simply asks again
+        int length = clockgusto_events_format(&client->sent, now, false);
+        httpd_resp_send(client->req, s_message, length);
+        clockgusto_events_release(client, false);
+        return false;
+    }
+
+    esp_err_t ret = ESP_OK;
+    while (ret == ESP_OK && !clockgusto_events_snapshot_equal(&client->sent, now))
+    {
+        int length = clockgusto_events_format(&client->sent, now, true);
+        ret = httpd_resp_send_chunk(client->req, s_message, length);
+        client->deadline_us = now_us + CLOCKGUSTO_EVENTS_KEEPALIVE_MS * 1000LL;
+    }
+    if (ret == ESP_OK && now_us >= client->deadline_us)
+    {
+        ret = httpd_resp_send_chunk(client->req, ":\n\n", 3);
+        client->deadline_us = now_us + CLOCKGUSTO_EVENTS_KEEPALIVE_MS * 1000LL;
+    }
+    if (ret != ESP_OK)
+    {
+        clockgusto_events_release(client, true);
+        return false;
+    }
+
+    return true;
+}
+
+static void clockgusto_events_task(void* arg)
+{
+    (void)arg;
+
+    TickType_t wait = portMAX_DELAY;
+    while (true)
+    {
+        if (ulTaskNotifyTake(pdTRUE, wait) > 0)
+        {
+            vTaskDelay(pdMS_TO_TICKS(CLOCKGUSTO_EVENTS_COALESCE_MS));
+            ulTaskNotifyTake(pdTRUE, 0);
+        }
+
+        clockgusto_events_snapshot_t now;
+        clockgusto_events_get_snapshot(&now);
+        int64_t now_us = esp_timer_get_time();
+        int64_t next_deadline_us = INT64_MAX;
+
+        for (uint8_t idx = 0; idx < CLOCKGUSTO_EVENTS_MAX_CLIENTS; ++idx)
+        {
+            clockgusto_events_client_t* client = &s_clients[idx];
+            portENTER_CRITICAL(&s_lock);
+            bool active = client->req != NULL;
+            portEXIT_CRITICAL(&s_lock);
+
+            if (active && clockgusto_events_serve(client, &now, now_us) && client->deadline_us < next_deadline_us)
+            {
+                next_deadline_us = client->deadline_us;
+            }
+        }
+
+        // without clients the task only wakes for new ones
+        wait = next_deadline_us == INT64_MAX ? portMAX_DELAY
+                                             : pdMS_TO_TICKS((next_deadline_us - now_us) / 1000) + 1;
+    }
+}
+
+static void clockgusto_events_log_listener(uint32_t seq)
+{
+    (void)seq;
+    clockgusto_events_notify(CLOCKGUSTO_EVENTS_LOG);
+}
+
+/** Parks the request in a free slot. Without one the client gets a 503 and polls the plain API. */
+static esp_err_t clockgusto_events_accept(httpd_req_t* req, bool stream, const clockgusto_events_snapshot_t* seen)
+{
+    if (!s_task)
+    {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "events not running");
+    }
+
+    clockgusto_events_client_t* client = NULL;
+    portENTER_CRITICAL(&s_lock);
+    for (uint8_t idx = 0; idx < CLOCKGUSTO_EVENTS_MAX_CLIENTS && !client; ++idx)
+    {
+        if (!s_clients[idx].used)
+        {
+            client = &s_clients[idx];
+            client->used = true;
+            s_client_count++;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!client)
+    {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "30");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, stream ? "text/event-stream" : "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    httpd_req_t* async_req = NULL;
+    esp_err_t ret = httpd_req_async_handler_begin(req, &async_req);
+    portENTER_CRITICAL(&s_lock);
+    if (ret == ESP_OK)
+    {
+        client->stream = stream;
+        client->sent = *seen;
+        client->deadline_us = esp_timer_get_time() +
+                              (stream ? CLOCKGUSTO_EVENTS_KEEPALIVE_MS : CLOCKGUSTO_EVENTS_POLL_TIMEOUT_MS) * 1000LL;
+        client->req = async_req;
+    }
+    else
+    {
+        client->used = false;
+        s_client_count--;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to hold the request: %s\n", esp_err_to_name(ret));
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, esp_err_to_name(ret));
+    }
+
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+/** GET /api/events starts with the full state and a page of log, then sends deltas only. */
+static esp_err_t clockgusto_events_stream_get(httpd_req_t* req)
+{
+    // nothing seen yet, the config version is never 0
+    clockgusto_events_snapshot_t seen = { 0 };
+    return clockgusto_events_accept(req, true, &seen);
+}
+
+static uint32_t clockgusto_events_get_query_u32(const char* query, const char* key)
+{
+    char value[CLOCKGUSTO_EVENTS_VALUE_SIZE];
+    if (httpd_query_key_value(query, key, value, sizeof(value)) != ESP_OK)
+    {
+        return 0;
+    }
+    return (uint32_t)strtoul(value, NULL, 10);
+}
+
+/** GET /api/poll echoes mask, config and log from the previous answer and returns as soon as any of
+ *  them is stale, at the latest after CLOCKGUSTO_EVENTS_POLL_TIMEOUT_MS. */
+static esp_err_t clockgusto_events_poll_get(httpd_req_t* req)
+{
+    char query[96];
+    clockgusto_events_snapshot_t seen = { 0 };
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK)
+    {
+        seen.time_mask = clockgusto_events_get_query_u32(query, "mask");
+        seen.config = clockgusto_events_get_query_u32(query, "config");
+        seen.log_seq = clockgusto_events_get_query_u32(query, "log");
+    }
+
+    return clockgusto_events_accept(req, false, &seen);
+}
+
+static const httpd_uri_t s_uris[] = {
+    { .uri = "/api/events", .method = HTTP_GET, .handler = clockgusto_events_stream_get },
+    { .uri = "/api/poll",   .method = HTTP_GET, .handler = clockgusto_events_poll_get },
+};
+
+esp_err_t clockgusto_events_init()
+{
+    if (xTaskCreate(clockgusto_events_task, "clockgusto events", CLOCKGUSTO_EVENTS_TASK_STACK, NULL,
+                    CLOCKGUSTO_EVENTS_TASK_PRIORITY, &s_task) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    clockgusto_log_set_listener(clockgusto_events_log_listener);
+    return ESP_OK;
+}
+
+esp_err_t clockgusto_events_register(httpd_handle_t server)
+{
+    for (size_t idx = 0; idx < sizeof(s_uris) / sizeof(s_uris[0]); ++idx)
+    {
+        esp_err_t ret = httpd_register_uri_handler(server, &s_uris[idx]);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+
+    return ESP_OK;
+}
+
+void clockgusto_events_notify(uint32_t changes)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (changes & CLOCKGUSTO_EVENTS_CONFIG)
+    {
+        s_config_version++;
+    }
+    bool listening = s_client_count > 0;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (listening && s_task)
+    {
+        xTaskNotifyGive(s_task);
+    }
+    clockgusto_mqtt_notify(changes);
+}
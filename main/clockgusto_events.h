@@ -0,0 +1,26 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include <stdint.h>
+
+#define CLOCKGUSTO_EVENTS_MAX_CLIENTS   4   // of the server's sockets, the rest stay free for requests
+
+typedef enum _clockgusto_events_change_t
+{
+    CLOCKGUSTO_EVENTS_TIME   = 1 << 0,  // the words on the face changed
+    CLOCKGUSTO_EVENTS_CONFIG = 1 << 1,  // mode, brightness, alarm or night settings
+    CLOCKGUSTO_EVENTS_LOG    = 1 << 2,
+} clockgusto_events_change_t;
+
+/** Starts the task that pushes state deltas to waiting clients and subscribes it to the log. */
+esp_err_t clockgusto_events_init();
+
+/** Adds GET /api/events, a Server-Sent Events stream, and GET /api/poll?mask=&config=&log=, a long
+ *  poll that answers as soon as the state differs from the one the client passes. Both share a
+ *  table of CLOCKGUSTO_EVENTS_MAX_CLIENTS connections. */
+esp_err_t clockgusto_events_register(httpd_handle_t server);
+
+/** Wakes the push task and passes the change on to MQTT. Cheap and a no-op for the network while
+ *  nobody listens. */
+void clockgusto_events_notify(uint32_t changes);
@@ -0,0 +1,236 @@
+#include "clockgusto_group.h"
+
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "lwip/igmp.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcpip.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "clockgusto_time.h"
+#include "clockgusto_tz.h"
+#include "clockgusto_wifi.h"
+
+static const char *TAG = "clockgusto group";
+
+static uint32_t s_node_id = CLOCKGUSTO_SYNC_NODE_NONE;
+
+/* Owned by the lwIP thread. */
+static struct udp_pcb* s_pcb = NULL;
+static ip_addr_t s_group_addr;
+static ip_addr_t s_master_addr;
+static uint16_t s_master_port = 0;
+static clockgusto_sync_node_t s_node;
+
+/* What readers see, copied out of s_node after every change. */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_started = false;
+static clockgusto_sync_clock_t s_clock;
+static clockgusto_group_stats_t s_stats;
+
+static int64_t clockgusto_group_utc_us()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+static void clockgusto_group_publish()
+{
+    portENTER_CRITICAL(&s_lock);
+    s_started = true;
+    s_clock.base_us = s_node.clock.base_us;
+    s_clock.offset_us = s_node.clock.offset_us;
+    s_clock.freq_ppb = s_node.clock.freq_ppb;
+    s_stats.role = s_node.role;
+    s_stats.master = s_node.role == CLOCKGUSTO_SYNC_LISTENING ? CLOCKGUSTO_SYNC_NODE_NONE : s_node.master;
+    s_stats.sync = s_node.stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void clockgusto_group_send(const uint8_t* packet, size_t size, const ip_addr_t* addr, uint16_t port)
+{
+    struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, size, PBUF_RAM);
+    if (!p)
+    {
+        return;
+    }
+    pbuf_take(p, packet, size);
+    udp_sendto(s_pcb, p, addr, port);
+    pbuf_free(p);
+}
+
+/** Runs in the lwIP thread, which also took the arrival time as early as anything could. */
+static void clockgusto_group_receive(void* arg, struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* addr,
+                                     uint16_t port)
+{
+    (void)arg;
+    (void)pcb;
+
+    int64_t local_us = esp_timer_get_time();
+    uint8_t data[CLOCKGUSTO_SYNC_PACKET_SIZE];
+    uint16_t size = pbuf_copy_partial(p, data, sizeof(data), 0);
+    size = p->tot_len == size ? size : 0;      // longer packets are not ours
+    pbuf_free(p);
+
+    uint8_t packet[CLOCKGUSTO_SYNC_PACKET_SIZE];
+    size_t packet_size = 0;
+    clockgusto_sync_action_t action = clockgusto_sync_node_receive(&s_node, data, size, local_us, packet,
+                                                                   &packet_size);
+    if (action == CLOCKGUSTO_SYNC_REPLY)
+    {
+        clockgusto_group_send(packet, packet_size, addr, port);
+    }
+    else if (action == CLOCKGUSTO_SYNC_NEW_MASTER)
+    {
+        ip_addr_copy(s_master_addr, *addr);
+        s_master_port = port;
+    }
+    clockgusto_group_publish();
+}
+
+static void clockgusto_group_tick(void* arg)
+{
+    (void)arg;
+
+    sys_timeout(CLOCKGUSTO_SYNC_INTERVAL_MS, clockgusto_group_tick, NULL);
+
+    s_node.synced = clockgusto_time_is_synced();
+    uint8_t packet[CLOCKGUSTO_SYNC_PACKET_SIZE];
+    size_t size = 0;
+    clockgusto_sync_role_t role = s_node.role;
+    clockgusto_sync_action_t action = clockgusto_sync_node_tick(&s_node, esp_timer_get_time(),
+                                                                clockgusto_group_utc_us(), packet, &size);
+    if (action == CLOCKGUSTO_SYNC_MULTICAST)
+    {
+        clockgusto_group_send(packet, size, &s_group_addr, CLOCKGUSTO_SYNC_PORT);
+    }
+    else if (action == CLOCKGUSTO_SYNC_TO_MASTER && s_master_port != 0)
+    {
+        clockgusto_group_send(packet, size, &s_master_addr, s_master_port);
+    }
+    clockgusto_group_publish();
+
+    if (s_node.role != role)
+    {
+        ESP_LOGI(TAG, "%s, master %08lx", s_node.role == CLOCKGUSTO_SYNC_MASTER ? "master" :
+                 s_node.role == CLOCKGUSTO_SYNC_FOLLOWER ? "follower" : "listening", (unsigned long)s_node.master);
+    }
+}
+
+/** Joins again on every network up, a join of a group already joined only counts a reference. */
+static void clockgusto_group_bind(void* ctx)
+{
+    (void)ctx;
+
+    if (!s_pcb)
+    {
+        s_pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+        if (!s_pcb)
+        {
+            ESP_LOGE(TAG, "Failed to create the pcb\n");
+            return;
+        }
+        if (udp_bind(s_pcb, IP_ANY_TYPE, CLOCKGUSTO_SYNC_PORT) != ERR_OK)
+        {
+            ESP_LOGE(TAG, "Failed to bind port %u\n", CLOCKGUSTO_SYNC_PORT);
+            udp_remove(s_pcb);
+            s_pcb = NULL;
+            return;
+        }
+        udp_recv(s_pcb, clockgusto_group_receive, NULL);
+
+        // the group clock starts where the face was, at the clock's own UTC
+        clockgusto_sync_node_init(&s_node, s_node_id, esp_timer_get_time(), clockgusto_group_utc_us());
+        clockgusto_group_publish();
+        sys_timeout(CLOCKGUSTO_SYNC_INTERVAL_MS, clockgusto_group_tick, NULL);
+        ESP_LOGI(TAG, "node %08lx on %s port %u", (unsigned long)s_node_id, CLOCKGUSTO_SYNC_GROUP,
+                 CLOCKGUSTO_SYNC_PORT);
+    }
+
+    if (igmp_joingroup(IP4_ADDR_ANY4, ip_2_ip4(&s_group_addr)) != ERR_OK)
+    {
+        ESP_LOGE(TAG, "Failed to join %s\n", CLOCKGUSTO_SYNC_GROUP);
+    }
+}
+
+static void clockgusto_group_network_handler(void* arg, esp_event_base_t event_base, int32_t event_id,
+                                             void* event_data)
+{
+    if (tcpip_callback(clockgusto_group_bind, NULL) != ERR_OK)
+    {
+        ESP_LOGE(TAG, "Failed to reach the lwip thread\n");
+    }
+}
+
+esp_err_t clockgusto_group_init()
+{
+    // the station MAC is unique enough, its vendor part is the same on all clocks
+    uint8_t mac[6];
+    esp_err_t ret = esp_efuse_mac_get_default(mac);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to read the mac address\n");
+        return ret;
+    }
+    s_node_id = (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5];
+    s_node_id = s_node_id == CLOCKGUSTO_SYNC_NODE_NONE ? 1 : s_node_id;
+    s_stats.node = s_node_id;
+
+    if (!ipaddr_aton(CLOCKGUSTO_SYNC_GROUP, &s_group_addr))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return esp_event_handler_register(CLOCKGUSTO_NET_EVENT, CLOCKGUSTO_NET_EVENT_UP,
+                                      clockgusto_group_network_handler, NULL);
+}
+
+int64_t clockgusto_group_get_time_us()
+{
+    int64_t local_us = esp_timer_get_time();
+    clockgusto_sync_clock_t clock;
+    bool started;
+
+    portENTER_CRITICAL(&s_lock);
+    started = s_started;
+    clock.base_us = s_clock.base_us;
+    clock.offset_us = s_clock.offset_us;
+    clock.freq_ppb = s_clock.freq_ppb;
+    portEXIT_CRITICAL(&s_lock);
+
+    return started ? clockgusto_sync_clock_now(&clock, local_us) : clockgusto_group_utc_us();
+}
+
+void clockgusto_group_get_local_hms(uint8_t* hours, uint8_t* minutes, uint8_t* seconds)
+{
+    int64_t utc_us = clockgusto_group_get_time_us() + CLOCKGUSTO_GROUP_FRAME_LEAD_US;
+    clockgusto_tz_to_local_hms((time_t)(utc_us / 1000000), hours, minutes, seconds);
+}
+
+uint8_t clockgusto_group_get_phase(uint32_t period_ms)
+{
+    int64_t period_us = (int64_t)period_ms * 1000;
+    return (uint8_t)(((clockgusto_group_get_time_us() + period_us / 2) / period_us) % 256);
+}
+
+int64_t clockgusto_group_get_frame_wait_us(uint32_t period_ms)
+{
+    // the group clock runs within CLOCKGUSTO_SYNC_MAX_FREQ_PPB of the local one, close enough for a wait
+    int64_t period_us = (int64_t)period_ms * 1000;
+    return period_us - clockgusto_group_get_time_us() % period_us;
+}
+
+void clockgusto_group_get_stats(clockgusto_group_stats_t* stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+
+#include "clockgusto_sync.h"
+
+#define CLOCKGUSTO_GROUP_FRAME_LEAD_US  2000    // a frame woken a hair before its grid point still belongs to it
+
+typedef struct _clockgusto_group_stats_t
+{
+    uint32_t node;
+    clockgusto_sync_role_t role;
+    uint32_t master;                // CLOCKGUSTO_SYNC_NODE_NONE while listening
+    clockgusto_sync_stats_t sync;
+} clockgusto_group_stats_t;
+
+/** Joins the clocks on the network in one group time once it is up, see clockgusto_sync.h. The
+ *  protocol runs in the lwIP thread, readers only see a snapshot of the group clock. Until the
+ *  network comes up group time is the clock's own UTC. */
+esp_err_t clockgusto_group_init();
+
+/** Group time in UTC us. */
+int64_t clockgusto_group_get_time_us();
+
+/** Local hours, minutes and seconds of group time, what all clocks of the group show. */
+void clockgusto_group_get_local_hms(uint8_t* hours, uint8_t* minutes, uint8_t* seconds);
+
+/** Animation step of a frame period, the nearest grid point of group time counted modulo 256. */
+uint8_t clockgusto_group_get_phase(uint32_t period_ms);
+
+/** Time until the next multiple of period_ms in group time, so every clock draws its frames at the
+ *  same instants. */
+int64_t clockgusto_group_get_frame_wait_us(uint32_t period_ms);
+
+/** */
+void clockgusto_group_get_stats(clockgusto_group_stats_t* stats);
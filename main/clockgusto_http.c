@@ -0,0 +1,573 @@
+#include "clockgusto_http.h"
+
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "clockgusto.h"
+#include "clockgusto_alarm.h"
+#include "clockgusto_boot.h"
+#include "clockgusto_events.h"
+#include "clockgusto_group.h"
+#include "clockgusto_json.h"
+#include "clockgusto_metrics.h"
+#include "clockgusto_mqtt.h"
+#include "clockgusto_night.h"
+#include "clockgusto_preview.h"
+#include "clockgusto_realtime.h"
+#include "clockgusto_temperature.h"
+#include "clockgusto_time.h"
+#include "clockgusto_webui.h"
+#include "clockgusto_wifi.h"
+
+#define CLOCKGUSTO_HTTP_RESPONSE_SIZE  2048
+#define CLOCKGUSTO_HTTP_QUERY_SIZE     128
+#define CLOCKGUSTO_HTTP_VALUE_SIZE     32
+#define CLOCKGUSTO_HTTP_MAX_HANDLERS   24      // room for the endpoints of later services
+#define CLOCKGUSTO_HTTP_TASK_STACK     4096
+#define CLOCKGUSTO_HTTP_MAX_SOCKETS    10      // event and preview clients hold theirs, requests need the rest
+#define CLOCKGUSTO_HTTP_ARENA_SIZE     1024    // request body plus whatever a handler needs on top
+#define CLOCKGUSTO_HTTP_RECV_RETRIES   3       // each waits the server's recv_wait_timeout, 5 s by default
+
+static const char *TAG = "clockgusto http";
+
+static httpd_handle_t s_server = NULL;
+
+// only touched from the server task, which runs one handler at a time
+static char s_response[CLOCKGUSTO_HTTP_RESPONSE_SIZE];
+static char s_query[CLOCKGUSTO_HTTP_QUERY_SIZE];
+static uint8_t s_arena_buffer[CLOCKGUSTO_HTTP_ARENA_SIZE];
+static clockgusto_arena_t s_arena;
+
+static const char* s_mode_names[CLOCKGUSTO_MODE_COUNT] = {
+    "clock",
+    "temperature",
+};
+
+static const char* s_group_role_names[] = {
+    "listening",
+    "follower",
+    "master",
+};
+
+static esp_err_t clockgusto_http_send_json(httpd_req_t* req, int length)
+{
+    if (length < 0 || length >= (int)sizeof(s_response))
+    {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "response too large");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, s_response, length);
+}
+
+/** Receives the whole body into the request arena, which starts empty for every request. A client
+ *  that lets CLOCKGUSTO_HTTP_RECV_RETRIES receive timeouts pass over the body gets ESP_ERR_TIMEOUT,
+ *  so a trickle cannot hold the server task either. */
+static esp_err_t clockgusto_http_recv_body(httpd_req_t* req, const char** body, size_t* length)
+{
+    clockgusto_arena_reset(&s_arena);
+    char* buffer = clockgusto_arena_alloc(&s_arena, req->content_len);
+    if (!buffer)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t received = 0;
+    uint8_t timeouts = 0;
+    while (received < req->content_len)
+    {
+        int ret = httpd_req_recv(req, buffer + received, req->content_len - received);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < CLOCKGUSTO_HTTP_RECV_RETRIES)
+        {
+            continue;
+        }
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+        if (ret <= 0)
+        {
+            return ESP_FAIL;
+        }
+        received += ret;
+    }
+
+    *body = buffer;
+    *length = received;
+    return ESP_OK;
+}
+
+/** Parses a JSON body into target, sending the error response itself when that fails. */
+static bool clockgusto_http_parse_body(httpd_req_t* req, const clockgusto_json_field_t* fields, uint8_t count,
+                                       void* target, uint32_t* found)
+{
+    const char* body = NULL;
+    size_t length = 0;
+    esp_err_t ret = clockgusto_http_recv_body(req, &body, &length);
+    if (ret != ESP_OK)
+    {
+        if (ret == ESP_ERR_TIMEOUT)
+        {
+            httpd_resp_send_err(req, HTTPD_408_REQ_TIMEOUT, "body too slow");
+        }
+        else
+        {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, ret == ESP_ERR_INVALID_SIZE ? "body too large" : "body incomplete");
+        }
+        return false;
+    }
+
+    clockgusto_json_result_t result = clockgusto_json_parse(body, length, fields, count, target, found);
+    if (result != CLOCKGUSTO_JSON_OK)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, clockgusto_json_result_name(result));
+        return false;
+    }
+
+    return true;
+}
+
+/** Reads one query parameter into value, false if the request has no such key. */
+static bool clockgusto_http_get_param(httpd_req_t* req, const char* key, char* value, size_t size)
+{
+    if (httpd_req_get_url_query_str(req, s_query, sizeof(s_query)) != ESP_OK)
+    {
+        return false;
+    }
+
+    return httpd_query_key_value(s_query, key, value, size) == ESP_OK;
+}
+
+static bool clockgusto_http_get_long(httpd_req_t* req, const char* key, long long* number)
+{
+    char value[CLOCKGUSTO_HTTP_VALUE_SIZE];
+    if (!clockgusto_http_get_param(req, key, value, sizeof(value)))
+    {
+        return false;
+    }
+
+    char* end = NULL;
+    *number = strtoll(value, &end, 10);
+    return end != value && *end == '\0';
+}
+
+static esp_err_t clockgusto_http_time_get(httpd_req_t* req)
+{
+    time_t now = time(NULL);
+    struct tm local_time;
+    clockgusto_time_get_local(&local_time);
+
+    int length = snprintf(s_response, sizeof(s_response),
+                          "{\"utc\":%lld,\"local\":\"%04d-%02d-%02dT%02d:%02d:%02d\",\"synced\":%s,"
+                          "\"accuracy_ms\":%ld,\"degraded\":%s}",
+                          (long long)now, local_time.tm_year + 1900, local_time.tm_mon + 1, local_time.tm_mday,
+                          local_time.tm_hour, local_time.tm_min, local_time.tm_sec,
+                          clockgusto_time_is_synced() ? "true" : "false", (long)clockgusto_time_get_accuracy_ms(),
+                          clockgusto_time_is_degraded() ? "true" : "false");
+    return clockgusto_http_send_json(req, length);
+}
+
+typedef struct _clockgusto_http_time_body_t
+{
+    int64_t utc;
+} clockgusto_http_time_body_t;
+
+static const clockgusto_json_field_t s_time_fields[] = {
+    CLOCKGUSTO_JSON_FIELD(clockgusto_http_time_body_t, utc, "utc", CLOCKGUSTO_JSON_INT, 1, INT32_MAX),
+};
+
+/** PUT /api/time with {"utc":<seconds>} or ?utc=<seconds> sets the clock by hand, from a phone for
+ *  example. Whole seconds with an unknown delay are no reference: the clock steps to it and writes the
+ *  rtc, but does not count as synced and does not feed the drift fit. */
+static esp_err_t clockgusto_http_time_put(httpd_req_t* req)
+{
+    int64_t received_us = esp_timer_get_time();
+    long long utc = 0;
+    if (req->content_len > 0)
+    {
+        clockgusto_http_time_body_t body;
+        uint32_t found = 0;
+        if (!clockgusto_http_parse_body(req, s_time_fields, 1, &body, &found))
+        {
+            return ESP_OK;
+        }
+        utc = found ? body.utc : 0;
+    }
+    else if (!clockgusto_http_get_long(req, "utc", &utc))
+    {
+        utc = 0;
+    }
+    if (utc <= 0)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "utc=<seconds> expected");
+    }
+
+    clockgusto_time_set_manual((int64_t)utc * 1000000, received_us);
+    return clockgusto_http_time_get(req);
+}
+
+static esp_err_t clockgusto_http_brightness_get(httpd_req_t* req)
+{
+    int length = snprintf(s_response, sizeof(s_response), "{\"brightness\":%u,\"night_level\":%u,\"derating\":%u}",
+                          clockgusto_get_brightness(), clockgusto_night_get_level(),
+                          clockgusto_temperature_get_derating());
+    return clockgusto_http_send_json(req, length);
+}
+
+typedef struct _clockgusto_http_value_body_t
+{
+    int32_t value;
+} clockgusto_http_value_body_t;
+
+static const clockgusto_json_field_t s_brightness_fields[] = {
+    CLOCKGUSTO_JSON_FIELD(clockgusto_http_value_body_t, value, "brightness", CLOCKGUSTO_JSON_INT, 0, 100),
+};
+
+static esp_err_t clockgusto_http_brightness_put(httpd_req_t* req)
+{
+    long long brightness = -1;
+    if (req->content_len > 0)
+    {
+        clockgusto_http_value_body_t body;
+        uint32_t found = 0;
+        if (!clockgusto_http_parse_body(req, s_brightness_fields, 1, &body, &found))
+        {
+            return ESP_OK;
+        }
+        brightness = found ? body.value : -1;
+    }
+    else if (!clockgusto_http_get_long(req, "value", &brightness))
+    {
+        brightness = -1;
+    }
+    if (brightness < 0 || brightness > 100)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "brightness 0..100 expected");
+    }
+
+    clockgusto_set_brightness((uint8_t)brightness);
+    return clockgusto_http_brightness_get(req);
+}
+
+static esp_err_t clockgusto_http_mode_get(httpd_req_t* req)
+{
+    int length = snprintf(s_response, sizeof(s_response), "{\"mode\":\"%s\"}", s_mode_names[clockgusto_get_mode()]);
+    return clockgusto_http_send_json(req, length);
+}
+
+typedef struct _clockgusto_http_mode_body_t
+{
+    char value[CLOCKGUSTO_HTTP_VALUE_SIZE];
+} clockgusto_http_mode_body_t;
+
+static const clockgusto_json_field_t s_mode_fields[] = {
+    CLOCKGUSTO_JSON_FIELD(clockgusto_http_mode_body_t, value, "mode", CLOCKGUSTO_JSON_STRING, 1, 0),
+};
+
+static esp_err_t clockgusto_http_mode_put(httpd_req_t* req)
+{
+    clockgusto_http_mode_body_t body = { 0 };
+    uint32_t found = 0;
+    if (req->content_len > 0)
+    {
+        if (!clockgusto_http_parse_body(req, s_mode_fields, 1, &body, &found))
+        {
+            return ESP_OK;
+        }
+    }
+    else
+    {
+        found = clockgusto_http_get_param(req, "value", body.value, sizeof(body.value));
+    }
+
+    const char* value = body.value;
+    if (found)
+    {
+        for (uint8_t mode = 0; mode < CLOCKGUSTO_MODE_COUNT; ++mode)
+        {
+            if (strcmp(value, s_mode_names[mode]) == 0)
+            {
+                clockgusto_set_mode((clockgusto_mode_t)mode);
+                return clockgusto_http_mode_get(req);
+            }
+        }
+    }
+
+    return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "mode clock|temperature expected");
+}
+
+/** Appends the boot stages to the status document from length on, -1 when they do not fit. Stages
+ *  not reached count -1 us. */
+static int clockgusto_http_format_boot(int length)
+{
+    if (length < 0 || length >= (int)sizeof(s_response))
+    {
+        return -1;
+    }
+
+    clockgusto_boot_report_t boot;
+    clockgusto_boot_get_report(&boot);
+
+    length += snprintf(s_response + length, sizeof(s_response) - length,
+                       "\"boot\":{\"budget_ms\":%" PRIu32 ",\"over_budget\":%s,\"stage_us\":{",
+                       boot.budget_ms, boot.over_budget ? "true" : "false");
+    for (uint8_t stage = 0; stage < CLOCKGUSTO_BOOT_STAGE_COUNT && length < (int)sizeof(s_response); ++stage)
+    {
+        length += snprintf(s_response + length, sizeof(s_response) - length, "%s\"%s\":%lld",
+                           stage > 0 ? "," : "", clockgusto_boot_stage_name((clockgusto_boot_stage_t)stage),
+                           (long long)boot.stage_us[stage]);
+    }
+    if (length < (int)sizeof(s_response))
+    {
+        length += snprintf(s_response + length, sizeof(s_response) - length, "}}}");
+    }
+    return length < (int)sizeof(s_response) ? length : -1;
+}
+
+static esp_err_t clockgusto_http_status_get(httpd_req_t* req)
+{
+    clockgusto_health_t health;
+    clockgusto_get_health(&health);
+    clockgusto_wifi_stats_t wifi;
+    clockgusto_wifi_get_stats(&wifi);
+    clockgusto_preview_stats_t preview;
+    clockgusto_preview_get_stats(&preview);
+    clockgusto_realtime_stats_t realtime;
+    clockgusto_realtime_get_stats(&realtime);
+    clockgusto_webui_stats_t webui;
+    clockgusto_webui_get_stats(&webui);
+    clockgusto_mqtt_stats_t mqtt;
+    clockgusto_mqtt_get_stats(&mqtt);
+    clockgusto_group_stats_t group;
+    clockgusto_group_get_stats(&group);
+    float celsius = 0.0f;
+    bool has_temperature = clockgusto_temperature_get(&celsius);
+
+    int length = snprintf(s_response, sizeof(s_response),
+                          "{\"uptime_s\":%lld,\"free_heap\":%" PRIu32 ",\"min_free_heap\":%" PRIu32 ","
+                          "\"render_errors\":%" PRIu32 ",\"render_recoveries\":%" PRIu32 ","
+                          "\"rtc_failures\":%" PRIu32 ",\"degraded\":%s,"
+                          "\"temperature\":%.2f,\"temperature_valid\":%s,"
+                          "\"wifi\":{\"rssi\":%d,\"connects\":%" PRIu32 ",\"disconnects\":%" PRIu32 ","
+                          "\"connect_ms\":%" PRIu32 ",\"last_reason\":%u},"
+                          "\"preview\":{\"clients\":%u,\"frames\":%" PRIu32 ",\"skipped\":%" PRIu32 ","
+                          "\"bytes_per_s\":%" PRIu32 "},"
+                          "\"realtime\":{\"active\":%s,\"frames\":%" PRIu32 ",\"dropped\":%" PRIu32 ","
+                          "\"rejected\":%" PRIu32 ",\"latency_us\":%" PRIu32 ",\"latency_avg_us\":%" PRIu32 ","
+                          "\"latency_max_us\":%" PRIu32 "},"
+                          "\"webui\":{\"requests\":%" PRIu32 ",\"not_modified\":%" PRIu32 ",\"response_us\":%" PRIu32 ","
+                          "\"response_max_us\":%" PRIu32 ",\"heap_delta\":%" PRId32 ",\"stack_free\":%" PRIu32 "},"
+                          "\"mqtt\":{\"connected\":%s,\"connects\":%" PRIu32 ",\"changes\":%" PRIu32 ","
+                          "\"publishes\":%" PRIu32 ",\"failures\":%" PRIu32 ",\"commands\":%" PRIu32 ","
+                          "\"bytes_per_h\":%" PRIu32 ",\"cpu_ms_per_h\":%" PRIu32 "},"
+                          "\"group\":{\"node\":\"%08" PRIx32 "\",\"role\":\"%s\",\"master\":\"%08" PRIx32 "\","
+                          "\"exchanges\":%" PRIu32 ",\"steps\":%" PRIu32 ",\"error_us\":%" PRId32 ","
+                          "\"delay_us\":%" PRId32 ",\"freq_ppb\":%" PRId32 "},",
+                          (long long)(esp_timer_get_time() / 1000000), esp_get_free_heap_size(),
+                          esp_get_minimum_free_heap_size(), health.render_errors, health.render_recoveries,
+                          health.rtc_failures, health.degraded ? "true" : "false", celsius,
+                          has_temperature ? "true" : "false", wifi.rssi, wifi.connects, wifi.disconnects,
+                          wifi.connect_ms, wifi.last_reason, preview.clients, preview.frames, preview.skipped,
+                          preview.bytes_per_s, realtime.active ? "true" : "false", realtime.frames,
+                          realtime.dropped, realtime.rejected, realtime.latency_us, realtime.latency_avg_us,
+                          realtime.latency_max_us, webui.requests, webui.not_modified, webui.response_us,
+                          webui.response_max_us, webui.heap_delta, webui.stack_free,
+                          mqtt.connected ? "true" : "false", mqtt.connects, mqtt.changes, mqtt.publishes,
+                          mqtt.failures, mqtt.commands, mqtt.bytes_per_h, mqtt.cpu_ms_per_h, group.node,
+                          s_group_role_names[group.role], group.master, group.sync.exchanges, group.sync.steps,
+                          group.sync.error_us, group.sync.delay_us, group.sync.freq_ppb);
+    length = clockgusto_http_format_boot(length);
+    return clockgusto_http_send_json(req, length);
+}
+
+static esp_err_t clockgusto_http_alarm_get(httpd_req_t* req)
+{
+    static const char* state_names[] = { "idle", "sunrise", "ringing" };
+    clockgusto_alarm_config_t config;
+    clockgusto_alarm_get_config(&config);
+
+    int length = snprintf(s_response, sizeof(s_response),
+                          "{\"enabled\":%s,\"hour\":%u,\"minute\":%u,\"days\":%u,\"sunrise\":%s,\"state\":\"%s\"}",
+                          config.enabled ? "true" : "false", config.hour, config.minute, config.days,
+                          config.sunrise ? "true" : "false", state_names[clockgusto_alarm_get_state()]);
+    return clockgusto_http_send_json(req, length);
+}
+
+static const clockgusto_json_field_t s_alarm_fields[] = {
+    CLOCKGUSTO_JSON_FIELD(clockgusto_alarm_config_t, enabled, "enabled", CLOCKGUSTO_JSON_BOOL, 0, 1),
+    CLOCKGUSTO_JSON_FIELD(clockgusto_alarm_config_t, hour, "hour", CLOCKGUSTO_JSON_INT, 0, 23),
+    CLOCKGUSTO_JSON_FIELD(clockgusto_alarm_config_t, minute, "minute", CLOCKGUSTO_JSON_INT, 0, 59),
+    CLOCKGUSTO_JSON_FIELD(clockgusto_alarm_config_t, days, "days", CLOCKGUSTO_JSON_INT, 0, 0x7f),
+    CLOCKGUSTO_JSON_FIELD(clockgusto_alarm_config_t, sunrise, "sunrise", CLOCKGUSTO_JSON_BOOL, 0, 1),
+};
+
+/** Absent keys keep their current value. */
+static esp_err_t clockgusto_http_alarm_put(httpd_req_t* req)
+{
+    clockgusto_alarm_config_t config;
+    clockgusto_alarm_get_config(&config);
+    uint32_t found = 0;
+    if (!clockgusto_http_parse_body(req, s_alarm_fields, sizeof(s_alarm_fields) / sizeof(s_alarm_fields[0]),
+                                    &config, &found))
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = clockgusto_alarm_set_config(&config);
+    if (ret != ESP_OK)
+    {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, esp_err_to_name(ret));
+    }
+    return clockgusto_http_alarm_get(req);
+}
+
+/** Ends a sunrise or a ringing alarm, the body is ignored. */
+static esp_err_t clockgusto_http_alarm_dismiss(httpd_req_t* req)
+{
+    clockgusto_alarm_dismiss();
+    return clockgusto_http_alarm_get(req);
+}
+
+static esp_err_t clockgusto_http_night_get(httpd_req_t* req)
+{
+    clockgusto_night_config_t config;
+    clockgusto_night_get_config(&config);
+    int16_t sunrise_min = 0;
+    int16_t sunset_min = 0;
+    bool has_sun_times = clockgusto_night_get_sun_times(&sunrise_min, &sunset_min);
+
+    int length = snprintf(s_response, sizeof(s_response),
+                          "{\"enabled\":%s,\"latitude\":%s%ld.%04ld,\"longitude\":%s%ld.%04ld,\"night_level\":%u,"
+                          "\"twilight_min\":%u,\"sunrise_utc_min\":%d,\"sunset_utc_min\":%d,\"level\":%u}",
+                          config.enabled ? "true" : "false",
+                          config.latitude_e4 < 0 ? "-" : "", labs(config.latitude_e4) / 10000,
+                          labs(config.latitude_e4) % 10000, config.longitude_e4 < 0 ? "-" : "",
+                          labs(config.longitude_e4) / 10000, labs(config.longitude_e4) % 10000,
+                          config.night_level, config.twilight_min, has_sun_times ? sunrise_min : -1,
+                          has_sun_times ? sunset_min : -1, clockgusto_night_get_level());
+    return clockgusto_http_send_json(req, length);
+}
+
+static const clockgusto_json_field_t s_night_fields[] = {
+    CLOCKGUSTO_JSON_FIELD(clockgusto_night_config_t, enabled, "enabled", CLOCKGUSTO_JSON_BOOL, 0, 1),
+    CLOCKGUSTO_JSON_FIELD(clockgusto_night_config_t, latitude_e4, "latitude", CLOCKGUSTO_JSON_FIXED4, -900000, 900000),
+    CLOCKGUSTO_JSON_FIELD(clockgusto_night_config_t, longitude_e4, "longitude", CLOCKGUSTO_JSON_FIXED4, -1800000, 1800000),
+    CLOCKGUSTO_JSON_FIELD(clockgusto_night_config_t, night_level, "night_level", CLOCKGUSTO_JSON_INT, 0, 100),
+    CLOCKGUSTO_JSON_FIELD(clockgusto_night_config_t, twilight_min, "twilight_min", CLOCKGUSTO_JSON_INT, 0, 240),
+};
+
+static esp_err_t clockgusto_http_night_put(httpd_req_t* req)
+{
+    clockgusto_night_config_t config;
+    clockgusto_night_get_config(&config);
+    uint32_t found = 0;
+    if (!clockgusto_http_parse_body(req, s_night_fields, sizeof(s_night_fields) / sizeof(s_night_fields[0]),
+                                    &config, &found))
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = clockgusto_night_set_config(&config);
+    if (ret != ESP_OK)
+    {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, esp_err_to_name(ret));
+    }
+    return clockgusto_http_night_get(req);
+}
+
+static esp_err_t clockgusto_http_metrics_chunk(void* ctx, const char* data, size_t size)
+{
+    return httpd_resp_send_chunk((httpd_req_t*)ctx, data, size);
+}
+
+/** Prometheus scrapes, sent in chunks of the response buffer. */
+static esp_err_t clockgusto_http_metrics_get(httpd_req_t* req)
+{
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    esp_err_t ret = clockgusto_metrics_write(s_response, sizeof(s_response), clockgusto_http_metrics_chunk, req);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "metrics scrape aborted: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static const httpd_uri_t s_uris[] = {
+    { .uri = "/api/time",       .method = HTTP_GET, .handler = clockgusto_http_time_get },
+    { .uri = "/api/time",       .method = HTTP_PUT, .handler = clockgusto_http_time_put },
+    { .uri = "/api/brightness", .method = HTTP_GET, .handler = clockgusto_http_brightness_get },
+    { .uri = "/api/brightness", .method = HTTP_PUT, .handler = clockgusto_http_brightness_put },
+    { .uri = "/api/mode",       .method = HTTP_GET, .handler = clockgusto_http_mode_get },
+    { .uri = "/api/mode",       .method = HTTP_PUT, .handler = clockgusto_http_mode_put },
+    { .uri = "/api/status",     .method = HTTP_GET, .handler = clockgusto_http_status_get },
+    { .uri = "/api/alarm",      .method = HTTP_GET, .handler = clockgusto_http_alarm_get },
+    { .uri = "/api/alarm",      .method = HTTP_PUT, .handler = clockgusto_http_alarm_put },
+    { .uri = "/api/alarm/dismiss", .method = HTTP_POST, .handler = clockgusto_http_alarm_dismiss },
+    { .uri = "/api/night",      .method = HTTP_GET, .handler = clockgusto_http_night_get },
+    { .uri = "/api/night",      .method = HTTP_PUT, .handler = clockgusto_http_night_put },
+    { .uri = "/metrics",        .method = HTTP_GET, .handler = clockgusto_http_metrics_get },
+};
+
+/** The server outlives link losses, the sockets simply idle until the station is back. */
+static void clockgusto_http_network_handler(void* arg, esp_event_base_t event_base, int32_t event_id,
+                                            void* event_data)
+{
+    if (s_server)
+    {
+        return;
+    }
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.max_uri_handlers = CLOCKGUSTO_HTTP_MAX_HANDLERS;
+    config.stack_size = CLOCKGUSTO_HTTP_TASK_STACK;
+    config.max_open_sockets = CLOCKGUSTO_HTTP_MAX_SOCKETS;
+    config.lru_purge_enable = true;     // a polling app that never closes must not lock others out
+    config.uri_match_fn = httpd_uri_match_wildcard;     // the web ui catches every GET the API leaves
+    esp_err_t ret = httpd_start(&s_server, &config);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start the server: %s\n", esp_err_to_name(ret));
+        s_server = NULL;
+        return;
+    }
+
+    for (size_t idx = 0; idx < sizeof(s_uris) / sizeof(s_uris[0]); ++idx)
+    {
+        httpd_register_uri_handler(s_server, &s_uris[idx]);
+    }
+    ret = clockgusto_events_register(s_server);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "event endpoints: %s", esp_err_to_name(ret));
+    }
+    ret = clockgusto_preview_register(s_server);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "preview: %s", esp_err_to_name(ret));
+    }
+    ret = clockgusto_webui_register(s_server);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "web ui: %s", esp_err_to_name(ret));
+    }
+    ESP_LOGI(TAG, "listening on port %u", config.server_port);
+}
+
+esp_err_t clockgusto_http_init()
+{
+    clockgusto_arena_init(&s_arena, s_arena_buffer, sizeof(s_arena_buffer));
+
+    return esp_event_handler_register(CLOCKGUSTO_NET_EVENT, CLOCKGUSTO_NET_EVENT_UP,
+                                      clockgusto_http_network_handler, NULL);
+}
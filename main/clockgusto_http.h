@@ -0,0 +1,7 @@
+#pragma once
+
+#include "esp_err.h"
+
+/** Serves the REST API under /api once the network comes up. Every response is formatted into one
+ *  static buffer, the server handles one request at a time on its own task. */
+esp_err_t clockgusto_http_init();
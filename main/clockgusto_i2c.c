@@ -0,0 +1,360 @@
+#include "clockgusto_i2c.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "driver/gpio.h"
+#include "driver/i2c.h"
+#include "hal/gpio_types.h"
+#include "hal/i2c_types.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clockgusto_metrics.h"
+
+#define CLOCKGUSTO_I2C_PORT           I2C_NUM_0
+#define CLOCKGUSTO_I2C_TIMEOUT_MS     20      // a DS3231 burst takes about 1 ms at 100 kHz
+#define CLOCKGUSTO_I2C_QUEUE_LENGTH   8
+#define CLOCKGUSTO_I2C_TASK_STACK     3072
+#define CLOCKGUSTO_I2C_TASK_PRIORITY  (tskIDLE_PRIORITY + 5)    // above every client, the bus never waits on them
+#define CLOCKGUSTO_I2C_ATTEMPTS       3
+#define CLOCKGUSTO_I2C_CLEAR_PULSES   9       // a stuck slave releases SDA after at most nine clocks
+#define CLOCKGUSTO_I2C_CLEAR_HALF_US  5       // 100 kHz
+
+typedef struct _clockgusto_i2c_device_entry_t
+{
+    uint8_t address;
+    clockgusto_i2c_priority_t priority;
+    int64_t deadline_us;
+} clockgusto_i2c_device_entry_t;
+
+typedef struct _clockgusto_i2c_request_t
+{
+    clockgusto_i2c_transaction_t transaction;
+    int64_t queued_us;
+} clockgusto_i2c_request_t;
+
+typedef struct _clockgusto_i2c_sync_t
+{
+    SemaphoreHandle_t done;
+    esp_err_t result;
+} clockgusto_i2c_sync_t;
+
+static const char *TAG = "clockgusto i2c";
+
+static TaskHandle_t s_task = NULL;
+static i2c_config_t s_config;
+static QueueHandle_t s_queues[CLOCKGUSTO_I2C_PRIORITY_COUNT];
+static clockgusto_i2c_device_entry_t s_devices[CLOCKGUSTO_I2C_MAX_DEVICES];
+static uint8_t s_device_count = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int64_t s_started_us = 0;
+static clockgusto_i2c_stats_t s_stats;
+static uint64_t s_latency_sum_us = 0;
+
+static bool clockgusto_i2c_next(clockgusto_i2c_request_t* request)
+{
+    for (int8_t priority = CLOCKGUSTO_I2C_PRIORITY_COUNT - 1; priority >= 0; --priority)
+    {
+        if (xQueueReceive(s_queues[priority], request, 0) == pdTRUE)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static esp_err_t clockgusto_i2c_transfer_once(const clockgusto_i2c_transaction_t* transaction, uint8_t address)
+{
+    if (transaction->read_size == 0)
+    {
+        return i2c_master_write_to_device(CLOCKGUSTO_I2C_PORT, address, transaction->write,
+                                          transaction->write_size, pdMS_TO_TICKS(CLOCKGUSTO_I2C_TIMEOUT_MS));
+    }
+    if (transaction->write_size == 0)
+    {
+        return i2c_master_read_from_device(CLOCKGUSTO_I2C_PORT, address, transaction->read,
+                                           transaction->read_size, pdMS_TO_TICKS(CLOCKGUSTO_I2C_TIMEOUT_MS));
+    }
+
+    return i2c_master_write_read_device(CLOCKGUSTO_I2C_PORT, address, transaction->write, transaction->write_size,
+                                        transaction->read, transaction->read_size,
+                                        pdMS_TO_TICKS(CLOCKGUSTO_I2C_TIMEOUT_MS));
+}
+
+static esp_err_t clockgusto_i2c_install()
+{
+    esp_err_t ret = i2c_param_config(CLOCKGUSTO_I2C_PORT, &s_config);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    return i2c_driver_install(CLOCKGUSTO_I2C_PORT, s_config.mode, 0, 0, 0);
+}
+
+/** A slave that lost a clock edge mid byte holds SDA low forever and every further transfer times
+ *  out. Clocking SCL by hand until it lets go and ending with a stop condition frees the bus. */
+static void clockgusto_i2c_clear_bus()
+{
+    i2c_driver_delete(CLOCKGUSTO_I2C_PORT);
+
+    gpio_num_t sda = s_config.sda_io_num;
+    gpio_num_t scl = s_config.scl_io_num;
+    gpio_set_level(scl, 1);
+    gpio_set_level(sda, 1);
+    gpio_set_direction(scl, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_direction(sda, GPIO_MODE_INPUT_OUTPUT_OD);
+
+    for (uint8_t pulse = 0; pulse < CLOCKGUSTO_I2C_CLEAR_PULSES && gpio_get_level(sda) == 0; ++pulse)
+    {
+        gpio_set_level(scl, 0);
+        esp_rom_delay_us(CLOCKGUSTO_I2C_CLEAR_HALF_US);
+        gpio_set_level(scl, 1);
+        esp_rom_delay_us(CLOCKGUSTO_I2C_CLEAR_HALF_US);
+    }
+
+    // stop condition: SDA rises while SCL is high
+    gpio_set_level(scl, 0);
+    esp_rom_delay_us(CLOCKGUSTO_I2C_CLEAR_HALF_US);
+    gpio_set_level(sda, 0);
+    esp_rom_delay_us(CLOCKGUSTO_I2C_CLEAR_HALF_US);
+    gpio_set_level(scl, 1);
+    esp_rom_delay_us(CLOCKGUSTO_I2C_CLEAR_HALF_US);
+    gpio_set_level(sda, 1);
+    esp_rom_delay_us(CLOCKGUSTO_I2C_CLEAR_HALF_US);
+
+    esp_err_t ret = clockgusto_i2c_install();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to reinstall driver after bus clear.\n");
+    }
+}
+
+static void clockgusto_i2c_run(const clockgusto_i2c_request_t* request)
+{
+    const clockgusto_i2c_transaction_t* transaction = &request->transaction;
+    const clockgusto_i2c_device_entry_t* device = &s_devices[transaction->device];
+
+    int64_t start_us = esp_timer_get_time();
+    int64_t latency_us = start_us - request->queued_us;
+    // the histogram takes 32 bits of microseconds, a longer wait counts as the largest value
+    int64_t observed_us = latency_us < 0 ? 0 : (latency_us > UINT32_MAX ? UINT32_MAX : latency_us);
+    clockgusto_metrics_observe(CLOCKGUSTO_METRICS_I2C_LATENCY, (uint32_t)observed_us);
+
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+    bool expired = latency_us > device->deadline_us;
+    uint8_t attempts = 0;
+    uint8_t clears = 0;
+
+    // a stale read is worse than none, the caller decides whether to try again
+    while (!expired && attempts < CLOCKGUSTO_I2C_ATTEMPTS)
+    {
+        ret = clockgusto_i2c_transfer_once(transaction, device->address);
+        attempts++;
+        if (ret == ESP_OK || ret == ESP_ERR_INVALID_ARG)
+        {
+            break;
+        }
+        if (ret == ESP_ERR_TIMEOUT || ret == ESP_ERR_INVALID_STATE)
+        {
+            // the controller saw the bus stuck, a NACK (ESP_FAIL) is retried as is
+            clockgusto_i2c_clear_bus();
+            clears++;
+        }
+        expired = esp_timer_get_time() - request->queued_us > device->deadline_us;
+    }
+    int64_t end_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.transactions++;
+    s_latency_sum_us += latency_us;
+    if (latency_us > s_stats.latency_max_us)
+    {
+        s_stats.latency_max_us = (uint32_t)latency_us;
+    }
+    s_stats.busy_us += end_us - start_us;
+    s_stats.retries += attempts > 1 ? attempts - 1 : 0;
+    s_stats.bus_clears += clears;
+    if (ret != ESP_OK)
+    {
+        s_stats.failures++;
+        if (expired)
+        {
+            s_stats.deadline_misses++;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (transaction->done)
+    {
+        transaction->done(ret, transaction->arg);
+    }
+}
+
+static void clockgusto_i2c_task(void* arg)
+{
+    (void)arg;
+    clockgusto_i2c_request_t request;
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // re-check the higher priorities after every transaction
+        while (clockgusto_i2c_next(&request))
+        {
+            clockgusto_i2c_run(&request);
+        }
+    }
+}
+
+static void clockgusto_i2c_sync_done(esp_err_t result, void* arg)
+{
+    clockgusto_i2c_sync_t* sync = (clockgusto_i2c_sync_t*)arg;
+    sync->result = result;
+    xSemaphoreGive(sync->done);
+}
+
+esp_err_t clockgusto_i2c_init(uint8_t sda_pin, uint8_t scl_pin, uint32_t freq_hz)
+{
+    if (s_task)
+    {
+        return ESP_OK;
+    }
+
+    s_config = (i2c_config_t){
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = sda_pin, // serial data line
+        .sda_pullup_en = GPIO_PULLUP_ENABLE,
+        .scl_io_num = scl_pin, // serial clock
+        .scl_pullup_en = GPIO_PULLUP_ENABLE,
+        .master.clk_speed = freq_hz,
+    };
+
+    esp_err_t ret = clockgusto_i2c_install();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to install driver.\n");
+        return ret;
+    }
+
+    for (uint8_t priority = 0; priority < CLOCKGUSTO_I2C_PRIORITY_COUNT; ++priority)
+    {
+        s_queues[priority] = xQueueCreate(CLOCKGUSTO_I2C_QUEUE_LENGTH, sizeof(clockgusto_i2c_request_t));
+        if (!s_queues[priority])
+        {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    s_started_us = esp_timer_get_time();
+    if (xTaskCreate(clockgusto_i2c_task, "clockgusto i2c", CLOCKGUSTO_I2C_TASK_STACK,
+                    NULL, CLOCKGUSTO_I2C_TASK_PRIORITY, &s_task) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t clockgusto_i2c_add_device(uint8_t address, clockgusto_i2c_priority_t priority, uint32_t deadline_ms,
+                                    clockgusto_i2c_device_t* device)
+{
+    if (priority >= CLOCKGUSTO_I2C_PRIORITY_COUNT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_device_count >= CLOCKGUSTO_I2C_MAX_DEVICES)
+    {
+        portEXIT_CRITICAL(&s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    *device = s_device_count;
+    s_devices[s_device_count++] = (clockgusto_i2c_device_entry_t){
+        .address = address,
+        .priority = priority,
+        .deadline_us = (int64_t)deadline_ms * 1000,
+    };
+    portEXIT_CRITICAL(&s_lock);
+
+    return ESP_OK;
+}
+
+esp_err_t clockgusto_i2c_submit(const clockgusto_i2c_transaction_t* transaction)
+{
+    if (!s_task)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (transaction->device >= s_device_count || (transaction->write_size == 0 && transaction->read_size == 0))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    clockgusto_i2c_request_t request = {
+        .transaction = *transaction,
+        .queued_us = esp_timer_get_time(),
+    };
+    if (xQueueSend(s_queues[s_devices[transaction->device].priority], &request, 0) != pdTRUE)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.queue_full++;
+        portEXIT_CRITICAL(&s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    xTaskNotifyGive(s_task);
+
+    return ESP_OK;
+}
+
+esp_err_t clockgusto_i2c_transfer(clockgusto_i2c_device_t device, const uint8_t* write, size_t write_size,
+                                  uint8_t* read, size_t read_size)
+{
+    StaticSemaphore_t done_buffer;
+    clockgusto_i2c_sync_t sync = {
+        .done = xSemaphoreCreateBinaryStatic(&done_buffer),
+        .result = ESP_FAIL,
+    };
+    clockgusto_i2c_transaction_t transaction = {
+        .device = device,
+        .write = write,
+        .write_size = write_size,
+        .read = read,
+        .read_size = read_size,
+        .done = clockgusto_i2c_sync_done,
+        .arg = &sync,
+    };
+
+    esp_err_t ret = clockgusto_i2c_submit(&transaction);
+    if (ret == ESP_OK)
+    {
+        // every queued transaction completes, expired ones without touching the bus
+        xSemaphoreTake(sync.done, portMAX_DELAY);
+        ret = sync.result;
+    }
+    vSemaphoreDelete(sync.done);
+
+    return ret;
+}
+
+void clockgusto_i2c_get_stats(clockgusto_i2c_stats_t* stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    uint64_t latency_sum_us = s_latency_sum_us;
+    portEXIT_CRITICAL(&s_lock);
+
+    stats->latency_avg_us = stats->transactions ? (uint32_t)(latency_sum_us / stats->transactions) : 0;
+    stats->elapsed_us = s_task ? esp_timer_get_time() - s_started_us : 0;
+    stats->utilisation_permille = stats->elapsed_us ? (uint16_t)(stats->busy_us * 1000 / stats->elapsed_us) : 0;
+}
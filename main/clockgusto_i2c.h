@@ -0,0 +1,70 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLOCKGUSTO_I2C_MAX_DEVICES 4
+
+typedef enum _clockgusto_i2c_priority_t
+{
+    CLOCKGUSTO_I2C_PRIORITY_LOW,
+    CLOCKGUSTO_I2C_PRIORITY_NORMAL,
+    CLOCKGUSTO_I2C_PRIORITY_HIGH,
+    CLOCKGUSTO_I2C_PRIORITY_COUNT
+} clockgusto_i2c_priority_t;
+
+typedef uint8_t clockgusto_i2c_device_t;
+
+/** Runs on the bus task once the transaction finished, failed or missed its deadline. Keep it short,
+ *  the next transaction waits for it. */
+typedef void (*clockgusto_i2c_done_cb_t)(esp_err_t result, void* arg);
+
+/** write goes out first, then a repeated start reads into read. Either side may be empty. The
+ *  buffers belong to the bus until done ran. */
+typedef struct _clockgusto_i2c_transaction_t
+{
+    clockgusto_i2c_device_t device;
+    const uint8_t* write;
+    size_t write_size;
+    uint8_t* read;
+    size_t read_size;
+    clockgusto_i2c_done_cb_t done;
+    void* arg;
+} clockgusto_i2c_transaction_t;
+
+typedef struct _clockgusto_i2c_stats_t
+{
+    uint32_t transactions;
+    uint32_t failures;          // after all attempts
+    uint32_t retries;
+    uint32_t bus_clears;
+    uint32_t deadline_misses;
+    uint32_t queue_full;
+    uint32_t latency_avg_us;    // submit until the bus task starts the transfer
+    uint32_t latency_max_us;
+    uint64_t busy_us;           // time spent on the wire
+    uint64_t elapsed_us;        // since the bus came up
+    uint16_t utilisation_permille;
+} clockgusto_i2c_stats_t;
+
+/** Installs the driver on I2C_NUM_0 and starts the bus task that owns it. Calling it again with the
+ *  bus already up is fine, the first configuration stays. */
+esp_err_t clockgusto_i2c_init(uint8_t sda_pin, uint8_t scl_pin, uint32_t freq_hz);
+
+/** Registers a device. Its transactions are queued at priority and fail with ESP_ERR_TIMEOUT instead
+ *  of going out if they waited longer than deadline_ms for the bus. Failed transfers are retried, after
+ *  a bus clear if the bus hung, as long as the deadline allows. */
+esp_err_t clockgusto_i2c_add_device(uint8_t address, clockgusto_i2c_priority_t priority, uint32_t deadline_ms,
+                                    clockgusto_i2c_device_t* device);
+
+/** Queues a transaction and returns at once, the result arrives through transaction->done. */
+esp_err_t clockgusto_i2c_submit(const clockgusto_i2c_transaction_t* transaction);
+
+/** Queues a transaction and blocks the caller, not the bus, until it completed. */
+esp_err_t clockgusto_i2c_transfer(clockgusto_i2c_device_t device, const uint8_t* write, size_t write_size,
+                                  uint8_t* read, size_t read_size);
+
+/** */
+void clockgusto_i2c_get_stats(clockgusto_i2c_stats_t* stats);
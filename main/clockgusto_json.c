@@ -0,0 +1,577 @@
+#include "clockgusto_json.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CLOCKGUSTO_JSON_FIXED_DECIMALS 4
+
+typedef struct _clockgusto_json_reader_t
+{
+    const char* json;
+    size_t length;
+    size_t pos;
+} clockgusto_json_reader_t;
+
+void clockgusto_arena_init(clockgusto_arena_t* arena, void* buffer, size_t size)
+{
+    arena->base = (uint8_t*)buffer;
+    arena->size = size;
+    arena->used = 0;
+    arena->peak = 0;
+}
+
+void* clockgusto_arena_alloc(clockgusto_arena_t* arena, size_t size)
+{
+    size_t start = (arena->used + 3) & ~(size_t)3;
+    if (start > arena->size || size > arena->size - start)
+    {
+        return NULL;
+    }
+
+    arena->used = start + size;
+    if (arena->used > arena->peak)
+    {
+        arena->peak = arena->used;
+    }
+    return arena->base + start;
+}
+
+void clockgusto_arena_reset(clockgusto_arena_t* arena)
+{
+    arena->used = 0;
+}
+
+static void clockgusto_json_skip_space(clockgusto_json_reader_t* reader)
+{
+    while (reader->pos < reader->length)
+    {
+        char c = reader->json[reader->pos];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+        {
+            return;
+        }
+        reader->pos++;
+    }
+}
+
+/** Next significant character without consuming it, '\0' at the end of the input. */
+static char clockgusto_json_peek(clockgusto_json_reader_t* reader)
+{
+    clockgusto_json_skip_space(reader);
+    return reader->pos < reader->length ? reader->json[reader->pos] : '\0';
+}
+
+static bool clockgusto_json_consume(clockgusto_json_reader_t* reader, char expected)
+{
+    if (clockgusto_json_peek(reader) != expected)
+    {
+        return false;
+    }
+
+    reader->pos++;
+    return true;
+}
+
+static bool clockgusto_json_literal(clockgusto_json_reader_t* reader, const char* literal)
+{
+    size_t size = strlen(literal);
+    if (reader->length - reader->pos < size || memcmp(reader->json + reader->pos, literal, size) != 0)
+    {
+        return false;
+    }
+
+    reader->pos += size;
+    return true;
+}
+
+static int32_t clockgusto_json_hex4(clockgusto_json_reader_t* reader)
+{
+    if (reader->length - reader->pos < 4)
+    {
+        return -1;
+    }
+
+    int32_t value = 0;
+    for (uint8_t idx = 0; idx < 4; ++idx)
+    {
+        char c = reader->json[reader->pos++];
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+        {
+            value |= c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            value |= c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            value |= c - 'A' + 10;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    return value;
+}
+
+/** Copies a string token unescaped into out, NULL only validates it. Too long for capacity, the rest
+ *  is still validated and RANGE is reported. */
+static clockgusto_json_result_t clockgusto_json_string(clockgusto_json_reader_t* reader, char* out,
+                                                       size_t capacity, size_t* out_length)
+{
+    if (!clockgusto_json_consume(reader, '"'))
+    {
+        return CLOCKGUSTO_JSON_SYNTAX;
+    }
+
+    size_t length = 0;
+    bool overflow = false;
+    while (reader->pos < reader->length)
+    {
+        uint8_t c = (uint8_t)reader->json[reader->pos++];
+        uint8_t encoded[4];
+        uint8_t encoded_size = 1;
+        encoded[0] = c;
+
+        if (c == '"')
+        {
+            if (out && capacity > 0)
+            {
+                out[overflow ? capacity - 1 : length] = '\0';
+            }
+            if (out_length)
+            {
+                *out_length = length;
+            }
+            return overflow ? CLOCKGUSTO_JSON_RANGE : CLOCKGUSTO_JSON_OK;
+        }
+        if (c < 0x20)
+        {
+            return CLOCKGUSTO_JSON_SYNTAX;
+        }
+        if (c == '\\')
+        {
+            if (reader->pos >= reader->length)
+            {
+                return CLOCKGUSTO_JSON_SYNTAX;
+            }
+            char escape = reader->json[reader->pos++];
+            switch (escape)
+            {
+            case '"':  encoded[0] = '"';  break;
+            case '\\': encoded[0] = '\\'; break;
+            case '/':  encoded[0] = '/';  break;
+            case 'b':  encoded[0] = '\b'; break;
+            case 'f':  encoded[0] = '\f'; break;
+            case 'n':  encoded[0] = '\n'; break;
+            case 'r':  encoded[0] = '\r'; break;
+            case 't':  encoded[0] = '\t'; break;
+            case 'u':
+            {
+                int32_t code = clockgusto_json_hex4(reader);
+                if (code < 0 || (code >= 0xdc00 && code <= 0xdfff))
+                {
+                    return CLOCKGUSTO_JSON_SYNTAX;
+                }
+                if (code >= 0xd800 && code <= 0xdbff)
+                {
+                    // a high surrogate needs its low half right behind it
+                    if (!clockgusto_json_literal(reader, "\\u"))
+                    {
+                        return CLOCKGUSTO_JSON_SYNTAX;
+                    }
+                    int32_t low = clockgusto_json_hex4(reader);
+                    if (low < 0xdc00 || low > 0xdfff)
+                    {
+                        return CLOCKGUSTO_JSON_SYNTAX;
+                    }
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                }
+
+                if (code < 0x80)
+                {
+                    encoded[0] = (uint8_t)code;
+                }
+                else if (code < 0x800)
+                {
+                    encoded[0] = (uint8_t)(0xc0 | (code >> 6));
+                    encoded[1] = (uint8_t)(0x80 | (code & 0x3f));
+                    encoded_size = 2;
+                }
+                else if (code < 0x10000)
+                {
+                    encoded[0] = (uint8_t)(0xe0 | (code >> 12));
+                    encoded[1] = (uint8_t)(0x80 | ((code >> 6) & 0x3f));
+                    encoded[2] = (uint8_t)(0x80 | (code & 0x3f));
+                    encoded_size = 3;
+                }
+                else
+                {
+                    encoded[0] = (uint8_t)(0xf0 | (code >> 18));
+                    encoded[1] = (uint8_t)(0x80 | ((code >> 12) & 0x3f));
+                    encoded[2] = (uint8_t)(0x80 | ((code >> 6) & 0x3f));
+                    encoded[3] = (uint8_t)(0x80 | (code & 0x3f));
+                    encoded_size = 4;
+                }
+                break;
+            }
+            default:
+                return CLOCKGUSTO_JSON_SYNTAX;
+            }
+        }
+
+        if (out && !overflow)
+        {
+            if (capacity == 0 || length + encoded_size > capacity - 1)
+            {
+                overflow = true;
+                continue;
+            }
+            memcpy(out + length, encoded, encoded_size);
+        }
+        length += encoded_size;
+    }
+
+    return CLOCKGUSTO_JSON_SYNTAX;
+}
+
+/** JSON number grammar. The value is scaled by 10^decimals, digits beyond are cut off, exponents are a
+ *  TYPE error because none of the API's fields needs them. */
+static clockgusto_json_result_t clockgusto_json_number(clockgusto_json_reader_t* reader, uint8_t decimals,
+                                                       int64_t* value)
+{
+    clockgusto_json_skip_space(reader);
+    const char* json = reader->json;
+    bool negative = false;
+    bool overflow = false;
+    bool fraction = false;
+    bool exponent = false;
+    int64_t magnitude = 0;
+    uint8_t fraction_digits = 0;
+
+    if (reader->pos < reader->length && json[reader->pos] == '-')
+    {
+        negative = true;
+        reader->pos++;
+    }
+    if (reader->pos >= reader->length || json[reader->pos] < '0' || json[reader->pos] > '9')
+    {
+        return CLOCKGUSTO_JSON_SYNTAX;
+    }
+    if (json[reader->pos] == '0' && reader->pos + 1 < reader->length && json[reader->pos + 1] >= '0' &&
+        json[reader->pos + 1] <= '9')
+    {
+        return CLOCKGUSTO_JSON_SYNTAX;
+    }
+    while (reader->pos < reader->length && json[reader->pos] >= '0' && json[reader->pos] <= '9')
+    {
+        if (magnitude > (INT64_MAX - 9) / 10)
+        {
+            overflow = true;
+        }
+        else
+        {
+            magnitude = magnitude * 10 + (json[reader->pos] - '0');
+        }
+        reader->pos++;
+    }
+
+    if (reader->pos < reader->length && json[reader->pos] == '.')
+    {
+        fraction = true;
+        reader->pos++;
+        if (reader->pos >= reader->length || json[reader->pos] < '0' || json[reader->pos] > '9')
+        {
+            return CLOCKGUSTO_JSON_SYNTAX;
+        }
+        while (reader->pos < reader->length && json[reader->pos] >= '0' && json[reader->pos] <= '9')
+        {
+            if (fraction_digits < decimals)
+            {
+                if (magnitude > (INT64_MAX - 9) / 10)
+                {
+                    overflow = true;
+                }
+                else
+                {
+                    magnitude = magnitude * 10 + (json[reader->pos] - '0');
+                }
+                fraction_digits++;
+            }
+            reader->pos++;
+        }
+    }
+
+    if (reader->pos < reader->length && (json[reader->pos] == 'e' || json[reader->pos] == 'E'))
+    {
+        exponent = true;
+        reader->pos++;
+        if (reader->pos < reader->length && (json[reader->pos] == '+' || json[reader->pos] == '-'))
+        {
+            reader->pos++;
+        }
+        if (reader->pos >= reader->length || json[reader->pos] < '0' || json[reader->pos] > '9')
+        {
+            return CLOCKGUSTO_JSON_SYNTAX;
+        }
+        while (reader->pos < reader->length && json[reader->pos] >= '0' && json[reader->pos] <= '9')
+        {
+            reader->pos++;
+        }
+    }
+
+    if (exponent || (fraction && decimals == 0))
+    {
+        return CLOCKGUSTO_JSON_TYPE;
+    }
+    for (; fraction_digits < decimals; ++fraction_digits)
+    {
+        if (magnitude > INT64_MAX / 10)
+        {
+            overflow = true;
+            break;
+        }
+        magnitude *= 10;
+    }
+    if (overflow)
+    {
+        return CLOCKGUSTO_JSON_RANGE;
+    }
+
+    *value = negative ? -magnitude : magnitude;
+    return CLOCKGUSTO_JSON_OK;
+}
+
+static clockgusto_json_result_t clockgusto_json_skip(clockgusto_json_reader_t* reader, uint8_t depth)
+{
+    char c = clockgusto_json_peek(reader);
+    if (c == '"')
+    {
+        return clockgusto_json_string(reader, NULL, 0, NULL);
+    }
+    if (c == '{' || c == '[')
+    {
+        if (depth >= CLOCKGUSTO_JSON_MAX_DEPTH)
+        {
+            return CLOCKGUSTO_JSON_DEPTH;
+        }
+
+        char close = c == '{' ? '}' : ']';
+        reader->pos++;
+        if (clockgusto_json_consume(reader, close))
+        {
+            return CLOCKGUSTO_JSON_OK;
+        }
+        do
+        {
+            if (c == '{')
+            {
+                clockgusto_json_result_t result = clockgusto_json_string(reader, NULL, 0, NULL);
+                if (result != CLOCKGUSTO_JSON_OK)
+                {
+                    return result;
+                }
+                if (!clockgusto_json_consume(reader, ':'))
+                {
+                    return CLOCKGUSTO_JSON_SYNTAX;
+                }
+            }
+            clockgusto_json_result_t result = clockgusto_json_skip(reader, depth + 1);
+            if (result != CLOCKGUSTO_JSON_OK)
+            {
+                return result;
+            }
+        } while (clockgusto_json_consume(reader, ','));
+
+        return clockgusto_json_consume(reader, close) ? CLOCKGUSTO_JSON_OK : CLOCKGUSTO_JSON_SYNTAX;
+    }
+    if (c == 't')
+    {
+        return clockgusto_json_literal(reader, "true") ? CLOCKGUSTO_JSON_OK : CLOCKGUSTO_JSON_SYNTAX;
+    }
+    if (c == 'f')
+    {
+        return clockgusto_json_literal(reader, "false") ? CLOCKGUSTO_JSON_OK : CLOCKGUSTO_JSON_SYNTAX;
+    }
+    if (c == 'n')
+    {
+        return clockgusto_json_literal(reader, "null") ? CLOCKGUSTO_JSON_OK : CLOCKGUSTO_JSON_SYNTAX;
+    }
+
+    // numbers only need to be well formed here, whatever their size or exponent
+    int64_t ignored;
+    clockgusto_json_result_t result = clockgusto_json_number(reader, 0, &ignored);
+    return result == CLOCKGUSTO_JSON_SYNTAX ? CLOCKGUSTO_JSON_SYNTAX : CLOCKGUSTO_JSON_OK;
+}
+
+static void clockgusto_json_store_int(void* member, uint16_t size, int64_t value)
+{
+    switch (size)
+    {
+    case 1: { int8_t narrow = (int8_t)value; memcpy(member, &narrow, size); break; }
+    case 2: { int16_t narrow = (int16_t)value; memcpy(member, &narrow, size); break; }
+    case 4: { int32_t narrow = (int32_t)value; memcpy(member, &narrow, size); break; }
+    default: memcpy(member, &value, sizeof(value)); break;
+    }
+}
+
+static clockgusto_json_result_t clockgusto_json_value(clockgusto_json_reader_t* reader,
+                                                      const clockgusto_json_field_t* field, void* target)
+{
+    uint8_t* member = (uint8_t*)target + field->offset;
+    char c = clockgusto_json_peek(reader);
+
+    switch (field->type)
+    {
+    case CLOCKGUSTO_JSON_BOOL:
+    {
+        bool value;
+        if (c == 't' && clockgusto_json_literal(reader, "true"))
+        {
+            value = true;
+        }
+        else if (c == 'f' && clockgusto_json_literal(reader, "false"))
+        {
+            value = false;
+        }
+        else
+        {
+            clockgusto_json_result_t result = clockgusto_json_skip(reader, 0);
+            return result == CLOCKGUSTO_JSON_OK ? CLOCKGUSTO_JSON_TYPE : result;
+        }
+        memcpy(member, &value, sizeof(value));
+        return CLOCKGUSTO_JSON_OK;
+    }
+
+    case CLOCKGUSTO_JSON_INT:
+    case CLOCKGUSTO_JSON_FIXED4:
+    {
+        if (c != '-' && (c < '0' || c > '9'))
+        {
+            clockgusto_json_result_t result = clockgusto_json_skip(reader, 0);
+            return result == CLOCKGUSTO_JSON_OK ? CLOCKGUSTO_JSON_TYPE : result;
+        }
+
+        int64_t value = 0;
+        uint8_t decimals = field->type == CLOCKGUSTO_JSON_FIXED4 ? CLOCKGUSTO_JSON_FIXED_DECIMALS : 0;
+        clockgusto_json_result_t result = clockgusto_json_number(reader, decimals, &value);
+        if (result != CLOCKGUSTO_JSON_OK)
+        {
+            return result;
+        }
+        if (value < field->min || value > field->max)
+        {
+            return CLOCKGUSTO_JSON_RANGE;
+        }
+        clockgusto_json_store_int(member, field->size, value);
+        return CLOCKGUSTO_JSON_OK;
+    }
+
+    case CLOCKGUSTO_JSON_STRING:
+    {
+        if (c != '"')
+        {
+            clockgusto_json_result_t result = clockgusto_json_skip(reader, 0);
+            return result == CLOCKGUSTO_JSON_OK ? CLOCKGUSTO_JSON_TYPE : result;
+        }
+
+        size_t length = 0;
+        clockgusto_json_result_t result = clockgusto_json_string(reader, (char*)member, field->size, &length);
+        if (result == CLOCKGUSTO_JSON_OK && (int64_t)length < field->min)
+        {
+            return CLOCKGUSTO_JSON_RANGE;
+        }
+        return result;
+    }
+    }
+
+    return CLOCKGUSTO_JSON_TYPE;
+}
+
+clockgusto_json_result_t clockgusto_json_parse(const char* json, size_t length,
+                                               const clockgusto_json_field_t* fields, uint8_t field_count,
+                                               void* target, uint32_t* found)
+{
+    clockgusto_json_reader_t reader = {
+        .json = json,
+        .length = length,
+        .pos = 0,
+    };
+    *found = 0;
+    if (field_count > CLOCKGUSTO_JSON_MAX_FIELDS)
+    {
+        return CLOCKGUSTO_JSON_RANGE;
+    }
+    if (!clockgusto_json_consume(&reader, '{'))
+    {
+        return CLOCKGUSTO_JSON_SYNTAX;
+    }
+
+    if (!clockgusto_json_consume(&reader, '}'))
+    {
+        do
+        {
+            // longer keys than any field cannot match and are only validated
+            char key[CLOCKGUSTO_JSON_MAX_KEY + 1];
+            size_t key_length = 0;
+            clockgusto_json_result_t result = clockgusto_json_string(&reader, key, sizeof(key), &key_length);
+            if (result == CLOCKGUSTO_JSON_SYNTAX)
+            {
+                return result;
+            }
+            bool known_length = result == CLOCKGUSTO_JSON_OK;
+            if (!clockgusto_json_consume(&reader, ':'))
+            {
+                return CLOCKGUSTO_JSON_SYNTAX;
+            }
+
+            uint8_t field_idx = field_count;
+            for (uint8_t idx = 0; known_length && idx < field_count; ++idx)
+            {
+                if (strlen(fields[idx].key) == key_length && memcmp(key, fields[idx].key, key_length) == 0)
+                {
+                    field_idx = idx;
+                    break;
+                }
+            }
+
+            if (field_idx < field_count)
+            {
+                result = clockgusto_json_value(&reader, &fields[field_idx], target);
+                *found |= (uint32_t)1 << field_idx;
+            }
+            else
+            {
+                result = clockgusto_json_skip(&reader, 0);
+            }
+            if (result != CLOCKGUSTO_JSON_OK)
+            {
+                return result;
+            }
+        } while (clockgusto_json_consume(&reader, ','));
+
+        if (!clockgusto_json_consume(&reader, '}'))
+        {
+            return CLOCKGUSTO_JSON_SYNTAX;
+        }
+    }
+
+    return clockgusto_json_peek(&reader) == '\0' && reader.pos == reader.length ? CLOCKGUSTO_JSON_OK
+                                                                                  : CLOCKGUSTO_JSON_SYNTAX;
+}
+
+const char* clockgusto_json_result_name(clockgusto_json_result_t result)
+{
+    switch (result)
+    {
+    case CLOCKGUSTO_JSON_OK:     return "ok";
+    case CLOCKGUSTO_JSON_SYNTAX: return "syntax error";
+    case CLOCKGUSTO_JSON_TYPE:   return "wrong type";
+    case CLOCKGUSTO_JSON_RANGE:  return "out of range";
+    case CLOCKGUSTO_JSON_DEPTH:  return "nested too deep";
+    }
+    return "unknown";
+}
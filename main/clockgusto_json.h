@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLOCKGUSTO_JSON_MAX_DEPTH   8       // nesting of skipped values
+#define CLOCKGUSTO_JSON_MAX_KEY     31
+#define CLOCKGUSTO_JSON_MAX_FIELDS  32
+
+/* Plain C without ESP-IDF dependencies, so the parser can be fuzzed and benchmarked on a host. */
+
+/** Bump allocator over a fixed buffer. Everything a request needs comes from here and is dropped in
+ *  one go by the reset, so the heap never sees request sized blocks. */
+typedef struct _clockgusto_arena_t
+{
+    uint8_t* base;
+    size_t size;
+    size_t used;
+    size_t peak;
+} clockgusto_arena_t;
+
+typedef enum _clockgusto_json_type_t
+{
+    CLOCKGUSTO_JSON_BOOL,           // bool member
+    CLOCKGUSTO_JSON_INT,            // signed or unsigned member of 1, 2, 4 or 8 bytes, range checked
+    CLOCKGUSTO_JSON_FIXED4,         // decimal number stored times 10000 in an integer member
+    CLOCKGUSTO_JSON_STRING,         // char array, unescaped and terminated
+} clockgusto_json_type_t;
+
+typedef enum _clockgusto_json_result_t
+{
+    CLOCKGUSTO_JSON_OK,
+    CLOCKGUSTO_JSON_SYNTAX,         // not a single well formed object
+    CLOCKGUSTO_JSON_TYPE,           // a known key holds the wrong kind of value
+    CLOCKGUSTO_JSON_RANGE,          // number out of range or string too long for its member
+    CLOCKGUSTO_JSON_DEPTH,          // skipped value nested too deep
+} clockgusto_json_result_t;
+
+/** Where a key's value lands in the target struct. */
+typedef struct _clockgusto_json_field_t
+{
+    const char* key;
+    clockgusto_json_type_t type;
+    uint16_t offset;
+    uint16_t size;
+    int64_t min;
+    int64_t max;
+} clockgusto_json_field_t;
+
+#define CLOCKGUSTO_JSON_FIELD(type_name, member, json_key, json_type, min_value, max_value) \
+    { .key = (json_key), .type = (json_type), .offset = offsetof(type_name, member),            \
+      .size = sizeof(((type_name*)0)->member), .min = (min_value), .max = (max_value) }
+
+/** */
+void clockgusto_arena_init(clockgusto_arena_t* arena, void* buffer, size_t size);
+
+/** Word aligned block, NULL once the arena is exhausted. */
+void* clockgusto_arena_alloc(clockgusto_arena_t* arena, size_t size);
+
+/** */
+void clockgusto_arena_reset(clockgusto_arena_t* arena);
+
+/** Parses one object in a single pass straight into target, without tokens or a tree. It takes the
+ *  whole body at once, the HTTP server receives it into the request arena first. Keys without a
+ *  field are skipped, whatever they hold. Bit n of *found is set when fields[n] was present. target
+ *  may be partly written when the result is not CLOCKGUSTO_JSON_OK. */
+clockgusto_json_result_t clockgusto_json_parse(const char* json, size_t length,
+                                               const clockgusto_json_field_t* fields, uint8_t field_count,
+                                               void* target, uint32_t* found);
+
+/** */
+const char* clockgusto_json_result_name(clockgusto_json_result_t result);
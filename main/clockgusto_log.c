@@ -0,0 +1,80 @@
+#include "clockgusto_log.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static vprintf_like_t s_console = NULL;
+static clockgusto_log_listener_t s_listener = NULL;
+
+static char s_lines[CLOCKGUSTO_LOG_LINES][CLOCKGUSTO_LOG_LINE_SIZE];
+static uint32_t s_seq = 0;
+
+/** Formats into the ring first, then hands the untouched arguments on to the console. */
+static int clockgusto_log_vprintf(const char* format, va_list args)
+{
+    char line[CLOCKGUSTO_LOG_LINE_SIZE];
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(line, sizeof(line), format, copy);
+    va_end(copy);
+
+    if (length > 0)
+    {
+        size_t size = strnlen(line, sizeof(line));
+        while (size > 0 && (line[size - 1] == '\n' || line[size - 1] == '\r'))
+        {
+            line[--size] = '\0';
+        }
+
+        portENTER_CRITICAL(&s_lock);
+        uint32_t seq = ++s_seq;
+        memcpy(s_lines[seq % CLOCKGUSTO_LOG_LINES], line, size + 1);
+        portEXIT_CRITICAL(&s_lock);
+
+        clockgusto_log_listener_t listener = s_listener;
+        if (listener)
+        {
+            listener(seq);
+        }
+    }
+
+    return s_console ? s_console(format, args) : length;
+}
+
+void clockgusto_log_init()
+{
+    if (!s_console)
+    {
+        s_console = esp_log_set_vprintf(clockgusto_log_vprintf);
+    }
+}
+
+void clockgusto_log_set_listener(clockgusto_log_listener_t listener)
+{
+    s_listener = listener;
+}
+
+uint32_t clockgusto_log_get_seq()
+{
+    return s_seq;
+}
+
+bool clockgusto_log_get_line(uint32_t seq, char* line, size_t size)
+{
+    bool available = false;
+    portENTER_CRITICAL(&s_lock);
+    if (seq > 0 && seq <= s_seq && s_seq - seq < CLOCKGUSTO_LOG_LINES)
+    {
+        strlcpy(line, s_lines[seq % CLOCKGUSTO_LOG_LINES], size);
+        available = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    return available;
+}
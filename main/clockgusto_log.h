@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLOCKGUSTO_LOG_LINES        32
+#define CLOCKGUSTO_LOG_LINE_SIZE    96      // longer lines are cut
+
+typedef void (*clockgusto_log_listener_t)(uint32_t seq);
+
+/** Hooks esp_log so every line also lands in a ring of the last CLOCKGUSTO_LOG_LINES lines. Lines are
+ *  numbered from 1, the console output is unchanged. */
+void clockgusto_log_init();
+
+/** Called after each stored line, from the task that logged it. It must not log itself. */
+void clockgusto_log_set_listener(clockgusto_log_listener_t listener);
+
+/** Sequence number of the newest line, 0 before the first. */
+uint32_t clockgusto_log_get_seq();
+
+/** Copies line seq without its newline. Returns false once the ring has overwritten it or before it
+ *  was written. */
+bool clockgusto_log_get_line(uint32_t seq, char* line, size_t size);
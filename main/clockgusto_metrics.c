@@ -0,0 +1,214 @@
+#include "clockgusto_metrics.h"
+
+#include "esp_system.h"
+#include "esp_timer.h"
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "clockgusto.h"
+#include "clockgusto_boot.h"
+#include "clockgusto_i2c.h"
+#include "clockgusto_serial.h"
+#include "clockgusto_wifi.h"
+
+#define CLOCKGUSTO_METRICS_MAX_BOUNDS   10
+
+typedef struct _clockgusto_metrics_histogram_t
+{
+    const char* name;
+    const char* help;
+    const uint32_t* bounds_us;      // upper bounds, ascending, +Inf follows implicitly
+    uint8_t bound_count;
+} clockgusto_metrics_histogram_t;
+
+/* A frame at the chase rate has 125 ms, the strip alone needs about 3.6 ms. */
+static const uint32_t s_frame_bounds_us[] = { 1000, 2000, 4000, 6000, 8000, 12000, 16000, 32000, 64000, 125000 };
+static const uint32_t s_transmit_bounds_us[] = { 2000, 3000, 3500, 4000, 4500, 5000, 7500, 10000, 20000, 50000 };
+static const uint32_t s_i2c_bounds_us[] = { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000 };
+
+static const clockgusto_metrics_histogram_t s_histograms[CLOCKGUSTO_METRICS_HISTOGRAM_COUNT] = {
+    [CLOCKGUSTO_METRICS_FRAME_RENDER] = { "clockgusto_frame_render_seconds", "Update and show of one frame",
+                                          s_frame_bounds_us, sizeof(s_frame_bounds_us) / sizeof(uint32_t) },
+    [CLOCKGUSTO_METRICS_RMT_TRANSMIT] = { "clockgusto_rmt_transmit_seconds", "LED strip transfer of one frame",
+                                          s_transmit_bounds_us, sizeof(s_transmit_bounds_us) / sizeof(uint32_t) },
+    [CLOCKGUSTO_METRICS_I2C_LATENCY]  = { "clockgusto_i2c_latency_seconds", "I2C submit until the transfer starts",
+                                          s_i2c_bounds_us, sizeof(s_i2c_bounds_us) / sizeof(uint32_t) },
+};
+
+/* Buckets are not cumulative here, the scrape sums them up and takes the count from the total. The
+ * sum carries into a high word when the low one wraps, about every 70 minutes of observed time. */
+static atomic_uint_least32_t s_buckets[CLOCKGUSTO_METRICS_HISTOGRAM_COUNT][CLOCKGUSTO_METRICS_MAX_BOUNDS + 1];
+static atomic_uint_least32_t s_sum_low_us[CLOCKGUSTO_METRICS_HISTOGRAM_COUNT];
+static atomic_uint_least32_t s_sum_high[CLOCKGUSTO_METRICS_HISTOGRAM_COUNT];
+
+typedef struct _clockgusto_metrics_writer_t
+{
+    char* buffer;
+    size_t size;
+    size_t length;
+    clockgusto_metrics_sink_t sink;
+    void* ctx;
+    esp_err_t ret;
+} clockgusto_metrics_writer_t;
+
+void clockgusto_metrics_observe(clockgusto_metrics_histogram_id_t id, uint32_t value_us)
+{
+    const clockgusto_metrics_histogram_t* histogram = &s_histograms[id];
+    uint8_t bucket = 0;
+    while (bucket < histogram->bound_count && value_us > histogram->bounds_us[bucket])
+    {
+        bucket++;
+    }
+
+    atomic_fetch_add_explicit(&s_buckets[id][bucket], 1, memory_order_relaxed);
+    uint32_t sum = atomic_fetch_add_explicit(&s_sum_low_us[id], value_us, memory_order_relaxed);
+    if ((uint32_t)(sum + value_us) < sum)
+    {
+        atomic_fetch_add_explicit(&s_sum_high[id], 1, memory_order_relaxed);
+    }
+}
+
+static void clockgusto_metrics_flush(clockgusto_metrics_writer_t* writer)
+{
+    if (writer->ret == ESP_OK && writer->length > 0)
+    {
+        writer->ret = writer->sink(writer->ctx, writer->buffer, writer->length);
+    }
+    writer->length = 0;
+}
+
+static void clockgusto_metrics_printf(clockgusto_metrics_writer_t* writer, const char* format, ...)
+{
+    for (uint8_t attempt = 0; attempt < 2; ++attempt)
+    {
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(writer->buffer + writer->length, writer->size - writer->length, format, args);
+        va_end(args);
+        if (length >= 0 && (size_t)length < writer->size - writer->length)
+        {
+            writer->length += length;
+            return;
+        }
+        // the line did not fit, send what is there and write it again at the start
+        clockgusto_metrics_flush(writer);
+    }
+}
+
+static void clockgusto_metrics_scalar(clockgusto_metrics_writer_t* writer, const char* name, const char* type,
+                                      const char* help, int64_t value)
+{
+    clockgusto_metrics_printf(writer, "# HELP %s %s\n# TYPE %s %s\n%s %" PRId64 "\n", name, help, name, type, name,
+                              value);
+}
+
+static void clockgusto_metrics_histogram(clockgusto_metrics_writer_t* writer, clockgusto_metrics_histogram_id_t id)
+{
+    const clockgusto_metrics_histogram_t* histogram = &s_histograms[id];
+    clockgusto_metrics_printf(writer, "# HELP %s %s\n# TYPE %s histogram\n", histogram->name, histogram->help,
+                              histogram->name);
+
+    uint32_t count = 0;
+    for (uint8_t bucket = 0; bucket < histogram->bound_count; ++bucket)
+    {
+        count += atomic_load_explicit(&s_buckets[id][bucket], memory_order_relaxed);
+        clockgusto_metrics_printf(writer, "%s_bucket{le=\"%g\"} %" PRIu32 "\n", histogram->name,
+                                  histogram->bounds_us[bucket] / 1e6, count);
+    }
+    count += atomic_load_explicit(&s_buckets[id][histogram->bound_count], memory_order_relaxed);
+
+    uint32_t high;
+    uint32_t low;
+    do
+    {
+        high = atomic_load_explicit(&s_sum_high[id], memory_order_relaxed);
+        low = atomic_load_explicit(&s_sum_low_us[id], memory_order_relaxed);
+    } while (high != atomic_load_explicit(&s_sum_high[id], memory_order_relaxed));
+    uint64_t sum_us = (uint64_t)high << 32 | low;
+
+    clockgusto_metrics_printf(writer, "%s_bucket{le=\"+Inf\"} %" PRIu32 "\n%s_sum %.6f\n%s_count %" PRIu32 "\n",
+                              histogram->name, count, histogram->name, sum_us / 1e6, histogram->name, count);
+}
+
+/** One sample per stage reached, so a scrape after a slow boot shows which stage took the time. */
+static void clockgusto_metrics_boot(clockgusto_metrics_writer_t* writer)
+{
+    clockgusto_boot_report_t boot;
+    clockgusto_boot_get_report(&boot);
+
+    clockgusto_metrics_printf(writer, "# HELP clockgusto_boot_stage_seconds Time since startup a boot stage was "
+                              "reached at\n# TYPE clockgusto_boot_stage_seconds gauge\n");
+    for (uint8_t stage = 0; stage < CLOCKGUSTO_BOOT_STAGE_COUNT; ++stage)
+    {
+        if (boot.stage_us[stage] >= 0)
+        {
+            clockgusto_metrics_printf(writer, "clockgusto_boot_stage_seconds{stage=\"%s\"} %.6f\n",
+                                      clockgusto_boot_stage_name((clockgusto_boot_stage_t)stage),
+                                      boot.stage_us[stage] / 1e6);
+        }
+    }
+    clockgusto_metrics_scalar(writer, "clockgusto_boot_over_budget", "gauge",
+                              "1 when the first correct frame came later than the boot budget", boot.over_budget);
+}
+
+esp_err_t clockgusto_metrics_write(char* buffer, size_t size, clockgusto_metrics_sink_t sink, void* ctx)
+{
+    clockgusto_health_t health;
+    clockgusto_get_health(&health);
+    clockgusto_wifi_stats_t wifi;
+    clockgusto_wifi_get_stats(&wifi);
+    clockgusto_i2c_stats_t i2c;
+    clockgusto_i2c_get_stats(&i2c);
+    clockgusto_serial_stats_t serial;
+    clockgusto_serial_get_stats(&serial);
+
+    clockgusto_metrics_writer_t writer = {
+        .buffer = buffer,
+        .size = size,
+        .length = 0,
+        .sink = sink,
+        .ctx = ctx,
+        .ret = ESP_OK,
+    };
+
+    for (uint8_t id = 0; id < CLOCKGUSTO_METRICS_HISTOGRAM_COUNT; ++id)
+    {
+        clockgusto_metrics_histogram(&writer, (clockgusto_metrics_histogram_id_t)id);
+    }
+    clockgusto_metrics_boot(&writer);
+    clockgusto_metrics_scalar(&writer, "clockgusto_render_errors_total", "counter",
+                              "Frames the LED strip did not take", health.render_errors);
+    clockgusto_metrics_scalar(&writer, "clockgusto_render_recoveries_total", "counter",
+                              "Stuck LED strip transfers aborted", health.render_recoveries);
+    clockgusto_metrics_scalar(&writer, "clockgusto_i2c_transactions_total", "counter",
+                              "I2C transactions completed or failed", i2c.transactions);
+    clockgusto_metrics_scalar(&writer, "clockgusto_i2c_errors_total", "counter",
+                              "I2C transactions failed after all attempts", i2c.failures);
+    clockgusto_metrics_scalar(&writer, "clockgusto_i2c_retries_total", "counter",
+                              "I2C transfers attempted again", i2c.retries);
+    clockgusto_metrics_scalar(&writer, "clockgusto_i2c_deadline_misses_total", "counter",
+                              "I2C transactions that waited past their deadline", i2c.deadline_misses);
+    clockgusto_metrics_scalar(&writer, "clockgusto_wifi_rssi_dbm", "gauge",
+                              "Last RSSI sample, 0 before the first", wifi.rssi);
+    clockgusto_metrics_scalar(&writer, "clockgusto_wifi_connects_total", "counter",
+                              "Wi-Fi connections that got an address", wifi.connects);
+    clockgusto_metrics_scalar(&writer, "clockgusto_wifi_disconnects_total", "counter",
+                              "Wi-Fi attempts failed or links lost", wifi.disconnects);
+    clockgusto_metrics_scalar(&writer, "clockgusto_serial_requests_total", "counter",
+                              "Valid frames from the serial host", serial.requests);
+    clockgusto_metrics_scalar(&writer, "clockgusto_serial_noise_total", "counter",
+                              "Serial input that was no valid frame", serial.noise + serial.overruns);
+    clockgusto_metrics_scalar(&writer, "clockgusto_heap_free_bytes", "gauge", "Free heap",
+                              esp_get_free_heap_size());
+    clockgusto_metrics_scalar(&writer, "clockgusto_heap_min_free_bytes", "gauge", "Lowest free heap since boot",
+                              esp_get_minimum_free_heap_size());
+    clockgusto_metrics_scalar(&writer, "clockgusto_uptime_seconds", "counter", "Time since boot",
+                              esp_timer_get_time() / 1000000);
+
+    clockgusto_metrics_flush(&writer);
+    return writer.ret;
+}
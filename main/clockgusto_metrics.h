@@ -0,0 +1,25 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum _clockgusto_metrics_histogram_id_t
+{
+    CLOCKGUSTO_METRICS_FRAME_RENDER,    // update and show of one frame, transmit included
+    CLOCKGUSTO_METRICS_RMT_TRANSMIT,    // channel enabled until the strip latched the frame
+    CLOCKGUSTO_METRICS_I2C_LATENCY,     // submit until the bus task starts the transfer
+    CLOCKGUSTO_METRICS_HISTOGRAM_COUNT
+} clockgusto_metrics_histogram_id_t;
+
+/** Takes one piece of the text, which always ends at a line end. */
+typedef esp_err_t (*clockgusto_metrics_sink_t)(void* ctx, const char* data, size_t size);
+
+/** Writes everything in the Prometheus text format: the histograms observed here, plus counters and gauges
+ *  the other modules already keep, read now. Lines collect in buffer and go to sink whenever it is
+ *  full, so the text has no size limit. Stops at the first error of the sink. */
+esp_err_t clockgusto_metrics_write(char* buffer, size_t size, clockgusto_metrics_sink_t sink, void* ctx);
+
+/** Counts a duration into its fixed buckets with a few relaxed atomic adds, no lock and no
+ *  allocation, so any task may call it from its hot path. */
+void clockgusto_metrics_observe(clockgusto_metrics_histogram_id_t id, uint32_t value_us);
@@ -0,0 +1,354 @@
+#include "clockgusto_mqtt.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mqtt_client.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "clockgusto.h"
+#include "clockgusto_alarm.h"
+#include "clockgusto_events.h"
+#include "clockgusto_night.h"
+#include "clockgusto_temperature.h"
+#include "clockgusto_time.h"
+#include "clockgusto_wifi.h"
+
+#define CLOCKGUSTO_MQTT_MIN_INTERVAL_MS 2000    // a burst of changes goes out as one publish
+#define CLOCKGUSTO_MQTT_PERIOD_MS       60000   // temperature and health change without a notification
+#define CLOCKGUSTO_MQTT_KEEPALIVE_S     120
+#define CLOCKGUSTO_MQTT_TOPIC_SIZE      64
+#define CLOCKGUSTO_MQTT_PAYLOAD_SIZE    320
+#define CLOCKGUSTO_MQTT_VALUE_SIZE      16
+#define CLOCKGUSTO_MQTT_TCPIP_OVERHEAD  40      // ipv4 and tcp headers without options
+#define CLOCKGUSTO_MQTT_TASK_STACK      3072
+#define CLOCKGUSTO_MQTT_TASK_PRIORITY   (tskIDLE_PRIORITY + 1)
+
+static const char *TAG = "clockgusto mqtt";
+
+static const char* s_mode_names[CLOCKGUSTO_MODE_COUNT] = {
+    "clock",
+    "temperature",
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_task = NULL;
+static esp_mqtt_client_handle_t s_client = NULL;
+static clockgusto_mqtt_stats_t s_stats;
+static int64_t s_first_connect_us = 0;
+static bool s_republish = false;
+
+static char s_state_topic[CLOCKGUSTO_MQTT_TOPIC_SIZE];
+static char s_online_topic[CLOCKGUSTO_MQTT_TOPIC_SIZE];
+static char s_set_topic[CLOCKGUSTO_MQTT_TOPIC_SIZE];
+
+/* Only the publisher task touches these. */
+static char s_payload[CLOCKGUSTO_MQTT_PAYLOAD_SIZE];
+static char s_last_payload[CLOCKGUSTO_MQTT_PAYLOAD_SIZE];
+
+/** Size of a PUBLISH with QoS 0 on the wire, fixed header and remaining length included. */
+static uint32_t clockgusto_mqtt_packet_size(size_t topic_length, size_t payload_length)
+{
+    uint32_t remaining = (uint32_t)(2 + topic_length + payload_length);
+    uint32_t length_bytes = remaining < 128 ? 1 : remaining < 16384 ? 2 : 3;
+    return 1 + length_bytes + remaining;
+}
+
+/** The whole state in one retained document. Values are rounded so sensor noise does not publish. */
+static int clockgusto_mqtt_format()
+{
+    struct tm local_time;
+    clockgusto_time_get_local(&local_time);
+    clockgusto_health_t health;
+    clockgusto_get_health(&health);
+    float celsius = 0.0f;
+    bool has_temperature = clockgusto_temperature_get(&celsius);
+
+    int length = snprintf(s_payload, sizeof(s_payload),
+                          "{\"time\":\"%02d:%02d\",\"mask\":%" PRIu32 ",\"synced\":%s,\"mode\":\"%s\","
+                          "\"brightness\":%u,\"night_level\":%u,\"derating\":%u,",
+                          local_time.tm_hour, local_time.tm_min, clockgusto_get_time_mask(),
+                          clockgusto_time_is_synced() ? "true" : "false", s_mode_names[clockgusto_get_mode()],
+                          clockgusto_get_brightness(), clockgusto_night_get_level(),
+                          clockgusto_temperature_get_derating());
+    if (has_temperature)
+    {
+        length += snprintf(s_payload + length, sizeof(s_payload) - length, "\"temperature\":%.1f,", celsius);
+    }
+    length += snprintf(s_payload + length, sizeof(s_payload) - length,
+                       "\"degraded\":%s,\"render_errors\":%" PRIu32 ",\"rtc_failures\":%" PRIu32 "}",
+                       health.degraded ? "true" : "false", health.render_errors, health.rtc_failures);
+    return length < (int)sizeof(s_payload) ? length : -1;
+}
+
+static void clockgusto_mqtt_count_sent(size_t topic_length, size_t payload_length, int qos)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_stats.bytes += clockgusto_mqtt_packet_size(topic_length, payload_length) + (qos > 0 ? 2 : 0);
+    s_stats.packets++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/** Sends the state when it differs from the last one sent, or after a reconnect. Returns false when
+ *  nothing went out. */
+static bool clockgusto_mqtt_publish(bool republish)
+{
+    int64_t start_us = esp_timer_get_time();
+    int length = clockgusto_mqtt_format();
+    bool unchanged = length >= 0 && !republish && strcmp(s_payload, s_last_payload) == 0;
+    int msg_id = -1;
+    if (length >= 0 && !unchanged)
+    {
+        msg_id = esp_mqtt_client_publish(s_client, s_state_topic, s_payload, length, 0, 1);
+        if (msg_id >= 0)
+        {
+            memcpy(s_last_payload, s_payload, (size_t)length + 1);
+            clockgusto_mqtt_count_sent(strlen(s_state_topic), (size_t)length, 0);
+        }
+    }
+    uint32_t cpu_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.cpu_us += cpu_us;
+    if (unchanged)
+    {
+        s_stats.unchanged++;
+    }
+    else if (msg_id >= 0)
+    {
+        s_stats.publishes++;
+    }
+    else
+    {
+        s_stats.failures++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (length < 0)
+    {
+        ESP_LOGE(TAG, "Failed to fit the state into %u bytes\n", CLOCKGUSTO_MQTT_PAYLOAD_SIZE);
+    }
+    return msg_id >= 0;
+}
+
+/** Waits for changes and publishes at most every CLOCKGUSTO_MQTT_MIN_INTERVAL_MS. Whatever changes
+ *  during the wait rides along with the publish that follows it. */
+static void clockgusto_mqtt_task(void* arg)
+{
+    (void)arg;
+
+    int64_t last_publish_us = -CLOCKGUSTO_MQTT_MIN_INTERVAL_MS * 1000LL;
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CLOCKGUSTO_MQTT_PERIOD_MS));
+
+        int64_t wait_us = last_publish_us + CLOCKGUSTO_MQTT_MIN_INTERVAL_MS * 1000LL - esp_timer_get_time();
+        if (wait_us > 0)
+        {
+            vTaskDelay(pdMS_TO_TICKS(wait_us / 1000) + 1);
+            ulTaskNotifyTake(pdTRUE, 0);
+        }
+
+        portENTER_CRITICAL(&s_lock);
+        bool connected = s_stats.connected;
+        bool republish = s_republish;
+        s_republish = false;
+        portEXIT_CRITICAL(&s_lock);
+        if (connected && clockgusto_mqtt_publish(republish))
+        {
+            last_publish_us = esp_timer_get_time();
+        }
+    }
+}
+
+/** Control payloads are plain values: a percentage for brightness, a mode name for mode, "dismiss" for
+ *  the alarm. */
+static void clockgusto_mqtt_command(const char* topic, int topic_length, const char* data, int data_length)
+{
+    size_t prefix_length = strlen(s_set_topic) - 1;    // without the '+'
+    if (topic_length <= (int)prefix_length || data_length <= 0 || data_length >= CLOCKGUSTO_MQTT_VALUE_SIZE)
+    {
+        return;
+    }
+
+    char value[CLOCKGUSTO_MQTT_VALUE_SIZE];
+    memcpy(value, data, (size_t)data_length);
+    value[data_length] = '\0';
+    const char* name = topic + prefix_length;
+    int name_length = topic_length - (int)prefix_length;
+
+    bool applied = false;
+    if (name_length == 10 && memcmp(name, "brightness", 10) == 0)
+    {
+        char* end = NULL;
+        long brightness = strtol(value, &end, 10);
+        if (end != value && *end == '\0' && brightness >= 0 && brightness <= 100)
+        {
+            clockgusto_set_brightness((uint8_t)brightness);
+            applied = true;
+        }
+    }
+    else if (name_length == 4 && memcmp(name, "mode", 4) == 0)
+    {
+        for (uint8_t mode = 0; mode < CLOCKGUSTO_MODE_COUNT && !applied; ++mode)
+        {
+            if (strcmp(value, s_mode_names[mode]) == 0)
+            {
+                clockgusto_set_mode((clockgusto_mode_t)mode);
+                applied = true;
+            }
+        }
+    }
+    else if (name_length == 5 && memcmp(name, "alarm", 5) == 0 && strcmp(value, "dismiss") == 0)
+    {
+        clockgusto_alarm_dismiss();
+        applied = true;
+    }
+
+    if (!applied)
+    {
+        ESP_LOGW(TAG, "ignored %.*s: %s", topic_length, topic, value);
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.commands++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/** Runs on the client's own task, so nothing here blocks the publisher or the render task. */
+static void clockgusto_mqtt_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id,
+                                          void* event_data)
+{
+    esp_mqtt_event_handle_t event = event_data;
+    switch ((esp_mqtt_event_id_t)event_id)
+    {
+    case MQTT_EVENT_CONNECTED:
+        esp_mqtt_client_subscribe(s_client, s_set_topic, 0);
+        if (esp_mqtt_client_publish(s_client, s_online_topic, "online", 6, 1, 1) >= 0)
+        {
+            clockgusto_mqtt_count_sent(strlen(s_online_topic), 6, 1);
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_stats.connected = true;
+        s_stats.connects++;
+        if (s_first_connect_us == 0)
+        {
+            s_first_connect_us = esp_timer_get_time();
+        }
+        // a broker that lost its retained state gets it back right away
+        s_republish = true;
+        portEXIT_CRITICAL(&s_lock);
+        xTaskNotifyGive(s_task);
+        ESP_LOGI(TAG, "connected, publishing to %s", s_state_topic);
+        break;
+
+    case MQTT_EVENT_DISCONNECTED:
+        portENTER_CRITICAL(&s_lock);
+        s_stats.connected = false;
+        portEXIT_CRITICAL(&s_lock);
+        break;
+
+    case MQTT_EVENT_DATA:
+        // control values are short, a message split over several events is not one of them
+        if (event->current_data_offset == 0 && event->data_len == event->total_data_len)
+        {
+            clockgusto_mqtt_command(event->topic, event->topic_len, event->data, event->data_len);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void clockgusto_mqtt_network_handler(void* arg, esp_event_base_t event_base, int32_t event_id,
+                                            void* event_data)
+{
+    if (s_client)
+    {
+        return;
+    }
+
+    const esp_mqtt_client_config_t config = {
+        .broker.address.uri = CONFIG_CLOCKGUSTO_MQTT_URI,
+        .session.keepalive = CLOCKGUSTO_MQTT_KEEPALIVE_S,
+        .session.last_will = {
+            .topic = s_online_topic,
+            .msg = "offline",
+            .msg_len = 7,
+            .qos = 1,
+            .retain = 1,
+        },
+    };
+    s_client = esp_mqtt_client_init(&config);
+    if (!s_client)
+    {
+        ESP_LOGE(TAG, "Failed to create the client\n");
+        return;
+    }
+    esp_mqtt_client_register_event(s_client, MQTT_EVENT_ANY, clockgusto_mqtt_event_handler, NULL);
+    esp_err_t ret = esp_mqtt_client_start(s_client);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start the client: %s\n", esp_err_to_name(ret));
+    }
+}
+
+esp_err_t clockgusto_mqtt_init()
+{
+    if (strlen(CONFIG_CLOCKGUSTO_MQTT_URI) == 0)
+    {
+        ESP_LOGI(TAG, "no broker configured");
+        return ESP_OK;
+    }
+
+    snprintf(s_state_topic, sizeof(s_state_topic), "%s/state", CONFIG_CLOCKGUSTO_MQTT_TOPIC);
+    snprintf(s_online_topic, sizeof(s_online_topic), "%s/online", CONFIG_CLOCKGUSTO_MQTT_TOPIC);
+    snprintf(s_set_topic, sizeof(s_set_topic), "%s/set/+", CONFIG_CLOCKGUSTO_MQTT_TOPIC);
+
+    if (xTaskCreate(clockgusto_mqtt_task, "clockgusto mqtt", CLOCKGUSTO_MQTT_TASK_STACK, NULL,
+                    CLOCKGUSTO_MQTT_TASK_PRIORITY, &s_task) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return esp_event_handler_register(CLOCKGUSTO_NET_EVENT, CLOCKGUSTO_NET_EVENT_UP,
+                                      clockgusto_mqtt_network_handler, NULL);
+}
+
+void clockgusto_mqtt_notify(uint32_t changes)
+{
+    if (!s_task || !(changes & (CLOCKGUSTO_EVENTS_TIME | CLOCKGUSTO_EVENTS_CONFIG)))
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.changes++;
+    portEXIT_CRITICAL(&s_lock);
+    xTaskNotifyGive(s_task);
+}
+
+void clockgusto_mqtt_get_stats(clockgusto_mqtt_stats_t* stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    int64_t since_us = s_first_connect_us;
+    portEXIT_CRITICAL(&s_lock);
+
+    int64_t elapsed_ms = since_us ? (esp_timer_get_time() - since_us) / 1000 : 0;
+    if (elapsed_ms > 0)
+    {
+        uint64_t bytes = stats->bytes + (uint64_t)stats->packets * CLOCKGUSTO_MQTT_TCPIP_OVERHEAD;
+        stats->bytes_per_h = (uint32_t)(bytes * 3600000ULL / (uint64_t)elapsed_ms);
+        stats->cpu_ms_per_h = (uint32_t)((uint64_t)stats->cpu_us * 3600ULL / (uint64_t)elapsed_ms);
+    }
+}
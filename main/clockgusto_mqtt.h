@@ -0,0 +1,32 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct _clockgusto_mqtt_stats_t
+{
+    bool connected;
+    uint32_t connects;
+    uint32_t changes;               // notifications, many of them end in the same publish
+    uint32_t publishes;
+    uint32_t unchanged;             // periodic checks that found nothing new to send
+    uint32_t failures;
+    uint32_t commands;              // control messages applied
+    uint64_t bytes;                 // publishes the clock sent, tcp/ip headers and keepalives not included
+    uint32_t packets;
+    uint32_t cpu_us;                // publisher task time, formatting and handing over to the socket
+    uint32_t bytes_per_h;           // since the first connect, 40 bytes of tcp/ip headers per packet included
+    uint32_t cpu_ms_per_h;
+} clockgusto_mqtt_stats_t;
+
+/** Starts the publisher task and connects to CONFIG_CLOCKGUSTO_MQTT_URI once the network is up.
+ *  The client reconnects on its own. Does nothing without a configured broker. */
+esp_err_t clockgusto_mqtt_init();
+
+/** Marks the state dirty and wakes the publisher, which rate limits and batches what it sends.
+ *  Cheap enough for the render task, it never touches the network. */
+void clockgusto_mqtt_notify(uint32_t changes);
+
+/** */
+void clockgusto_mqtt_get_stats(clockgusto_mqtt_stats_t* stats);
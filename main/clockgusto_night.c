@@ -0,0 +1,251 @@
+#include "clockgusto_night.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "clockgusto_events.h"
+
+#define CLOCKGUSTO_NIGHT_NVS_NAMESPACE   "night"
+#define CLOCKGUSTO_NIGHT_NVS_KEY         "config"
+#define CLOCKGUSTO_NIGHT_MINUTES         (24 * 60)
+#define CLOCKGUSTO_NIGHT_CHECK_MS        (10 * 60 * 1000)   // catches the utc day changing and clock jumps
+#define CLOCKGUSTO_NIGHT_TASK_STACK      3072
+#define CLOCKGUSTO_NIGHT_TASK_PRIORITY   (tskIDLE_PRIORITY + 1)
+#define CLOCKGUSTO_NIGHT_ZENITH_DEG      90.833             // upper limb on the horizon, with refraction
+
+static const char *TAG = "clockgusto night";
+
+static clockgusto_night_config_t s_config = {
+    .enabled = true,
+    .latitude_e4 = 525200,      // Berlin, matches the default time zone
+    .longitude_e4 = 134050,
+    .night_level = 20,
+    .twilight_min = 60,
+};
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_task = NULL;
+
+/* Percent per minute after UTC midnight. Only the task writes it, byte stores are atomic and a
+ * frame reading a half rebuilt table is off by at most a day's drift of the sun. */
+static uint8_t s_curve[CLOCKGUSTO_NIGHT_MINUTES];
+static int32_t s_curve_day = -1;
+static int16_t s_sunrise_min = 0;
+static int16_t s_sunset_min = 0;
+static bool s_has_sun_times = false;
+
+/** NOAA's low precision solar position. Returns false and sets *polar_day when the sun never crosses
+ *  the horizon on that day. */
+static bool clockgusto_night_sun_times(const clockgusto_night_config_t* config, int year_day,
+                                       int16_t* sunrise_min, int16_t* sunset_min, bool* polar_day)
+{
+    const double rad = M_PI / 180.0;
+    double latitude = config->latitude_e4 / 10000.0;
+    double longitude = config->longitude_e4 / 10000.0;
+
+    // fractional year at noon
+    double gamma = 2.0 * M_PI / 365.0 * (year_day + 0.5);
+    double eqtime_min = 229.18 * (0.000075 + 0.001868 * cos(gamma) - 0.032077 * sin(gamma) -
+                                  0.014615 * cos(2 * gamma) - 0.040849 * sin(2 * gamma));
+    double declination = 0.006918 - 0.399912 * cos(gamma) + 0.070257 * sin(gamma) -
+                         0.006758 * cos(2 * gamma) + 0.000907 * sin(2 * gamma) -
+                         0.002697 * cos(3 * gamma) + 0.00148 * sin(3 * gamma);
+
+    double cos_hour_angle = cos(CLOCKGUSTO_NIGHT_ZENITH_DEG * rad) / (cos(latitude * rad) * cos(declination)) -
+                            tan(latitude * rad) * tan(declination);
+    if (cos_hour_angle > 1.0 || cos_hour_angle < -1.0)
+    {
+        *polar_day = cos_hour_angle < -1.0;
+        return false;
+    }
+
+    double hour_angle_deg = acos(cos_hour_angle) / rad;
+    double noon_min = 720.0 - 4.0 * longitude - eqtime_min;
+    *sunrise_min = (int16_t)(((int32_t)lround(noon_min - 4.0 * hour_angle_deg) + 2 * CLOCKGUSTO_NIGHT_MINUTES) %
+                             CLOCKGUSTO_NIGHT_MINUTES);
+    *sunset_min = (int16_t)(((int32_t)lround(noon_min + 4.0 * hour_angle_deg) + 2 * CLOCKGUSTO_NIGHT_MINUTES) %
+                            CLOCKGUSTO_NIGHT_MINUTES);
+    return true;
+}
+
+/** Fills the curve for one UTC day: the night level, a raised cosine ramp across each twilight and
+ *  full brightness in between. The day may wrap around UTC midnight. */
+static void clockgusto_night_build(const clockgusto_night_config_t* config, int year_day)
+{
+    int16_t sunrise_min = 0;
+    int16_t sunset_min = 0;
+    bool polar_day = false;
+    bool has_sun_times = config->enabled &&
+                         clockgusto_night_sun_times(config, year_day, &sunrise_min, &sunset_min, &polar_day);
+
+    if (!config->enabled || (!has_sun_times && polar_day))
+    {
+        memset(s_curve, 100, sizeof(s_curve));
+    }
+    else if (!has_sun_times)
+    {
+        memset(s_curve, config->night_level, sizeof(s_curve));
+    }
+    else
+    {
+        int32_t day_length = (sunset_min - sunrise_min + CLOCKGUSTO_NIGHT_MINUTES) % CLOCKGUSTO_NIGHT_MINUTES;
+        for (int32_t minute = 0; minute < CLOCKGUSTO_NIGHT_MINUTES; ++minute)
+        {
+            // signed distance to the nearest sunrise or sunset, positive during the day
+            int32_t since_sunrise = (minute - sunrise_min + CLOCKGUSTO_NIGHT_MINUTES) % CLOCKGUSTO_NIGHT_MINUTES;
+            int32_t distance;
+            if (since_sunrise < day_length)
+            {
+                int32_t until_sunset = day_length - since_sunrise;
+                distance = since_sunrise < until_sunset ? since_sunrise : until_sunset;
+            }
+            else
+            {
+                int32_t since_sunset = since_sunrise - day_length;
+                int32_t until_sunrise = CLOCKGUSTO_NIGHT_MINUTES - since_sunrise;
+                distance = -(since_sunset < until_sunrise ? since_sunset : until_sunrise);
+            }
+
+            double daylight;
+            if (config->twilight_min == 0)
+            {
+                daylight = distance >= 0 ? 1.0 : 0.0;
+            }
+            else
+            {
+                double progress = (distance + config->twilight_min / 2.0) / config->twilight_min;
+                progress = progress < 0.0 ? 0.0 : (progress > 1.0 ? 1.0 : progress);
+                daylight = (1.0 - cos(M_PI * progress)) / 2.0;
+            }
+            s_curve[minute] = (uint8_t)lround(config->night_level + (100 - config->night_level) * daylight);
+        }
+    }
+
+    s_sunrise_min = sunrise_min;
+    s_sunset_min = sunset_min;
+    s_has_sun_times = has_sun_times;
+}
+
+static void clockgusto_night_task(void* arg)
+{
+    (void)arg;
+
+    bool changed = false;
+    while (true)
+    {
+        time_t now = time(NULL);
+        int32_t day = (int32_t)(now / 86400);
+        if (day != s_curve_day || changed)
+        {
+            clockgusto_night_config_t config;
+            portENTER_CRITICAL(&s_lock);
+            config = s_config;
+            portEXIT_CRITICAL(&s_lock);
+
+            struct tm utc_time;
+            gmtime_r(&now, &utc_time);
+            clockgusto_night_build(&config, utc_time.tm_yday);
+            s_curve_day = day;
+
+            if (s_has_sun_times)
+            {
+                ESP_LOGI(TAG, "sunrise %02d:%02d, sunset %02d:%02d utc", s_sunrise_min / 60, s_sunrise_min % 60,
+                         s_sunset_min / 60, s_sunset_min % 60);
+            }
+        }
+
+        // a configuration change wakes the task early
+        changed = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CLOCKGUSTO_NIGHT_CHECK_MS)) > 0;
+    }
+}
+
+esp_err_t clockgusto_night_start()
+{
+    nvs_handle_t handle;
+    if (nvs_open(CLOCKGUSTO_NIGHT_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK)
+    {
+        clockgusto_night_config_t config;
+        size_t size = sizeof(config);
+        esp_err_t ret = nvs_get_blob(handle, CLOCKGUSTO_NIGHT_NVS_KEY, &config, &size);
+        nvs_close(handle);
+        if (ret == ESP_OK && size == sizeof(config))
+        {
+            s_config = config;
+        }
+    }
+
+    // the first frames already get a curve, the task only keeps it current
+    time_t now = time(NULL);
+    struct tm utc_time;
+    gmtime_r(&now, &utc_time);
+    clockgusto_night_build(&s_config, utc_time.tm_yday);
+    s_curve_day = (int32_t)(now / 86400);
+
+    if (xTaskCreate(clockgusto_night_task, "clockgusto night", CLOCKGUSTO_NIGHT_TASK_STACK, NULL,
+                    CLOCKGUSTO_NIGHT_TASK_PRIORITY, &s_task) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t clockgusto_night_set_config(const clockgusto_night_config_t* config)
+{
+    if (config->latitude_e4 < -900000 || config->latitude_e4 > 900000 || config->longitude_e4 < -1800000 ||
+        config->longitude_e4 > 1800000 || config->night_level > 100)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_config = *config;
+    portEXIT_CRITICAL(&s_lock);
+    if (s_task)
+    {
+        xTaskNotifyGive(s_task);
+    }
+    clockgusto_events_notify(CLOCKGUSTO_EVENTS_CONFIG);
+
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(CLOCKGUSTO_NIGHT_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to open nvs\n");
+        return ret;
+    }
+    ret = nvs_set_blob(handle, CLOCKGUSTO_NIGHT_NVS_KEY, config, sizeof(*config));
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    return ret;
+}
+
+void clockgusto_night_get_config(clockgusto_night_config_t* config)
+{
+    portENTER_CRITICAL(&s_lock);
+    *config = s_config;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+bool clockgusto_night_get_sun_times(int16_t* sunrise_min, int16_t* sunset_min)
+{
+    *sunrise_min = s_sunrise_min;
+    *sunset_min = s_sunset_min;
+    return s_has_sun_times;
+}
+
+uint8_t clockgusto_night_get_level()
+{
+    time_t now = time(NULL);
+    return s_curve[(now / 60) % CLOCKGUSTO_NIGHT_MINUTES];
+}
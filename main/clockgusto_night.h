@@ -0,0 +1,30 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct _clockgusto_night_config_t
+{
+    bool enabled;
+    int32_t latitude_e4;    // degrees * 10000, north positive
+    int32_t longitude_e4;   // degrees * 10000, east positive
+    uint8_t night_level;    // percent of the brightness left at night
+    uint8_t twilight_min;   // length of the ramp, centred on sunrise and sunset
+} clockgusto_night_config_t;
+
+/** Loads the location from NVS, computes today's curve and starts the task that recomputes it every
+ *  UTC midnight. */
+esp_err_t clockgusto_night_start();
+
+/** Persists config and recomputes the curve. */
+esp_err_t clockgusto_night_set_config(const clockgusto_night_config_t* config);
+
+/** */
+void clockgusto_night_get_config(clockgusto_night_config_t* config);
+
+/** Today's sunrise and sunset in minutes after UTC midnight, false during polar day or night. */
+bool clockgusto_night_get_sun_times(int16_t* sunrise_min, int16_t* sunset_min);
+
+/** Brightness in percent the time of day allows, one table lookup. */
+uint8_t clockgusto_night_get_level();
@@ -0,0 +1,105 @@
+#include "clockgusto_power.h"
+
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include <stdint.h>
+#include <string.h>
+
+#define CLOCKGUSTO_POWER_MAX_FREQ_MHZ    160
+#define CLOCKGUSTO_POWER_MIN_FREQ_MHZ    40     // XTAL, the APB lock of a driver raises it to 80
+#define CLOCKGUSTO_POWER_LED_IDLE_UA     700    // WS2812B quiescent current per package
+#define CLOCKGUSTO_POWER_CHANNEL_FULL_UA 12000  // one colour channel at 255
+#define CLOCKGUSTO_POWER_CPU_ACTIVE_UA   30000  // ESP32 running without radio
+#define CLOCKGUSTO_POWER_CPU_SLEEP_UA    800    // light sleep
+#define CLOCKGUSTO_POWER_AVERAGE_SHIFT   4      // running average over about 16 frames
+#define CLOCKGUSTO_POWER_REPORT_US       (3600LL * 1000000)
+
+static const char *TAG = "clockgusto power";
+
+static clockgusto_power_estimate_t s_estimates[CLOCKGUSTO_MODE_COUNT];
+static int64_t s_last_report_us = 0;
+
+esp_err_t clockgusto_power_init()
+{
+#ifdef CONFIG_PM_ENABLE
+    esp_pm_config_t config = {
+        .max_freq_mhz = CLOCKGUSTO_POWER_MAX_FREQ_MHZ,
+        .min_freq_mhz = CLOCKGUSTO_POWER_MIN_FREQ_MHZ,
+        .light_sleep_enable = true,
+    };
+
+    esp_err_t ret = esp_pm_configure(&config);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to configure power management.\n");
+        return ret;
+    }
+
+    return ESP_OK;
+#else
+    ESP_LOGW(TAG, "CONFIG_PM_ENABLE is off, the chip stays awake");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+static uint32_t clockgusto_power_average(uint32_t average, uint32_t sample, uint32_t frames)
+{
+    if (frames == 0)
+    {
+        return sample;
+    }
+
+    return (uint32_t)((int64_t)average + (((int64_t)sample - average) >> CLOCKGUSTO_POWER_AVERAGE_SHIFT));
+}
+
+void clockgusto_power_note_frame(clockgusto_mode_t mode, const uint8_t* pixels, size_t size,
+                                 int64_t active_us, int64_t period_us)
+{
+    if (mode >= CLOCKGUSTO_MODE_COUNT || period_us <= 0)
+    {
+        return;
+    }
+
+    uint32_t channel_sum = 0;
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        channel_sum += pixels[idx];
+    }
+    uint32_t led_ua = (size / CLOCKGUSTO_BYTES_PER_LED) * CLOCKGUSTO_POWER_LED_IDLE_UA +
+                      (uint32_t)((uint64_t)channel_sum * CLOCKGUSTO_POWER_CHANNEL_FULL_UA / 255);
+
+    if (active_us > period_us)
+    {
+        active_us = period_us;
+    }
+    uint32_t cpu_ua = (uint32_t)((active_us * CLOCKGUSTO_POWER_CPU_ACTIVE_UA +
+                                  (period_us - active_us) * CLOCKGUSTO_POWER_CPU_SLEEP_UA) / period_us);
+
+    clockgusto_power_estimate_t* estimate = &s_estimates[mode];
+    estimate->led_ua = clockgusto_power_average(estimate->led_ua, led_ua, estimate->frames);
+    estimate->cpu_ua = clockgusto_power_average(estimate->cpu_ua, cpu_ua, estimate->frames);
+    estimate->total_ua = estimate->led_ua + estimate->cpu_ua;
+    estimate->frames++;
+
+    int64_t now_us = esp_timer_get_time();
+    if (now_us - s_last_report_us >= CLOCKGUSTO_POWER_REPORT_US)
+    {
+        s_last_report_us = now_us;
+        ESP_LOGI(TAG, "mode %d: %lu.%lu mA (leds %lu mA, cpu %lu mA)", (int)mode,
+                 (unsigned long)(estimate->total_ua / 1000), (unsigned long)(estimate->total_ua % 1000 / 100),
+                 (unsigned long)(estimate->led_ua / 1000), (unsigned long)(estimate->cpu_ua / 1000));
+    }
+}
+
+void clockgusto_power_get_estimate(clockgusto_mode_t mode, clockgusto_power_estimate_t* estimate)
+{
+    if (mode >= CLOCKGUSTO_MODE_COUNT)
+    {
+        memset(estimate, 0, sizeof(*estimate));
+        return;
+    }
+
+    *estimate = s_estimates[mode];
+}
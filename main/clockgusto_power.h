@@ -0,0 +1,27 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clockgusto.h"
+
+typedef struct _clockgusto_power_estimate_t
+{
+    uint32_t led_ua;        // strip quiescent plus pixel current
+    uint32_t cpu_ua;        // active share of the frame period, light sleep for the rest
+    uint32_t total_ua;
+    uint32_t frames;
+} clockgusto_power_estimate_t;
+
+/** Turns on dynamic frequency scaling and automatic light sleep. Tickless idle then sleeps whenever
+ *  every task waits, and only the drivers' own PM locks keep the chip up while they transfer. */
+esp_err_t clockgusto_power_init();
+
+/** Folds one frame into the running estimate of mode: the pixels that went out, how long the frame
+ *  kept the CPU busy and how long until the next one. */
+void clockgusto_power_note_frame(clockgusto_mode_t mode, const uint8_t* pixels, size_t size,
+                                 int64_t active_us, int64_t period_us);
+
+/** Average supply current of mode estimated from a current model, not a measurement. */
+void clockgusto_power_get_estimate(clockgusto_mode_t mode, clockgusto_power_estimate_t* estimate);
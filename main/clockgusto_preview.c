@@ -0,0 +1,319 @@
+#include "clockgusto_preview.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "clockgusto.h"
+
+#define CLOCKGUSTO_PREVIEW_INTERVAL_MS      100     // at most 10 frames a second, the chase renders 8
+#define CLOCKGUSTO_PREVIEW_KEYFRAME_MS      5000    // a viewer that lost a message recovers by then
+#define CLOCKGUSTO_PREVIEW_FRAME_SIZE       (CLOCKGUSTO_NUM_LEDS * CLOCKGUSTO_BYTES_PER_LED)
+#define CLOCKGUSTO_PREVIEW_BITMAP_SIZE      ((CLOCKGUSTO_NUM_LEDS + 7) / 8)
+#define CLOCKGUSTO_PREVIEW_HEADER_SIZE      3
+#define CLOCKGUSTO_PREVIEW_MESSAGE_SIZE     (CLOCKGUSTO_PREVIEW_HEADER_SIZE + CLOCKGUSTO_PREVIEW_BITMAP_SIZE + \
+                                             CLOCKGUSTO_PREVIEW_FRAME_SIZE)
+#define CLOCKGUSTO_PREVIEW_TASK_STACK       3072
+#define CLOCKGUSTO_PREVIEW_TASK_PRIORITY    tskIDLE_PRIORITY   // the main loop renders at priority 1
+
+static const char *TAG = "clockgusto preview";
+
+typedef enum _clockgusto_preview_message_t
+{
+    CLOCKGUSTO_PREVIEW_KEYFRAME,
+    CLOCKGUSTO_PREVIEW_DELTA,
+} clockgusto_preview_message_t;
+
+typedef struct _clockgusto_preview_client_t
+{
+    int fd;                         // -1 while the slot is free
+    bool closing;                   // close triggered, the slot frees with the session
+    bool needs_keyframe;
+    int64_t keyframe_us;
+    int64_t connected_us;
+    uint64_t bytes;
+    uint8_t shown[CLOCKGUSTO_PREVIEW_FRAME_SIZE];  // what the viewer has, the base of the next delta
+} clockgusto_preview_client_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static httpd_handle_t s_server = NULL;
+static TaskHandle_t s_task = NULL;
+static uint8_t s_client_count = 0;
+static bool s_queued = false;           // a send is queued on the server and has not started yet
+static int64_t s_submitted_us = 0;
+static uint16_t s_frame_number = 0;
+static clockgusto_preview_stats_t s_stats;
+static int64_t s_window_us = 0;
+static uint32_t s_window_bytes = 0;
+
+/* s_pending is written by the render loop under the lock. Everything else belongs to the server's task:
+ * the handshake, the sends queued with httpd_queue_work and the session close all run there. */
+static uint8_t s_pending[CLOCKGUSTO_PREVIEW_FRAME_SIZE];
+static uint8_t s_frame[CLOCKGUSTO_PREVIEW_FRAME_SIZE];
+static uint8_t s_message[CLOCKGUSTO_PREVIEW_MESSAGE_SIZE];
+static clockgusto_preview_client_t s_clients[CLOCKGUSTO_PREVIEW_MAX_CLIENTS] = {
+    [0 ... CLOCKGUSTO_PREVIEW_MAX_CLIENTS - 1] = { .fd = -1 },
+};
+
+/** Builds the message that takes a client from what it shows to s_frame. Returns 0 when nothing
+ *  changed. A delta that would outgrow a keyframe becomes one. */
+static size_t clockgusto_preview_encode(clockgusto_preview_client_t* client, bool keyframe, uint16_t frame_number)
+{
+    s_message[1] = (uint8_t)frame_number;
+    s_message[2] = (uint8_t)(frame_number >> 8);
+
+    size_t length = CLOCKGUSTO_PREVIEW_HEADER_SIZE;
+    if (!keyframe)
+    {
+        uint8_t* bitmap = &s_message[CLOCKGUSTO_PREVIEW_HEADER_SIZE];
+        memset(bitmap, 0, CLOCKGUSTO_PREVIEW_BITMAP_SIZE);
+        length += CLOCKGUSTO_PREVIEW_BITMAP_SIZE;
+
+        uint16_t changed = 0;
+        for (uint16_t led_idx = 0; led_idx < CLOCKGUSTO_NUM_LEDS; ++led_idx)
+        {
+            const uint8_t* pixel = &s_frame[led_idx * CLOCKGUSTO_BYTES_PER_LED];
+            if (memcmp(pixel, &client->shown[led_idx * CLOCKGUSTO_BYTES_PER_LED], CLOCKGUSTO_BYTES_PER_LED) != 0)
+            {
+                bitmap[led_idx / 8] |= 1 << (led_idx % 8);
+                memcpy(&s_message[length], pixel, CLOCKGUSTO_BYTES_PER_LED);
+                length += CLOCKGUSTO_BYTES_PER_LED;
+                changed++;
+            }
+        }
+        if (changed == 0)
+        {
+            return 0;
+        }
+        keyframe = length >= CLOCKGUSTO_PREVIEW_HEADER_SIZE + CLOCKGUSTO_PREVIEW_FRAME_SIZE;
+    }
+
+    if (keyframe)
+    {
+        memcpy(&s_message[CLOCKGUSTO_PREVIEW_HEADER_SIZE], s_frame, CLOCKGUSTO_PREVIEW_FRAME_SIZE);
+        length = CLOCKGUSTO_PREVIEW_HEADER_SIZE + CLOCKGUSTO_PREVIEW_FRAME_SIZE;
+    }
+    s_message[0] = keyframe ? CLOCKGUSTO_PREVIEW_KEYFRAME : CLOCKGUSTO_PREVIEW_DELTA;
+
+    memcpy(client->shown, s_frame, CLOCKGUSTO_PREVIEW_FRAME_SIZE);
+    return length;
+}
+
+/** Frees the slot once the server closes the session, so a reused fd never reaches the old slot. */
+static void clockgusto_preview_free_ctx(void* ctx)
+{
+    clockgusto_preview_client_t* client = ctx;
+    int64_t seconds = (esp_timer_get_time() - client->connected_us) / 1000000;
+    ESP_LOGI(TAG, "viewer left after %lld s, %lu B/s on average", (long long)seconds,
+             (unsigned long)(seconds > 0 ? client->bytes / seconds : client->bytes));
+
+    portENTER_CRITICAL(&s_lock);
+    client->fd = -1;
+    client->closing = false;
+    s_client_count--;
+    s_stats.clients = s_client_count;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/** Runs on the server's task, queued by the preview task, so the sends never race the server. */
+static void clockgusto_preview_send(void* arg)
+{
+    (void)arg;
+
+    uint16_t frame_number;
+    portENTER_CRITICAL(&s_lock);
+    memcpy(s_frame, s_pending, sizeof(s_frame));
+    frame_number = s_frame_number;
+    s_queued = false;
+    portEXIT_CRITICAL(&s_lock);
+
+    int64_t now_us = esp_timer_get_time();
+    uint32_t frames = 0;
+    uint32_t keyframes = 0;
+    uint32_t bytes = 0;
+    for (uint8_t idx = 0; idx < CLOCKGUSTO_PREVIEW_MAX_CLIENTS; ++idx)
+    {
+        clockgusto_preview_client_t* client = &s_clients[idx];
+        if (client->fd < 0 || client->closing)
+        {
+            continue;
+        }
+
+        bool keyframe = client->needs_keyframe ||
+                        now_us - client->keyframe_us >= CLOCKGUSTO_PREVIEW_KEYFRAME_MS * 1000LL;
+        size_t length = clockgusto_preview_encode(client, keyframe, frame_number);
+        if (length == 0)
+        {
+            continue;
+        }
+
+        httpd_ws_frame_t frame = {
+            .final = true,
+            .type = HTTPD_WS_TYPE_BINARY,
+            .payload = s_message,
+            .len = length,
+        };
+        if (httpd_ws_send_frame_async(s_server, client->fd, &frame) != ESP_OK)
+        {
+            client->closing = true;
+            httpd_sess_trigger_close(s_server, client->fd);
+            continue;
+        }
+
+        if (s_message[0] == CLOCKGUSTO_PREVIEW_KEYFRAME)
+        {
+            client->needs_keyframe = false;
+            client->keyframe_us = now_us;
+            keyframes++;
+        }
+        client->bytes += length;
+        frames++;
+        bytes += length;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.frames += frames;
+    s_stats.keyframes += keyframes;
+    s_stats.bytes += bytes;
+    s_window_bytes += bytes;
+    if (now_us - s_window_us >= 1000000)
+    {
+        s_stats.bytes_per_s = (uint32_t)(s_window_bytes * 1000000LL / (now_us - s_window_us));
+        s_window_us = now_us;
+        s_window_bytes = 0;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/** Encoding and sending belong to the server's task, this one only hands the frame over, below the
+ *  render loop so the loop never waits for the server's control socket. */
+static void clockgusto_preview_task(void* arg)
+{
+    (void)arg;
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        portENTER_CRITICAL(&s_lock);
+        bool queue = !s_queued;
+        s_queued = true;
+        portEXIT_CRITICAL(&s_lock);
+
+        if (queue && httpd_queue_work(s_server, clockgusto_preview_send, NULL) != ESP_OK)
+        {
+            portENTER_CRITICAL(&s_lock);
+            s_queued = false;
+            portEXIT_CRITICAL(&s_lock);
+        }
+    }
+}
+
+/** The handshake takes a slot, later messages from the viewer are read and dropped. */
+static esp_err_t clockgusto_preview_handler(httpd_req_t* req)
+{
+    if (req->method == HTTP_GET)
+    {
+        int64_t now_us = esp_timer_get_time();
+        clockgusto_preview_client_t* client = NULL;
+        portENTER_CRITICAL(&s_lock);
+        for (uint8_t idx = 0; idx < CLOCKGUSTO_PREVIEW_MAX_CLIENTS && !client; ++idx)
+        {
+            if (s_clients[idx].fd < 0)
+            {
+                client = &s_clients[idx];
+                client->fd = httpd_req_to_sockfd(req);
+                client->closing = false;
+                client->needs_keyframe = true;
+                client->connected_us = now_us;
+                client->bytes = 0;
+                if (s_client_count++ == 0)
+                {
+                    s_window_us = now_us;
+                    s_window_bytes = 0;
+                }
+                s_stats.clients = s_client_count;
+            }
+        }
+        portEXIT_CRITICAL(&s_lock);
+
+        if (!client)
+        {
+            ESP_LOGW(TAG, "viewer refused, %u already watching", CLOCKGUSTO_PREVIEW_MAX_CLIENTS);
+            return ESP_FAIL;
+        }
+        // the server calls this when the session closes, however that happens
+        req->sess_ctx = client;
+        req->free_ctx = clockgusto_preview_free_ctx;
+        ESP_LOGI(TAG, "viewer joined");
+        return ESP_OK;
+    }
+
+    uint8_t discard[16];
+    httpd_ws_frame_t frame = { .payload = NULL };
+    esp_err_t ret = httpd_ws_recv_frame(req, &frame, 0);
+    if (ret != ESP_OK || frame.len > sizeof(discard))
+    {
+        return ESP_FAIL;
+    }
+    frame.payload = discard;
+    return frame.len > 0 ? httpd_ws_recv_frame(req, &frame, sizeof(discard)) : ESP_OK;
+}
+
+static const httpd_uri_t s_uri = {
+    .uri = "/api/preview",
+    .method = HTTP_GET,
+    .handler = clockgusto_preview_handler,
+    .is_websocket = true,
+};
+
+esp_err_t clockgusto_preview_register(httpd_handle_t server)
+{
+    if (!s_task && xTaskCreate(clockgusto_preview_task, "clockgusto preview", CLOCKGUSTO_PREVIEW_TASK_STACK,
+                               NULL, CLOCKGUSTO_PREVIEW_TASK_PRIORITY, &s_task) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_server = server;
+    return httpd_register_uri_handler(server, &s_uri);
+}
+
+void clockgusto_preview_submit(const uint8_t* pixels)
+{
+    if (s_client_count == 0)
+    {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    bool accepted = now_us - s_submitted_us >= CLOCKGUSTO_PREVIEW_INTERVAL_MS * 1000LL;
+    if (accepted)
+    {
+        memcpy(s_pending, pixels, sizeof(s_pending));
+        s_frame_number++;
+        s_submitted_us = now_us;
+    }
+    else
+    {
+        s_stats.skipped++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (accepted)
+    {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+void clockgusto_preview_get_stats(clockgusto_preview_stats_t* stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include <stdint.h>
+
+#define CLOCKGUSTO_PREVIEW_MAX_CLIENTS  2
+
+typedef struct _clockgusto_preview_stats_t
+{
+    uint8_t clients;
+    uint32_t frames;                // messages sent to all clients, keyframes included
+    uint32_t keyframes;
+    uint32_t skipped;               // rendered frames the rate limit left out
+    uint64_t bytes;                 // websocket payload, without framing
+    uint32_t bytes_per_s;           // over the last full second with clients
+} clockgusto_preview_stats_t;
+
+/** Adds the WebSocket /api/preview. Each binary message is one frame:
+ *
+ *      byte 0      0 keyframe, 1 delta
+ *      byte 1..2   frame number, little endian
+ *      keyframe    every pixel, 3 bytes each in strip order green, blue, red
+ *      delta       bitmap of the changed pixels, pixel 0 in bit 0 of the first byte, then 3 bytes for
+ *                  each changed pixel in pixel order
+ *
+ *  Unchanged frames are not sent. A keyframe starts every stream and follows every
+ *  CLOCKGUSTO_PREVIEW_KEYFRAME_MS. */
+esp_err_t clockgusto_preview_register(httpd_handle_t server);
+
+/** Offers a rendered frame. Returns at once: without clients or within the rate limit it does
+ *  nothing, otherwise it copies the frame for the preview task, which runs below the render loop. */
+void clockgusto_preview_submit(const uint8_t* pixels);
+
+/** */
+void clockgusto_preview_get_stats(clockgusto_preview_stats_t* stats);
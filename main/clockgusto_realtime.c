@@ -0,0 +1,188 @@
+#include "clockgusto_realtime.h"
+
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcpip.h"
+#include "lwip/udp.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "clockgusto.h"
+#include "clockgusto_ddp.h"
+#include "clockgusto_wifi.h"
+
+#define CLOCKGUSTO_REALTIME_FRAME_SIZE  (CLOCKGUSTO_NUM_LEDS * CLOCKGUSTO_BYTES_PER_LED)
+
+static const char *TAG = "clockgusto realtime";
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_render_task = NULL;
+static struct udp_pcb* s_pcb = NULL;
+static clockgusto_realtime_stats_t s_stats;
+
+/* Triple buffer. The lwIP thread owns the back buffer, the render task the display buffer, the ready
+ * one changes hands under the lock. Neither side ever waits for the other. Only the lwIP thread
+ * writes, the render task reads the display buffer and never changes it. */
+static uint8_t s_buffers[3][CLOCKGUSTO_REALTIME_FRAME_SIZE];
+static uint8_t s_back = 0;
+static uint8_t s_ready = 1;
+static uint8_t s_display = 2;
+static bool s_fresh = false;
+static int64_t s_ready_us = 0;          // when the ready frame was pushed
+static int64_t s_display_us = 0;
+static int64_t s_packet_us = 0;
+
+/** Runs in the lwIP thread, so it only decodes and hands over. */
+static void clockgusto_realtime_receive(void* arg, struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* addr,
+                                        uint16_t port)
+{
+    (void)arg;
+    (void)pcb;
+    (void)addr;
+    (void)port;
+
+    // the header is the only part copied, senders may split it across buffers in theory
+    uint8_t header_data[CLOCKGUSTO_DDP_MAX_HEADER_SIZE];
+    uint16_t header_size = pbuf_copy_partial(p, header_data, sizeof(header_data), 0);
+    clockgusto_ddp_header_t header;
+    if (!clockgusto_ddp_parse_header(header_data, header_size, &header))
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.packets++;
+        s_stats.rejected++;
+        portEXIT_CRITICAL(&s_lock);
+        pbuf_free(p);
+        return;
+    }
+
+    uint32_t remaining = p->tot_len > header.size ? p->tot_len - header.size : 0;
+    remaining = remaining < header.length ? remaining : header.length;
+    uint32_t skip = header.size;
+    uint32_t offset = header.offset;
+    for (struct pbuf* q = p; q && remaining > 0; q = q->next)
+    {
+        if (skip >= q->len)
+        {
+            skip -= q->len;
+            continue;
+        }
+        uint32_t length = q->len - skip;
+        length = length < remaining ? length : remaining;
+        clockgusto_ddp_write(s_buffers[s_back], CLOCKGUSTO_REALTIME_FRAME_SIZE, offset, (const uint8_t*)q->payload + skip,
+                             length);
+        offset += length;
+        remaining -= length;
+        skip = 0;
+    }
+    pbuf_free(p);
+
+    int64_t now_us = esp_timer_get_time();
+    bool push = header.flags & CLOCKGUSTO_DDP_FLAG_PUSH;
+    uint8_t pushed = s_back;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.packets++;
+    s_packet_us = now_us;
+    if (push)
+    {
+        uint8_t ready = s_ready;
+        s_ready = s_back;
+        s_back = ready;
+        s_stats.dropped += s_fresh;
+        s_stats.frames++;
+        s_fresh = true;
+        s_ready_us = now_us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (push)
+    {
+        /* The recycled back buffer holds an older frame. A sender that only updates part of the strip
+         * builds on the last frame, so that is copied in. Nobody else writes either buffer. */
+        memcpy(s_buffers[s_back], s_buffers[pushed], CLOCKGUSTO_REALTIME_FRAME_SIZE);
+        xTaskNotifyGive(s_render_task);
+    }
+}
+
+static void clockgusto_realtime_bind(void* ctx)
+{
+    (void)ctx;
+
+    s_pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!s_pcb)
+    {
+        ESP_LOGE(TAG, "Failed to create the pcb\n");
+        return;
+    }
+    if (udp_bind(s_pcb, IP_ANY_TYPE, CLOCKGUSTO_DDP_PORT) != ERR_OK)
+    {
+        ESP_LOGE(TAG, "Failed to bind port %u\n", CLOCKGUSTO_DDP_PORT);
+        udp_remove(s_pcb);
+        s_pcb = NULL;
+        return;
+    }
+    udp_recv(s_pcb, clockgusto_realtime_receive, NULL);
+    ESP_LOGI(TAG, "ddp on port %u", CLOCKGUSTO_DDP_PORT);
+}
+
+/** The pcb is bound to any address, so it survives link losses and address changes. */
+static void clockgusto_realtime_network_handler(void* arg, esp_event_base_t event_base, int32_t event_id,
+                                                void* event_data)
+{
+    if (!s_pcb && tcpip_callback(clockgusto_realtime_bind, NULL) != ERR_OK)
+    {
+        ESP_LOGE(TAG, "Failed to reach the lwip thread\n");
+    }
+}
+
+esp_err_t clockgusto_realtime_init(TaskHandle_t render_task)
+{
+    s_render_task = render_task;
+
+    return esp_event_handler_register(CLOCKGUSTO_NET_EVENT, CLOCKGUSTO_NET_EVENT_UP,
+                                      clockgusto_realtime_network_handler, NULL);
+}
+
+const uint8_t* clockgusto_realtime_take_frame(bool* active)
+{
+    int64_t now_us = esp_timer_get_time();
+    const uint8_t* frame = NULL;
+
+    portENTER_CRITICAL(&s_lock);
+    *active = s_packet_us != 0 && now_us - s_packet_us < CLOCKGUSTO_REALTIME_TIMEOUT_MS * 1000LL;
+    if (s_fresh)
+    {
+        uint8_t display = s_display;
+        s_display = s_ready;
+        s_ready = display;
+        s_fresh = false;
+        s_display_us = s_ready_us;
+        frame = s_buffers[s_display];
+    }
+    s_stats.active = *active;
+    portEXIT_CRITICAL(&s_lock);
+
+    return frame;
+}
+
+void clockgusto_realtime_note_shown()
+{
+    uint32_t latency_us = (uint32_t)(esp_timer_get_time() - s_display_us);
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.latency_us = latency_us;
+    s_stats.latency_avg_us = s_stats.latency_avg_us == 0 ? latency_us
+                                                         : s_stats.latency_avg_us - s_stats.latency_avg_us / 16 +
+                                                               latency_us / 16;
+    s_stats.latency_max_us = latency_us > s_stats.latency_max_us ? latency_us : s_stats.latency_max_us;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void clockgusto_realtime_get_stats(clockgusto_realtime_stats_t* stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CLOCKGUSTO_REALTIME_TIMEOUT_MS  2500    // without packets the clock face comes back
+
+typedef struct _clockgusto_realtime_stats_t
+{
+    bool active;
+    uint32_t packets;
+    uint32_t rejected;              // not DDP pixel data for the display
+    uint32_t frames;                // pushed by the sender
+    uint32_t dropped;               // replaced by a newer frame before the strip showed them
+    uint32_t latency_us;            // push packet received to frame latched, last frame
+    uint32_t latency_avg_us;        // moving average over about 16 frames
+    uint32_t latency_max_us;
+} clockgusto_realtime_stats_t;
+
+/** Listens for DDP on UDP port CLOCKGUSTO_DDP_PORT once the network is up. Packets are decoded in
+ *  the lwIP thread straight from the pbuf into the back buffer of a triple buffer, a push flag
+ *  publishes the frame and wakes render_task. */
+esp_err_t clockgusto_realtime_init(TaskHandle_t render_task);
+
+/** Returns the newest complete frame in strip order when one arrived since the last call, else NULL.
+ *  The buffer is read only and stays untouched until the next call. *active is true while packets
+ *  keep coming. */
+const uint8_t* clockgusto_realtime_take_frame(bool* active);
+
+/** Records the latency of the frame last taken, once it is on the strip. */
+void clockgusto_realtime_note_shown();
+
+/** */
+void clockgusto_realtime_get_stats(clockgusto_realtime_stats_t* stats);
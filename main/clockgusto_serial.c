@@ -0,0 +1,599 @@
+#include "clockgusto_serial.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "driver/uart.h"
+#include "driver/uart_vfs.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "clockgusto.h"
+#include "clockgusto_alarm.h"
+#include "clockgusto_log.h"
+#include "clockgusto_metrics.h"
+#include "clockgusto_night.h"
+#include "clockgusto_time.h"
+#include "clockgusto_tz.h"
+#include "clockgusto_wifi.h"
+#include "clockgusto_wire.h"
+
+#define CLOCKGUSTO_SERIAL_PORT          CONFIG_ESP_CONSOLE_UART_NUM
+#define CLOCKGUSTO_SERIAL_RX_BUFFER     2048    // holds a frame of the largest size
+#define CLOCKGUSTO_SERIAL_TX_BUFFER     4096    // bulk data drains at line rate from here
+#define CLOCKGUSTO_SERIAL_QUEUE_LENGTH  16
+#define CLOCKGUSTO_SERIAL_READ_SIZE     128
+#define CLOCKGUSTO_SERIAL_STREAM_POLL_MS 10     // while streaming frame buffers the task also wakes on its own
+#define CLOCKGUSTO_SERIAL_TASK_STACK    4096    // metrics formatting
+#define CLOCKGUSTO_SERIAL_TASK_PRIORITY (tskIDLE_PRIORITY + 2)  // above the render loop, arrival times count
+#define CLOCKGUSTO_SERIAL_FRAME_SIZE    (CLOCKGUSTO_NUM_LEDS * CLOCKGUSTO_BYTES_PER_LED)
+#define CLOCKGUSTO_SERIAL_WAKE_EDGES    3       // rx edges that wake the chip, the bytes carrying them are lost
+#define CLOCKGUSTO_SERIAL_SESSION_MS    10000   // light sleep stays off this long after the last byte from the host
+
+static const char *TAG = "clockgusto serial";
+
+static QueueHandle_t s_queue = NULL;
+static TaskHandle_t s_task = NULL;
+static esp_pm_lock_handle_t s_pm_lock = NULL;
+static int64_t s_session_end_us = 0;    // 0 while no host session holds the lock, owned by the serial task
+
+/* Owned by the serial task. */
+static clockgusto_wire_reader_t s_reader;
+static uint8_t s_tx[CLOCKGUSTO_WIRE_MAX_ENCODED];
+static uint8_t s_payload[CLOCKGUSTO_WIRE_MAX_PAYLOAD];
+
+/* Shared with the render task. */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t s_frames_left = 0;
+static uint8_t s_stream_seq = 0;
+static bool s_frame_fresh = false;
+static uint32_t s_frame_number = 0;
+static uint8_t s_frame[CLOCKGUSTO_SERIAL_FRAME_SIZE];
+static clockgusto_serial_stats_t s_stats;
+
+static esp_err_t clockgusto_serial_send(uint8_t type, uint8_t seq, const uint8_t* payload, size_t size)
+{
+    size_t length = clockgusto_wire_encode(type, seq, payload, size, s_tx);
+    if (length == 0)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // one write, so console lines from other tasks can only come before or after the frame
+    if (uart_write_bytes(CLOCKGUSTO_SERIAL_PORT, s_tx, length) != (int)length)
+    {
+        return ESP_FAIL;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.bytes += length;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+static int64_t clockgusto_serial_utc_us()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+static clockgusto_wire_status_t clockgusto_serial_status(esp_err_t ret)
+{
+    return ret == ESP_OK ? CLOCKGUSTO_WIRE_OK : ret == ESP_ERR_INVALID_ARG ? CLOCKGUSTO_WIRE_BAD_VALUE
+                                                                           : CLOCKGUSTO_WIRE_FAILED;
+}
+
+static void clockgusto_serial_put_switch(uint8_t* data, const clockgusto_tz_switch_t* tz_switch)
+{
+    data[0] = tz_switch->month;
+    data[1] = tz_switch->week;
+    data[2] = tz_switch->wday;
+    clockgusto_wire_put_u16(data + 3, tz_switch->minute);
+}
+
+static void clockgusto_serial_get_switch(const uint8_t* data, clockgusto_tz_switch_t* tz_switch)
+{
+    tz_switch->month = data[0];
+    tz_switch->week = data[1];
+    tz_switch->wday = data[2];
+    tz_switch->minute = clockgusto_wire_get_u16(data + 3);
+}
+
+/** Writes the value of key after the key byte. Returns its size, 0 for an unknown key. */
+static size_t clockgusto_serial_config_get(uint8_t key, uint8_t* value)
+{
+    switch (key)
+    {
+    case CLOCKGUSTO_WIRE_KEY_BRIGHTNESS:
+        value[0] = clockgusto_get_brightness();
+        return 1;
+
+    case CLOCKGUSTO_WIRE_KEY_MODE:
+        value[0] = (uint8_t)clockgusto_get_mode();
+        return 1;
+
+    case CLOCKGUSTO_WIRE_KEY_ALARM:
+    {
+        clockgusto_alarm_config_t config;
+        clockgusto_alarm_get_config(&config);
+        value[0] = config.enabled;
+        value[1] = config.hour;
+        value[2] = config.minute;
+        value[3] = config.days;
+        value[4] = config.sunrise;
+        return 5;
+    }
+
+    case CLOCKGUSTO_WIRE_KEY_NIGHT:
+    {
+        clockgusto_night_config_t config;
+        clockgusto_night_get_config(&config);
+        value[0] = config.enabled;
+        clockgusto_wire_put_u32(value + 1, (uint32_t)config.latitude_e4);
+        clockgusto_wire_put_u32(value + 5, (uint32_t)config.longitude_e4);
+        value[9] = config.night_level;
+        value[10] = config.twilight_min;
+        return 11;
+    }
+
+    case CLOCKGUSTO_WIRE_KEY_TZ:
+    {
+        clockgusto_tz_rule_t rule;
+        clockgusto_tz_get_rule(&rule);
+        clockgusto_wire_put_u16(value, (uint16_t)rule.std_offset_min);
+        clockgusto_wire_put_u16(value + 2, (uint16_t)rule.dst_offset_min);
+        clockgusto_serial_put_switch(value + 4, &rule.dst_start);
+        clockgusto_serial_put_switch(value + 9, &rule.dst_end);
+        return 14;
+    }
+
+    case CLOCKGUSTO_WIRE_KEY_WIFI:
+    {
+        char ssid[CLOCKGUSTO_WIFI_SSID_SIZE];
+        clockgusto_wifi_get_ssid(ssid);
+        value[0] = (uint8_t)strlen(ssid);
+        memcpy(value + 1, ssid, value[0]);
+        return 1 + value[0];
+    }
+
+    default:
+        return 0;
+    }
+}
+
+/** The only value of variable size, the setter checks the lengths. */
+static clockgusto_wire_status_t clockgusto_serial_wifi_set(const uint8_t* value, size_t size)
+{
+    if (size < 1 || size < 1 + (size_t)value[0] || value[0] >= CLOCKGUSTO_WIFI_SSID_SIZE ||
+        size - 1 - value[0] > 64)
+    {
+        return CLOCKGUSTO_WIRE_BAD_LENGTH;
+    }
+
+    char ssid[CLOCKGUSTO_WIFI_SSID_SIZE];
+    char password[64 + 1];
+    memcpy(ssid, value + 1, value[0]);
+    ssid[value[0]] = '\0';
+    memcpy(password, value + 1 + value[0], size - 1 - value[0]);
+    password[size - 1 - value[0]] = '\0';
+    if (strlen(ssid) != value[0] || strlen(password) != size - 1 - value[0])
+    {
+        return CLOCKGUSTO_WIRE_BAD_VALUE;
+    }
+
+    esp_err_t ret = clockgusto_wifi_set_credentials(ssid, password);
+    memset(password, 0, sizeof(password));
+    return clockgusto_serial_status(ret);
+}
+
+/** The setters check the values themselves, only the sizes are checked here. */
+static clockgusto_wire_status_t clockgusto_serial_config_set(uint8_t key, const uint8_t* value, size_t size)
+{
+    if (key == CLOCKGUSTO_WIRE_KEY_WIFI)
+    {
+        return clockgusto_serial_wifi_set(value, size);
+    }
+
+    uint8_t current[16];
+    size_t expected = clockgusto_serial_config_get(key, current);
+    if (expected == 0)
+    {
+        return CLOCKGUSTO_WIRE_UNKNOWN;
+    }
+    if (size != expected)
+    {
+        return CLOCKGUSTO_WIRE_BAD_LENGTH;
+    }
+
+    switch (key)
+    {
+    case CLOCKGUSTO_WIRE_KEY_BRIGHTNESS:
+        if (value[0] > 100)
+        {
+            return CLOCKGUSTO_WIRE_BAD_VALUE;
+        }
+        clockgusto_set_brightness(value[0]);
+        return CLOCKGUSTO_WIRE_OK;
+
+    case CLOCKGUSTO_WIRE_KEY_MODE:
+        if (value[0] >= CLOCKGUSTO_MODE_COUNT)
+        {
+            return CLOCKGUSTO_WIRE_BAD_VALUE;
+        }
+        clockgusto_set_mode((clockgusto_mode_t)value[0]);
+        return CLOCKGUSTO_WIRE_OK;
+
+    case CLOCKGUSTO_WIRE_KEY_ALARM:
+    {
+        clockgusto_alarm_config_t config = {
+            .enabled = value[0] != 0,
+            .hour = value[1],
+            .minute = value[2],
+            .days = value[3],
+            .sunrise = value[4] != 0,
+        };
+        return clockgusto_serial_status(clockgusto_alarm_set_config(&config));
+    }
+
+    case CLOCKGUSTO_WIRE_KEY_NIGHT:
+    {
+        clockgusto_night_config_t config = {
+            .enabled = value[0] != 0,
+            .latitude_e4 = (int32_t)clockgusto_wire_get_u32(value + 1),
+            .longitude_e4 = (int32_t)clockgusto_wire_get_u32(value + 5),
+            .night_level = value[9],
+            .twilight_min = value[10],
+        };
+        return clockgusto_serial_status(clockgusto_night_set_config(&config));
+    }
+
+    case CLOCKGUSTO_WIRE_KEY_TZ:
+    {
+        clockgusto_tz_rule_t rule = {
+            .std_offset_min = (int16_t)clockgusto_wire_get_u16(value),
+            .dst_offset_min = (int16_t)clockgusto_wire_get_u16(value + 2),
+        };
+        clockgusto_serial_get_switch(value + 4, &rule.dst_start);
+        clockgusto_serial_get_switch(value + 9, &rule.dst_end);
+        esp_err_t ret = clockgusto_tz_set_rule(&rule);
+        if (ret == ESP_OK)
+        {
+            // the rtc alarms run on UTC and were worked out with the old offsets
+            clockgusto_alarm_rearm();
+        }
+        return clockgusto_serial_status(ret);
+    }
+
+    default:
+        return CLOCKGUSTO_WIRE_UNKNOWN;
+    }
+}
+
+/** The host names the UTC of the frame's last byte, the wire and its own latency already added. The
+ *  arrival time is when this task took the data event off the queue, a delay the host's ping
+ *  measurement includes the same way. A host setting the clock is no reference, it goes the manual
+ *  way and leaves the sync state and the drift fit alone. */
+static clockgusto_wire_status_t clockgusto_serial_time_set(const clockgusto_wire_frame_t* frame, int64_t arrival_us)
+{
+    if (frame->size != 8)
+    {
+        return CLOCKGUSTO_WIRE_BAD_LENGTH;
+    }
+    int64_t utc_us = clockgusto_wire_get_i64(frame->payload);
+    if (utc_us <= 0)
+    {
+        return CLOCKGUSTO_WIRE_BAD_VALUE;
+    }
+
+    clockgusto_time_set_manual(utc_us, arrival_us);
+    return CLOCKGUSTO_WIRE_OK;
+}
+
+static clockgusto_wire_status_t clockgusto_serial_logs(const clockgusto_wire_frame_t* frame, uint8_t* out,
+                                                      size_t* size)
+{
+    if (frame->size != 4)
+    {
+        return CLOCKGUSTO_WIRE_BAD_LENGTH;
+    }
+
+    uint32_t newest = clockgusto_log_get_seq();
+    uint32_t oldest = newest > CLOCKGUSTO_LOG_LINES ? newest - CLOCKGUSTO_LOG_LINES + 1 : 1;
+    uint32_t seq = clockgusto_wire_get_u32(frame->payload);
+    seq = seq < oldest ? oldest : seq;
+
+    uint8_t line[4 + CLOCKGUSTO_LOG_LINE_SIZE];
+    for (; seq <= newest; ++seq)
+    {
+        if (!clockgusto_log_get_line(seq, (char*)line + 4, CLOCKGUSTO_LOG_LINE_SIZE))
+        {
+            continue;   // overwritten meanwhile
+        }
+        clockgusto_wire_put_u32(line, seq);
+        if (clockgusto_serial_send(CLOCKGUSTO_WIRE_LOG_LINE, frame->seq, line, 4 + strlen((char*)line + 4)) != ESP_OK)
+        {
+            return CLOCKGUSTO_WIRE_FAILED;
+        }
+    }
+
+    clockgusto_wire_put_u32(out, seq);
+    *size = 4;
+    return CLOCKGUSTO_WIRE_OK;
+}
+
+static esp_err_t clockgusto_serial_metrics_chunk(void* ctx, const char* data, size_t size)
+{
+    return clockgusto_serial_send(CLOCKGUSTO_WIRE_METRICS_TEXT, *(const uint8_t*)ctx, (const uint8_t*)data, size);
+}
+
+static void clockgusto_serial_handle(const clockgusto_wire_frame_t* frame, int64_t arrival_us)
+{
+    clockgusto_wire_status_t status = CLOCKGUSTO_WIRE_OK;
+    uint8_t* out = s_payload + 1;
+    size_t size = 0;
+
+    switch (frame->type)
+    {
+    case CLOCKGUSTO_WIRE_PING:
+        out[0] = CLOCKGUSTO_WIRE_VERSION;
+        clockgusto_wire_put_u16(out + 1, CLOCKGUSTO_WIRE_MAX_PAYLOAD);
+        size = 3;
+        break;
+
+    case CLOCKGUSTO_WIRE_TIME_GET:
+    case CLOCKGUSTO_WIRE_TIME_SET:
+        // a set answers with the time after it
+        status = frame->type == CLOCKGUSTO_WIRE_TIME_SET ? clockgusto_serial_time_set(frame, arrival_us)
+                                                         : CLOCKGUSTO_WIRE_OK;
+        clockgusto_wire_put_i64(out, clockgusto_serial_utc_us());
+        size = 8;
+        break;
+
+    case CLOCKGUSTO_WIRE_CONFIG_GET:
+    case CLOCKGUSTO_WIRE_CONFIG_SET:
+        if (frame->size < 1)
+        {
+            status = CLOCKGUSTO_WIRE_BAD_LENGTH;
+            break;
+        }
+        // a set answers with the value now in force
+        if (frame->type == CLOCKGUSTO_WIRE_CONFIG_SET)
+        {
+            status = clockgusto_serial_config_set(frame->payload[0], frame->payload + 1, frame->size - 1);
+        }
+        out[0] = frame->payload[0];
+        size = 1 + clockgusto_serial_config_get(out[0], out + 1);
+        status = size == 1 ? CLOCKGUSTO_WIRE_UNKNOWN : status;
+        break;
+
+    case CLOCKGUSTO_WIRE_FRAMES:
+        if (frame->size != 2)
+        {
+            status = CLOCKGUSTO_WIRE_BAD_LENGTH;
+            break;
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_frames_left = clockgusto_wire_get_u16(frame->payload);
+        s_stream_seq = frame->seq;
+        s_frame_fresh = false;
+        portEXIT_CRITICAL(&s_lock);
+        break;
+
+    case CLOCKGUSTO_WIRE_LOGS:
+        status = clockgusto_serial_logs(frame, out, &size);
+        break;
+
+    case CLOCKGUSTO_WIRE_METRICS:
+        // the text is formatted into the payload buffer, the answer only needs it afterwards
+        status = clockgusto_serial_status(clockgusto_metrics_write((char*)s_payload, sizeof(s_payload),
+                                                                   clockgusto_serial_metrics_chunk,
+                                                                   (void*)&frame->seq));
+        break;
+
+    case CLOCKGUSTO_WIRE_DISMISS:
+        out[0] = (uint8_t)clockgusto_alarm_get_state();
+        size = 1;
+        clockgusto_alarm_dismiss();
+        break;
+
+    default:
+        status = CLOCKGUSTO_WIRE_UNKNOWN;
+        break;
+    }
+
+    s_payload[0] = status;
+    clockgusto_serial_send(frame->type | CLOCKGUSTO_WIRE_RESPONSE, frame->seq, s_payload,
+                           status == CLOCKGUSTO_WIRE_OK ? 1 + size : 1);
+}
+
+static void clockgusto_serial_stream()
+{
+    uint8_t payload[4 + CLOCKGUSTO_SERIAL_FRAME_SIZE];
+    uint8_t seq;
+
+    portENTER_CRITICAL(&s_lock);
+    bool fresh = s_frame_fresh && s_frames_left > 0;
+    if (fresh)
+    {
+        clockgusto_wire_put_u32(payload, s_frame_number);
+        memcpy(payload + 4, s_frame, sizeof(s_frame));
+        s_frame_fresh = false;
+        s_frames_left--;
+        s_stats.streamed++;
+    }
+    seq = s_stream_seq;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (fresh)
+    {
+        clockgusto_serial_send(CLOCKGUSTO_WIRE_FRAME_DATA, seq, payload, sizeof(payload));
+    }
+}
+
+static void clockgusto_serial_receive(size_t available, int64_t arrival_us)
+{
+    uint8_t data[CLOCKGUSTO_SERIAL_READ_SIZE];
+    while (available > 0)
+    {
+        int length = uart_read_bytes(CLOCKGUSTO_SERIAL_PORT, data,
+                                     available < sizeof(data) ? available : sizeof(data), 0);
+        if (length <= 0)
+        {
+            return;
+        }
+        available -= length;
+
+        for (int idx = 0; idx < length; ++idx)
+        {
+            clockgusto_wire_frame_t frame;
+            clockgusto_wire_result_t result = clockgusto_wire_reader_push(&s_reader, data[idx], &frame);
+            if (result == CLOCKGUSTO_WIRE_FRAME)
+            {
+                portENTER_CRITICAL(&s_lock);
+                s_stats.requests++;
+                portEXIT_CRITICAL(&s_lock);
+                clockgusto_serial_handle(&frame, arrival_us);
+            }
+            else if (result == CLOCKGUSTO_WIRE_NOISE)
+            {
+                portENTER_CRITICAL(&s_lock);
+                s_stats.noise++;
+                portEXIT_CRITICAL(&s_lock);
+            }
+        }
+    }
+}
+
+/** Light sleep stops the uart clock, so while the host talks the chip stays awake. The session
+ *  starts with any byte that made it in, the wake bytes themselves are lost, and ends after
+ *  CLOCKGUSTO_SERIAL_SESSION_MS of silence. */
+static void clockgusto_serial_session(bool received)
+{
+    int64_t now_us = esp_timer_get_time();
+    if (received)
+    {
+        if (s_session_end_us == 0)
+        {
+            if (s_pm_lock)
+            {
+                esp_pm_lock_acquire(s_pm_lock);
+            }
+            ESP_LOGI(TAG, "host session");
+        }
+        s_session_end_us = now_us + CLOCKGUSTO_SERIAL_SESSION_MS * 1000LL;
+    }
+    else if (s_session_end_us != 0 && now_us >= s_session_end_us)
+    {
+        s_session_end_us = 0;
+        if (s_pm_lock)
+        {
+            esp_pm_lock_release(s_pm_lock);
+        }
+        ESP_LOGI(TAG, "host session ended");
+    }
+}
+
+static void clockgusto_serial_task(void* arg)
+{
+    (void)arg;
+    uart_event_t event;
+
+    while (true)
+    {
+        TickType_t wait = portMAX_DELAY;
+        if (s_frames_left > 0)
+        {
+            wait = pdMS_TO_TICKS(CLOCKGUSTO_SERIAL_STREAM_POLL_MS);
+        }
+        else if (s_session_end_us != 0)
+        {
+            int64_t left_us = s_session_end_us - esp_timer_get_time();
+            wait = left_us > 0 ? pdMS_TO_TICKS(left_us / 1000) + 1 : 0;
+        }
+
+        if (xQueueReceive(s_queue, &event, wait) == pdTRUE)
+        {
+            /* Taken when the event leaves the queue, not when the driver posted it at its rx timeout a
+             * few bit times after the last byte. The ping round trip the host measures holds both. */
+            int64_t arrival_us = esp_timer_get_time();
+            if (event.type == UART_DATA)
+            {
+                clockgusto_serial_session(true);
+                clockgusto_serial_receive(event.size, arrival_us);
+            }
+            else if (event.type == UART_FIFO_OVF || event.type == UART_BUFFER_FULL)
+            {
+                // whatever frame was arriving is lost, the host tries again after its timeout
+                uart_flush_input(CLOCKGUSTO_SERIAL_PORT);
+                xQueueReset(s_queue);
+                clockgusto_wire_reader_init(&s_reader);
+                portENTER_CRITICAL(&s_lock);
+                s_stats.overruns++;
+                portEXIT_CRITICAL(&s_lock);
+            }
+        }
+        clockgusto_serial_session(false);
+        clockgusto_serial_stream();
+    }
+}
+
+esp_err_t clockgusto_serial_init()
+{
+    esp_err_t ret = uart_driver_install(CLOCKGUSTO_SERIAL_PORT, CLOCKGUSTO_SERIAL_RX_BUFFER,
+                                        CLOCKGUSTO_SERIAL_TX_BUFFER, CLOCKGUSTO_SERIAL_QUEUE_LENGTH, &s_queue, 0);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to install the uart driver\n");
+        return ret;
+    }
+    uart_vfs_dev_use_driver(CLOCKGUSTO_SERIAL_PORT);
+    clockgusto_wire_reader_init(&s_reader);
+
+    // without CONFIG_PM_ENABLE there is no light sleep to hold off or to wake from
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "serial", &s_pm_lock) != ESP_OK)
+    {
+        s_pm_lock = NULL;
+    }
+    else if (uart_set_wakeup_threshold(CLOCKGUSTO_SERIAL_PORT, CLOCKGUSTO_SERIAL_WAKE_EDGES) != ESP_OK ||
+             esp_sleep_enable_uart_wakeup(CLOCKGUSTO_SERIAL_PORT) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "uart does not wake the chip, the host has to catch it awake");
+    }
+
+    if (xTaskCreate(clockgusto_serial_task, "clockgusto serial", CLOCKGUSTO_SERIAL_TASK_STACK, NULL,
+                    CLOCKGUSTO_SERIAL_TASK_PRIORITY, &s_task) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "framed protocol v%u on uart %u", CLOCKGUSTO_WIRE_VERSION, CLOCKGUSTO_SERIAL_PORT);
+    return ESP_OK;
+}
+
+void clockgusto_serial_submit(const uint8_t* pixels)
+{
+    if (s_frames_left == 0)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.skipped += s_frame_fresh;
+    memcpy(s_frame, pixels, sizeof(s_frame));
+    s_frame_number++;
+    s_frame_fresh = true;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void clockgusto_serial_get_stats(clockgusto_serial_stats_t* stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+
+typedef struct _clockgusto_serial_stats_t
+{
+    uint32_t requests;              // valid frames from the host
+    uint32_t noise;                 // runs between delimiters that were no frame
+    uint32_t overruns;              // receive buffer overflows, the input was dropped
+    uint32_t streamed;              // frame buffers sent
+    uint32_t skipped;               // frames shown while the previous one was still waiting for the uart
+    uint64_t bytes;                 // sent, delimiters included
+} clockgusto_serial_stats_t;
+
+/** Takes the console UART over for the framed protocol of clockgusto_wire.h: installs the driver, routes
+ *  the console through it so log lines never split a frame, and starts the task that answers the host.
+ *  Log output stays readable as text between the frames. With power management on, the host wakes the
+ *  chip from light sleep with its first bytes, which are lost, and keeps it awake while it talks. */
+esp_err_t clockgusto_serial_init();
+
+/** Offers a frame that is on the strip now. Returns at once unless the host asked for frames, then it
+ *  copies the pixels for the serial task. */
+void clockgusto_serial_submit(const uint8_t* pixels);
+
+/** */
+void clockgusto_serial_get_stats(clockgusto_serial_stats_t* stats);
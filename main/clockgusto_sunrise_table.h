@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Generated by tools/gen_sunrise_table.py, do not edit. */
+
+#define CLOCKGUSTO_SUNRISE_TABLE_POINTS 64
+
+/** Green, blue, red in strip byte order, evenly spaced over the sunrise, the last entry is daylight. */
+static const uint8_t clockgusto_sunrise_table[CLOCKGUSTO_SUNRISE_TABLE_POINTS][3] = {
+    {   0,   0,   0 }, // 1000 K   0%
+    {   0,   0,   0 }, // 1374 K   0%
+    {   0,   0,   0 }, // 1567 K   0%
+    {   0,   0,   0 }, // 1724 K   0%
+    {   0,   0,   1 }, // 1860 K   0%
+    {   1,   0,   1 }, // 1983 K   0%
+    {   1,   0,   1 }, // 2097 K   1%
+    {   1,   0,   2 }, // 2204 K   1%
+    {   2,   1,   3 }, // 2304 K   1%
+    {   2,   1,   4 }, // 2400 K   1%
+    {   3,   1,   4 }, // 2491 K   2%
+    {   3,   2,   5 }, // 2579 K   2%
+    {   4,   2,   7 }, // 2663 K   3%
+    {   5,   3,   8 }, // 2745 K   3%
+    {   6,   4,   9 }, // 2825 K   4%
+    {   7,   4,  11 }, // 2902 K   4%
+    {   9,   5,  13 }, // 2977 K   5%
+    {  10,   6,  14 }, // 3050 K   6%
+    {  12,   8,  16 }, // 3122 K   6%
+    {  13,   9,  18 }, // 3192 K   7%
+    {  15,  10,  20 }, // 3260 K   8%
+    {  17,  12,  23 }, // 3327 K   9%
+    {  19,  13,  25 }, // 3393 K  10%
+    {  21,  15,  28 }, // 3458 K  11%
+    {  23,  17,  31 }, // 3521 K  12%
+    {  26,  19,  33 }, // 3584 K  13%
+    {  28,  21,  36 }, // 3646 K  14%
+    {  31,  24,  40 }, // 3706 K  16%
+    {  34,  26,  43 }, // 3766 K  17%
+    {  37,  29,  46 }, // 3825 K  18%
+    {  40,  31,  50 }, // 3883 K  20%
+    {  43,  34,  54 }, // 3940 K  21%
+    {  46,  37,  57 }, // 3997 K  23%
+    {  50,  41,  61 }, // 4052 K  24%
+    {  54,  44,  66 }, // 4108 K  26%
+    {  58,  48,  70 }, // 4162 K  27%
+    {  62,  51,  74 }, // 4216 K  29%
+    {  66,  55,  79 }, // 4269 K  31%
+    {  70,  59,  84 }, // 4322 K  33%
+    {  75,  64,  89 }, // 4374 K  35%
+    {  79,  68,  94 }, // 4426 K  37%
+    {  84,  73,  99 }, // 4477 K  39%
+    {  89,  77, 105 }, // 4528 K  41%
+    {  95,  82, 110 }, // 4578 K  43%
+    { 100,  87, 116 }, // 4628 K  45%
+    { 106,  93, 122 }, // 4677 K  48%
+    { 111,  98, 128 }, // 4726 K  50%
+    { 117, 104, 134 }, // 4774 K  52%
+    { 123, 110, 140 }, // 4822 K  55%
+    { 130, 116, 147 }, // 4870 K  58%
+    { 136, 122, 153 }, // 4917 K  60%
+    { 143, 129, 160 }, // 4964 K  63%
+    { 150, 135, 167 }, // 5010 K  66%
+    { 157, 142, 174 }, // 5056 K  68%
+    { 164, 149, 182 }, // 5102 K  71%
+    { 171, 156, 189 }, // 5147 K  74%
+    { 179, 164, 197 }, // 5192 K  77%
+    { 187, 172, 205 }, // 5237 K  80%
+    { 195, 180, 213 }, // 5282 K  83%
+    { 203, 188, 221 }, // 5326 K  87%
+    { 211, 196, 229 }, // 5370 K  90%
+    { 220, 205, 238 }, // 5413 K  93%
+    { 229, 213, 246 }, // 5457 K  97%
+    { 237, 222, 255 }, // 5500 K 100%
+};
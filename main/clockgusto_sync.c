@@ -0,0 +1,335 @@
+#include "clockgusto_sync.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CLOCKGUSTO_SYNC_MAGIC_0     'C'
+#define CLOCKGUSTO_SYNC_MAGIC_1     'G'
+#define CLOCKGUSTO_SYNC_VERSION     1
+#define CLOCKGUSTO_SYNC_PHASE_GAIN  2       // half of the phase error is corrected at once
+#define CLOCKGUSTO_SYNC_FREQ_GAIN   256     // the frequency follows slowly, single errors are mostly jitter
+#define CLOCKGUSTO_SYNC_SLEW_US     200     // per interval towards the node's own UTC, followers keep up
+
+static void clockgusto_sync_put_u32(uint8_t* data, uint32_t value)
+{
+    for (int idx = 0; idx < 4; ++idx)
+    {
+        data[idx] = (uint8_t)(value >> (24 - 8 * idx));
+    }
+}
+
+static void clockgusto_sync_put_i64(uint8_t* data, int64_t value)
+{
+    for (int idx = 0; idx < 8; ++idx)
+    {
+        data[idx] = (uint8_t)((uint64_t)value >> (56 - 8 * idx));
+    }
+}
+
+static uint32_t clockgusto_sync_get_u32(const uint8_t* data)
+{
+    return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | data[3];
+}
+
+static int64_t clockgusto_sync_get_i64(const uint8_t* data)
+{
+    uint64_t value = 0;
+    for (int idx = 0; idx < 8; ++idx)
+    {
+        value = value << 8 | data[idx];
+    }
+    return (int64_t)value;
+}
+
+/* magic, version, type, flags, 3 reserved, node, origin, receive, transmit, all big endian */
+size_t clockgusto_sync_encode(const clockgusto_sync_packet_t* packet, uint8_t* data)
+{
+    memset(data, 0, CLOCKGUSTO_SYNC_PACKET_SIZE);
+    data[0] = CLOCKGUSTO_SYNC_MAGIC_0;
+    data[1] = CLOCKGUSTO_SYNC_MAGIC_1;
+    data[2] = CLOCKGUSTO_SYNC_VERSION;
+    data[3] = packet->type;
+    data[4] = packet->flags;
+    clockgusto_sync_put_u32(data + 8, packet->node);
+    clockgusto_sync_put_i64(data + 12, packet->origin_us);
+    clockgusto_sync_put_i64(data + 20, packet->receive_us);
+    clockgusto_sync_put_i64(data + 28, packet->transmit_us);
+    return CLOCKGUSTO_SYNC_PACKET_SIZE;
+}
+
+bool clockgusto_sync_decode(const uint8_t* data, size_t size, clockgusto_sync_packet_t* packet)
+{
+    if (size < CLOCKGUSTO_SYNC_PACKET_SIZE || data[0] != CLOCKGUSTO_SYNC_MAGIC_0 ||
+        data[1] != CLOCKGUSTO_SYNC_MAGIC_1 || data[2] != CLOCKGUSTO_SYNC_VERSION ||
+        data[3] < CLOCKGUSTO_SYNC_BEACON || data[3] > CLOCKGUSTO_SYNC_RESPONSE)
+    {
+        return false;
+    }
+
+    packet->type = data[3];
+    packet->flags = data[4];
+    packet->node = clockgusto_sync_get_u32(data + 8);
+    packet->origin_us = clockgusto_sync_get_i64(data + 12);
+    packet->receive_us = clockgusto_sync_get_i64(data + 20);
+    packet->transmit_us = clockgusto_sync_get_i64(data + 28);
+    return packet->node != CLOCKGUSTO_SYNC_NODE_NONE;
+}
+
+void clockgusto_sync_clock_init(clockgusto_sync_clock_t* clock)
+{
+    memset(clock, 0, sizeof(*clock));
+}
+
+int64_t clockgusto_sync_clock_now(const clockgusto_sync_clock_t* clock, int64_t local_us)
+{
+    return local_us + clock->offset_us + (local_us - clock->base_us) * clock->freq_ppb / 1000000000LL;
+}
+
+static void clockgusto_sync_clock_forget(clockgusto_sync_clock_t* clock)
+{
+    clock->sample_count = 0;
+    clock->sample_next = 0;
+    clock->used_us = 0;
+}
+
+/** One step of the loop: half the phase error now, the frequency from the error rate since the
+ *  last sample. Errors beyond CLOCKGUSTO_SYNC_STEP_US would take too long to slew. */
+static void clockgusto_sync_clock_apply(clockgusto_sync_clock_t* clock, const clockgusto_sync_sample_t* sample,
+                                        int64_t previous_us, clockgusto_sync_stats_t* stats)
+{
+    int64_t predicted_us = clockgusto_sync_clock_now(clock, sample->local_us) - sample->local_us;
+    int64_t error_us = sample->offset_us - predicted_us;
+
+    if (!clock->locked || llabs(error_us) > CLOCKGUSTO_SYNC_STEP_US)
+    {
+        clock->offset_us = sample->offset_us;
+        clock->locked = true;
+        stats->steps++;
+    }
+    else
+    {
+        int64_t interval_us = sample->local_us - previous_us;
+        if (previous_us != 0 && interval_us > 0)
+        {
+            int64_t freq_ppb = clock->freq_ppb + error_us * 1000000000LL / interval_us / CLOCKGUSTO_SYNC_FREQ_GAIN;
+            freq_ppb = freq_ppb > CLOCKGUSTO_SYNC_MAX_FREQ_PPB ? CLOCKGUSTO_SYNC_MAX_FREQ_PPB : freq_ppb;
+            freq_ppb = freq_ppb < -CLOCKGUSTO_SYNC_MAX_FREQ_PPB ? -CLOCKGUSTO_SYNC_MAX_FREQ_PPB : freq_ppb;
+            clock->freq_ppb = (int32_t)freq_ppb;
+        }
+        clock->offset_us = predicted_us + error_us / CLOCKGUSTO_SYNC_PHASE_GAIN;
+    }
+    clock->base_us = sample->local_us;
+
+    stats->applied++;
+    stats->error_us = (int32_t)error_us;
+    stats->delay_us = (int32_t)sample->delay_us;
+    stats->freq_ppb = clock->freq_ppb;
+}
+
+/* The clock filter of NTP: of the last few exchanges the one with the shortest round trip has the
+ * least queueing in it, so only that one steers, and only once. */
+bool clockgusto_sync_clock_sample(clockgusto_sync_clock_t* clock, int64_t t1, int64_t t2, int64_t t3, int64_t t4,
+                                  clockgusto_sync_stats_t* stats)
+{
+    clockgusto_sync_sample_t* sample = &clock->samples[clock->sample_next];
+    sample->local_us = t1 + (t4 - t1) / 2;
+    sample->offset_us = ((t2 - t1) + (t3 - t4)) / 2;
+    sample->delay_us = (t4 - t1) - (t3 - t2);
+    clock->sample_next = (clock->sample_next + 1) % CLOCKGUSTO_SYNC_FILTER_SIZE;
+    if (clock->sample_count < CLOCKGUSTO_SYNC_FILTER_SIZE)
+    {
+        clock->sample_count++;
+    }
+
+    const clockgusto_sync_sample_t* best = NULL;
+    for (uint8_t idx = 0; idx < clock->sample_count; ++idx)
+    {
+        const clockgusto_sync_sample_t* candidate = &clock->samples[idx];
+        if (!best || candidate->delay_us < best->delay_us ||
+            (candidate->delay_us == best->delay_us && candidate->local_us > best->local_us))
+        {
+            best = candidate;
+        }
+    }
+    if (best->local_us <= clock->used_us)
+    {
+        return false;
+    }
+
+    int64_t previous_us = clock->used_us;
+    clock->used_us = best->local_us;
+    clockgusto_sync_clock_apply(clock, best, previous_us, stats);
+    return true;
+}
+
+void clockgusto_sync_node_init(clockgusto_sync_node_t* node, uint32_t id, int64_t local_us, int64_t utc_us)
+{
+    memset(node, 0, sizeof(*node));
+    node->id = id;
+    node->role = CLOCKGUSTO_SYNC_LISTENING;
+    node->since_us = local_us;
+    clockgusto_sync_clock_init(&node->clock);
+    node->clock.base_us = local_us;
+    node->clock.offset_us = utc_us - local_us;
+    node->clock.locked = true;
+}
+
+/** A clock with a time source beats one without, then the lower id wins. */
+static bool clockgusto_sync_is_better(bool synced, uint32_t id, bool other_synced, uint32_t other_id)
+{
+    return synced != other_synced ? synced : id < other_id;
+}
+
+static void clockgusto_sync_follow(clockgusto_sync_node_t* node, const clockgusto_sync_packet_t* beacon,
+                                   int64_t local_us)
+{
+    node->role = CLOCKGUSTO_SYNC_FOLLOWER;
+    node->master = beacon->node;
+    node->master_synced = beacon->flags & CLOCKGUSTO_SYNC_FLAG_SYNCED;
+    node->since_us = local_us;
+    node->pending_us = 0;
+    // samples of another master say nothing about this one, and the first exchange sets the time
+    clockgusto_sync_clock_forget(&node->clock);
+    node->clock.locked = false;
+}
+
+/** Moves the group clock of a node without a master towards its own UTC, slowly enough that the
+ *  followers of a master move along without losing each other. */
+static void clockgusto_sync_steer(clockgusto_sync_node_t* node, int64_t local_us, int64_t utc_us)
+{
+    clockgusto_sync_clock_t* clock = &node->clock;
+    int64_t group_us = clockgusto_sync_clock_now(clock, local_us);
+    int64_t error_us = utc_us - group_us;
+    if (llabs(error_us) > CLOCKGUSTO_SYNC_STEP_US)
+    {
+        node->stats.steps++;
+    }
+    else
+    {
+        error_us = error_us > CLOCKGUSTO_SYNC_SLEW_US ? CLOCKGUSTO_SYNC_SLEW_US : error_us;
+        error_us = error_us < -CLOCKGUSTO_SYNC_SLEW_US ? -CLOCKGUSTO_SYNC_SLEW_US : error_us;
+    }
+    clock->offset_us = group_us + error_us - local_us;
+    clock->base_us = local_us;
+    clock->locked = true;
+}
+
+static void clockgusto_sync_build(const clockgusto_sync_node_t* node, uint8_t type, int64_t origin_us,
+                                  int64_t receive_us, int64_t transmit_us, uint8_t* packet, size_t* size)
+{
+    clockgusto_sync_packet_t out = {
+        .type = type,
+        .flags = node->synced ? CLOCKGUSTO_SYNC_FLAG_SYNCED : 0,
+        .node = node->id,
+        .origin_us = origin_us,
+        .receive_us = receive_us,
+        .transmit_us = transmit_us,
+    };
+    *size = clockgusto_sync_encode(&out, packet);
+}
+
+clockgusto_sync_action_t clockgusto_sync_node_tick(clockgusto_sync_node_t* node, int64_t local_us, int64_t utc_us,
+                                                   uint8_t* packet, size_t* size)
+{
+    if (node->role == CLOCKGUSTO_SYNC_FOLLOWER && local_us - node->since_us > CLOCKGUSTO_SYNC_LOST_MS * 1000LL)
+    {
+        // the group clock runs on from the last lock while the others decide who takes over
+        node->role = CLOCKGUSTO_SYNC_LISTENING;
+        node->master = CLOCKGUSTO_SYNC_NODE_NONE;
+        node->since_us = local_us;
+        clockgusto_sync_clock_forget(&node->clock);
+    }
+
+    if (node->role == CLOCKGUSTO_SYNC_FOLLOWER && node->synced && !node->master_synced)
+    {
+        // a time source beats stability, the old master follows once it hears the beacon
+        node->role = CLOCKGUSTO_SYNC_MASTER;
+        node->master = node->id;
+    }
+
+    if (node->role == CLOCKGUSTO_SYNC_FOLLOWER)
+    {
+        node->pending_us = local_us;
+        clockgusto_sync_build(node, CLOCKGUSTO_SYNC_REQUEST, local_us, 0, 0, packet, size);
+        return CLOCKGUSTO_SYNC_TO_MASTER;
+    }
+
+    clockgusto_sync_steer(node, local_us, utc_us);
+
+    if (node->role == CLOCKGUSTO_SYNC_LISTENING)
+    {
+        if (local_us - node->since_us < CLOCKGUSTO_SYNC_CLAIM_MS * 1000LL)
+        {
+            return CLOCKGUSTO_SYNC_NOTHING;
+        }
+        node->role = CLOCKGUSTO_SYNC_MASTER;
+        node->master = node->id;
+    }
+
+    clockgusto_sync_build(node, CLOCKGUSTO_SYNC_BEACON, 0, 0, clockgusto_sync_clock_now(&node->clock, local_us),
+                          packet, size);
+    return CLOCKGUSTO_SYNC_MULTICAST;
+}
+
+clockgusto_sync_action_t clockgusto_sync_node_receive(clockgusto_sync_node_t* node, const uint8_t* data,
+                                                      size_t size, int64_t local_us, uint8_t* packet,
+                                                      size_t* packet_size)
+{
+    clockgusto_sync_packet_t in;
+    if (!clockgusto_sync_decode(data, size, &in) || in.node == node->id)
+    {
+        return CLOCKGUSTO_SYNC_NOTHING;
+    }
+    bool in_synced = in.flags & CLOCKGUSTO_SYNC_FLAG_SYNCED;
+
+    switch (in.type)
+    {
+    case CLOCKGUSTO_SYNC_BEACON:
+        if (node->role == CLOCKGUSTO_SYNC_FOLLOWER && in.node == node->master)
+        {
+            node->since_us = local_us;
+            node->master_synced = in_synced;
+            return CLOCKGUSTO_SYNC_NEW_MASTER;  // its address may have changed
+        }
+        if (node->role == CLOCKGUSTO_SYNC_LISTENING ||
+            (node->role == CLOCKGUSTO_SYNC_FOLLOWER &&
+             clockgusto_sync_is_better(in_synced, in.node, node->master_synced, node->master)) ||
+            (node->role == CLOCKGUSTO_SYNC_MASTER &&
+             clockgusto_sync_is_better(in_synced, in.node, node->synced, node->id)))
+        {
+            clockgusto_sync_follow(node, &in, local_us);
+            return CLOCKGUSTO_SYNC_NEW_MASTER;
+        }
+        return CLOCKGUSTO_SYNC_NOTHING;
+
+    case CLOCKGUSTO_SYNC_REQUEST:
+        if (node->role != CLOCKGUSTO_SYNC_MASTER)
+        {
+            return CLOCKGUSTO_SYNC_NOTHING;
+        }
+        // the answer leaves within microseconds, so receive and transmit share the arrival time
+        int64_t now_us = clockgusto_sync_clock_now(&node->clock, local_us);
+        clockgusto_sync_build(node, CLOCKGUSTO_SYNC_RESPONSE, in.origin_us, now_us, now_us, packet, packet_size);
+        return CLOCKGUSTO_SYNC_REPLY;
+
+    case CLOCKGUSTO_SYNC_RESPONSE:
+        if (node->role != CLOCKGUSTO_SYNC_FOLLOWER || in.node != node->master || node->pending_us == 0 ||
+            in.origin_us != node->pending_us)
+        {
+            return CLOCKGUSTO_SYNC_NOTHING;
+        }
+        node->pending_us = 0;
+        node->stats.exchanges++;
+        clockgusto_sync_clock_sample(&node->clock, in.origin_us, in.receive_us, in.transmit_us, local_us,
+                                     &node->stats);
+        return CLOCKGUSTO_SYNC_NOTHING;
+
+    default:
+        return CLOCKGUSTO_SYNC_NOTHING;
+    }
+}
+
+int64_t clockgusto_sync_node_now(const clockgusto_sync_node_t* node, int64_t local_us)
+{
+    return clockgusto_sync_clock_now(&node->clock, local_us);
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLOCKGUSTO_SYNC_PORT            4049
+#define CLOCKGUSTO_SYNC_GROUP           "239.255.67.71"     // administratively scoped, 67 71 is "CG"
+#define CLOCKGUSTO_SYNC_PACKET_SIZE     36
+#define CLOCKGUSTO_SYNC_INTERVAL_MS     1000    // beacons and requests
+#define CLOCKGUSTO_SYNC_CLAIM_MS        3500    // listening without a beacon before becoming master
+#define CLOCKGUSTO_SYNC_LOST_MS         4500    // without a beacon the master is gone
+#define CLOCKGUSTO_SYNC_STEP_US         100000  // errors above are stepped, below slewed
+#define CLOCKGUSTO_SYNC_MAX_FREQ_PPB    500000
+#define CLOCKGUSTO_SYNC_NODE_NONE       0
+
+/* Plain C without ESP-IDF dependencies, so several clocks can be simulated over loopback on a host.
+ *
+ * Every node keeps a group clock on its monotonic local time line. One node, the master, multicasts
+ * beacons with its group time and steers it towards its own UTC. The others follow the first beacon
+ * they hear: every interval they ask the master for the time with a unicast request and derive
+ * offset and delay from the four timestamps of the exchange, like NTP. A master only gives way to a
+ * better one, a clock with a time source before one without, then the lower node id, so a clock that
+ * boots into a running group does not move everybody's time. */
+
+typedef enum _clockgusto_sync_type_t
+{
+    CLOCKGUSTO_SYNC_BEACON   = 1,   // multicast by the master
+    CLOCKGUSTO_SYNC_REQUEST  = 2,   // follower to master
+    CLOCKGUSTO_SYNC_RESPONSE = 3,   // master to follower
+} clockgusto_sync_type_t;
+
+#define CLOCKGUSTO_SYNC_FLAG_SYNCED     0x01    // the sender's time comes from a time source
+
+typedef struct _clockgusto_sync_packet_t
+{
+    uint8_t type;
+    uint8_t flags;
+    uint32_t node;
+    int64_t origin_us;              // t1, the requester's time when it asked, echoed back
+    int64_t receive_us;             // t2, group time the request arrived
+    int64_t transmit_us;            // t3, group time the answer or beacon left
+} clockgusto_sync_packet_t;
+
+#define CLOCKGUSTO_SYNC_FILTER_SIZE     8
+
+typedef struct _clockgusto_sync_sample_t
+{
+    int64_t local_us;               // midpoint of the exchange on the local clock
+    int64_t offset_us;              // group minus local
+    int64_t delay_us;               // round trip without the master's turnaround
+} clockgusto_sync_sample_t;
+
+/** Group time as a function of local time, steered by a phase and frequency locked loop. */
+typedef struct _clockgusto_sync_clock_t
+{
+    int64_t base_us;                // local time of the last correction
+    int64_t offset_us;              // group minus local at base_us
+    int32_t freq_ppb;               // how much faster the group runs than the local clock
+    bool locked;
+
+    clockgusto_sync_sample_t samples[CLOCKGUSTO_SYNC_FILTER_SIZE];
+    uint8_t sample_count;
+    uint8_t sample_next;
+    int64_t used_us;                // local time of the last sample applied, each is used once
+} clockgusto_sync_clock_t;
+
+typedef enum _clockgusto_sync_role_t
+{
+    CLOCKGUSTO_SYNC_LISTENING,      // looking for a master before claiming the role
+    CLOCKGUSTO_SYNC_FOLLOWER,
+    CLOCKGUSTO_SYNC_MASTER,
+} clockgusto_sync_role_t;
+
+typedef struct _clockgusto_sync_stats_t
+{
+    uint32_t exchanges;             // answers received
+    uint32_t applied;               // answers the filter passed to the loop
+    uint32_t steps;                 // corrections too large to slew
+    int32_t error_us;               // phase error of the last applied sample
+    int32_t delay_us;               // its round trip
+    int32_t freq_ppb;
+} clockgusto_sync_stats_t;
+
+typedef struct _clockgusto_sync_node_t
+{
+    uint32_t id;                    // unique in the group, never CLOCKGUSTO_SYNC_NODE_NONE
+    bool synced;                    // this clock's own time comes from a time source
+    clockgusto_sync_role_t role;
+    uint32_t master;
+    bool master_synced;
+    int64_t since_us;               // start of listening, or the last beacon of the master
+    int64_t pending_us;             // origin of the outstanding request, 0 when none
+    clockgusto_sync_clock_t clock;
+    clockgusto_sync_stats_t stats;
+} clockgusto_sync_node_t;
+
+typedef enum _clockgusto_sync_action_t
+{
+    CLOCKGUSTO_SYNC_NOTHING,
+    CLOCKGUSTO_SYNC_MULTICAST,      // send the packet to the group
+    CLOCKGUSTO_SYNC_TO_MASTER,      // send the packet to the master's address
+    CLOCKGUSTO_SYNC_REPLY,          // send the packet back to where the received one came from
+    CLOCKGUSTO_SYNC_NEW_MASTER,     // the received packet came from the master, remember its address
+} clockgusto_sync_action_t;
+
+/** */
+size_t clockgusto_sync_encode(const clockgusto_sync_packet_t* packet, uint8_t* data);
+
+/** False for anything that is not a sync packet of this version. */
+bool clockgusto_sync_decode(const uint8_t* data, size_t size, clockgusto_sync_packet_t* packet);
+
+/** */
+void clockgusto_sync_clock_init(clockgusto_sync_clock_t* clock);
+
+/** Group time at the given local time. */
+int64_t clockgusto_sync_clock_now(const clockgusto_sync_clock_t* clock, int64_t local_us);
+
+/** Feeds the timestamps of one exchange, t1 and t4 local, t2 and t3 group time. Returns true when
+ *  the clock filter passed a sample to the loop. */
+bool clockgusto_sync_clock_sample(clockgusto_sync_clock_t* clock, int64_t t1, int64_t t2, int64_t t3, int64_t t4,
+                                  clockgusto_sync_stats_t* stats);
+
+/** Starts listening, with the group clock set to utc_us. Local times are monotonic us, utc_us is the
+ *  node's own idea of UTC at local_us. */
+void clockgusto_sync_node_init(clockgusto_sync_node_t* node, uint32_t id, int64_t local_us, int64_t utc_us);
+
+/** Runs every CLOCKGUSTO_SYNC_INTERVAL_MS: claims or gives up the master role and fills packet with
+ *  a beacon or a request. The action says where it goes. Without a master to follow the group clock
+ *  is steered towards utc_us. */
+clockgusto_sync_action_t clockgusto_sync_node_tick(clockgusto_sync_node_t* node, int64_t local_us, int64_t utc_us,
+                                                   uint8_t* packet, size_t* size);
+
+/** Handles a received packet, local_us taken as close to its arrival as possible. A reply, if any,
+ *  is written to packet. */
+clockgusto_sync_action_t clockgusto_sync_node_receive(clockgusto_sync_node_t* node, const uint8_t* data,
+                                                      size_t size, int64_t local_us, uint8_t* packet,
+                                                      size_t* packet_size);
+
+/** Group time in UTC us. */
+int64_t clockgusto_sync_node_now(const clockgusto_sync_node_t* node, int64_t local_us);
@@ -0,0 +1,104 @@
+#include "clockgusto_temperature.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rtc_ds3231.h"
+
+#define CLOCKGUSTO_TEMPERATURE_PERIOD_MS       64000   // DS3231 converts every 64 s on its own
+#define CLOCKGUSTO_TEMPERATURE_RETRY_MS        5000
+#define CLOCKGUSTO_TEMPERATURE_TASK_STACK      2048
+#define CLOCKGUSTO_TEMPERATURE_TASK_PRIORITY   (tskIDLE_PRIORITY + 1)
+#define CLOCKGUSTO_TEMPERATURE_DERATE_START_Q  (45 * 4)  // quarter degrees
+#define CLOCKGUSTO_TEMPERATURE_DERATE_FULL_Q   (60 * 4)
+#define CLOCKGUSTO_TEMPERATURE_DERATE_MIN      30       // percent left at and above full derating
+#define CLOCKGUSTO_TEMPERATURE_HYSTERESIS_Q    (2 * 4)
+
+static const char *TAG = "clockgusto temperature";
+
+// quarter degrees, written by the sampling task only, 32 bit stores are atomic on the esp32
+static volatile int32_t s_temperature_q = 0;
+static volatile bool s_valid = false;
+static volatile uint8_t s_derating = 100;
+static int32_t s_derate_temperature_q = 0;
+
+static uint8_t clockgusto_temperature_derate(int32_t temperature_q)
+{
+    if (temperature_q <= CLOCKGUSTO_TEMPERATURE_DERATE_START_Q)
+    {
+        return 100;
+    }
+    if (temperature_q >= CLOCKGUSTO_TEMPERATURE_DERATE_FULL_Q)
+    {
+        return CLOCKGUSTO_TEMPERATURE_DERATE_MIN;
+    }
+
+    int32_t span_q = CLOCKGUSTO_TEMPERATURE_DERATE_FULL_Q - CLOCKGUSTO_TEMPERATURE_DERATE_START_Q;
+    int32_t above_q = temperature_q - CLOCKGUSTO_TEMPERATURE_DERATE_START_Q;
+    return 100 - (100 - CLOCKGUSTO_TEMPERATURE_DERATE_MIN) * above_q / span_q;
+}
+
+static void clockgusto_temperature_task(void* arg)
+{
+    (void)arg;
+
+    while (true)
+    {
+        float celsius;
+        esp_err_t ret = rtc_ds3231_get_temperature(&celsius);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGW(TAG, "read failed: %s", esp_err_to_name(ret));
+            vTaskDelay(pdMS_TO_TICKS(CLOCKGUSTO_TEMPERATURE_RETRY_MS));
+            continue;
+        }
+
+        int32_t temperature_q = (int32_t)(celsius * 4.0f);
+        s_temperature_q = temperature_q;
+        s_valid = true;
+
+        // rising temperatures derate at once, falling ones only after the hysteresis band
+        if (temperature_q > s_derate_temperature_q)
+        {
+            s_derate_temperature_q = temperature_q;
+        }
+        else if (temperature_q < s_derate_temperature_q - CLOCKGUSTO_TEMPERATURE_HYSTERESIS_Q)
+        {
+            s_derate_temperature_q = temperature_q + CLOCKGUSTO_TEMPERATURE_HYSTERESIS_Q;
+        }
+
+        uint8_t derating = clockgusto_temperature_derate(s_derate_temperature_q);
+        if (derating != s_derating)
+        {
+            ESP_LOGI(TAG, "%.2f C, brightness limited to %u%%", celsius, derating);
+        }
+        s_derating = derating;
+
+        vTaskDelay(pdMS_TO_TICKS(CLOCKGUSTO_TEMPERATURE_PERIOD_MS));
+    }
+}
+
+esp_err_t clockgusto_temperature_start()
+{
+    if (xTaskCreate(clockgusto_temperature_task, "clockgusto temp", CLOCKGUSTO_TEMPERATURE_TASK_STACK,
+                    NULL, CLOCKGUSTO_TEMPERATURE_TASK_PRIORITY, NULL) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+bool clockgusto_temperature_get(float* celsius)
+{
+    *celsius = s_temperature_q / 4.0f;
+    return s_valid;
+}
+
+uint8_t clockgusto_temperature_get_derating()
+{
+    return s_derating;
+}
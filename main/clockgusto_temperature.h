@@ -0,0 +1,14 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Starts sampling the DS3231 sensor at its own 64 s conversion cadence. */
+esp_err_t clockgusto_temperature_start();
+
+/** Last sampled temperature. Served from the cache, never touches the I2C bus. */
+bool clockgusto_temperature_get(float* celsius);
+
+/** Brightness in percent the enclosure temperature allows, 100 while it is cool. */
+uint8_t clockgusto_temperature_get_derating();
@@ -0,0 +1,559 @@
+#include "clockgusto_time.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_sntp.h"
+#include "esp_timer.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "clockgusto_alarm.h"
+#include "clockgusto_calibration.h"
+#include "clockgusto_tz.h"
+#include "clockgusto_wifi.h"
+#include "rtc_ds3231.h"
+
+#define CLOCKGUSTO_TIME_NTP_SERVER             "pool.ntp.org"
+#define CLOCKGUSTO_TIME_TASK_STACK             3072
+#define CLOCKGUSTO_TIME_TASK_PRIORITY          (tskIDLE_PRIORITY + 2)
+#define CLOCKGUSTO_TIME_RTC_WRITE_LEAD_US      400      // start, address, register and seconds byte at 100 kHz plus the hop to the bus task
+#define CLOCKGUSTO_TIME_SPIN_WINDOW_US         500      // only the last stretch before a deadline is busy waited
+#define CLOCKGUSTO_TIME_EDGE_STEPS             5        // halvings of the coarse edge window, one rtc second each
+#define CLOCKGUSTO_TIME_HOLDOVER_INTERVAL_S    3600
+#define CLOCKGUSTO_TIME_RTC_RETRY_INTERVAL_S   60       // while the rtc does not answer
+#define CLOCKGUSTO_TIME_HOLDOVER_THRESHOLD_US  100000
+#define CLOCKGUSTO_TIME_RTC_TOLERANCE_US       50000    // rtc is only rewritten beyond this offset
+#define CLOCKGUSTO_TIME_DRIFT_LIMIT_US         1000000  // larger offsets are a wrong setting, not drift
+#define CLOCKGUSTO_TIME_NOTIFY_REFERENCE       BIT0     // a reference arrived, measure and follow it
+#define CLOCKGUSTO_TIME_NOTIFY_MANUAL          BIT1     // a person set the clock, write it to the rtc
+#define CLOCKGUSTO_TIME_SNTP_ERROR_US          20000    // lwIP sntp takes no round trip, half a slow WLAN one
+#define CLOCKGUSTO_TIME_XTAL_DRIFT_PPB         20000    // ESP32 crystal over temperature, free run between syncs
+#define CLOCKGUSTO_TIME_RTC_DRIFT_PPB          2000     // DS3231 from 0 to 40 C, holdover
+
+static const char *TAG = "clockgusto time";
+
+static TaskHandle_t s_time_task = NULL;
+static bool s_sntp_started = false;
+static volatile bool s_synced = false;
+static volatile int64_t s_last_sync_us = 0;
+static volatile uint32_t s_source_error_us = 0;     // what the last reference itself may be off by
+static volatile bool s_rtc_ok = true;
+static bool s_seeded = false;
+static bool s_rtc_valid = false;        // the rtc holds a time that was written, not its reset value
+static uint32_t s_rtc_failures = 0;
+static esp_timer_handle_t s_wake_timer = NULL;
+static SemaphoreHandle_t s_wake = NULL;
+
+static int64_t clockgusto_time_system_us()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+/** System time plus whatever adjtime() has not slewed in yet, i.e. the last reference carried forward. */
+static int64_t clockgusto_time_reference_us()
+{
+    struct timeval pending = { 0 };
+    adjtime(NULL, &pending);
+
+    return clockgusto_time_system_us() + (int64_t)pending.tv_sec * 1000000 + pending.tv_usec;
+}
+
+/** Slews the system clock by offset_us, stepping only when adjtime() refuses the offset as too large. */
+static void clockgusto_time_correct(int64_t offset_us)
+{
+    struct timeval delta = {
+        .tv_sec = offset_us / 1000000,
+        .tv_usec = offset_us % 1000000,
+    };
+    if (adjtime(&delta, NULL) != 0)
+    {
+        int64_t corrected_us = clockgusto_time_system_us() + offset_us;
+        struct timeval now = {
+            .tv_sec = corrected_us / 1000000,
+            .tv_usec = corrected_us % 1000000,
+        };
+        settimeofday(&now, NULL);
+    }
+}
+
+static void clockgusto_time_sync_notification(struct timeval* tv)
+{
+    (void)tv;
+    s_synced = true;
+    s_seeded = true;
+    s_last_sync_us = esp_timer_get_time();
+    s_source_error_us = CLOCKGUSTO_TIME_SNTP_ERROR_US;
+    ESP_LOGI(TAG, "sntp sync, accuracy %ld ms", (long)clockgusto_time_get_accuracy_ms());
+    // the first sync steps from 1970 or from a stale rtc, the alarms were worked out on that date
+    clockgusto_alarm_rearm();
+
+    if (s_time_task)
+    {
+        xTaskNotify(s_time_task, CLOCKGUSTO_TIME_NOTIFY_REFERENCE, eSetBits);
+    }
+}
+
+static esp_err_t clockgusto_time_note_rtc(esp_err_t ret)
+{
+    if (ret != ESP_OK)
+    {
+        s_rtc_failures++;
+    }
+    if (s_rtc_ok != (ret == ESP_OK))
+    {
+        ESP_LOGW(TAG, "rtc %s", ret == ESP_OK ? "back" : esp_err_to_name(ret));
+    }
+    s_rtc_ok = ret == ESP_OK;
+
+    return ret;
+}
+
+/** The system clock survives a software reset, so without the rtc it keeps the last known time. A
+ *  DS3231 that lost its backup supply counts from its reset value with the oscillator stop flag set;
+ *  the flag stays until a real time was written back, so the next boot does not trust it either. */
+static esp_err_t clockgusto_time_seed()
+{
+    bool stopped = false;
+    esp_err_t ret = clockgusto_time_note_rtc(rtc_ds3231_get_oscillator_stopped(&stopped));
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    if (stopped)
+    {
+        s_rtc_valid = false;
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    struct tm rtc_time;
+    ret = clockgusto_time_note_rtc(rtc_ds3231_get_datetime(&rtc_time));
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    struct timeval now = {
+        .tv_sec = clockgusto_tz_make_utc(&rtc_time),
+        .tv_usec = 0,
+    };
+    settimeofday(&now, NULL);
+    s_seeded = true;
+    s_rtc_valid = true;
+
+    return ESP_OK;
+}
+
+static void clockgusto_time_wake(void* arg)
+{
+    (void)arg;
+    xSemaphoreGive(s_wake);
+}
+
+/** Blocks until until_us on the esp_timer time line. Whole ticks go to vTaskDelay, the rest of the
+ *  way to a one-shot timer, and only the last CLOCKGUSTO_TIME_SPIN_WINDOW_US are busy waited, so the
+ *  render loop below keeps its frames. */
+static void clockgusto_time_sleep_until(int64_t until_us)
+{
+    int64_t sleep_us = until_us - CLOCKGUSTO_TIME_SPIN_WINDOW_US - esp_timer_get_time();
+    TickType_t ticks = sleep_us > 0 ? (TickType_t)(sleep_us / (portTICK_PERIOD_MS * 1000)) : 0;
+    if (ticks > 0)
+    {
+        vTaskDelay(ticks);
+    }
+
+    sleep_us = until_us - CLOCKGUSTO_TIME_SPIN_WINDOW_US - esp_timer_get_time();
+    if (sleep_us > 0 && esp_timer_start_once(s_wake_timer, (uint64_t)sleep_us) == ESP_OK)
+    {
+        xSemaphoreTake(s_wake, pdMS_TO_TICKS(sleep_us / 1000) + 2);
+    }
+    while (esp_timer_get_time() < until_us)
+    {
+    }
+}
+
+/** Writes the reference time into the DS3231 so the burst lands on a second boundary. Writing the
+ *  seconds register restarts the DS3231 countdown, so the RTC phase follows the reference exactly. */
+static esp_err_t clockgusto_time_write_rtc_aligned()
+{
+    int64_t now_us = clockgusto_time_reference_us();
+    int64_t target_us = (now_us / 1000000 + 1) * 1000000;
+    if (target_us - now_us < CLOCKGUSTO_TIME_RTC_WRITE_LEAD_US + 1000)
+    {
+        target_us += 1000000;
+    }
+
+    // the slew moves the reference line by microseconds over the wait, so the timer line serves
+    clockgusto_time_sleep_until(esp_timer_get_time() + (target_us - now_us) - CLOCKGUSTO_TIME_RTC_WRITE_LEAD_US);
+
+    time_t target_sec = (time_t)(target_us / 1000000);
+    struct tm target_time;
+    gmtime_r(&target_sec, &target_time);
+
+    esp_err_t ret = clockgusto_time_note_rtc(rtc_ds3231_set_datetime(&target_time));
+    if (ret == ESP_OK && !s_rtc_valid)
+    {
+        ret = clockgusto_time_note_rtc(rtc_ds3231_clear_oscillator_stopped());
+        s_rtc_valid = ret == ESP_OK;
+    }
+
+    return ret;
+}
+
+/** Reads the rtc and stamps the read with the middle of the transfer on the esp_timer time line. */
+static esp_err_t clockgusto_time_read_rtc(struct tm* rtc_time, int64_t* read_us)
+{
+    int64_t before_us = esp_timer_get_time();
+    esp_err_t ret = rtc_ds3231_get_datetime(rtc_time);
+    *read_us = (before_us + esp_timer_get_time()) / 2;
+
+    return ret;
+}
+
+/** Locates a DS3231 seconds edge on the system time line without busy polling the bus. The first
+ *  pass brackets the edge between two reads a tick apart. Each following second one read at the
+ *  middle of the bracket halves it, so CLOCKGUSTO_TIME_EDGE_STEPS seconds later the edge is known
+ *  to well under a millisecond. *rtc_s is the second that began at *edge_us. */
+static esp_err_t clockgusto_time_sample_rtc_edge(time_t* rtc_s, int64_t* edge_us)
+{
+    struct tm sample;
+    int64_t read_us;
+    esp_err_t ret = clockgusto_time_read_rtc(&sample, &read_us);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    int first_sec = sample.tm_sec;
+    int64_t before_us = read_us;        // last read that still showed the old second
+    int64_t after_us = 0;               // first read that showed the new one
+    for (uint8_t poll = 0; poll < 120 && after_us == 0; ++poll)
+    {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        ret = clockgusto_time_read_rtc(&sample, &read_us);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+        if (sample.tm_sec != first_sec)
+        {
+            after_us = read_us;
+            first_sec = sample.tm_sec;
+            *rtc_s = clockgusto_tz_make_utc(&sample);
+        }
+        else
+        {
+            before_us = read_us;
+        }
+    }
+    if (after_us == 0)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    for (uint8_t step = 1; step <= CLOCKGUSTO_TIME_EDGE_STEPS; ++step)
+    {
+        // the same edge one second on, probed in the middle of what is left of the bracket
+        before_us += 1000000;
+        after_us += 1000000;
+        clockgusto_time_sleep_until((before_us + after_us) / 2);
+        ret = clockgusto_time_read_rtc(&sample, &read_us);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+        if (sample.tm_sec == (first_sec + step) % 60)
+        {
+            after_us = read_us < after_us ? read_us : after_us;
+        }
+        else
+        {
+            before_us = read_us > before_us ? read_us : before_us;
+        }
+    }
+
+    *rtc_s += CLOCKGUSTO_TIME_EDGE_STEPS;
+    *edge_us = (before_us + after_us) / 2 + (clockgusto_time_system_us() - esp_timer_get_time());
+    return ESP_OK;
+}
+
+/** Offset of the DS3231 against the system clock, positive when the rtc is ahead. */
+static esp_err_t clockgusto_time_measure_rtc(int64_t* offset_us)
+{
+    time_t rtc_s;
+    int64_t edge_us;
+    esp_err_t ret = clockgusto_time_note_rtc(clockgusto_time_sample_rtc_edge(&rtc_s, &edge_us));
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    *offset_us = (int64_t)rtc_s * 1000000 - edge_us;
+    return ESP_OK;
+}
+
+/** Without a network reference the DS3231 is the better oscillator, so the system clock is slewed
+ *  towards it. */
+static void clockgusto_time_holdover()
+{
+    if (!s_seeded)
+    {
+        clockgusto_time_seed();
+        return;
+    }
+    if (!s_rtc_valid)
+    {
+        // nothing to hold over to, the next reference writes the rtc
+        return;
+    }
+
+    int64_t offset_us;
+    esp_err_t ret = clockgusto_time_measure_rtc(&offset_us);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "rtc sample failed: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    if (llabs(offset_us) < CLOCKGUSTO_TIME_HOLDOVER_THRESHOLD_US)
+    {
+        return;
+    }
+
+    clockgusto_time_correct(offset_us);
+    ESP_LOGI(TAG, "holdover, system clock corrected by %lld ms towards rtc", offset_us / 1000);
+}
+
+/** Measures the rtc against a fresh reference for the drift calibration and only rewrites the rtc
+ *  once it is off by more than the tolerance, so drift can accumulate over days between writes. */
+static void clockgusto_time_reference_update()
+{
+    int64_t offset_us;
+    esp_err_t ret = s_rtc_valid ? clockgusto_time_measure_rtc(&offset_us) : ESP_ERR_INVALID_STATE;
+    if (ret == ESP_OK)
+    {
+        struct timeval pending = { 0 };
+        adjtime(NULL, &pending);
+        offset_us -= (int64_t)pending.tv_sec * 1000000 + pending.tv_usec;
+
+        if (llabs(offset_us) < CLOCKGUSTO_TIME_DRIFT_LIMIT_US)
+        {
+            clockgusto_calibration_add_sample((uint32_t)(clockgusto_time_reference_us() / 1000000), offset_us);
+        }
+        if (llabs(offset_us) < CLOCKGUSTO_TIME_RTC_TOLERANCE_US)
+        {
+            return;
+        }
+    }
+
+    esp_err_t write_ret = clockgusto_time_write_rtc_aligned();
+    if (write_ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "rtc write failed: %s", esp_err_to_name(write_ret));
+        return;
+    }
+
+    if (ret == ESP_OK && llabs(offset_us) < CLOCKGUSTO_TIME_DRIFT_LIMIT_US)
+    {
+        clockgusto_calibration_note_rtc_step(-offset_us);
+    }
+    else
+    {
+        clockgusto_calibration_discard();
+    }
+}
+
+static bool clockgusto_time_reference_fresh()
+{
+    return s_synced &&
+           esp_timer_get_time() - s_last_sync_us <= 2LL * clockgusto_calibration_get_sync_interval_s() * 1000000;
+}
+
+static void clockgusto_time_task(void* arg)
+{
+    (void)arg;
+    TickType_t wait = 0;
+
+    while (true)
+    {
+        uint32_t notified = 0;
+        if (xTaskNotifyWait(0, UINT32_MAX, &notified, wait) == pdPASS)
+        {
+            if (notified & CLOCKGUSTO_TIME_NOTIFY_MANUAL)
+            {
+                // the rtc jumps by an unknown amount, and a typed in time is no sample for the fit
+                esp_err_t ret = clockgusto_time_write_rtc_aligned();
+                if (ret != ESP_OK)
+                {
+                    ESP_LOGW(TAG, "rtc write failed: %s", esp_err_to_name(ret));
+                }
+                clockgusto_calibration_discard();
+            }
+            if (notified & CLOCKGUSTO_TIME_NOTIFY_REFERENCE)
+            {
+                clockgusto_time_reference_update();
+                sntp_set_sync_interval(clockgusto_calibration_get_sync_interval_s() * 1000);
+            }
+        }
+        else if (!clockgusto_time_reference_fresh())
+        {
+            clockgusto_time_holdover();
+        }
+
+        wait = pdMS_TO_TICKS((s_rtc_ok ? CLOCKGUSTO_TIME_HOLDOVER_INTERVAL_S : CLOCKGUSTO_TIME_RTC_RETRY_INTERVAL_S) * 1000);
+    }
+}
+
+static void clockgusto_time_network_handler(void* arg, esp_event_base_t event_base, int32_t event_id,
+                                            void* event_data)
+{
+    clockgusto_time_start_sntp();
+}
+
+esp_err_t clockgusto_time_init()
+{
+    esp_err_t ret = clockgusto_time_seed();
+    if (ret == ESP_ERR_INVALID_STATE)
+    {
+        ESP_LOGW(TAG, "rtc lost its time, waiting for a time source");
+    }
+    else if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "rtc unreadable, keeping the last known time until it answers");
+    }
+
+    s_wake = xSemaphoreCreateBinary();
+    esp_timer_create_args_t wake_args = {
+        .callback = clockgusto_time_wake,
+        .name = "clockgusto time wake",
+    };
+    if (!s_wake || esp_timer_create(&wake_args, &s_wake_timer) != ESP_OK)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreate(clockgusto_time_task, "clockgusto time", CLOCKGUSTO_TIME_TASK_STACK,
+                    NULL, CLOCKGUSTO_TIME_TASK_PRIORITY, &s_time_task) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return esp_event_handler_register(CLOCKGUSTO_NET_EVENT, CLOCKGUSTO_NET_EVENT_UP,
+                                      clockgusto_time_network_handler, NULL);
+}
+
+void clockgusto_time_start_sntp()
+{
+    if (s_sntp_started)
+    {
+        return;
+    }
+    s_sntp_started = true;
+
+    /* Smooth mode hands small offsets to adjtime(), so the displayed minute is slewed and never
+     * jumps or repeats. Only offsets adjtime() refuses fall back to a step. */
+    esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, CLOCKGUSTO_TIME_NTP_SERVER);
+    sntp_set_sync_interval(clockgusto_calibration_get_sync_interval_s() * 1000);
+    sntp_set_sync_mode(SNTP_SYNC_MODE_SMOOTH);
+    sntp_set_time_sync_notification_cb(clockgusto_time_sync_notification);
+    esp_sntp_init();
+    ESP_LOGI(TAG, "sntp started with %s", CLOCKGUSTO_TIME_NTP_SERVER);
+}
+
+void clockgusto_time_set_reference(time_t reference_s, int64_t timer_us, uint32_t error_us)
+{
+    int64_t system_us = clockgusto_time_system_us() - (esp_timer_get_time() - timer_us);
+    int64_t offset_us = (int64_t)reference_s * 1000000 - system_us;
+
+    clockgusto_time_correct(offset_us);
+
+    s_synced = true;
+    s_seeded = true;
+    s_last_sync_us = esp_timer_get_time();
+    s_source_error_us = error_us;
+    ESP_LOGI(TAG, "reference sync, offset %lld ms", offset_us / 1000);
+    clockgusto_alarm_rearm();
+
+    if (s_time_task)
+    {
+        xTaskNotify(s_time_task, CLOCKGUSTO_TIME_NOTIFY_REFERENCE, eSetBits);
+    }
+}
+
+void clockgusto_time_set_manual(int64_t utc_us, int64_t timer_us)
+{
+    int64_t now_us = utc_us + (esp_timer_get_time() - timer_us);
+    struct timeval now = {
+        .tv_sec = now_us / 1000000,
+        .tv_usec = now_us % 1000000,
+    };
+    // a step, which also drops a pending slew
+    settimeofday(&now, NULL);
+    s_seeded = true;
+    ESP_LOGI(TAG, "manual set");
+    clockgusto_alarm_rearm();
+
+    if (s_time_task)
+    {
+        xTaskNotify(s_time_task, CLOCKGUSTO_TIME_NOTIFY_MANUAL, eSetBits);
+    }
+}
+
+bool clockgusto_time_is_synced()
+{
+    return s_synced;
+}
+
+int32_t clockgusto_time_get_accuracy_ms()
+{
+    if (!s_synced)
+    {
+        return -1;
+    }
+
+    struct timeval pending = { 0 };
+    adjtime(NULL, &pending);
+    int64_t error_us = s_source_error_us + llabs((int64_t)pending.tv_sec * 1000000 + pending.tv_usec);
+
+    int64_t elapsed_s = (esp_timer_get_time() - s_last_sync_us) / 1000000;
+    if (clockgusto_time_reference_fresh())
+    {
+        // between syncs the system clock runs free on the crystal
+        error_us += elapsed_s * CLOCKGUSTO_TIME_XTAL_DRIFT_PPB / 1000;
+    }
+    else
+    {
+        // then it follows the rtc, which was left within its tolerance of the last reference
+        error_us += CLOCKGUSTO_TIME_RTC_TOLERANCE_US + CLOCKGUSTO_TIME_HOLDOVER_THRESHOLD_US +
+                    elapsed_s * CLOCKGUSTO_TIME_RTC_DRIFT_PPB / 1000;
+    }
+
+    return (int32_t)(error_us / 1000 < INT32_MAX ? error_us / 1000 : INT32_MAX);
+}
+
+void clockgusto_time_get_local(struct tm* local_time)
+{
+    clockgusto_tz_to_local(time(NULL), local_time);
+}
+
+void clockgusto_time_get_local_hms(uint8_t* hours, uint8_t* minutes, uint8_t* seconds)
+{
+    clockgusto_tz_to_local_hms(time(NULL), hours, minutes, seconds);
+}
+
+bool clockgusto_time_is_degraded()
+{
+    return !s_rtc_ok && !clockgusto_time_reference_fresh();
+}
+
+uint32_t clockgusto_time_get_rtc_failures()
+{
+    return s_rtc_failures;
+}
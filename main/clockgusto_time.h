@@ -0,0 +1,45 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/** Seeds the system clock from the DS3231, which holds UTC, and starts the time keeping task. An
+ *  unreadable rtc is not fatal, the task keeps trying while the clock runs on. SNTP starts on the
+ *  first CLOCKGUSTO_NET_EVENT_UP, so the default event loop has to exist. */
+esp_err_t clockgusto_time_init();
+
+/** Starts SNTP in smooth mode. Safe to call on every IP acquisition. */
+void clockgusto_time_start_sntp();
+
+/** Hands over a reference from a local time source such as DCF77: reference_s began at timer_us on
+ *  the esp_timer time line, give or take error_us. Small offsets are slewed, the rtc follows on the
+ *  time task. */
+void clockgusto_time_set_reference(time_t reference_s, int64_t timer_us, uint32_t error_us);
+
+/** Takes a time a person or a host tool set, utc_us at timer_us on the esp_timer time line. The
+ *  clock steps to it and the time task writes it to the rtc, but it is no reference: the clock does
+ *  not count as synced, and the drift fit starts over instead of taking it as a sample. */
+void clockgusto_time_set_manual(int64_t utc_us, int64_t timer_us);
+
+/** */
+bool clockgusto_time_is_synced();
+
+/** Bound on the error of the system clock in ms, or -1 before the first sync: the last reference's
+ *  own error, the correction still pending and the drift allowed since, the crystal's while the
+ *  reference is fresh, the DS3231's and its tolerances in holdover. */
+int32_t clockgusto_time_get_accuracy_ms();
+
+/** Local wall time of the disciplined system clock. Never touches the I2C bus. */
+void clockgusto_time_get_local(struct tm* local_time);
+
+/** Local time of day for the frame loop, a table lookup instead of a calendar computation. */
+void clockgusto_time_get_local_hms(uint8_t* hours, uint8_t* minutes, uint8_t* seconds);
+
+/** No trustworthy source: the rtc does not answer and no reference arrived lately. The system clock
+ *  still runs from the last known time. */
+bool clockgusto_time_is_degraded();
+
+/** */
+uint32_t clockgusto_time_get_rtc_failures();
@@ -0,0 +1,226 @@
+#include "clockgusto_tz.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "clockgusto_tz_table.h"
+
+#define CLOCKGUSTO_TZ_NVS_NAMESPACE "tz"
+#define CLOCKGUSTO_TZ_NVS_KEY       "rule"
+#define CLOCKGUSTO_TZ_YEARS         (CLOCKGUSTO_TZ_TABLE_LAST_YEAR - CLOCKGUSTO_TZ_TABLE_FIRST_YEAR + 1)
+#define CLOCKGUSTO_TZ_MAX_OFFSET_MIN (14 * 60)  // Kiribati, the farthest any zone is from UTC
+
+static const char *TAG = "clockgusto tz";
+
+static const clockgusto_tz_rule_t clockgusto_tz_berlin = {
+    .std_offset_min = 60,
+    .dst_offset_min = 120,
+    .dst_start = { .month = 3, .week = 5, .wday = 0, .minute = 2 * 60 },
+    .dst_end = { .month = 10, .week = 5, .wday = 0, .minute = 3 * 60 },
+};
+
+/** A rule and its table. The live one only changes under s_lock and all at once, so the render task
+ *  never searches a table that is half built or belongs to another rule. */
+typedef struct _clockgusto_tz_zone_t
+{
+    clockgusto_tz_rule_t rule;
+    const uint32_t* transitions;
+    uint16_t transition_count;
+    bool first_is_start;
+} clockgusto_tz_zone_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_custom_transitions[2 * CLOCKGUSTO_TZ_YEARS];
+static clockgusto_tz_zone_t s_zone = {
+    .rule = clockgusto_tz_berlin,
+    .transitions = clockgusto_tz_berlin_transitions,
+    .transition_count = sizeof(clockgusto_tz_berlin_transitions) / sizeof(uint32_t),
+    .first_is_start = true,
+};
+
+static int32_t clockgusto_tz_days_from_civil(int32_t year, uint32_t month, uint32_t mday)
+{
+    year -= month <= 2;
+    int32_t era = (year >= 0 ? year : year - 399) / 400;
+    uint32_t yoe = (uint32_t)(year - era * 400);
+    uint32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + mday - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + (int32_t)doe - 719468;
+}
+
+static uint32_t clockgusto_tz_switch_instant(int32_t year, const clockgusto_tz_switch_t* sw, int16_t offset_before_min)
+{
+    static const uint8_t month_days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    uint8_t days_in_month = month_days[sw->month - 1] + (sw->month == 2 && leap);
+
+    int32_t first = clockgusto_tz_days_from_civil(year, sw->month, 1);
+    uint8_t first_wday = (uint8_t)((first % 7 + 11) % 7);  // 1970-01-01 was a thursday
+    uint32_t mday = 1 + (sw->wday + 7 - first_wday) % 7 + 7 * (sw->week - 1);
+    while (mday > days_in_month)
+    {
+        mday -= 7;
+    }
+
+    int64_t local_s = (int64_t)(first + mday - 1) * 86400 + sw->minute * 60;
+    return (uint32_t)(local_s - offset_before_min * 60);
+}
+
+/** Expands rule into a scratch table, then swaps it in under the lock. Returns the transition count. */
+static uint16_t clockgusto_tz_build(const clockgusto_tz_rule_t* rule)
+{
+    clockgusto_tz_zone_t zone = {
+        .rule = *rule,
+        .transitions = clockgusto_tz_berlin_transitions,
+        .transition_count = sizeof(clockgusto_tz_berlin_transitions) / sizeof(uint32_t),
+        .first_is_start = true,
+    };
+    uint32_t scratch[2 * CLOCKGUSTO_TZ_YEARS];
+    bool custom = memcmp(rule, &clockgusto_tz_berlin, sizeof(*rule)) != 0;
+    if (custom)
+    {
+        zone.transitions = s_custom_transitions;
+        zone.transition_count = 0;
+        for (int32_t year = CLOCKGUSTO_TZ_TABLE_FIRST_YEAR;
+             rule->std_offset_min != rule->dst_offset_min && year <= CLOCKGUSTO_TZ_TABLE_LAST_YEAR; ++year)
+        {
+            uint32_t start = clockgusto_tz_switch_instant(year, &rule->dst_start, rule->std_offset_min);
+            uint32_t end = clockgusto_tz_switch_instant(year, &rule->dst_end, rule->dst_offset_min);
+
+            // southern zones end DST early in the year and start it late
+            zone.first_is_start = start < end;
+            scratch[zone.transition_count++] = zone.first_is_start ? start : end;
+            scratch[zone.transition_count++] = zone.first_is_start ? end : start;
+        }
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    if (custom)
+    {
+        memcpy(s_custom_transitions, scratch, zone.transition_count * sizeof(uint32_t));
+    }
+    s_zone = zone;
+    portEXIT_CRITICAL(&s_lock);
+
+    return zone.transition_count;
+}
+
+esp_err_t clockgusto_tz_init()
+{
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(CLOCKGUSTO_TZ_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (ret != ESP_OK)
+    {
+        // nothing stored yet, the default table stays
+        return ESP_OK;
+    }
+
+    clockgusto_tz_rule_t rule;
+    size_t size = sizeof(rule);
+    ret = nvs_get_blob(handle, CLOCKGUSTO_TZ_NVS_KEY, &rule, &size);
+    nvs_close(handle);
+    if (ret == ESP_OK && size == sizeof(rule))
+    {
+        uint16_t transition_count = clockgusto_tz_build(&rule);
+        ESP_LOGI(TAG, "rule utc%+d/%+d, %u transitions", rule.std_offset_min, rule.dst_offset_min, transition_count);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t clockgusto_tz_set_rule(const clockgusto_tz_rule_t* rule)
+{
+    if (rule->std_offset_min < -CLOCKGUSTO_TZ_MAX_OFFSET_MIN || rule->std_offset_min > CLOCKGUSTO_TZ_MAX_OFFSET_MIN ||
+        rule->dst_offset_min < -CLOCKGUSTO_TZ_MAX_OFFSET_MIN || rule->dst_offset_min > CLOCKGUSTO_TZ_MAX_OFFSET_MIN)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const clockgusto_tz_switch_t* switches[] = { &rule->dst_start, &rule->dst_end };
+    for (uint8_t idx = 0; idx < 2; ++idx)
+    {
+        if (switches[idx]->month < 1 || switches[idx]->month > 12 || switches[idx]->week < 1 ||
+            switches[idx]->week > 5 || switches[idx]->wday > 6 || switches[idx]->minute >= 48 * 60)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    clockgusto_tz_build(rule);
+
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(CLOCKGUSTO_TZ_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    ret = nvs_set_blob(handle, CLOCKGUSTO_TZ_NVS_KEY, rule, sizeof(*rule));
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    return ret;
+}
+
+void clockgusto_tz_get_rule(clockgusto_tz_rule_t* rule)
+{
+    portENTER_CRITICAL(&s_lock);
+    *rule = s_zone.rule;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+int32_t clockgusto_tz_get_offset_s(time_t utc)
+{
+    // the search stays under the lock, eight comparisons at most, so the table cannot change under it
+    portENTER_CRITICAL(&s_lock);
+    uint16_t low = 0;
+    uint16_t high = s_zone.transition_count;
+    while (low < high)
+    {
+        uint16_t mid = (low + high) / 2;
+        if ((int64_t)s_zone.transitions[mid] <= (int64_t)utc)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    // low is the number of transitions at or before utc, a southern zone begins the table in the
+    // summer that started the year before
+    bool dst = s_zone.first_is_start ? (low % 2 == 1) : (s_zone.transition_count > 0 && low % 2 == 0);
+    int32_t offset_s = (dst ? s_zone.rule.dst_offset_min : s_zone.rule.std_offset_min) * 60;
+    portEXIT_CRITICAL(&s_lock);
+
+    return offset_s;
+}
+
+void clockgusto_tz_to_local_hms(time_t utc, uint8_t* hours, uint8_t* minutes, uint8_t* seconds)
+{
+    int64_t local = (int64_t)utc + clockgusto_tz_get_offset_s(utc);
+    int32_t second_of_day = (int32_t)(((local % 86400) + 86400) % 86400);
+
+    *hours = second_of_day / 3600;
+    *minutes = (second_of_day / 60) % 60;
+    *seconds = second_of_day % 60;
+}
+
+void clockgusto_tz_to_local(time_t utc, struct tm* local_time)
+{
+    time_t local = utc + clockgusto_tz_get_offset_s(utc);
+    gmtime_r(&local, local_time);
+}
+
+time_t clockgusto_tz_make_utc(const struct tm* utc_time)
+{
+    int32_t days = clockgusto_tz_days_from_civil(1900 + utc_time->tm_year, utc_time->tm_mon + 1, 1) + utc_time->tm_mday - 1;
+    return (time_t)days * 86400 + utc_time->tm_hour * 3600 + utc_time->tm_min * 60 + utc_time->tm_sec;
+}
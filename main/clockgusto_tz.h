@@ -0,0 +1,45 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/** One DST switch in POSIX TZ terms: the week-th wday of month (week 5 is the last one) at minute
+ *  of the local time in force before the switch. */
+typedef struct _clockgusto_tz_switch_t
+{
+    uint8_t month;          // 1 .. 12
+    uint8_t week;           // 1 .. 5
+    uint8_t wday;           // 0 sunday .. 6 saturday
+    uint16_t minute;        // minutes after local midnight
+} clockgusto_tz_switch_t;
+
+typedef struct _clockgusto_tz_rule_t
+{
+    int16_t std_offset_min; // east of UTC
+    int16_t dst_offset_min; // equal to std_offset_min for zones without DST
+    clockgusto_tz_switch_t dst_start;
+    clockgusto_tz_switch_t dst_end;
+} clockgusto_tz_rule_t;
+
+/** Loads a configured rule from NVS, otherwise the Europe/Berlin table in flash stays in use. */
+esp_err_t clockgusto_tz_init();
+
+/** Expands rule into a transition table once and persists it. */
+esp_err_t clockgusto_tz_set_rule(const clockgusto_tz_rule_t* rule);
+
+/** */
+void clockgusto_tz_get_rule(clockgusto_tz_rule_t* rule);
+
+/** UTC offset in force at utc, a binary search over the transition table. */
+int32_t clockgusto_tz_get_offset_s(time_t utc);
+
+/** Local hours, minutes and seconds without a calendar computation. */
+void clockgusto_tz_to_local_hms(time_t utc, uint8_t* hours, uint8_t* minutes, uint8_t* seconds);
+
+/** Full local calendar time, for consumers that need the date. */
+void clockgusto_tz_to_local(time_t utc, struct tm* local_time);
+
+/** UTC counterpart of timegm(), newlib does not provide one. */
+time_t clockgusto_tz_make_utc(const struct tm* utc_time);
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Generated by tools/gen_tz_table.py, do not edit. */
+
+#define CLOCKGUSTO_TZ_TABLE_FIRST_YEAR 2025
+#define CLOCKGUSTO_TZ_TABLE_LAST_YEAR  2099
+
+/** Europe/Berlin, UTC seconds of every switch, CEST begins on even and ends on odd entries. */
+static const uint32_t clockgusto_tz_berlin_transitions[] = {
+    1743296400u, 1761440400u, // 2025
+    1774746000u, 1792890000u, // 2026
+    1806195600u, 1824944400u, // 2027
+    1837645200u, 1856394000u, // 2028
+    1869094800u, 1887843600u, // 2029
+    1901149200u, 1919293200u, // 2030
+    1932598800u, 1950742800u, // 2031
+    1964048400u, 1982797200u, // 2032
+    1995498000u, 2014246800u, // 2033
+    2026947600u, 2045696400u, // 2034
+    2058397200u, 2077146000u, // 2035
+    2090451600u, 2108595600u, // 2036
+    2121901200u, 2140045200u, // 2037
+    2153350800u, 2172099600u, // 2038
+    2184800400u, 2203549200u, // 2039
+    2216250000u, 2234998800u, // 2040
+    2248304400u, 2266448400u, // 2041
+    2279754000u, 2297898000u, // 2042
+    2311203600u, 2329347600u, // 2043
+    2342653200u, 2361402000u, // 2044
+    2374102800u, 2392851600u, // 2045
+    2405552400u, 2424301200u, // 2046
+    2437606800u, 2455750800u, // 2047
+    2469056400u, 2487200400u, // 2048
+    2500506000u, 2519254800u, // 2049
+    2531955600u, 2550704400u, // 2050
+    2563405200u, 2582154000u, // 2051
+    2595459600u, 2613603600u, // 2052
+    2626909200u, 2645053200u, // 2053
+    2658358800u, 2676502800u, // 2054
+    2689808400u, 2708557200u, // 2055
+    2721258000u, 2740006800u, // 2056
+    2752707600u, 2771456400u, // 2057
+    2784762000u, 2802906000u, // 2058
+    2816211600u, 2834355600u, // 2059
+    2847661200u, 2866410000u, // 2060
+    2879110800u, 2897859600u, // 2061
+    2910560400u, 2929309200u, // 2062
+    2942010000u, 2960758800u, // 2063
+    2974064400u, 2992208400u, // 2064
+    3005514000u, 3023658000u, // 2065
+    3036963600u, 3055712400u, // 2066
+    3068413200u, 3087162000u, // 2067
+    3099862800u, 3118611600u, // 2068
+    3131917200u, 3150061200u, // 2069
+    3163366800u, 3181510800u, // 2070
+    3194816400u, 3212960400u, // 2071
+    3226266000u, 3245014800u, // 2072
+    3257715600u, 3276464400u, // 2073
+    3289165200u, 3307914000u, // 2074
+    3321219600u, 3339363600u, // 2075
+    3352669200u, 3370813200u, // 2076
+    3384118800u, 3402867600u, // 2077
+    3415568400u, 3434317200u, // 2078
+    3447018000u, 3465766800u, // 2079
+    3479072400u, 3497216400u, // 2080
+    3510522000u, 3528666000u, // 2081
+    3541971600u, 3560115600u, // 2082
+    3573421200u, 3592170000u, // 2083
+    3604870800u, 3623619600u, // 2084
+    3636320400u, 3655069200u, // 2085
+    3668374800u, 3686518800u, // 2086
+    3699824400u, 3717968400u, // 2087
+    3731274000u, 3750022800u, // 2088
+    3762723600u, 3781472400u, // 2089
+    3794173200u, 3812922000u, // 2090
+    3825622800u, 3844371600u, // 2091
+    3857677200u, 3875821200u, // 2092
+    3889126800u, 3907270800u, // 2093
+    3920576400u, 3939325200u, // 2094
+    3952026000u, 3970774800u, // 2095
+    3983475600u, 4002224400u, // 2096
+    4015530000u, 4033674000u, // 2097
+    4046979600u, 4065123600u, // 2098
+    4078429200u, 4096573200u, // 2099
+};
@@ -0,0 +1,195 @@
+#include "clockgusto_webui.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CLOCKGUSTO_WEBUI_MAGIC          "CGUI"
+#define CLOCKGUSTO_WEBUI_VERSION        1
+#define CLOCKGUSTO_WEBUI_PATH_SIZE      44
+#define CLOCKGUSTO_WEBUI_TYPE_SIZE      24
+#define CLOCKGUSTO_WEBUI_ETAG_SIZE      12      // quoted crc32 in hex
+#define CLOCKGUSTO_WEBUI_INDEX          "/index.html"
+
+static const char *TAG = "clockgusto webui";
+
+/** The layout tools/pack_webui.py writes, little endian like the chip. */
+typedef struct _clockgusto_webui_header_t
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t count;
+    uint32_t size;
+    uint32_t crc;
+} clockgusto_webui_header_t;
+
+typedef struct _clockgusto_webui_entry_t
+{
+    char path[CLOCKGUSTO_WEBUI_PATH_SIZE];
+    char content_type[CLOCKGUSTO_WEBUI_TYPE_SIZE];
+    uint32_t offset;
+    uint32_t length;
+    uint32_t crc;
+} clockgusto_webui_entry_t;
+
+static const uint8_t* s_image = NULL;
+static const clockgusto_webui_header_t* s_header = NULL;
+static const clockgusto_webui_entry_t* s_entries = NULL;
+static esp_partition_mmap_handle_t s_mmap_handle;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static clockgusto_webui_stats_t s_stats;
+
+/** Maps the partition for good. The mapping costs MMU pages, no RAM, and the image is checked once. */
+static esp_err_t clockgusto_webui_map()
+{
+    const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, CLOCKGUSTO_WEBUI_SUBTYPE,
+                                                                CLOCKGUSTO_WEBUI_PARTITION);
+    if (!partition)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const void* mapped = NULL;
+    esp_err_t ret = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &mapped,
+                                       &s_mmap_handle);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    const clockgusto_webui_header_t* header = mapped;
+    size_t entries_size = (size_t)header->count * sizeof(clockgusto_webui_entry_t);
+    if (memcmp(header->magic, CLOCKGUSTO_WEBUI_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CLOCKGUSTO_WEBUI_VERSION || header->size > partition->size ||
+        header->size < sizeof(*header) + entries_size ||
+        esp_rom_crc32_le(0, (const uint8_t*)mapped + sizeof(*header), header->size - sizeof(*header)) != header->crc)
+    {
+        esp_partition_munmap(s_mmap_handle);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    const clockgusto_webui_entry_t* entries = (const clockgusto_webui_entry_t*)(header + 1);
+    for (uint16_t idx = 0; idx < header->count; ++idx)
+    {
+        if (entries[idx].offset > header->size || entries[idx].length > header->size - entries[idx].offset)
+        {
+            esp_partition_munmap(s_mmap_handle);
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+
+    s_image = mapped;
+    s_header = header;
+    s_entries = entries;
+    ESP_LOGI(TAG, "%u files, %" PRIu32 " bytes", header->count, header->size);
+    return ESP_OK;
+}
+
+static const clockgusto_webui_entry_t* clockgusto_webui_find(const char* uri)
+{
+    size_t length = strcspn(uri, "?#");
+    if (length == 1 && uri[0] == '/')
+    {
+        uri = CLOCKGUSTO_WEBUI_INDEX;
+        length = strlen(CLOCKGUSTO_WEBUI_INDEX);
+    }
+
+    for (uint16_t idx = 0; idx < s_header->count; ++idx)
+    {
+        const char* path = s_entries[idx].path;
+        if (strnlen(path, CLOCKGUSTO_WEBUI_PATH_SIZE) == length && memcmp(path, uri, length) == 0)
+        {
+            return &s_entries[idx];
+        }
+    }
+
+    return NULL;
+}
+
+static esp_err_t clockgusto_webui_get(httpd_req_t* req)
+{
+    int64_t start_us = esp_timer_get_time();
+    uint32_t heap_before = esp_get_free_heap_size();
+
+    const clockgusto_webui_entry_t* entry = clockgusto_webui_find(req->uri);
+    if (!entry)
+    {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "not found");
+    }
+
+    // the crc of the gzipped file changes with every build that changes the file
+    char etag[CLOCKGUSTO_WEBUI_ETAG_SIZE];
+    snprintf(etag, sizeof(etag), "\"%08" PRIx32 "\"", entry->crc);
+    char if_none_match[CLOCKGUSTO_WEBUI_ETAG_SIZE];
+    bool not_modified = httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) ==
+                            ESP_OK &&
+                        strcmp(if_none_match, etag) == 0;
+
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");   // keep it, but ask first
+    esp_err_t ret;
+    if (not_modified)
+    {
+        httpd_resp_set_status(req, "304 Not Modified");
+        ret = httpd_resp_send(req, NULL, 0);
+    }
+    else
+    {
+        // the type strings live in flash too, the packer terminates them
+        httpd_resp_set_type(req, entry->content_type);
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+        ret = httpd_resp_send(req, (const char*)s_image + entry->offset, entry->length);
+    }
+
+    uint32_t response_us = (uint32_t)(esp_timer_get_time() - start_us);
+    int32_t heap_delta = (int32_t)(heap_before - esp_get_free_heap_size());
+    uint32_t stack_free = uxTaskGetStackHighWaterMark(NULL) * sizeof(StackType_t);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.requests++;
+    s_stats.not_modified += not_modified;
+    s_stats.bytes += not_modified ? 0 : entry->length;
+    s_stats.response_us = response_us;
+    s_stats.response_max_us = response_us > s_stats.response_max_us ? response_us : s_stats.response_max_us;
+    s_stats.heap_delta = heap_delta;
+    s_stats.stack_free = s_stats.requests == 1 || stack_free < s_stats.stack_free ? stack_free : s_stats.stack_free;
+    portEXIT_CRITICAL(&s_lock);
+
+    return ret;
+}
+
+static const httpd_uri_t s_uri = {
+    .uri = "/*",
+    .method = HTTP_GET,
+    .handler = clockgusto_webui_get,
+};
+
+esp_err_t clockgusto_webui_register(httpd_handle_t server)
+{
+    if (!s_image)
+    {
+        esp_err_t ret = clockgusto_webui_map();
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to map the web ui: %s\n", esp_err_to_name(ret));
+            return ret;
+        }
+    }
+
+    return httpd_register_uri_handler(server, &s_uri);
+}
+
+void clockgusto_webui_get_stats(clockgusto_webui_stats_t* stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
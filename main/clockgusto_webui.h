@@ -0,0 +1,27 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include <stdint.h>
+
+#define CLOCKGUSTO_WEBUI_PARTITION      "webui"
+#define CLOCKGUSTO_WEBUI_SUBTYPE        0x40    // first custom data subtype, see partitions.csv
+
+typedef struct _clockgusto_webui_stats_t
+{
+    uint32_t requests;
+    uint32_t not_modified;          // answered 304 from the ETag alone
+    uint64_t bytes;                 // gzipped bodies sent
+    uint32_t response_us;           // handler entry until the whole response is with the socket, last request
+    uint32_t response_max_us;
+    int32_t heap_delta;             // heap bytes a request took and kept, last request, 0 is expected
+    uint32_t stack_free;            // least stack the server task had left, in bytes
+} clockgusto_webui_stats_t;
+
+/** Maps the web UI image that tools/pack_webui.py built into the webui partition and serves its
+ *  files for every GET no API handler took. Register it last, the server needs wildcard matching.
+ *  Bodies go from the flash mapping to the socket without a RAM buffer, gzipped as packed. */
+esp_err_t clockgusto_webui_register(httpd_handle_t server);
+
+/** */
+void clockgusto_webui_get_stats(clockgusto_webui_stats_t* stats);
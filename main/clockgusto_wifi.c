@@ -1,18 +1,29 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/event_groups.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "nvs.h"
 
 #include "lwip/err.h"
 #include "lwip/sys.h"
 
-#define CLOCKGUSTO_ESP_WIFI_SSID      "M.M Homespot 2.4G"
-#define CLOCKGUSTO_ESP_WIFI_PASS      "OWTi87eJ."
-#define CLOCKGUSTO_ESP_MAXIMUM_RETRY  10
+#include "clockgusto_wifi.h"
+
+#define CLOCKGUSTO_WIFI_BACKOFF_MIN_MS  500
+#define CLOCKGUSTO_WIFI_BACKOFF_MAX_MS  (5 * 60 * 1000)
+#define CLOCKGUSTO_WIFI_STABLE_MS       (60 * 1000)     // a link that lasted this long resets the backoff
+#define CLOCKGUSTO_WIFI_RSSI_PERIOD_MS  30000
+#define CLOCKGUSTO_WIFI_NVS_NAMESPACE "wifi"
+#define CLOCKGUSTO_WIFI_NVS_SSID      "ssid"
+#define CLOCKGUSTO_WIFI_NVS_PASS      "pass"
+#define CLOCKGUSTO_WIFI_NVS_CACHE     "cache"
+#define CLOCKGUSTO_WIFI_TASK_STACK    4096
+#define CLOCKGUSTO_WIFI_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
 
 #define CLOCKGUSTO_WIFI_SAE_MODE WPA3_SAE_PWE_BOTH
 #define CLOCKGUSTO_H2E_IDENTIFIER "\0"
@@ -42,16 +53,204 @@
 
 
 
-static EventGroupHandle_t s_wifi_event_group;
+ESP_EVENT_DEFINE_BASE(CLOCKGUSTO_NET_EVENT);
+
+/** Timer expiries are posted to the event loop, so the state machine only ever runs on its task. */
+ESP_EVENT_DEFINE_BASE(CLOCKGUSTO_WIFI_TIMER_EVENT);
 
-#define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
+enum
+{
+    CLOCKGUSTO_WIFI_TIMER_RETRY,
+    CLOCKGUSTO_WIFI_TIMER_RSSI,
+};
+
+/** The access point of the last good association. The lease itself is restored by lwip
+ *  (CONFIG_LWIP_DHCP_RESTORE_LAST_IP), so dhcp only has to confirm it. */
+typedef struct _clockgusto_wifi_cache_t
+{
+    uint8_t bssid[6];
+    uint8_t channel;
+} clockgusto_wifi_cache_t;
 
 static const char *TAG = "clockgusto wifi station";
 
-static int s_retry_num = 0;
+static volatile clockgusto_wifi_state_t s_state = CLOCKGUSTO_WIFI_STOPPED;
+static uint32_t s_backoff_ms = 0;
+static int64_t s_connected_us = 0;
+static esp_timer_handle_t s_retry_timer = NULL;
+static esp_timer_handle_t s_rssi_timer = NULL;
+static int32_t s_rssi_avg_q4 = 0;       // 1/16 dBm
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static wifi_config_t s_wifi_config;
+static clockgusto_wifi_cache_t s_cache;
+static bool s_cache_valid = false;
+static bool s_directed = false;         // the running attempt goes to the cached bssid and channel
+static int64_t s_connect_start_us = 0;
+static clockgusto_wifi_stats_t s_stats;
+
+/** The ssid and password fields take the full 32 and 64 bytes without a terminator. */
+static void clockgusto_wifi_copy_field(uint8_t* field, size_t size, const char* value)
+{
+    memset(field, 0, size);
+    memcpy(field, value, strnlen(value, size));
+}
+
+static void clockgusto_wifi_load()
+{
+    clockgusto_wifi_copy_field(s_wifi_config.sta.ssid, sizeof(s_wifi_config.sta.ssid), CONFIG_CLOCKGUSTO_WIFI_SSID);
+    clockgusto_wifi_copy_field(s_wifi_config.sta.password, sizeof(s_wifi_config.sta.password),
+                               CONFIG_CLOCKGUSTO_WIFI_PASSWORD);
+
+    nvs_handle_t handle;
+    if (nvs_open(CLOCKGUSTO_WIFI_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return;
+    }
+
+    // stored credentials override the build defaults as a pair
+    char ssid[sizeof(s_wifi_config.sta.ssid) + 1];
+    char password[sizeof(s_wifi_config.sta.password) + 1];
+    size_t ssid_size = sizeof(ssid);
+    size_t password_size = sizeof(password);
+    if (nvs_get_str(handle, CLOCKGUSTO_WIFI_NVS_SSID, ssid, &ssid_size) == ESP_OK &&
+        nvs_get_str(handle, CLOCKGUSTO_WIFI_NVS_PASS, password, &password_size) == ESP_OK)
+    {
+        clockgusto_wifi_copy_field(s_wifi_config.sta.ssid, sizeof(s_wifi_config.sta.ssid), ssid);
+        clockgusto_wifi_copy_field(s_wifi_config.sta.password, sizeof(s_wifi_config.sta.password), password);
+    }
+
+    size_t cache_size = sizeof(s_cache);
+    s_cache_valid = nvs_get_blob(handle, CLOCKGUSTO_WIFI_NVS_CACHE, &s_cache, &cache_size) == ESP_OK &&
+                    cache_size == sizeof(s_cache) && s_cache.channel != 0;
+    nvs_close(handle);
+}
+
+/** Only writes when the access point changed, roaming between two is rare enough for the flash. */
+static void clockgusto_wifi_store_cache()
+{
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK)
+    {
+        return;
+    }
 
+    clockgusto_wifi_cache_t cache = { .channel = ap.primary };
+    memcpy(cache.bssid, ap.bssid, sizeof(cache.bssid));
+    if (s_cache_valid && memcmp(&cache, &s_cache, sizeof(cache)) == 0)
+    {
+        return;
+    }
+
+    nvs_handle_t handle;
+    if (nvs_open(CLOCKGUSTO_WIFI_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK)
+    {
+        return;
+    }
+    if (nvs_set_blob(handle, CLOCKGUSTO_WIFI_NVS_CACHE, &cache, sizeof(cache)) == ESP_OK)
+    {
+        nvs_commit(handle);
+        s_cache = cache;
+        s_cache_valid = true;
+    }
+    nvs_close(handle);
+}
+
+/** Directed connects skip the scan: one channel, one bssid. Otherwise every channel is scanned and
+ *  the strongest access point of the ssid wins. */
+static void clockgusto_wifi_connect(bool directed)
+{
+    s_directed = directed && s_cache_valid;
+    s_wifi_config.sta.bssid_set = s_directed;
+    s_wifi_config.sta.channel = s_directed ? s_cache.channel : 0;
+    s_wifi_config.sta.scan_method = s_directed ? WIFI_FAST_SCAN : WIFI_ALL_CHANNEL_SCAN;
+    s_wifi_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+    if (s_directed)
+    {
+        memcpy(s_wifi_config.sta.bssid, s_cache.bssid, sizeof(s_cache.bssid));
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config);
 
+    s_state = CLOCKGUSTO_WIFI_CONNECTING;
+    s_connect_start_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    s_stats.attempts++;
+    portEXIT_CRITICAL(&s_lock);
+    esp_wifi_connect();
+}
+
+static void clockgusto_wifi_timer_callback(void* arg)
+{
+    int32_t event_id = (int32_t)(intptr_t)arg;
+    if (esp_event_post(CLOCKGUSTO_WIFI_TIMER_EVENT, event_id, NULL, 0, 0) != ESP_OK &&
+        event_id == CLOCKGUSTO_WIFI_TIMER_RETRY)
+    {
+        // a dropped retry would leave the station waiting forever
+        esp_timer_start_once(s_retry_timer, CLOCKGUSTO_WIFI_BACKOFF_MIN_MS * 1000ULL);
+    }
+}
+
+/** Doubles the delay up to the cap. Half of it is random, so clocks behind a restarted router do not
+ *  come back in lockstep. */
+static void clockgusto_wifi_schedule_retry()
+{
+    s_backoff_ms = s_backoff_ms == 0 ? CLOCKGUSTO_WIFI_BACKOFF_MIN_MS : s_backoff_ms * 2;
+    if (s_backoff_ms > CLOCKGUSTO_WIFI_BACKOFF_MAX_MS)
+    {
+        s_backoff_ms = CLOCKGUSTO_WIFI_BACKOFF_MAX_MS;
+    }
+    uint32_t delay_ms = s_backoff_ms / 2 + esp_random() % (s_backoff_ms / 2 + 1);
+
+    s_state = CLOCKGUSTO_WIFI_BACKOFF;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.backoff_ms = delay_ms;
+    portEXIT_CRITICAL(&s_lock);
+    esp_timer_start_once(s_retry_timer, (uint64_t)delay_ms * 1000);
+}
+
+static void clockgusto_wifi_note_disconnect(const wifi_event_sta_disconnected_t* event)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_stats.disconnects++;
+    s_stats.last_reason = event->reason;
+    switch (event->reason)
+    {
+    case WIFI_REASON_BEACON_TIMEOUT:
+        s_stats.reason_beacon_timeout++;
+        break;
+    case WIFI_REASON_NO_AP_FOUND:
+        s_stats.reason_no_ap++;
+        break;
+    case WIFI_REASON_AUTH_EXPIRE:
+    case WIFI_REASON_AUTH_FAIL:
+    case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+    case WIFI_REASON_HANDSHAKE_TIMEOUT:
+        s_stats.reason_auth++;
+        break;
+    default:
+        s_stats.reason_other++;
+        break;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void clockgusto_wifi_sample_rssi()
+{
+    int rssi = 0;
+    if (esp_wifi_sta_get_rssi(&rssi) != ESP_OK)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    bool first = s_stats.rssi == 0;
+    s_rssi_avg_q4 = first ? rssi * 16 : s_rssi_avg_q4 + rssi - s_rssi_avg_q4 / 16;
+    s_stats.rssi = (int8_t)rssi;
+    s_stats.rssi_min = first || rssi < s_stats.rssi_min ? (int8_t)rssi : s_stats.rssi_min;
+    s_stats.rssi_avg = (int8_t)(s_rssi_avg_q4 / 16);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/** The whole connection runs in here, on the event loop task. Nothing waits for it. */
 static void event_handler(void* arg, 
                           esp_event_base_t event_base,
                           int32_t event_id, void* event_data)
@@ -59,44 +258,153 @@ static void event_handler(void* arg,
     if (event_base == WIFI_EVENT && 
         event_id == WIFI_EVENT_STA_START) 
     {
-        esp_wifi_connect();
+        clockgusto_wifi_connect(true);
     } 
     else if (event_base == WIFI_EVENT && 
              event_id == WIFI_EVENT_STA_DISCONNECTED) 
     {
-        if (s_retry_num < CLOCKGUSTO_ESP_MAXIMUM_RETRY) 
+        wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*) event_data;
+        clockgusto_wifi_note_disconnect(event);
+
+        bool was_connected = s_state == CLOCKGUSTO_WIFI_CONNECTED;
+        if (was_connected)
         {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "retry to connect to the AP");
-        } 
-        else 
+            esp_timer_stop(s_rssi_timer);
+            esp_event_post(CLOCKGUSTO_NET_EVENT, CLOCKGUSTO_NET_EVENT_DOWN, NULL, 0, 0);
+            ESP_LOGW(TAG, "link lost, reason %u", event->reason);
+
+            // a link that held is a fresh start with an immediate try, a flapping one keeps backing off
+            if (esp_timer_get_time() - s_connected_us >= CLOCKGUSTO_WIFI_STABLE_MS * 1000LL)
+            {
+                s_backoff_ms = 0;
+                clockgusto_wifi_connect(true);
+            }
+            else
+            {
+                clockgusto_wifi_schedule_retry();
+            }
+        }
+        else
         {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+            ESP_LOGI(TAG, "connect failed, reason %u", event->reason);
+            clockgusto_wifi_schedule_retry();
         }
-        ESP_LOGI(TAG, "connect to the AP fail");
     } 
+    else if (event_base == CLOCKGUSTO_WIFI_TIMER_EVENT &&
+             event_id == CLOCKGUSTO_WIFI_TIMER_RETRY)
+    {
+        // the cached access point and a full scan take turns
+        clockgusto_wifi_connect(!s_directed);
+        ESP_LOGI(TAG, "retry to connect to the AP%s", s_directed ? ", directed" : "");
+    }
+    else if (event_base == CLOCKGUSTO_WIFI_TIMER_EVENT &&
+             event_id == CLOCKGUSTO_WIFI_TIMER_RSSI)
+    {
+        if (s_state == CLOCKGUSTO_WIFI_CONNECTED)
+        {
+            clockgusto_wifi_sample_rssi();
+        }
+    }
     else if (event_base == IP_EVENT && 
              event_id == IP_EVENT_STA_GOT_IP) 
     {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
-        s_retry_num = 0;
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        s_connected_us = esp_timer_get_time();
+        uint32_t connect_ms = (uint32_t)((s_connected_us - s_connect_start_us) / 1000);
+        portENTER_CRITICAL(&s_lock);
+        s_stats.connect_ms = connect_ms;
+        s_stats.directed = s_directed;
+        s_stats.connects++;
+        s_stats.backoff_ms = 0;
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGI(TAG, "got ip:" IPSTR " after %lu ms%s", IP2STR(&event->ip_info.ip),
+                 (unsigned long)connect_ms, s_directed ? ", directed" : "");
+        s_state = CLOCKGUSTO_WIFI_CONNECTED;
+        clockgusto_wifi_store_cache();
+        clockgusto_wifi_sample_rssi();
+        esp_timer_start_periodic(s_rssi_timer, CLOCKGUSTO_WIFI_RSSI_PERIOD_MS * 1000ULL);
+        esp_event_post(CLOCKGUSTO_NET_EVENT, CLOCKGUSTO_NET_EVENT_UP, &event->ip_info, sizeof(event->ip_info), 0);
     }
 }
 
-void wifi_init_sta(void)
+#ifdef CONFIG_CLOCKGUSTO_WIFI_STATIC_IP
+/** Without the dhcp client the netif reports IP_EVENT_STA_GOT_IP with this address on association,
+ *  so the connection state machine runs unchanged. */
+static esp_err_t clockgusto_wifi_set_static_ip(esp_netif_t* netif)
 {
-    s_wifi_event_group = xEventGroupCreate();
+    esp_netif_ip_info_t ip_info = { 0 };
+    esp_netif_dns_info_t dns = { .ip.type = ESP_IPADDR_TYPE_V4 };
+    const char* dns_server = CONFIG_CLOCKGUSTO_WIFI_DNS[0] != '\0' ? CONFIG_CLOCKGUSTO_WIFI_DNS
+                                                                    : CONFIG_CLOCKGUSTO_WIFI_GATEWAY;
+    if (esp_netif_str_to_ip4(CONFIG_CLOCKGUSTO_WIFI_IP, &ip_info.ip) != ESP_OK ||
+        esp_netif_str_to_ip4(CONFIG_CLOCKGUSTO_WIFI_NETMASK, &ip_info.netmask) != ESP_OK ||
+        esp_netif_str_to_ip4(CONFIG_CLOCKGUSTO_WIFI_GATEWAY, &ip_info.gw) != ESP_OK ||
+        esp_netif_str_to_ip4(dns_server, &dns.ip.u_addr.ip4) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "static address not understood");
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    ESP_ERROR_CHECK(esp_netif_init());
+    esp_err_t ret = esp_netif_dhcpc_stop(netif);
+    if (ret != ESP_OK && ret != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED)
+    {
+        return ret;
+    }
+    ret = esp_netif_set_ip_info(netif, &ip_info);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    ESP_LOGI(TAG, "static ip " IPSTR, IP2STR(&ip_info.ip));
+    return esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns);
+}
+#endif
 
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+static esp_err_t clockgusto_wifi_init_sta()
+{
+    esp_err_t ret = esp_netif_init();
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    esp_netif_t* netif = esp_netif_create_default_wifi_sta();
+#ifdef CONFIG_CLOCKGUSTO_WIFI_STATIC_IP
+    ret = clockgusto_wifi_set_static_ip(netif);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+#else
+    (void)netif;
+#endif
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    ret = esp_wifi_init(&cfg);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    // the configuration is rewritten on every attempt, the driver needs no flash copy of it
+    esp_wifi_set_storage(WIFI_STORAGE_RAM);
+
+    esp_timer_create_args_t timer_args = {
+        .callback = clockgusto_wifi_timer_callback,
+        .arg = (void*)(intptr_t)CLOCKGUSTO_WIFI_TIMER_RETRY,
+        .name = "wifi retry",
+    };
+    ret = esp_timer_create(&timer_args, &s_retry_timer);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    timer_args.arg = (void*)(intptr_t)CLOCKGUSTO_WIFI_TIMER_RSSI;
+    timer_args.name = "wifi rssi";
+    timer_args.skip_unhandled_events = true;
+    ret = esp_timer_create(&timer_args, &s_rssi_timer);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
 
     esp_event_handler_instance_t instance_any_id;
     esp_event_handler_instance_t instance_got_ip;
@@ -110,50 +418,116 @@ void wifi_init_sta(void)
                                                         &event_handler,
                                                         NULL,
                                                         &instance_got_ip));
+    esp_event_handler_instance_t instance_timer;
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(CLOCKGUSTO_WIFI_TIMER_EVENT,
+                                                        ESP_EVENT_ANY_ID,
+                                                        &event_handler,
+                                                        NULL,
+                                                        &instance_timer));
 
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = CLOCKGUSTO_ESP_WIFI_SSID,
-            .password = CLOCKGUSTO_ESP_WIFI_PASS,
-            /* Authmode threshold resets to WPA2 as default if password matches WPA2 standards (password len => 8).
-             * If you want to connect the device to deprecated WEP/WPA networks, Please set the threshold value
-             * to WIFI_AUTH_WEP/WIFI_AUTH_WPA_PSK and set the password with length and format matching to
-             * WIFI_AUTH_WEP/WIFI_AUTH_WPA_PSK standards.
-             */
-            .threshold.authmode = CLOCKGUSTO_WIFI_SCAN_AUTH_MODE_THRESHOLD,
-            //.sae_pwe_h2e = CLOCKGUSTO_WIFI_SAE_MODE,
-            //.sae_h2e_identifier = CLOCKGUSTO_H2E_IDENTIFIER,
-        },
-    };
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
-    ESP_ERROR_CHECK(esp_wifi_start() );
+    clockgusto_wifi_load();
+    if (s_wifi_config.sta.ssid[0] == '\0')
+    {
+        ESP_LOGW(TAG, "no ssid configured");
+        return ESP_ERR_NOT_FOUND;
+    }
 
-    ESP_LOGI(TAG, "wifi_init_sta finished.");
+    /* Authmode threshold resets to WPA2 as default if password matches WPA2 standards (password len => 8).
+     * If you want to connect the device to deprecated WEP/WPA networks, Please set the threshold value
+     * to WIFI_AUTH_WEP/WIFI_AUTH_WPA_PSK and set the password with length and format matching to
+     * WIFI_AUTH_WEP/WIFI_AUTH_WPA_PSK standards.
+     */
+    s_wifi_config.sta.threshold.authmode = CLOCKGUSTO_WIFI_SCAN_AUTH_MODE_THRESHOLD;
+    //s_wifi_config.sta.sae_pwe_h2e = CLOCKGUSTO_WIFI_SAE_MODE;
+    //s_wifi_config.sta.sae_h2e_identifier = CLOCKGUSTO_H2E_IDENTIFIER;
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config) );
 
-    /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed for the maximum
-     * number of re-tries (WIFI_FAIL_BIT). The bits are set by event_handler() (see above) */
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-                                           WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-                                           pdFALSE,
-                                           pdFALSE,
-                                           pdMS_TO_TICKS(10000));
+    return esp_wifi_start();
+}
+/** Driver init loads the phy calibration and takes a few hundred ms, so it runs beside the frame loop
+ *  and ends once the station is started. */
+static void clockgusto_wifi_task(void* arg)
+{
+    (void)arg;
 
-    /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which event actually
-     * happened. */
-    if (bits & WIFI_CONNECTED_BIT) 
+    esp_err_t ret = clockgusto_wifi_init_sta();
+    if (ret != ESP_OK)
     {
-        ESP_LOGI(TAG, "connected to ap SSID:%s password:%s",
-                 CLOCKGUSTO_ESP_WIFI_SSID, CLOCKGUSTO_ESP_WIFI_PASS);
-    } 
-    else if (bits & WIFI_FAIL_BIT) 
+        ESP_LOGE(TAG, "Failed to start the station: %s\n", esp_err_to_name(ret));
+        s_state = CLOCKGUSTO_WIFI_FAILED;
+    }
+    else
     {
-        ESP_LOGI(TAG, "Failed to connect to SSID:%s, password:%s",
-                 CLOCKGUSTO_ESP_WIFI_SSID, CLOCKGUSTO_ESP_WIFI_PASS);
-    } 
-    else 
+        ESP_LOGI(TAG, "wifi_init_sta finished.");
+    }
+
+    vTaskDelete(NULL);
+}
+
+esp_err_t clockgusto_wifi_start()
+{
+    if (s_state != CLOCKGUSTO_WIFI_STOPPED)
     {
-        ESP_LOGE(TAG, "UNEXPECTED EVENT");
+        return ESP_ERR_INVALID_STATE;
     }
+
+    s_state = CLOCKGUSTO_WIFI_STARTING;
+    if (xTaskCreate(clockgusto_wifi_task, "clockgusto wifi", CLOCKGUSTO_WIFI_TASK_STACK, NULL,
+                    CLOCKGUSTO_WIFI_TASK_PRIORITY, NULL) != pdPASS)
+    {
+        s_state = CLOCKGUSTO_WIFI_STOPPED;
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+void clockgusto_wifi_get_ssid(char* ssid)
+{
+    memcpy(ssid, s_wifi_config.sta.ssid, sizeof(s_wifi_config.sta.ssid));
+    ssid[sizeof(s_wifi_config.sta.ssid)] = '\0';
 }
 
+clockgusto_wifi_state_t clockgusto_wifi_get_state()
+{
+    return s_state;
+}
+
+void clockgusto_wifi_get_stats(clockgusto_wifi_stats_t* stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t clockgusto_wifi_set_credentials(const char* ssid, const char* password)
+{
+    if (strlen(ssid) == 0 || strlen(ssid) > sizeof(s_wifi_config.sta.ssid) ||
+        strlen(password) > sizeof(s_wifi_config.sta.password))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(CLOCKGUSTO_WIFI_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to open nvs\n");
+        return ret;
+    }
+    ret = nvs_set_str(handle, CLOCKGUSTO_WIFI_NVS_SSID, ssid);
+    if (ret == ESP_OK)
+    {
+        ret = nvs_set_str(handle, CLOCKGUSTO_WIFI_NVS_PASS, password);
+    }
+    if (ret == ESP_OK)
+    {
+        // the cached access point belongs to the old network
+        nvs_erase_key(handle, CLOCKGUSTO_WIFI_NVS_CACHE);
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    return ret;
+}
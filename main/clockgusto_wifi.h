@@ -1,3 +1,65 @@
 #pragma once
 
-void wifi_init_sta(void);
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CLOCKGUSTO_WIFI_SSID_SIZE   33      // 32 bytes and a terminator
+
+/** Connectivity as seen by network services, posted on the default event loop. Services register a
+ *  handler instead of waiting for the station. */
+ESP_EVENT_DECLARE_BASE(CLOCKGUSTO_NET_EVENT);
+
+typedef enum _clockgusto_net_event_t
+{
+    CLOCKGUSTO_NET_EVENT_UP,        // event data: esp_netif_ip_info_t
+    CLOCKGUSTO_NET_EVENT_DOWN,
+} clockgusto_net_event_t;
+
+typedef enum _clockgusto_wifi_state_t
+{
+    CLOCKGUSTO_WIFI_STOPPED,
+    CLOCKGUSTO_WIFI_STARTING,       // driver and netif initialising
+    CLOCKGUSTO_WIFI_CONNECTING,     // associating and waiting for dhcp
+    CLOCKGUSTO_WIFI_CONNECTED,
+    CLOCKGUSTO_WIFI_BACKOFF,        // waiting for the next attempt
+    CLOCKGUSTO_WIFI_FAILED,         // not configured or the driver did not start
+} clockgusto_wifi_state_t;
+
+typedef struct _clockgusto_wifi_stats_t
+{
+    uint32_t connect_ms;            // last attempt start to ip
+    bool directed;                  // last connect went to the cached access point without a scan
+    uint32_t connects;
+    uint32_t attempts;
+    uint32_t disconnects;           // every failed attempt or lost link
+    uint32_t reason_beacon_timeout;
+    uint32_t reason_no_ap;
+    uint32_t reason_auth;           // wrong password or handshake timeouts
+    uint32_t reason_other;
+    uint16_t last_reason;           // wifi_err_reason_t
+    uint32_t backoff_ms;            // current delay before the next attempt
+    int8_t rssi;                    // last sample while connected, 0 before the first
+    int8_t rssi_min;
+    int8_t rssi_avg;                // moving average of the samples
+} clockgusto_wifi_stats_t;
+
+/** Brings the station up in the background and returns at once. Needs the default event loop. A
+ *  lost or failed connection is retried forever with jittered exponential backoff. */
+esp_err_t clockgusto_wifi_start();
+
+/** Network the clock joins, ssid needs CLOCKGUSTO_WIFI_SSID_SIZE bytes. */
+void clockgusto_wifi_get_ssid(char* ssid);
+
+/** */
+clockgusto_wifi_state_t clockgusto_wifi_get_state();
+
+/** */
+void clockgusto_wifi_get_stats(clockgusto_wifi_stats_t* stats);
+
+/** Persists credentials over the CONFIG_CLOCKGUSTO_WIFI_SSID/PASSWORD defaults and drops the cached
+ *  access point. Used from the next start. Takes SSIDs up to 32 bytes and passwords up to 64, a
+ *  64 digit hex PSK included. */
+esp_err_t clockgusto_wifi_set_credentials(const char* ssid, const char* password);
@@ -0,0 +1,187 @@
+#include "clockgusto_wire.h"
+
+#include <string.h>
+
+// a nibble at a time, 64 bytes of table instead of 1 kB
+static const uint32_t s_crc_table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+uint32_t clockgusto_wire_crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+    crc = ~crc;
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        crc ^= data[idx];
+        crc = (crc >> 4) ^ s_crc_table[crc & 0x0f];
+        crc = (crc >> 4) ^ s_crc_table[crc & 0x0f];
+    }
+    return ~crc;
+}
+
+size_t clockgusto_wire_cobs_encode(const uint8_t* data, size_t size, uint8_t* encoded)
+{
+    size_t code_idx = 0;
+    size_t out = 1;
+    uint8_t code = 1;
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        if (data[idx] != 0)
+        {
+            encoded[out++] = data[idx];
+            code++;
+        }
+        if (data[idx] == 0 || code == 0xff)
+        {
+            encoded[code_idx] = code;
+            code_idx = out++;
+            code = 1;
+        }
+    }
+    encoded[code_idx] = code;
+    return out;
+}
+
+size_t clockgusto_wire_cobs_decode(const uint8_t* encoded, size_t size, uint8_t* data, size_t max_size)
+{
+    size_t out = 0;
+    size_t idx = 0;
+    while (idx < size)
+    {
+        uint8_t code = encoded[idx++];
+        if (code == 0 || idx + code - 1 > size || out + code - 1 > max_size)
+        {
+            return 0;
+        }
+        memcpy(data + out, encoded + idx, code - 1);
+        out += code - 1;
+        idx += code - 1;
+        // a full block has no implied zero, nor has the last one
+        if (code != 0xff && idx < size)
+        {
+            if (out >= max_size)
+            {
+                return 0;
+            }
+            data[out++] = 0;
+        }
+    }
+    return out;
+}
+
+size_t clockgusto_wire_encode(uint8_t type, uint8_t seq, const uint8_t* payload, size_t size, uint8_t* out)
+{
+    if (size > CLOCKGUSTO_WIRE_MAX_PAYLOAD)
+    {
+        return 0;
+    }
+
+    // the frame is assembled behind the space its encoding needs, then encoded to the front
+    uint8_t* frame = out + CLOCKGUSTO_WIRE_MAX_ENCODED - CLOCKGUSTO_WIRE_HEADER_SIZE - size - CLOCKGUSTO_WIRE_CRC_SIZE;
+    frame[0] = type;
+    frame[1] = seq;
+    memmove(frame + CLOCKGUSTO_WIRE_HEADER_SIZE, payload, size);
+    size_t frame_size = CLOCKGUSTO_WIRE_HEADER_SIZE + size;
+    clockgusto_wire_put_u32(frame + frame_size, clockgusto_wire_crc32(0, frame, frame_size));
+    frame_size += CLOCKGUSTO_WIRE_CRC_SIZE;
+
+    out[0] = 0;
+    size_t length = 1 + clockgusto_wire_cobs_encode(frame, frame_size, out + 1);
+    out[length++] = 0;
+    return length;
+}
+
+void clockgusto_wire_reader_init(clockgusto_wire_reader_t* reader)
+{
+    reader->length = 0;
+    reader->overflow = false;
+}
+
+clockgusto_wire_result_t clockgusto_wire_reader_push(clockgusto_wire_reader_t* reader, uint8_t byte,
+                                                     clockgusto_wire_frame_t* frame)
+{
+    if (byte != 0)
+    {
+        if (reader->length < sizeof(reader->encoded))
+        {
+            reader->encoded[reader->length++] = byte;
+        }
+        else
+        {
+            reader->overflow = true;
+        }
+        return CLOCKGUSTO_WIRE_MORE;
+    }
+
+    size_t length = reader->length;
+    bool overflow = reader->overflow;
+    clockgusto_wire_reader_init(reader);
+    if (length == 0)
+    {
+        return CLOCKGUSTO_WIRE_MORE;    // back to back delimiters
+    }
+    if (overflow)
+    {
+        return CLOCKGUSTO_WIRE_NOISE;
+    }
+
+    size_t size = clockgusto_wire_cobs_decode(reader->encoded, length, reader->decoded, sizeof(reader->decoded));
+    if (size < CLOCKGUSTO_WIRE_HEADER_SIZE + CLOCKGUSTO_WIRE_CRC_SIZE)
+    {
+        return CLOCKGUSTO_WIRE_NOISE;
+    }
+    size -= CLOCKGUSTO_WIRE_CRC_SIZE;
+    if (clockgusto_wire_crc32(0, reader->decoded, size) != clockgusto_wire_get_u32(reader->decoded + size))
+    {
+        return CLOCKGUSTO_WIRE_NOISE;
+    }
+
+    frame->type = reader->decoded[0];
+    frame->seq = reader->decoded[1];
+    frame->payload = reader->decoded + CLOCKGUSTO_WIRE_HEADER_SIZE;
+    frame->size = size - CLOCKGUSTO_WIRE_HEADER_SIZE;
+    return CLOCKGUSTO_WIRE_FRAME;
+}
+
+void clockgusto_wire_put_u16(uint8_t* data, uint16_t value)
+{
+    data[0] = (uint8_t)value;
+    data[1] = (uint8_t)(value >> 8);
+}
+
+void clockgusto_wire_put_u32(uint8_t* data, uint32_t value)
+{
+    for (int idx = 0; idx < 4; ++idx)
+    {
+        data[idx] = (uint8_t)(value >> (8 * idx));
+    }
+}
+
+void clockgusto_wire_put_i64(uint8_t* data, int64_t value)
+{
+    for (int idx = 0; idx < 8; ++idx)
+    {
+        data[idx] = (uint8_t)((uint64_t)value >> (8 * idx));
+    }
+}
+
+uint16_t clockgusto_wire_get_u16(const uint8_t* data)
+{
+    return (uint16_t)(data[0] | data[1] << 8);
+}
+
+uint32_t clockgusto_wire_get_u32(const uint8_t* data)
+{
+    return (uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+int64_t clockgusto_wire_get_i64(const uint8_t* data)
+{
+    uint64_t value = 0;
+    for (int idx = 7; idx >= 0; --idx)
+    {
+        value = value << 8 | data[idx];
+    }
+    return (int64_t)value;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLOCKGUSTO_WIRE_VERSION         1
+#define CLOCKGUSTO_WIRE_MAX_PAYLOAD     1024
+#define CLOCKGUSTO_WIRE_HEADER_SIZE     2       // type, seq
+#define CLOCKGUSTO_WIRE_CRC_SIZE        4
+#define CLOCKGUSTO_WIRE_MAX_FRAME       (CLOCKGUSTO_WIRE_HEADER_SIZE + CLOCKGUSTO_WIRE_MAX_PAYLOAD + CLOCKGUSTO_WIRE_CRC_SIZE)
+#define CLOCKGUSTO_WIRE_MAX_ENCODED     (CLOCKGUSTO_WIRE_MAX_FRAME + CLOCKGUSTO_WIRE_MAX_FRAME / 254 + 3)
+
+/* Plain C without ESP-IDF dependencies, so the host tool's stand-in for the clock runs the same codec.
+ *
+ * A frame is type, seq, payload and a CRC-32 (the zlib one) over all three, little endian. It goes
+ * over the wire COBS encoded between two zero bytes. Console text never contains a zero byte, so
+ * whatever sits between two delimiters and does not decode with a valid CRC is text, and log lines
+ * can share the UART with the protocol. Multi-byte fields are little endian.
+ *
+ * The host sends requests with a seq of its choice. The clock answers each with the request type
+ * ORed with CLOCKGUSTO_WIRE_RESPONSE, same seq, a status byte and the data. Bulk data comes first as
+ * stream frames with the seq of the request that asked for it. */
+
+typedef enum _clockgusto_wire_type_t
+{
+    CLOCKGUSTO_WIRE_PING         = 0x01,    // -> version u8, max payload u16
+    CLOCKGUSTO_WIRE_TIME_GET     = 0x02,    // -> utc_us i64
+    CLOCKGUSTO_WIRE_TIME_SET     = 0x03,    // utc_us i64 at the last byte of the frame -> utc_us i64 after the set
+    CLOCKGUSTO_WIRE_CONFIG_GET   = 0x04,    // key u8 -> key u8, value
+    CLOCKGUSTO_WIRE_CONFIG_SET   = 0x05,    // key u8, value -> key u8, value
+    CLOCKGUSTO_WIRE_FRAMES       = 0x06,    // count u16 -> FRAME_DATA for the next count frames shown, 0 stops
+    CLOCKGUSTO_WIRE_LOGS         = 0x07,    // first seq u32 -> LOG_LINE for each line still held, then next seq u32
+    CLOCKGUSTO_WIRE_METRICS      = 0x08,    // -> METRICS_TEXT chunks, the text /metrics serves
+    CLOCKGUSTO_WIRE_DISMISS      = 0x09,    // -> alarm state u8 before, 0 idle, 1 sunrise, 2 ringing
+
+    CLOCKGUSTO_WIRE_FRAME_DATA   = 0x41,    // frame number u32, pixels in strip order
+    CLOCKGUSTO_WIRE_LOG_LINE     = 0x42,    // seq u32, text without newline
+    CLOCKGUSTO_WIRE_METRICS_TEXT = 0x43,    // a piece of the text, pieces end at line ends
+
+    CLOCKGUSTO_WIRE_RESPONSE     = 0x80,
+} clockgusto_wire_type_t;
+
+typedef enum _clockgusto_wire_status_t
+{
+    CLOCKGUSTO_WIRE_OK          = 0,
+    CLOCKGUSTO_WIRE_UNKNOWN     = 1,        // type or config key
+    CLOCKGUSTO_WIRE_BAD_LENGTH  = 2,
+    CLOCKGUSTO_WIRE_BAD_VALUE   = 3,
+    CLOCKGUSTO_WIRE_FAILED      = 4,        // valid, but the clock could not apply or store it
+} clockgusto_wire_status_t;
+
+typedef enum _clockgusto_wire_key_t
+{
+    CLOCKGUSTO_WIRE_KEY_BRIGHTNESS = 1,     // u8 0..100
+    CLOCKGUSTO_WIRE_KEY_MODE       = 2,     // u8 clockgusto_mode_t
+    CLOCKGUSTO_WIRE_KEY_ALARM      = 3,     // enabled u8, hour u8, minute u8, days u8, sunrise u8
+    CLOCKGUSTO_WIRE_KEY_NIGHT      = 4,     // enabled u8, latitude_e4 i32, longitude_e4 i32, level u8, twilight_min u8
+    CLOCKGUSTO_WIRE_KEY_TZ         = 5,     // std_offset_min i16, dst_offset_min i16, then start and end as
+                                            // month u8, week u8, wday u8, minute u16
+    CLOCKGUSTO_WIRE_KEY_WIFI       = 6,     // ssid length u8, ssid, on a set the password follows, it is
+                                            // never read back; used after the next restart
+} clockgusto_wire_key_t;
+
+typedef struct _clockgusto_wire_frame_t
+{
+    uint8_t type;
+    uint8_t seq;
+    const uint8_t* payload;
+    size_t size;
+} clockgusto_wire_frame_t;
+
+typedef enum _clockgusto_wire_result_t
+{
+    CLOCKGUSTO_WIRE_MORE,                   // the byte was taken, no delimiter yet
+    CLOCKGUSTO_WIRE_FRAME,                  // a valid frame ended with this byte
+    CLOCKGUSTO_WIRE_NOISE,                  // something ended with this byte that was no frame
+} clockgusto_wire_result_t;
+
+/** Collects bytes up to a delimiter. Too long runs are dropped as noise. */
+typedef struct _clockgusto_wire_reader_t
+{
+    uint8_t encoded[CLOCKGUSTO_WIRE_MAX_ENCODED];
+    size_t length;
+    bool overflow;
+    uint8_t decoded[CLOCKGUSTO_WIRE_MAX_FRAME];
+} clockgusto_wire_reader_t;
+
+/** zlib's CRC-32, start with 0. */
+uint32_t clockgusto_wire_crc32(uint32_t crc, const uint8_t* data, size_t size);
+
+/** Returns the encoded size, at most size + size / 254 + 1. No zero byte is written. */
+size_t clockgusto_wire_cobs_encode(const uint8_t* data, size_t size, uint8_t* encoded);
+
+/** Returns the decoded size, or 0 for input that is no COBS block or would exceed max_size. */
+size_t clockgusto_wire_cobs_decode(const uint8_t* encoded, size_t size, uint8_t* data, size_t max_size);
+
+/** Builds a frame with both delimiters into out, which holds CLOCKGUSTO_WIRE_MAX_ENCODED bytes.
+ *  Returns its size, 0 when the payload is too long. */
+size_t clockgusto_wire_encode(uint8_t type, uint8_t seq, const uint8_t* payload, size_t size, uint8_t* out);
+
+/** */
+void clockgusto_wire_reader_init(clockgusto_wire_reader_t* reader);
+
+/** Feeds one received byte. On CLOCKGUSTO_WIRE_FRAME frame points into the reader until the next call. */
+clockgusto_wire_result_t clockgusto_wire_reader_push(clockgusto_wire_reader_t* reader, uint8_t byte,
+                                                     clockgusto_wire_frame_t* frame);
+
+/** */
+void clockgusto_wire_put_u16(uint8_t* data, uint16_t value);
+
+/** */
+void clockgusto_wire_put_u32(uint8_t* data, uint32_t value);
+
+/** */
+void clockgusto_wire_put_i64(uint8_t* data, int64_t value);
+
+/** */
+uint16_t clockgusto_wire_get_u16(const uint8_t* data);
+
+/** */
+uint32_t clockgusto_wire_get_u32(const uint8_t* data);
+
+/** */
+int64_t clockgusto_wire_get_i64(const uint8_t* data);
@@ -0,0 +1,269 @@
+#include "dcf77_decoder.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define DCF77_GLITCH_MS         40      // shorter pulses are noise
+#define DCF77_MERGE_GAP_MS      40      // shorter gaps split one pulse in two, they are bridged
+#define DCF77_ONE_THRESHOLD_MS  150     // nominal 100 ms is a zero, 200 ms is a one
+#define DCF77_MAX_PULSE_MS      280
+#define DCF77_GRID_TOLERANCE_MS 150     // pulses must start on the one second grid
+#define DCF77_FRAME_MASK        ((1ULL << DCF77_FRAME_BITS) - 1)
+
+static bool dcf77_bit(uint64_t bits, uint8_t idx)
+{
+    return (bits >> idx) & 1;
+}
+
+static bool dcf77_even_parity(uint64_t bits, uint8_t first, uint8_t last)
+{
+    uint8_t ones = 0;
+    for (uint8_t idx = first; idx <= last; ++idx)
+    {
+        ones += dcf77_bit(bits, idx);
+    }
+
+    return (ones % 2) == 0;
+}
+
+static uint8_t dcf77_bcd(uint64_t bits, uint8_t first, uint8_t count)
+{
+    static const uint8_t weights[] = { 1, 2, 4, 8, 10, 20, 40, 80 };
+    uint8_t value = 0;
+    for (uint8_t idx = 0; idx < count; ++idx)
+    {
+        value += dcf77_bit(bits, first + idx) ? weights[idx] : 0;
+    }
+
+    return value;
+}
+
+static int32_t dcf77_days_from_civil(int32_t year, uint32_t month, uint32_t mday)
+{
+    year -= month <= 2;
+    int32_t era = (year >= 0 ? year : year - 399) / 400;
+    uint32_t yoe = (uint32_t)(year - era * 400);
+    uint32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + mday - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + (int32_t)doe - 719468;
+}
+
+/** Minutes since 1970 in UTC, so frames on either side of a DST switch still agree. */
+static int32_t dcf77_minute_index(const dcf77_time_t* time)
+{
+    int32_t days = dcf77_days_from_civil(2000 + time->year, time->month, time->mday);
+    return days * 1440 + time->hour * 60 + time->minute - (time->cest ? 120 : 60);
+}
+
+static bool dcf77_decoder_vote(dcf77_decoder_t* decoder, const dcf77_time_t* time)
+{
+    dcf77_vote_t vote = {
+        .minute_index = dcf77_minute_index(time),
+        .marker = decoder->marker,
+    };
+
+    uint8_t votes = 1;
+    for (uint8_t idx = 0; idx < DCF77_VOTE_HISTORY; ++idx)
+    {
+        const dcf77_vote_t* earlier = &decoder->votes[idx];
+        if (earlier->marker != 0 &&
+            earlier->minute_index - (int32_t)earlier->marker == vote.minute_index - (int32_t)vote.marker)
+        {
+            ++votes;
+        }
+    }
+
+    decoder->votes[decoder->vote_head] = vote;
+    decoder->vote_head = (decoder->vote_head + 1) % DCF77_VOTE_HISTORY;
+
+    return votes >= DCF77_VOTES_REQUIRED;
+}
+
+static void dcf77_decoder_start_minute(dcf77_decoder_t* decoder, uint32_t start_ms)
+{
+    decoder->minute_start_ms = start_ms;
+    decoder->bits = 0;
+    decoder->seen = 0;
+}
+
+/** Closes the frame of the minute that began at minute_start_ms. The frame announces the minute
+ *  that begins now. */
+static bool dcf77_decoder_finish_minute(dcf77_decoder_t* decoder, uint32_t minutes,
+                                        dcf77_time_t* time, uint32_t* minute_start_ms)
+{
+    bool complete = minutes == 1 && decoder->seen == DCF77_FRAME_MASK;
+    uint32_t next_start_ms = decoder->minute_start_ms + minutes * 60000;
+    decoder->marker += minutes;
+
+    bool accepted = false;
+    dcf77_time_t decoded;
+    if (complete && dcf77_decoder_decode_frame(decoder->bits, &decoded))
+    {
+        ++decoder->frames_ok;
+        if (dcf77_decoder_vote(decoder, &decoded))
+        {
+            *time = decoded;
+            *minute_start_ms = next_start_ms;
+            accepted = true;
+        }
+    }
+    else
+    {
+        // a lost pulse may have been taken for the minute marker, so the next gap anchors again
+        ++decoder->frames_bad;
+        decoder->has_marker = false;
+    }
+
+    dcf77_decoder_start_minute(decoder, next_start_ms);
+    return accepted;
+}
+
+static bool dcf77_decoder_pulse(dcf77_decoder_t* decoder, uint32_t start_ms, uint32_t width_ms,
+                                dcf77_time_t* time, uint32_t* minute_start_ms)
+{
+    if (width_ms < DCF77_GLITCH_MS || width_ms > DCF77_MAX_PULSE_MS)
+    {
+        ++decoder->glitches;
+        return false;
+    }
+
+    if (!decoder->locked)
+    {
+        decoder->locked = true;
+        decoder->last_second_ms = start_ms;
+        return false;
+    }
+
+    uint32_t interval_ms = start_ms - decoder->last_second_ms;
+    uint32_t seconds = (interval_ms + 500) / 1000;
+    int32_t grid_error_ms = (int32_t)interval_ms - (int32_t)seconds * 1000;
+    if (seconds == 0 || grid_error_ms > DCF77_GRID_TOLERANCE_MS || grid_error_ms < -DCF77_GRID_TOLERANCE_MS)
+    {
+        ++decoder->glitches;
+        if (interval_ms > 3000)
+        {
+            // the receiver was silent for a while, whatever the grid was it is gone
+            decoder->last_second_ms = start_ms;
+            decoder->has_marker = false;
+        }
+        return false;
+    }
+    decoder->last_second_ms = start_ms;
+    ++decoder->pulses;
+
+    bool accepted = false;
+    uint32_t position = 0;
+    if (decoder->has_marker)
+    {
+        position = (start_ms - decoder->minute_start_ms + 500) / 1000;
+        if (position >= 60)
+        {
+            accepted = dcf77_decoder_finish_minute(decoder, position / 60, time, minute_start_ms);
+            position %= 60;
+        }
+    }
+
+    if (!decoder->has_marker)
+    {
+        // the missing pulse of second 59 makes a two second gap the start of a minute
+        if (seconds != 2)
+        {
+            return accepted;
+        }
+        decoder->has_marker = true;
+        dcf77_decoder_start_minute(decoder, start_ms);
+        position = 0;
+    }
+
+    if (position < DCF77_FRAME_BITS)
+    {
+        if (width_ms >= DCF77_ONE_THRESHOLD_MS)
+        {
+            decoder->bits |= 1ULL << position;
+        }
+        decoder->seen |= 1ULL << position;
+    }
+
+    return accepted;
+}
+
+void dcf77_decoder_reset(dcf77_decoder_t* decoder)
+{
+    memset(decoder, 0, sizeof(*decoder));
+}
+
+bool dcf77_decoder_feed(dcf77_decoder_t* decoder, bool level, uint32_t time_ms,
+                        dcf77_time_t* time, uint32_t* minute_start_ms)
+{
+    if (level)
+    {
+        if (decoder->in_pulse)
+        {
+            return false;
+        }
+        decoder->in_pulse = true;
+
+        if (decoder->pending && time_ms - decoder->pulse_end_ms < DCF77_MERGE_GAP_MS)
+        {
+            // the previous pulse continues, a short dropout split it
+            decoder->pending = false;
+            return false;
+        }
+
+        bool accepted = false;
+        if (decoder->pending)
+        {
+            decoder->pending = false;
+            accepted = dcf77_decoder_pulse(decoder, decoder->pulse_start_ms,
+                                           decoder->pulse_end_ms - decoder->pulse_start_ms,
+                                           time, minute_start_ms);
+        }
+        decoder->pulse_start_ms = time_ms;
+        return accepted;
+    }
+
+    if (!decoder->in_pulse)
+    {
+        return false;
+    }
+    decoder->in_pulse = false;
+    decoder->pulse_end_ms = time_ms;
+    decoder->pending = true;
+
+    return false;
+}
+
+bool dcf77_decoder_decode_frame(uint64_t bits, dcf77_time_t* time)
+{
+    bool cest = dcf77_bit(bits, 17);
+    bool cet = dcf77_bit(bits, 18);
+
+    if (dcf77_bit(bits, 0) || !dcf77_bit(bits, 20) || cest == cet)
+    {
+        return false;
+    }
+    if (!dcf77_even_parity(bits, 21, 28) || !dcf77_even_parity(bits, 29, 35) || !dcf77_even_parity(bits, 36, 58))
+    {
+        return false;
+    }
+
+    dcf77_time_t decoded = {
+        .minute = dcf77_bcd(bits, 21, 7),
+        .hour = dcf77_bcd(bits, 29, 6),
+        .mday = dcf77_bcd(bits, 36, 6),
+        .wday = dcf77_bcd(bits, 42, 3),
+        .month = dcf77_bcd(bits, 45, 5),
+        .year = dcf77_bcd(bits, 50, 8),
+        .cest = cest,
+    };
+    if (decoded.minute > 59 || decoded.hour > 23 || decoded.mday < 1 || decoded.mday > 31 ||
+        decoded.wday < 1 || decoded.wday > 7 || decoded.month < 1 || decoded.month > 12 || decoded.year > 99)
+    {
+        return false;
+    }
+
+    *time = decoded;
+    return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DCF77_FRAME_BITS     59
+#define DCF77_VOTE_HISTORY   3
+#define DCF77_VOTES_REQUIRED 2
+#define DCF77_PROBE_PULSES   40     // of the 59 a minute brings; noise lands on the grid a third as often
+
+/* Plain C without ESP-IDF dependencies, so recorded pulse trains can be replayed on a host. */
+
+typedef struct _dcf77_time_t
+{
+    uint8_t minute;
+    uint8_t hour;
+    uint8_t mday;
+    uint8_t wday;       // 1 monday .. 7 sunday
+    uint8_t month;
+    uint8_t year;       // 0 .. 99
+    bool cest;
+} dcf77_time_t;
+
+typedef struct _dcf77_vote_t
+{
+    int32_t minute_index;
+    uint32_t marker;
+} dcf77_vote_t;
+
+typedef struct _dcf77_decoder_t
+{
+    // pulse capture
+    bool in_pulse;
+    bool pending;
+    uint32_t pulse_start_ms;
+    uint32_t pulse_end_ms;
+    uint32_t last_second_ms;
+    bool locked;
+
+    // frame assembly
+    bool has_marker;
+    uint32_t minute_start_ms;
+    uint64_t bits;
+    uint64_t seen;
+
+    // voting
+    uint32_t marker;
+    dcf77_vote_t votes[DCF77_VOTE_HISTORY];
+    uint8_t vote_head;
+
+    uint32_t frames_ok;
+    uint32_t frames_bad;
+    uint32_t glitches;
+    uint32_t pulses;        // on the one second grid
+} dcf77_decoder_t;
+
+/** */
+void dcf77_decoder_reset(dcf77_decoder_t* decoder);
+
+/** Feeds one receiver edge, level true while the carrier is reduced. Returns true when a minute
+ *  frame passed parity and agrees with earlier frames. time then holds the minute that started at
+ *  minute_start_ms. */
+bool dcf77_decoder_feed(dcf77_decoder_t* decoder, bool level, uint32_t time_ms,
+                        dcf77_time_t* time, uint32_t* minute_start_ms);
+
+/** Checks framing bits and parity of a 59 bit frame and extracts the time. */
+bool dcf77_decoder_decode_frame(uint64_t bits, dcf77_time_t* time);
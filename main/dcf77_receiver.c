@@ -0,0 +1,223 @@
+#include "dcf77_receiver.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "clockgusto_time.h"
+#include "clockgusto_tz.h"
+#include "dcf77_decoder.h"
+
+#define DCF77_RECEIVER_QUEUE_LENGTH      16
+#define DCF77_RECEIVER_TASK_STACK        3072
+#define DCF77_RECEIVER_TASK_PRIORITY     (tskIDLE_PRIORITY + 3)
+#define DCF77_RECEIVER_LATENCY_MS        30     // typical demodulator delay of the receiver modules
+#define DCF77_RECEIVER_ERROR_US          20000  // spread of that delay between modules, plus edge jitter
+#define DCF77_RECEIVER_REFERENCE_EVERY_S 600    // the receiver sleeps in between
+#define DCF77_RECEIVER_LISTEN_S          900    // gives up on a weak signal so the chip can sleep again
+#define DCF77_RECEIVER_PROBE_S           60     // gives up sooner when not even the second pulses come
+
+typedef struct _dcf77_edge_t
+{
+    bool level;
+    uint32_t time_ms;
+} dcf77_edge_t;
+
+static const char *TAG = "dcf77 receiver";
+
+static QueueHandle_t s_edges = NULL;
+static gpio_num_t s_gpio_num;
+static bool s_inverted;
+static dcf77_decoder_t s_decoder;
+static esp_pm_lock_handle_t s_pm_lock = NULL;
+static int64_t s_listen_end_us;
+static int64_t s_probe_end_us;      // 0 once the probe passed
+
+static void dcf77_receiver_isr(void* arg)
+{
+    (void)arg;
+    dcf77_edge_t edge = {
+        .level = gpio_get_level(s_gpio_num) != s_inverted,
+        .time_ms = (uint32_t)(esp_timer_get_time() / 1000),
+    };
+
+    BaseType_t woken = pdFALSE;
+    xQueueSendFromISR(s_edges, &edge, &woken);
+    if (woken)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+/** Edge interrupts do not wake the chip from light sleep and the wakeup latency would smear the
+ *  timestamps, so light sleep is held off while the receiver listens. Once a reference went out the
+ *  receiver is switched off until the next one is due, and so it is after the first minute when
+ *  fewer than DCF77_PROBE_PULSES came on the second grid: no module, no antenna or no signal. */
+static void dcf77_receiver_listen(bool listen)
+{
+    if (listen)
+    {
+        if (s_pm_lock)
+        {
+            esp_pm_lock_acquire(s_pm_lock);
+        }
+
+        // the frames collected before the pause lie on another time line, the counters carry on
+        uint32_t frames_ok = s_decoder.frames_ok;
+        uint32_t frames_bad = s_decoder.frames_bad;
+        uint32_t glitches = s_decoder.glitches;
+        dcf77_decoder_reset(&s_decoder);
+        s_decoder.frames_ok = frames_ok;
+        s_decoder.frames_bad = frames_bad;
+        s_decoder.glitches = glitches;
+
+        int64_t now_us = esp_timer_get_time();
+        s_listen_end_us = now_us + DCF77_RECEIVER_LISTEN_S * 1000000LL;
+        s_probe_end_us = now_us + DCF77_RECEIVER_PROBE_S * 1000000LL;
+        gpio_intr_enable(s_gpio_num);
+    }
+    else
+    {
+        gpio_intr_disable(s_gpio_num);
+        xQueueReset(s_edges);
+        if (s_pm_lock)
+        {
+            esp_pm_lock_release(s_pm_lock);
+        }
+    }
+}
+
+static void dcf77_receiver_task(void* arg)
+{
+    (void)arg;
+    dcf77_edge_t edge;
+    bool listening = true;
+
+    dcf77_receiver_listen(true);
+    while (true)
+    {
+        if (!listening)
+        {
+            vTaskDelay(pdMS_TO_TICKS(DCF77_RECEIVER_REFERENCE_EVERY_S * 1000));
+            listening = true;
+            dcf77_receiver_listen(true);
+        }
+
+        int64_t now_us = esp_timer_get_time();
+        if (s_probe_end_us != 0 && now_us >= s_probe_end_us)
+        {
+            s_probe_end_us = 0;
+            if (s_decoder.pulses < DCF77_PROBE_PULSES)
+            {
+                ESP_LOGI(TAG, "%lu pulses in the first minute, no signal", (unsigned long)s_decoder.pulses);
+                listening = false;
+                dcf77_receiver_listen(false);
+                continue;
+            }
+        }
+        if (now_us >= s_listen_end_us)
+        {
+            listening = false;
+            dcf77_receiver_listen(false);
+            continue;
+        }
+
+        int64_t left_us = (s_probe_end_us != 0 ? s_probe_end_us : s_listen_end_us) - now_us;
+        if (xQueueReceive(s_edges, &edge, pdMS_TO_TICKS(left_us / 1000) + 1) != pdTRUE)
+        {
+            continue;
+        }
+
+        dcf77_time_t time;
+        uint32_t minute_start_ms;
+        if (!dcf77_decoder_feed(&s_decoder, edge.level, edge.time_ms, &time, &minute_start_ms))
+        {
+            continue;
+        }
+
+        ESP_LOGI(TAG, "%02u:%02u %02u.%02u.%02u %s", time.hour, time.minute, time.mday, time.month,
+                 time.year, time.cest ? "CEST" : "CET");
+
+        // DCF77 sends CET or CEST, the rtc and the system clock run on UTC
+        struct tm minute_time = {
+            .tm_min = time.minute,
+            .tm_hour = time.hour,
+            .tm_mday = time.mday,
+            .tm_mon = time.month - 1,
+            .tm_year = 100 + time.year,
+        };
+        time_t minute_utc = clockgusto_tz_make_utc(&minute_time) - (time.cest ? 2 : 1) * 3600;
+
+        // esp_timer_get_time() wraps the 32 bit ms stamps, undo it against the current time
+        now_us = esp_timer_get_time();
+        uint32_t age_ms = (uint32_t)(now_us / 1000) - minute_start_ms;
+        int64_t minute_start_us = now_us - (int64_t)age_ms * 1000 - DCF77_RECEIVER_LATENCY_MS * 1000;
+
+        // the time service slews to it, writes the rtc aligned and keeps the drift fit in step
+        clockgusto_time_set_reference(minute_utc, minute_start_us, DCF77_RECEIVER_ERROR_US);
+
+        listening = false;
+        dcf77_receiver_listen(false);
+    }
+}
+
+esp_err_t dcf77_receiver_start(gpio_num_t gpio_num, bool inverted)
+{
+    s_gpio_num = gpio_num;
+    s_inverted = inverted;
+    dcf77_decoder_reset(&s_decoder);
+
+    s_edges = xQueueCreate(DCF77_RECEIVER_QUEUE_LENGTH, sizeof(dcf77_edge_t));
+    if (!s_edges)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // without CONFIG_PM_ENABLE there is no light sleep to hold off
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "dcf77", &s_pm_lock) != ESP_OK)
+    {
+        s_pm_lock = NULL;
+    }
+
+    gpio_config_t io_config = {
+        .pin_bit_mask = 1ULL << gpio_num,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,   // most modules have an open collector output
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_ANYEDGE,
+    };
+    esp_err_t ret = gpio_config(&io_config);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to configure gpio.\n");
+        return ret;
+    }
+
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE)
+    {
+        ESP_LOGE(TAG, "Failed to install isr service.\n");
+        return ret;
+    }
+
+    if (xTaskCreate(dcf77_receiver_task, "dcf77", DCF77_RECEIVER_TASK_STACK,
+                    NULL, DCF77_RECEIVER_TASK_PRIORITY, NULL) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return gpio_isr_handler_add(gpio_num, dcf77_receiver_isr, NULL);
+}
+
+void dcf77_receiver_get_stats(uint32_t* frames_ok, uint32_t* frames_bad, uint32_t* glitches)
+{
+    *frames_ok = s_decoder.frames_ok;
+    *frames_bad = s_decoder.frames_bad;
+    *glitches = s_decoder.glitches;
+}
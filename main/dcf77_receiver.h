@@ -0,0 +1,14 @@
+#pragma once
+
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Timestamps receiver edges in a GPIO interrupt and decodes them on a task that sleeps on a queue,
+ *  so listening costs two interrupts per second. inverted is set for modules that pull the output
+ *  low while the carrier is reduced. */
+esp_err_t dcf77_receiver_start(gpio_num_t gpio_num, bool inverted);
+
+/** */
+void dcf77_receiver_get_stats(uint32_t* frames_ok, uint32_t* frames_bad, uint32_t* glitches);
@@ -1,58 +1,46 @@
 #include "rtc_ds3231.h"
 
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
 #include "esp_log.h"
-#include "driver/i2c.h"
-#include "hal/gpio_types.h"
-#include "hal/i2c_types.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
-#define I2C_MASTER_NUM        I2C_NUM_0
-#define I2C_MASTER_TIMEOUT_MS 1000
+#include "clockgusto_i2c.h"
+
+#define DS3231_MAX_BURST   7
+#define DS3231_DEADLINE_MS 100  // room for the retries, anything later is stale for the time service
 
 static const char *TAG = "rtc ds3231";
 
-static esp_err_t rtc_ds3231_write_register(uint8_t reg, uint8_t value)
-{
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (DS3231_ADDR << 1) | I2C_MASTER_WRITE, true); 
-    i2c_master_write_byte(cmd, reg, true);                                   
-    i2c_master_write_byte(cmd, value, true);                                 
-    i2c_master_stop(cmd);
+static clockgusto_i2c_device_t s_device;
 
-    esp_err_t ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
-    if (ret != ESP_OK)
+static esp_err_t rtc_ds3231_write_registers(uint8_t reg, const uint8_t* values, size_t count)
+{
+    if (count > DS3231_MAX_BURST)
     {
-        return ret;
+        return ESP_ERR_INVALID_SIZE;
     }
-    i2c_cmd_link_delete(cmd);
 
-    return ESP_OK;
+    uint8_t raw[1 + DS3231_MAX_BURST] = { reg };
+    memcpy(raw + 1, values, count);
+
+    return clockgusto_i2c_transfer(s_device, raw, 1 + count, NULL, 0);
 }
 
-static esp_err_t rtc_ds3231_read_register(uint8_t reg, uint8_t* value)
+static esp_err_t rtc_ds3231_read_registers(uint8_t reg, uint8_t* values, size_t count)
 {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (DS3231_ADDR << 1) | I2C_MASTER_WRITE, true); 
-    i2c_master_write_byte(cmd, reg, true);                                   
-    i2c_master_start(cmd);                                                  
-    i2c_master_write_byte(cmd, (DS3231_ADDR << 1) | I2C_MASTER_READ, true); 
-    i2c_master_read_byte(cmd, value, I2C_MASTER_NACK);                      
-    i2c_master_stop(cmd);
+    return clockgusto_i2c_transfer(s_device, &reg, 1, values, count);
+}
 
-    esp_err_t ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
-    if (ret != ESP_OK)
-    {
-        return ret;
-    }
-    i2c_cmd_link_delete(cmd);
+static esp_err_t rtc_ds3231_write_register(uint8_t reg, uint8_t value)
+{
+    return rtc_ds3231_write_registers(reg, &value, 1);
+}
 
-    return ESP_OK; 
+static esp_err_t rtc_ds3231_read_register(uint8_t reg, uint8_t* value)
+{
+    return rtc_ds3231_read_registers(reg, value, 1);
 }
 
 static uint8_t decimal_to_bcd(uint8_t decimal) 
@@ -67,26 +55,17 @@ static uint8_t bcd_to_decimal(uint8_t bcd)
 
 esp_err_t rtc_ds3231_init(uint8_t sda_pin, uint8_t scl_pin, uint32_t freq_hz)
 {
-    i2c_config_t i2c_config = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = sda_pin, // serial data line
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_io_num = scl_pin, // serial clock
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = freq_hz,
-    };
-
-    esp_err_t ret = i2c_param_config(I2C_NUM_0, &i2c_config);
+    esp_err_t ret = clockgusto_i2c_init(sda_pin, scl_pin, freq_hz);
     if (ret != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to init rtc ds3231.\n");         
+        ESP_LOGE(TAG, "Failed to init rtc ds3231.\n");
         return ret;
     }
 
-    ret = i2c_driver_install(I2C_MASTER_NUM, i2c_config.mode, 0, 0, 0);
+    ret = clockgusto_i2c_add_device(DS3231_ADDR, CLOCKGUSTO_I2C_PRIORITY_HIGH, DS3231_DEADLINE_MS, &s_device);
     if (ret != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to install driver.\n");
+        ESP_LOGE(TAG, "Failed to register rtc ds3231.\n");
         return ret;
     }
 
@@ -95,20 +74,18 @@ esp_err_t rtc_ds3231_init(uint8_t sda_pin, uint8_t scl_pin, uint32_t freq_hz)
 
 esp_err_t rtc_ds3231_set_time(uint8_t hours, uint8_t minutes, uint8_t seconds)
 {
-    esp_err_t ret = rtc_ds3231_write_register(DS3231_REG_SECONDS, (seconds / 10) << 4 | (seconds % 10));
-    if (ret != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Failed to write seconds\n");
-        return ret;
-    }
-    ret = rtc_ds3231_write_register(DS3231_REG_MINUTES, (minutes / 10) << 4 | (minutes % 10));
-    if (ret != ESP_OK)
-    {   
-        return ret;
-    }
-    ret = rtc_ds3231_write_register(DS3231_REG_HOURS, (hours / 10) << 4 | (hours % 10));
+    /* Seconds, minutes and hours go out in one burst. Writing the seconds register restarts the
+     * DS3231 countdown chain, so a single transaction keeps all three fields in step. */
+    uint8_t raw[3] = {
+        decimal_to_bcd(seconds),
+        decimal_to_bcd(minutes),
+        decimal_to_bcd(hours),
+    };
+
+    esp_err_t ret = rtc_ds3231_write_registers(DS3231_REG_SECONDS, raw, sizeof(raw));
     if (ret != ESP_OK)
     {
+        ESP_LOGE(TAG, "Failed to write time\n");
         return ret;
     }
 
@@ -117,29 +94,17 @@ esp_err_t rtc_ds3231_set_time(uint8_t hours, uint8_t minutes, uint8_t seconds)
 
 esp_err_t rtc_ds3231_get_time(uint8_t *hours, uint8_t *minutes, uint8_t *seconds)
 {
-    uint8_t raw_seconds = 0;
-    uint8_t raw_minutes = 0;
-    uint8_t raw_hours = 0;
+    uint8_t raw[3];
 
-    esp_err_t ret = rtc_ds3231_read_register(DS3231_REG_SECONDS, &raw_seconds);
-    if (ret != ESP_OK)
-    {
-        return ret;
-    }
-    ret = rtc_ds3231_read_register(DS3231_REG_MINUTES, &raw_minutes);
-    if (ret != ESP_OK)
-    {
-        return ret;
-    }
-    ret = rtc_ds3231_read_register(DS3231_REG_HOURS, &raw_hours);
+    esp_err_t ret = rtc_ds3231_read_registers(DS3231_REG_SECONDS, raw, sizeof(raw));
     if (ret != ESP_OK)
     {
         return ret;
     }
 
-    *seconds = (raw_seconds >> 4) * 10 + (raw_seconds & 0x0F);
-    *minutes = (raw_minutes >> 4) * 10 + (raw_minutes & 0x0F);
-    *hours = (raw_hours >> 4) * 10 + (raw_hours & 0x0F);
+    *seconds = bcd_to_decimal(raw[0] & 0x7F);
+    *minutes = bcd_to_decimal(raw[1] & 0x7F);
+    *hours = bcd_to_decimal(raw[2] & 0x3F);
     return ESP_OK;
 }
 
@@ -214,25 +179,207 @@ esp_err_t rtc_ds3231_get_date(uint8_t* day, uint8_t* date, uint8_t* month, uint8
 
 esp_err_t rtc_ds3231_get_temperature(float *temperature)
 {
-    uint8_t msb, lsb;
+    uint8_t raw[2];
 
-    esp_err_t ret = rtc_ds3231_read_register(DS3231_REG_TEMP_MSB, &msb);
+    esp_err_t ret = rtc_ds3231_read_registers(DS3231_REG_TEMP_MSB, raw, sizeof(raw));
     if (ret != ESP_OK)
     {
         return ret;
     }
-    ret = rtc_ds3231_read_register(DS3231_REG_TEMP_LSB, &lsb);
+
+    int8_t temp_integer = (int8_t)raw[0];
+
+    float temp_fraction = (raw[1] >> 6) * 0.25f;
+
+    *temperature = temp_integer + temp_fraction;
+
+    return ESP_OK;
+}
+
+esp_err_t rtc_ds3231_set_datetime(const struct tm* time)
+{
+    if (time->tm_year < 100 || time->tm_year > 299)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t century = time->tm_year >= 200 ? DS3231_MONTH_CENTURY : 0;
+    uint8_t raw[7] = {
+        decimal_to_bcd(time->tm_sec),
+        decimal_to_bcd(time->tm_min),
+        decimal_to_bcd(time->tm_hour),
+        decimal_to_bcd(time->tm_wday + 1),
+        decimal_to_bcd(time->tm_mday),
+        decimal_to_bcd(time->tm_mon + 1) | century,
+        decimal_to_bcd(time->tm_year % 100),
+    };
+
+    return rtc_ds3231_write_registers(DS3231_REG_SECONDS, raw, sizeof(raw));
+}
+
+esp_err_t rtc_ds3231_get_datetime(struct tm* time)
+{
+    uint8_t raw[7];
+
+    esp_err_t ret = rtc_ds3231_read_registers(DS3231_REG_SECONDS, raw, sizeof(raw));
     if (ret != ESP_OK)
     {
         return ret;
     }
 
-    int8_t temp_integer = (int8_t)msb;
+    *time = (struct tm){
+        .tm_sec = bcd_to_decimal(raw[0] & 0x7F),
+        .tm_min = bcd_to_decimal(raw[1] & 0x7F),
+        .tm_hour = bcd_to_decimal(raw[2] & 0x3F),
+        .tm_wday = bcd_to_decimal(raw[3] & 0x07) - 1,
+        .tm_mday = bcd_to_decimal(raw[4] & 0x3F),
+        .tm_mon = bcd_to_decimal(raw[5] & 0x1F) - 1,
+        .tm_year = bcd_to_decimal(raw[6]) + ((raw[5] & DS3231_MONTH_CENTURY) ? 200 : 100),
+        .tm_isdst = -1,
+    };
 
-    float temp_fraction = (lsb >> 6) * 0.25f;
+    return ESP_OK;
+}
 
-    *temperature = temp_integer + temp_fraction;
+esp_err_t rtc_ds3231_get_oscillator_stopped(bool* stopped)
+{
+    uint8_t status;
+
+    esp_err_t ret = rtc_ds3231_read_register(DS3231_REG_STATUS, &status);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    *stopped = (status & DS3231_STATUS_OSF) != 0;
+    return ESP_OK;
+}
+
+esp_err_t rtc_ds3231_clear_oscillator_stopped()
+{
+    uint8_t status;
 
+    esp_err_t ret = rtc_ds3231_read_register(DS3231_REG_STATUS, &status);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    return rtc_ds3231_write_register(DS3231_REG_STATUS, status & ~DS3231_STATUS_OSF);
+}
+
+esp_err_t rtc_ds3231_get_aging_offset(int8_t* offset)
+{
+    uint8_t raw;
+
+    esp_err_t ret = rtc_ds3231_read_register(DS3231_REG_AGING, &raw);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    *offset = (int8_t)raw;
     return ESP_OK;
 }
 
+esp_err_t rtc_ds3231_set_aging_offset(int8_t offset)
+{
+    esp_err_t ret = rtc_ds3231_write_register(DS3231_REG_AGING, (uint8_t)offset);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    uint8_t status;
+    ret = rtc_ds3231_read_register(DS3231_REG_STATUS, &status);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    if (status & DS3231_STATUS_BSY)
+    {
+        // a conversion is already running and picks up the new offset
+        return ESP_OK;
+    }
+
+    uint8_t control;
+    ret = rtc_ds3231_read_register(DS3231_REG_CONTROL, &control);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    return rtc_ds3231_write_register(DS3231_REG_CONTROL, control | DS3231_CONTROL_CONV);
+}
+
+esp_err_t rtc_ds3231_set_alarm1_daily(uint8_t hours, uint8_t minutes, uint8_t seconds)
+{
+    if (hours > 23 || minutes > 59 || seconds > 59)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // A1M4 set: the day is ignored
+    uint8_t raw[4] = {
+        decimal_to_bcd(seconds),
+        decimal_to_bcd(minutes),
+        decimal_to_bcd(hours),
+        DS3231_ALARM_MASK | 1,
+    };
+
+    return rtc_ds3231_write_registers(DS3231_REG_ALARM1, raw, sizeof(raw));
+}
+
+esp_err_t rtc_ds3231_set_alarm2_daily(uint8_t hours, uint8_t minutes)
+{
+    if (hours > 23 || minutes > 59)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // A2M4 set: the day is ignored
+    uint8_t raw[3] = {
+        decimal_to_bcd(minutes),
+        decimal_to_bcd(hours),
+        DS3231_ALARM_MASK | 1,
+    };
+
+    return rtc_ds3231_write_registers(DS3231_REG_ALARM2, raw, sizeof(raw));
+}
+
+esp_err_t rtc_ds3231_set_alarm_interrupts(bool alarm1, bool alarm2)
+{
+    uint8_t control;
+
+    esp_err_t ret = rtc_ds3231_read_register(DS3231_REG_CONTROL, &control);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    control &= ~(DS3231_CONTROL_A1IE | DS3231_CONTROL_A2IE | DS3231_CONTROL_CONV);
+    control |= DS3231_CONTROL_INTCN;
+    control |= alarm1 ? DS3231_CONTROL_A1IE : 0;
+    control |= alarm2 ? DS3231_CONTROL_A2IE : 0;
+
+    return rtc_ds3231_write_register(DS3231_REG_CONTROL, control);
+}
+
+esp_err_t rtc_ds3231_take_alarm_flags(uint8_t* flags)
+{
+    uint8_t status;
+
+    esp_err_t ret = rtc_ds3231_read_register(DS3231_REG_STATUS, &status);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    *flags = status & (DS3231_STATUS_A1F | DS3231_STATUS_A2F);
+    if (*flags == 0)
+    {
+        return ESP_OK;
+    }
+
+    return rtc_ds3231_write_register(DS3231_REG_STATUS, status & ~*flags);
+}
@@ -6,6 +6,7 @@
 #include "esp_err.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
 
 #define DS3231_ADDR 0x68  // I2C-Address of DS3231
 
@@ -21,9 +22,22 @@
 #define DS3231_REG_ALARM2   0x0B
 #define DS3231_REG_CONTROL  0x0E
 #define DS3231_REG_STATUS   0x0F
+#define DS3231_REG_AGING    0x10
 #define DS3231_REG_TEMP_MSB 0x11
 #define DS3231_REG_TEMP_LSB 0x12
 
+// Bits
+#define DS3231_MONTH_CENTURY 0x80
+#define DS3231_ALARM_MASK    0x80
+#define DS3231_CONTROL_CONV  0x20
+#define DS3231_CONTROL_INTCN 0x04
+#define DS3231_CONTROL_A2IE  0x02
+#define DS3231_CONTROL_A1IE  0x01
+#define DS3231_STATUS_OSF    0x80
+#define DS3231_STATUS_BSY    0x04
+#define DS3231_STATUS_A2F    0x02
+#define DS3231_STATUS_A1F    0x01
+
 /** */
 esp_err_t rtc_ds3231_init(uint8_t sda_pin, uint8_t scl_pin, uint32_t freq_hz);
 
@@ -42,4 +56,36 @@ esp_err_t rtc_ds3231_get_date(uint8_t* day, uint8_t* date, uint8_t* month, uint8
 /** */
 esp_err_t rtc_ds3231_get_temperature(float* temperature);
 
+/** Writes seconds through year in one burst so every field restarts on the same second. */
+esp_err_t rtc_ds3231_set_datetime(const struct tm* time);
+
+/** Reads seconds through year in one burst, so no field can roll over between reads. */
+esp_err_t rtc_ds3231_get_datetime(struct tm* time);
+
+/** Reports whether the oscillator stopped since the flag was last cleared, i.e. the time is invalid. */
+esp_err_t rtc_ds3231_get_oscillator_stopped(bool* stopped);
+
+/** */
+esp_err_t rtc_ds3231_clear_oscillator_stopped();
+
+/** */
+esp_err_t rtc_ds3231_get_aging_offset(int8_t* offset);
+
+/** Writes the aging offset and forces a temperature conversion so the new load capacitance applies
+ *  at once instead of at the next 64 s conversion. One LSB is roughly 0.1 ppm, positive slows down. */
+esp_err_t rtc_ds3231_set_aging_offset(int8_t offset);
+
+/** Alarm 1 fires every day when hours, minutes and seconds match. */
+esp_err_t rtc_ds3231_set_alarm1_daily(uint8_t hours, uint8_t minutes, uint8_t seconds);
+
+/** Alarm 2 fires every day when hours and minutes match, at second 00. */
+esp_err_t rtc_ds3231_set_alarm2_daily(uint8_t hours, uint8_t minutes);
+
+/** Routes the enabled alarms to the INT/SQW pin, which then stops putting out the square wave. */
+esp_err_t rtc_ds3231_set_alarm_interrupts(bool alarm1, bool alarm2);
+
+/** Returns the DS3231_STATUS_A1F and DS3231_STATUS_A2F bits that were set and clears them, which
+ *  releases the INT/SQW pin. */
+esp_err_t rtc_ds3231_take_alarm_flags(uint8_t* flags);
+
 #endif
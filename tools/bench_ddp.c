@@ -0,0 +1,198 @@
+/* Loopback test and benchmark of the DDP decoder in main/clockgusto_ddp.c, and a sender for the clock.
+ *
+ *     cc -O2 -Imain tools/bench_ddp.c main/clockgusto_ddp.c -o bench_ddp
+ *     ./bench_ddp [frames] [packets per frame]      decode over 127.0.0.1, check every frame
+ *     ./bench_ddp --target <clock ip> [fps]         drive the face with a rainbow, Ctrl-C to stop
+ *
+ * The loopback run sends each frame through a UDP socket on 127.0.0.1 and decodes it the way the
+ * firmware does, feeding every datagram to the decoder in random slices like a chained pbuf. It
+ * checks the decoded frame against the expected strip bytes and reports the throughput and the
+ * send to decoded latency. On the clock the packet to photon latency is in /api/status, realtime. */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "clockgusto_ddp.h"
+
+#define NUM_LEDS   114     // CLOCKGUSTO_NUM_LEDS, clockgusto.h needs ESP-IDF
+#define FRAME_SIZE (NUM_LEDS * 3)
+
+static double now_s()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/** RGB pixels for frame number n, different in every frame and pixel. */
+static void make_rgb(uint8_t* rgb, uint32_t n)
+{
+    for (int idx = 0; idx < FRAME_SIZE; ++idx)
+    {
+        rgb[idx] = (uint8_t)(idx * 7 + n * 13 + (idx % 3) * 101);
+    }
+}
+
+/** Sends one frame as packets DDP packets, push flag on the last. */
+static void send_frame(int sock, const struct sockaddr_in* to, const uint8_t* rgb, int packets, uint8_t sequence)
+{
+    uint8_t datagram[CLOCKGUSTO_DDP_MAX_HEADER_SIZE + FRAME_SIZE];
+    int chunk = (FRAME_SIZE + packets - 1) / packets;
+    for (int offset = 0; offset < FRAME_SIZE; offset += chunk)
+    {
+        int length = offset + chunk > FRAME_SIZE ? FRAME_SIZE - offset : chunk;
+        uint8_t flags = offset + length >= FRAME_SIZE ? CLOCKGUSTO_DDP_FLAG_PUSH : 0;
+        size_t header_size = clockgusto_ddp_build_header(datagram, flags, sequence, offset, (uint16_t)length);
+        memcpy(datagram + header_size, rgb + offset, length);
+        sendto(sock, datagram, header_size + length, 0, (const struct sockaddr*)to, sizeof(*to));
+    }
+}
+
+/** Decodes one datagram in random slices, true when it carried the push flag. */
+static bool receive_datagram(const uint8_t* datagram, size_t size, uint8_t* frame, uint32_t* rejected)
+{
+    clockgusto_ddp_header_t header;
+    if (!clockgusto_ddp_parse_header(datagram, size, &header))
+    {
+        (*rejected)++;
+        return false;
+    }
+
+    size_t remaining = size - header.size < header.length ? size - header.size : header.length;
+    const uint8_t* data = datagram + header.size;
+    uint32_t offset = header.offset;
+    while (remaining > 0)
+    {
+        size_t slice = 1 + rand() % remaining;
+        clockgusto_ddp_write(frame, FRAME_SIZE, offset, data, slice);
+        data += slice;
+        offset += slice;
+        remaining -= slice;
+    }
+
+    return header.flags & CLOCKGUSTO_DDP_FLAG_PUSH;
+}
+
+static int loopback(long frames, int packets)
+{
+    int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+    int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in address = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t address_size = sizeof(address);
+    if (bind(receiver, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        getsockname(receiver, (struct sockaddr*)&address, &address_size) != 0)
+    {
+        perror("bind");
+        return 1;
+    }
+
+    uint8_t rgb[FRAME_SIZE];
+    uint8_t expected[FRAME_SIZE];
+    uint8_t frame[FRAME_SIZE];
+    uint8_t datagram[2048];
+    uint32_t rejected = 0;
+    long mismatches = 0;
+    double latency_sum = 0.0;
+    double latency_max = 0.0;
+
+    srand(1);
+    double start = now_s();
+    for (long n = 0; n < frames; ++n)
+    {
+        make_rgb(rgb, (uint32_t)n);
+        // the decoder's own reordering, written out once by hand
+        for (int pixel = 0; pixel < NUM_LEDS; ++pixel)
+        {
+            expected[pixel * 3 + 0] = rgb[pixel * 3 + 1];
+            expected[pixel * 3 + 1] = rgb[pixel * 3 + 2];
+            expected[pixel * 3 + 2] = rgb[pixel * 3 + 0];
+        }
+
+        double sent = now_s();
+        send_frame(sender, &address, rgb, packets, (uint8_t)(n % 15 + 1));
+        bool pushed = false;
+        while (!pushed)
+        {
+            ssize_t size = recv(receiver, datagram, sizeof(datagram), 0);
+            if (size < 0)
+            {
+                perror("recv");
+                return 1;
+            }
+            pushed = receive_datagram(datagram, (size_t)size, frame, &rejected);
+        }
+        double latency = now_s() - sent;
+        latency_sum += latency;
+        latency_max = latency > latency_max ? latency : latency_max;
+        mismatches += memcmp(frame, expected, FRAME_SIZE) != 0;
+    }
+    double elapsed = now_s() - start;
+
+    // a packet the firmware has to turn away, and one past the end of the strip
+    uint8_t bad[CLOCKGUSTO_DDP_HEADER_SIZE] = { 0x80, 0, 0x0b, 1, 0, 0, 0, 0, 0, 0 };
+    uint32_t bad_rejected = 0;
+    receive_datagram(bad, sizeof(bad), frame, &bad_rejected);
+    uint8_t beyond[CLOCKGUSTO_DDP_HEADER_SIZE + 3];
+    clockgusto_ddp_build_header(beyond, CLOCKGUSTO_DDP_FLAG_PUSH, 1, FRAME_SIZE, 3);
+    memcpy(frame, expected, FRAME_SIZE);
+    receive_datagram(beyond, sizeof(beyond), frame, &bad_rejected);
+    bool edges_ok = bad_rejected == 1 && memcmp(frame, expected, FRAME_SIZE) == 0;
+
+    printf("%ld frames of %d packets: %.0f frames/s, %.1f Mbit/s, latency avg %.1f us max %.1f us\n", frames,
+           packets, frames / elapsed, frames * (FRAME_SIZE + packets * CLOCKGUSTO_DDP_HEADER_SIZE) * 8 / elapsed / 1e6,
+           latency_sum / frames * 1e6, latency_max * 1e6);
+    printf("%ld mismatched frames, %u rejected packets, edge cases %s\n", mismatches, rejected,
+           edges_ok ? "ok" : "FAILED");
+
+    close(sender);
+    close(receiver);
+    return mismatches == 0 && rejected == 0 && edges_ok ? 0 : 1;
+}
+
+static int drive(const char* target, double fps)
+{
+    int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in address = { .sin_family = AF_INET, .sin_port = htons(CLOCKGUSTO_DDP_PORT) };
+    if (inet_pton(AF_INET, target, &address.sin_addr) != 1)
+    {
+        fprintf(stderr, "not an ipv4 address: %s\n", target);
+        return 1;
+    }
+
+    uint8_t rgb[FRAME_SIZE];
+    for (uint32_t n = 0;; ++n)
+    {
+        for (int pixel = 0; pixel < NUM_LEDS; ++pixel)
+        {
+            // a hue wheel at a quarter of full power
+            uint32_t hue = (pixel * 256 / NUM_LEDS + n * 4) % 256;
+            uint8_t rise = (uint8_t)(hue % 85 * 3 / 4);
+            uint8_t fall = (uint8_t)(63 - rise);
+            rgb[pixel * 3 + 0] = hue < 85 ? fall : (hue < 170 ? 0 : rise);
+            rgb[pixel * 3 + 1] = hue < 85 ? rise : (hue < 170 ? fall : 0);
+            rgb[pixel * 3 + 2] = hue < 85 ? 0 : (hue < 170 ? rise : fall);
+        }
+        send_frame(sender, &address, rgb, 1, (uint8_t)(n % 15 + 1));
+        usleep((useconds_t)(1e6 / fps));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 2 && strcmp(argv[1], "--target") == 0)
+    {
+        return drive(argv[2], argc > 3 ? atof(argv[3]) : 40.0);
+    }
+
+    long frames = argc > 1 ? atol(argv[1]) : 100000;
+    int packets = argc > 2 ? atoi(argv[2]) : 1;
+    return loopback(frames, packets < 1 ? 1 : packets);
+}
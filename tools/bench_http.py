@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""Measures latency and throughput of the clock's REST API the way the app polls it.
+
+Every worker keeps one connection alive and requests the endpoints in turn. The report holds the
+throughput and the latency percentiles per endpoint, time to the response headers (first byte)
+and to the last byte.
+
+    python3 tools/bench_http.py 192.168.1.42 --seconds 10 --workers 2
+    python3 tools/bench_http.py 192.168.1.42 --webui
+    python3 tools/bench_http.py 192.168.1.42 --webui --revalidate
+    python3 tools/bench_http.py --stand-in
+
+--webui fetches the files of the web UI instead, gzipped like a browser asks for them.
+--revalidate sends the ETag of the first answer back, so the clock answers 304 from it alone.
+
+--stand-in serves canned responses from a local server instead, which gives the overhead of this
+client and the host network stack as a baseline.
+"""
+import argparse
+import http.client
+import http.server
+import json
+import socket
+import threading
+import time
+
+ENDPOINTS = ["/api/time", "/api/status", "/api/brightness", "/api/mode"]
+WEBUI_ENDPOINTS = ["/", "/app.js", "/style.css"]
+
+STAND_IN_RESPONSES = {
+    "/api/time": {"utc": 0, "local": "2025-01-12T12:00:00", "synced": True, "accuracy_ms": 0, "degraded": False},
+    "/api/status": {"uptime_s": 0, "free_heap": 0, "min_free_heap": 0, "render_errors": 0},
+    "/api/brightness": {"brightness": 100, "night_level": 100, "derating": 100},
+    "/api/mode": {"mode": "clock"},
+}
+
+
+class StandInHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    disable_nagle_algorithm = True
+
+    def do_GET(self):
+        body = json.dumps(STAND_IN_RESPONSES.get(self.path.split("?")[0], {})).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, format, *args):
+        pass
+
+
+def start_stand_in():
+    server = http.server.ThreadingHTTPServer(("127.0.0.1", 0), StandInHandler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server.server_address
+
+
+def connect(host, port):
+    connection = http.client.HTTPConnection(host, port, timeout=5)
+    connection.connect()
+    # the request goes out in one segment, delayed acks would otherwise dominate the figures
+    connection.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    return connection
+
+
+def worker(host, port, deadline, endpoints, revalidate, samples, errors):
+    connection = connect(host, port)
+    etags = {}
+    request = 0
+    while time.monotonic() < deadline:
+        path = endpoints[request % len(endpoints)]
+        request += 1
+        headers = {"Accept-Encoding": "gzip"}
+        if revalidate and path in etags:
+            headers["If-None-Match"] = etags[path]
+        start = time.perf_counter()
+        try:
+            connection.request("GET", path, headers=headers)
+            response = connection.getresponse()
+            first_byte = time.perf_counter()
+            response.read()
+            if response.status not in (200, 304):
+                errors.append(path)
+                continue
+            if response.getheader("ETag"):
+                etags[path] = response.getheader("ETag")
+        except (OSError, http.client.HTTPException):
+            errors.append(path)
+            connection.close()
+            try:
+                connection = connect(host, port)
+            except OSError:
+                time.sleep(0.1)
+            continue
+        samples.setdefault(path, []).append((first_byte - start, time.perf_counter() - start))
+    connection.close()
+
+
+def percentile(values, fraction):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host", nargs="?", help="address of the clock")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--seconds", type=float, default=10.0)
+    parser.add_argument("--workers", type=int, default=1)
+    parser.add_argument("--webui", action="store_true", help="fetch the web UI files instead of the API")
+    parser.add_argument("--revalidate", action="store_true", help="send If-None-Match with the last ETag")
+    parser.add_argument("--stand-in", action="store_true", help="benchmark a local stand-in server")
+    args = parser.parse_args()
+
+    if args.stand_in:
+        host, port = start_stand_in()
+    elif args.host:
+        host, port = args.host, args.port
+    else:
+        parser.error("host or --stand-in required")
+
+    endpoints = WEBUI_ENDPOINTS if args.webui else ENDPOINTS
+    deadline = time.monotonic() + args.seconds
+    results = [({}, []) for _ in range(args.workers)]
+    threads = [threading.Thread(target=worker, args=(host, port, deadline, endpoints, args.revalidate) + result)
+               for result in results]
+    started = time.monotonic()
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.monotonic() - started
+
+    samples = {}
+    errors = 0
+    for worker_samples, worker_errors in results:
+        errors += len(worker_errors)
+        for path, values in worker_samples.items():
+            samples.setdefault(path, []).extend(values)
+
+    total = sum(len(values) for values in samples.values())
+    print("%s:%d, %d workers, %.1f s: %d requests, %.1f req/s, %d errors" %
+          (host, port, args.workers, elapsed, total, total / elapsed, errors))
+    print("%-18s %8s %8s %8s %8s %8s" % ("endpoint", "ttfb p50", "p50 ms", "p95 ms", "p99 ms", "max ms"))
+    for path in endpoints:
+        if path in samples:
+            first_bytes = [first_byte for first_byte, _ in samples[path]]
+            values = [total for _, total in samples[path]]
+            print("%-18s %8.2f %8.2f %8.2f %8.2f %8.2f" % (path, percentile(first_bytes, 0.5) * 1000,
+                                                          percentile(values, 0.5) * 1000,
+                                                          percentile(values, 0.95) * 1000,
+                                                          percentile(values, 0.99) * 1000, max(values) * 1000))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,279 @@
+/* Host fuzz and benchmark of main/clockgusto_json.c, optionally side by side with cJSON, the JSON
+ * library ESP-IDF ships.
+ *
+ *     cc -O2 -g -fsanitize=address,undefined -Imain -I$IDF_PATH/components/json/cJSON \
+ *        tools/bench_json.c main/clockgusto_json.c $IDF_PATH/components/json/cJSON/cJSON.c -o bench_json
+ *     ./bench_json [fuzz iterations] [benchmark iterations]
+ *
+ * Without ESP-IDF, python3 tools/fetch_cjson.py puts cJSON into tools/cjson/, use -Itools/cjson and
+ * tools/cjson/cJSON.c instead. With -DBENCH_JSON_NO_CJSON it builds from main/ alone and runs only
+ * clockgusto_json: the sanitizers still check every input, the cJSON columns stay empty.
+ *
+ * The fuzzer mutates the API's request bodies and feeds both parsers. The sanitizers catch any out of
+ * bounds read, and every syntax verdict where the two parsers disagree is counted. The benchmark
+ * parses every body into its struct with both parsers. It reports the time per body, the heap cJSON
+ * allocates and the arena a request needs with clockgusto_json. Drop the sanitizers for the timing
+ * figures. No run with cJSON has been recorded for this tree yet. */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef BENCH_JSON_NO_CJSON
+#include "cJSON.h"
+#endif
+#include "clockgusto_json.h"
+
+typedef struct _bench_alarm_t
+{
+    bool enabled;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t days;
+    bool sunrise;
+    int32_t latitude_e4;
+    char mode[32];
+    int64_t utc;
+} bench_alarm_t;
+
+static const clockgusto_json_field_t s_fields[] = {
+    CLOCKGUSTO_JSON_FIELD(bench_alarm_t, enabled, "enabled", CLOCKGUSTO_JSON_BOOL, 0, 1),
+    CLOCKGUSTO_JSON_FIELD(bench_alarm_t, hour, "hour", CLOCKGUSTO_JSON_INT, 0, 23),
+    CLOCKGUSTO_JSON_FIELD(bench_alarm_t, minute, "minute", CLOCKGUSTO_JSON_INT, 0, 59),
+    CLOCKGUSTO_JSON_FIELD(bench_alarm_t, days, "days", CLOCKGUSTO_JSON_INT, 0, 0x7f),
+    CLOCKGUSTO_JSON_FIELD(bench_alarm_t, sunrise, "sunrise", CLOCKGUSTO_JSON_BOOL, 0, 1),
+    CLOCKGUSTO_JSON_FIELD(bench_alarm_t, latitude_e4, "latitude", CLOCKGUSTO_JSON_FIXED4, -900000, 900000),
+    CLOCKGUSTO_JSON_FIELD(bench_alarm_t, mode, "mode", CLOCKGUSTO_JSON_STRING, 1, 0),
+    CLOCKGUSTO_JSON_FIELD(bench_alarm_t, utc, "utc", CLOCKGUSTO_JSON_INT, 1, INT32_MAX),
+};
+#define FIELD_COUNT ((uint8_t)(sizeof(s_fields) / sizeof(s_fields[0])))
+
+static const char* s_bodies[] = {
+    "{\"utc\":1736683200}",
+    "{\"brightness\":80}",
+    "{\"mode\":\"temperature\"}",
+    "{\"enabled\":true,\"hour\":6,\"minute\":45,\"days\":62,\"sunrise\":true}",
+    "{\"enabled\":true,\"latitude\":52.5200,\"longitude\":13.4050,\"night_level\":20,\"twilight_min\":60}",
+    "{ \"mode\" : \"clock\", \"extra\" : [1, 2.5, {\"nested\": null}, \"k\\u00fcche\"], \"hour\" : 7 }",
+};
+#define BODY_COUNT (sizeof(s_bodies) / sizeof(s_bodies[0]))
+
+#ifndef BENCH_JSON_NO_CJSON
+static size_t s_heap_used = 0;
+static size_t s_heap_peak = 0;
+static size_t s_heap_allocations = 0;
+
+static void* counting_malloc(size_t size)
+{
+    size_t* block = malloc(sizeof(size_t) + size);
+    if (!block)
+    {
+        return NULL;
+    }
+    *block = size;
+    s_heap_used += size;
+    s_heap_allocations++;
+    if (s_heap_used > s_heap_peak)
+    {
+        s_heap_peak = s_heap_used;
+    }
+    return block + 1;
+}
+
+static void counting_free(void* pointer)
+{
+    if (!pointer)
+    {
+        return;
+    }
+    size_t* block = (size_t*)pointer - 1;
+    s_heap_used -= *block;
+    free(block);
+}
+
+/** The cJSON way of filling the same struct: build the tree, look every key up, delete the tree. */
+static bool parse_cjson(const char* json, size_t length, bench_alarm_t* alarm)
+{
+    cJSON* root = cJSON_ParseWithLength(json, length);
+    if (!root)
+    {
+        return false;
+    }
+
+    bool ok = cJSON_IsObject(root);
+    cJSON* item;
+    if ((item = cJSON_GetObjectItemCaseSensitive(root, "enabled")) && cJSON_IsBool(item))
+    {
+        alarm->enabled = cJSON_IsTrue(item);
+    }
+    if ((item = cJSON_GetObjectItemCaseSensitive(root, "hour")) && cJSON_IsNumber(item))
+    {
+        ok = ok && item->valueint >= 0 && item->valueint <= 23;
+        alarm->hour = (uint8_t)item->valueint;
+    }
+    if ((item = cJSON_GetObjectItemCaseSensitive(root, "minute")) && cJSON_IsNumber(item))
+    {
+        ok = ok && item->valueint >= 0 && item->valueint <= 59;
+        alarm->minute = (uint8_t)item->valueint;
+    }
+    if ((item = cJSON_GetObjectItemCaseSensitive(root, "days")) && cJSON_IsNumber(item))
+    {
+        alarm->days = (uint8_t)item->valueint;
+    }
+    if ((item = cJSON_GetObjectItemCaseSensitive(root, "sunrise")) && cJSON_IsBool(item))
+    {
+        alarm->sunrise = cJSON_IsTrue(item);
+    }
+    if ((item = cJSON_GetObjectItemCaseSensitive(root, "latitude")) && cJSON_IsNumber(item))
+    {
+        alarm->latitude_e4 = (int32_t)(item->valuedouble * 10000);
+    }
+    if ((item = cJSON_GetObjectItemCaseSensitive(root, "mode")) && cJSON_IsString(item))
+    {
+        snprintf(alarm->mode, sizeof(alarm->mode), "%s", item->valuestring);
+    }
+    if ((item = cJSON_GetObjectItemCaseSensitive(root, "utc")) && cJSON_IsNumber(item))
+    {
+        alarm->utc = (int64_t)item->valuedouble;
+    }
+
+    cJSON_Delete(root);
+    return ok;
+}
+#endif
+
+static double now_s()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void fuzz(long iterations)
+{
+    static const char alphabet[] = "{}[]\",:\\0123456789.-+eEtrufalsn u";
+    char buffer[512];
+    long disagreements = 0;
+    long accepted = 0;
+
+    srand(1);
+    for (long iteration = 0; iteration < iterations; ++iteration)
+    {
+        const char* seed = s_bodies[rand() % BODY_COUNT];
+        size_t length = strlen(seed);
+        memcpy(buffer, seed, length);
+
+        int mutations = 1 + rand() % 4;
+        for (int mutation = 0; mutation < mutations && length > 0; ++mutation)
+        {
+            size_t pos = rand() % length;
+            switch (rand() % 4)
+            {
+            case 0:
+                buffer[pos] = (char)(rand() % 256);
+                break;
+            case 1:
+                memmove(buffer + pos, buffer + pos + 1, length - pos - 1);
+                length--;
+                break;
+            case 2:
+                if (length < sizeof(buffer) - 1)
+                {
+                    memmove(buffer + pos + 1, buffer + pos, length - pos);
+                    buffer[pos] = alphabet[rand() % (sizeof(alphabet) - 1)];
+                    length++;
+                }
+                break;
+            default:
+                length = pos;   // truncated body
+                break;
+            }
+        }
+
+        // an exact sized copy, so the sanitizer sees any read past the end
+        char* input = malloc(length ? length : 1);
+        memcpy(input, buffer, length);
+
+        bench_alarm_t alarm;
+        uint32_t found = 0;
+        clockgusto_json_result_t result = clockgusto_json_parse(input, length, s_fields, FIELD_COUNT, &alarm, &found);
+        accepted += result == CLOCKGUSTO_JSON_OK;
+#ifndef BENCH_JSON_NO_CJSON
+        cJSON* root = cJSON_ParseWithLength(input, length);
+        bool cjson_valid = root && cJSON_IsObject(root);
+        cJSON_Delete(root);
+        disagreements += (result != CLOCKGUSTO_JSON_SYNTAX && result != CLOCKGUSTO_JSON_DEPTH) != cjson_valid;
+#endif
+        free(input);
+    }
+
+#ifdef BENCH_JSON_NO_CJSON
+    (void)disagreements;
+    printf("fuzz: %ld inputs, %ld accepted, no cJSON to compare with\n", iterations, accepted);
+#else
+    printf("fuzz: %ld inputs, %ld accepted, %ld syntax verdicts differ from cJSON\n", iterations, accepted,
+           disagreements);
+#endif
+}
+
+static void benchmark(long iterations)
+{
+    uint8_t arena_buffer[1024];
+    clockgusto_arena_t arena;
+    clockgusto_arena_init(&arena, arena_buffer, sizeof(arena_buffer));
+
+    printf("%-6s %12s %12s %12s %10s %12s\n", "body", "bytes", "ours ns", "cJSON ns", "arena B", "cJSON heap B");
+    for (size_t body = 0; body < BODY_COUNT; ++body)
+    {
+        const char* json = s_bodies[body];
+        size_t length = strlen(json);
+
+        // the arena holds the received body, exactly as the http handlers use it
+        double start = now_s();
+        for (long iteration = 0; iteration < iterations; ++iteration)
+        {
+            clockgusto_arena_reset(&arena);
+            char* copy = clockgusto_arena_alloc(&arena, length);
+            memcpy(copy, json, length);
+            bench_alarm_t alarm;
+            uint32_t found = 0;
+            clockgusto_json_parse(copy, length, s_fields, FIELD_COUNT, &alarm, &found);
+        }
+        double ours_ns = (now_s() - start) / iterations * 1e9;
+
+#ifdef BENCH_JSON_NO_CJSON
+        printf("%-6zu %12zu %12.0f %12s %10zu %12s\n", body, length, ours_ns, "-", arena.peak, "-");
+#else
+        s_heap_peak = 0;
+        s_heap_allocations = 0;
+        start = now_s();
+        for (long iteration = 0; iteration < iterations; ++iteration)
+        {
+            bench_alarm_t alarm;
+            parse_cjson(json, length, &alarm);
+        }
+        double cjson_ns = (now_s() - start) / iterations * 1e9;
+
+        printf("%-6zu %12zu %12.0f %12.0f %10zu %12zu\n", body, length, ours_ns, cjson_ns, arena.peak, s_heap_peak);
+        printf("%-6s %12s %12s %12s %10s %12.1f allocations per parse\n", "", "", "", "", "",
+               (double)s_heap_allocations / iterations);
+#endif
+    }
+}
+
+int main(int argc, char** argv)
+{
+#ifndef BENCH_JSON_NO_CJSON
+    cJSON_Hooks hooks = { .malloc_fn = counting_malloc, .free_fn = counting_free };
+    cJSON_InitHooks(&hooks);
+#endif
+
+    long fuzz_iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    long bench_iterations = argc > 2 ? atol(argv[2]) : 200000;
+    fuzz(fuzz_iterations);
+    benchmark(bench_iterations);
+    return 0;
+}
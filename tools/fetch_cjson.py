@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+"""Fetches cJSON for the host build of tools/bench_json.c, for machines without an ESP-IDF checkout.
+
+The two files land in tools/cjson/, which git ignores. Pick the tag the components/json/cJSON
+submodule of the ESP-IDF in use points at, so the comparison runs the same parser as the firmware.
+
+    python3 tools/fetch_cjson.py [--tag v1.7.18]
+    cc -O2 -Imain -Itools/cjson tools/bench_json.c main/clockgusto_json.c tools/cjson/cJSON.c -o bench_json
+"""
+import argparse
+import os
+import sys
+import urllib.request
+
+URL = "https://raw.githubusercontent.com/DaveGamble/cJSON/{tag}/{name}"
+FILES = ("cJSON.c", "cJSON.h")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--tag", default="v1.7.18", help="cJSON release tag")
+    parser.add_argument("--out", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "cjson"),
+                        help="target directory")
+    args = parser.parse_args()
+
+    os.makedirs(args.out, exist_ok=True)
+    for name in FILES:
+        url = URL.format(tag=args.tag, name=name)
+        try:
+            with urllib.request.urlopen(url, timeout=30) as response:
+                data = response.read()
+        except OSError as error:
+            print(f"{url}: {error}", file=sys.stderr)
+            return 1
+        with open(os.path.join(args.out, name), "wb") as f:
+            f.write(data)
+        print(f"{name}: {len(data)} bytes from {args.tag}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""Generates main/clockgusto_sunrise_table.h, the colour curve of the alarm sunrise.
+
+The light starts as a dim deep red around 1000 K and ends as a bright 5500 K white. Brightness
+follows a power curve, so the steps stay even to the eye. The colour temperature warms up faster
+than the light grows, like a real sunrise. Firmware interpolates between neighbouring entries.
+
+    python3 tools/gen_sunrise_table.py > main/clockgusto_sunrise_table.h
+"""
+import math
+
+POINTS = 64
+KELVIN_START = 1000
+KELVIN_END = 5500
+BRIGHTNESS_GAMMA = 2.2
+KELVIN_GAMMA = 0.6
+
+
+def kelvin_to_rgb(kelvin):
+    """Tanner Helland's fit of the black body colour, good enough for 1000 K .. 40000 K."""
+    temp = kelvin / 100.0
+    if temp <= 66:
+        red = 255.0
+        green = 99.4708025861 * math.log(temp) - 161.1195681661
+    else:
+        red = 329.698727446 * math.pow(temp - 60, -0.1332047592)
+        green = 288.1221695283 * math.pow(temp - 60, -0.0755148492)
+    if temp >= 66:
+        blue = 255.0
+    elif temp <= 19:
+        blue = 0.0
+    else:
+        blue = 138.5177312231 * math.log(temp - 10) - 305.0447927307
+
+    return [min(255.0, max(0.0, channel)) for channel in (red, green, blue)]
+
+
+def main():
+    print("#pragma once")
+    print()
+    print("#include <stdint.h>")
+    print()
+    print("/* Generated by tools/gen_sunrise_table.py, do not edit. */")
+    print()
+    print("#define CLOCKGUSTO_SUNRISE_TABLE_POINTS %d" % POINTS)
+    print()
+    print("/** Green, blue, red in strip byte order, evenly spaced over the sunrise, the last entry is daylight. */")
+    print("static const uint8_t clockgusto_sunrise_table[CLOCKGUSTO_SUNRISE_TABLE_POINTS][3] = {")
+    for point in range(POINTS):
+        progress = point / (POINTS - 1)
+        kelvin = KELVIN_START + (KELVIN_END - KELVIN_START) * math.pow(progress, KELVIN_GAMMA)
+        brightness = math.pow(progress, BRIGHTNESS_GAMMA)
+        red, green, blue = (round(channel * brightness) for channel in kelvin_to_rgb(kelvin))
+        print("    { %3d, %3d, %3d }, // %4d K %3d%%" % (green, blue, red, kelvin, round(brightness * 100)))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
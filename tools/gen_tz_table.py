@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+"""Generates main/clockgusto_tz_table.h, the DST transition instants of the default time zone.
+
+The rule mirrors the default in clockgusto_tz.c: Europe/Berlin, CET/CEST with the EU switch on the
+last Sunday of March and October at 01:00 UTC.
+
+    python3 tools/gen_tz_table.py > main/clockgusto_tz_table.h
+"""
+import calendar
+import datetime
+
+FIRST_YEAR = 2025
+LAST_YEAR = 2099
+
+
+def last_sunday(year, month):
+    last_day = calendar.monthrange(year, month)[1]
+    day = datetime.date(year, month, last_day)
+    return day - datetime.timedelta(days=(day.weekday() + 1) % 7)
+
+
+def utc_instant(day):
+    moment = datetime.datetime(day.year, day.month, day.day, 1, 0, tzinfo=datetime.timezone.utc)
+    return int(moment.timestamp())
+
+
+def main():
+    print("#pragma once")
+    print()
+    print("#include <stdint.h>")
+    print()
+    print("/* Generated by tools/gen_tz_table.py, do not edit. */")
+    print()
+    print("#define CLOCKGUSTO_TZ_TABLE_FIRST_YEAR %d" % FIRST_YEAR)
+    print("#define CLOCKGUSTO_TZ_TABLE_LAST_YEAR  %d" % LAST_YEAR)
+    print()
+    print("/** Europe/Berlin, UTC seconds of every switch, CEST begins on even and ends on odd entries. */")
+    print("static const uint32_t clockgusto_tz_berlin_transitions[] = {")
+    for year in range(FIRST_YEAR, LAST_YEAR + 1):
+        start = utc_instant(last_sunday(year, 3))
+        end = utc_instant(last_sunday(year, 10))
+        print("    %du, %du, // %d" % (start, end, year))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,17 @@
+#pragma once
+
+/* Host stand-in for the part of ESP-IDF's esp_err.h the plain modules in main/ use, so host tests
+ * in tools/ can build them. */
+
+typedef int esp_err_t;
+
+#define ESP_OK              0
+#define ESP_FAIL            -1
+#define ESP_ERR_NO_MEM      0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_NOT_FOUND   0x105
+
+static inline const char* esp_err_to_name(esp_err_t code)
+{
+    return code == ESP_OK ? "ESP_OK" : "ESP_ERR";
+}
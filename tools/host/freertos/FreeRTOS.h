@@ -0,0 +1,9 @@
+#pragma once
+
+/* Host stand-in for the FreeRTOS critical sections, the host tests run on one thread. */
+
+typedef int portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux)      ((void)(mux))
+#define portEXIT_CRITICAL(mux)       ((void)(mux))
@@ -0,0 +1,52 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF's nvs.h: every namespace opens, holds nothing and takes every write. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+typedef enum
+{
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+static inline esp_err_t nvs_open(const char* name, nvs_open_mode_t mode, nvs_handle_t* handle)
+{
+    (void)name;
+    (void)mode;
+    *handle = 1;
+    return ESP_OK;
+}
+
+static inline esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* value, size_t* size)
+{
+    (void)handle;
+    (void)key;
+    (void)value;
+    (void)size;
+    return ESP_ERR_NOT_FOUND;
+}
+
+static inline esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t size)
+{
+    (void)handle;
+    (void)key;
+    (void)value;
+    (void)size;
+    return ESP_OK;
+}
+
+static inline esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+static inline void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
@@ -0,0 +1,260 @@
+#!/usr/bin/env python3
+"""A broker stand-in for trying the clock's MQTT client without a home-automation setup.
+
+Speaks enough MQTT 3.1.1 for the clock and simple tools: CONNECT with a last will, SUBSCRIBE with
++ and # wildcards, retained PUBLISH with QoS 0 and 1, PINGREQ and DISCONNECT. Every message is
+printed, and on exit or every --report seconds the traffic per client follows: bytes and packets
+in both directions, projected to one hour, the same figures /api/status shows as bytes_per_h.
+
+    python3 tools/mqtt_broker.py --port 1883
+    python3 tools/mqtt_broker.py --set clockgusto/set/brightness=40 --set clockgusto/set/mode=temperature
+
+--set publishes to the clock a few seconds after it subscribed, which checks the control path.
+Set CONFIG_CLOCKGUSTO_MQTT_URI to mqtt://<this host>:<port>.
+"""
+import argparse
+import socket
+import struct
+import threading
+import time
+
+CONNECT, CONNACK, PUBLISH, PUBACK = 1, 2, 3, 4
+SUBSCRIBE, SUBACK, PINGREQ, PINGRESP, DISCONNECT = 8, 9, 12, 13, 14
+TCPIP_OVERHEAD = 40     # per segment, matches the firmware's estimate
+
+
+def encode_length(length):
+    encoded = bytearray()
+    while True:
+        byte = length % 128
+        length //= 128
+        encoded.append(byte | (0x80 if length else 0))
+        if not length:
+            return bytes(encoded)
+
+
+def encode_string(value):
+    data = value.encode()
+    return struct.pack(">H", len(data)) + data
+
+
+def topic_matches(pattern, topic):
+    pattern_parts = pattern.split("/")
+    topic_parts = topic.split("/")
+    for idx, part in enumerate(pattern_parts):
+        if part == "#":
+            return True
+        if idx >= len(topic_parts) or (part != "+" and part != topic_parts[idx]):
+            return False
+    return len(pattern_parts) == len(topic_parts)
+
+
+class Client:
+    def __init__(self, broker, sock, address):
+        self.broker = broker
+        self.sock = sock
+        self.address = address
+        self.name = "%s:%d" % address
+        self.subscriptions = []
+        self.will = None
+        self.lock = threading.Lock()
+        self.started = time.monotonic()
+        self.bytes_in = self.packets_in = self.bytes_out = self.packets_out = 0
+
+    def read_exact(self, size):
+        data = b""
+        while len(data) < size:
+            chunk = self.sock.recv(size - len(data))
+            if not chunk:
+                raise ConnectionError("closed")
+            data += chunk
+        return data
+
+    def read_packet(self):
+        first = self.read_exact(1)[0]
+        length = multiplier = 0
+        header = 1
+        while True:
+            byte = self.read_exact(1)[0]
+            header += 1
+            length += (byte & 0x7F) << multiplier
+            multiplier += 7
+            if not byte & 0x80:
+                break
+        body = self.read_exact(length)
+        self.bytes_in += header + length
+        self.packets_in += 1
+        return first >> 4, first & 0x0F, body
+
+    def send(self, packet_type, flags, body):
+        packet = bytes([(packet_type << 4) | flags]) + encode_length(len(body)) + body
+        with self.lock:
+            self.sock.sendall(packet)
+            self.bytes_out += len(packet)
+            self.packets_out += 1
+
+    def deliver(self, topic, payload, retain):
+        self.send(PUBLISH, 0x01 if retain else 0, encode_string(topic) + payload)
+
+    def handle_connect(self, body):
+        name_length = struct.unpack(">H", body[:2])[0]
+        pos = 2 + name_length + 1
+        flags = body[pos]
+        pos += 3    # flags and keepalive
+        client_id_length = struct.unpack(">H", body[pos:pos + 2])[0]
+        client_id = body[pos + 2:pos + 2 + client_id_length].decode(errors="replace")
+        pos += 2 + client_id_length
+        if flags & 0x04:
+            topic_length = struct.unpack(">H", body[pos:pos + 2])[0]
+            topic = body[pos + 2:pos + 2 + topic_length].decode()
+            pos += 2 + topic_length
+            message_length = struct.unpack(">H", body[pos:pos + 2])[0]
+            self.will = (topic, body[pos + 2:pos + 2 + message_length], bool(flags & 0x20))
+        self.name = "%s (%s)" % (client_id or "-", self.address[0])
+        self.send(CONNACK, 0, b"\x00\x00")
+        print("%s connected" % self.name)
+
+    def handle_subscribe(self, body):
+        packet_id = body[:2]
+        pos = 2
+        granted = bytearray()
+        while pos < len(body):
+            length = struct.unpack(">H", body[pos:pos + 2])[0]
+            pattern = body[pos + 2:pos + 2 + length].decode()
+            pos += 2 + length + 1
+            self.subscriptions.append(pattern)
+            granted.append(0)
+            print("%s subscribed %s" % (self.name, pattern))
+            for topic, payload in self.broker.retained_matching(pattern):
+                self.deliver(topic, payload, True)
+        self.send(SUBACK, 0, packet_id + bytes(granted))
+        self.broker.on_subscribe(self)
+
+    def handle_publish(self, flags, body):
+        length = struct.unpack(">H", body[:2])[0]
+        topic = body[2:2 + length].decode()
+        pos = 2 + length
+        qos = (flags >> 1) & 0x03
+        if qos:
+            self.send(PUBACK, 0, body[pos:pos + 2])
+            pos += 2
+        self.broker.publish(self, topic, body[pos:], bool(flags & 0x01))
+
+    def run(self):
+        try:
+            while True:
+                packet_type, flags, body = self.read_packet()
+                if packet_type == CONNECT:
+                    self.handle_connect(body)
+                elif packet_type == SUBSCRIBE:
+                    self.handle_subscribe(body)
+                elif packet_type == PUBLISH:
+                    self.handle_publish(flags, body)
+                elif packet_type == PINGREQ:
+                    self.send(PINGRESP, 0, b"")
+                elif packet_type == DISCONNECT:
+                    self.will = None
+                    break
+        except (ConnectionError, OSError, IndexError, struct.error):
+            pass
+        self.sock.close()
+        print("%s disconnected" % self.name)
+        self.broker.remove(self)
+
+
+class Broker:
+    def __init__(self, commands):
+        self.clients = []
+        self.retained = {}
+        self.commands = commands
+        self.lock = threading.Lock()
+
+    def retained_matching(self, pattern):
+        with self.lock:
+            return [(topic, payload) for topic, payload in self.retained.items() if topic_matches(pattern, topic)]
+
+    def publish(self, sender, topic, payload, retain):
+        print("%8.1f s %-28s %4d bytes %s%s" % (time.monotonic() - sender.started, topic, len(payload),
+                                                payload.decode(errors="replace"), " (retained)" if retain else ""))
+        with self.lock:
+            if retain:
+                self.retained[topic] = payload
+            receivers = [client for client in self.clients
+                         if any(topic_matches(pattern, topic) for pattern in client.subscriptions)]
+        for client in receivers:
+            try:
+                client.deliver(topic, payload, False)
+            except OSError:
+                pass
+
+    def on_subscribe(self, client):
+        if not self.commands:
+            return
+
+        def send_commands():
+            for topic, value in self.commands:
+                time.sleep(3)
+                print("-> %s %s" % (topic, value))
+                client.deliver(topic, value.encode(), False)
+        threading.Thread(target=send_commands, daemon=True).start()
+
+    def add(self, client):
+        with self.lock:
+            self.clients.append(client)
+
+    def remove(self, client):
+        with self.lock:
+            if client in self.clients:
+                self.clients.remove(client)
+        if client.will:
+            topic, payload, retain = client.will
+            self.publish(client, topic, payload, retain)
+        report([client])
+
+    def report(self):
+        with self.lock:
+            clients = list(self.clients)
+        report(clients)
+
+
+def report(clients):
+    for client in clients:
+        elapsed = max(time.monotonic() - client.started, 1e-3)
+        on_air_in = client.bytes_in + client.packets_in * TCPIP_OVERHEAD
+        on_air_out = client.bytes_out + client.packets_out * TCPIP_OVERHEAD
+        print("%s, %.0f s: sent %d bytes in %d packets, %.0f bytes/h on air; received %d bytes, %.0f bytes/h" %
+              (client.name, elapsed, client.bytes_in, client.packets_in, on_air_in * 3600 / elapsed,
+               client.bytes_out, on_air_out * 3600 / elapsed))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--report", type=float, default=600.0, help="seconds between traffic reports")
+    parser.add_argument("--set", action="append", default=[], metavar="TOPIC=VALUE",
+                        help="publish to subscribers after they subscribed")
+    args = parser.parse_args()
+
+    broker = Broker([tuple(command.split("=", 1)) for command in args.set])
+    server = socket.create_server(("", args.port))
+    print("listening on port %d" % args.port)
+
+    def reporter():
+        while True:
+            time.sleep(args.report)
+            broker.report()
+    threading.Thread(target=reporter, daemon=True).start()
+
+    try:
+        while True:
+            sock, address = server.accept()
+            sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            client = Client(broker, sock, address)
+            broker.add(client)
+            threading.Thread(target=client.run, daemon=True).start()
+    except KeyboardInterrupt:
+        broker.report()
+
+
+if __name__ == "__main__":
+    main()
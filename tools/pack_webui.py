@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""Packs the web UI into the image of the webui data partition, main/clockgusto_webui.c serves it.
+
+Every file under the source directory is gzipped at the highest level, the firmware sends it as is
+with Content-Encoding: gzip. The image layout, all integers little endian:
+
+    header      magic "CGUI", u16 version, u16 file count, u32 image size, u32 crc32 of everything
+                after the header
+    entries     per file: path[44] and content type[24], both NUL padded, u32 offset from the start
+                of the image, u32 length, u32 crc32 of the gzipped data, which is the ETag
+    data        the gzipped files, each 4 byte aligned
+
+    python3 tools/pack_webui.py webui build/webui.bin --partition-size 0x50000
+"""
+import argparse
+import gzip
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = b"CGUI"
+VERSION = 1
+HEADER = struct.Struct("<4sHHII")
+ENTRY = struct.Struct("<44s24sIII")
+PATH_SIZE = 44
+TYPE_SIZE = 24
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+    ".txt": "text/plain",
+}
+
+
+def collect(source):
+    files = []
+    for root, _, names in os.walk(source):
+        for name in sorted(names):
+            path = os.path.join(root, name)
+            url = "/" + os.path.relpath(path, source).replace(os.sep, "/")
+            extension = os.path.splitext(name)[1].lower()
+            if extension not in CONTENT_TYPES:
+                sys.exit("no content type for %s" % path)
+            if len(url.encode()) >= PATH_SIZE:
+                sys.exit("path too long: %s" % url)
+            files.append((url, CONTENT_TYPES[extension], path))
+    return sorted(files)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source")
+    parser.add_argument("output")
+    parser.add_argument("--partition-size", type=lambda value: int(value, 0), default=0x50000)
+    args = parser.parse_args()
+
+    files = collect(args.source)
+    offset = HEADER.size + ENTRY.size * len(files)
+    entries = b""
+    data = b""
+    raw_size = 0
+    for url, content_type, path in files:
+        with open(path, "rb") as source:
+            raw = source.read()
+        raw_size += len(raw)
+        # mtime 0 keeps the image and with it the ETags reproducible
+        packed = gzip.compress(raw, compresslevel=9, mtime=0)
+        padding = b"\0" * (-len(packed) % 4)
+        entries += ENTRY.pack(url.encode(), content_type.encode(), offset + len(data), len(packed),
+                              zlib.crc32(packed))
+        data += packed + padding
+        print("%-28s %7d -> %6d bytes" % (url, len(raw), len(packed)), file=sys.stderr)
+
+    body = entries + data
+    image = HEADER.pack(MAGIC, VERSION, len(files), HEADER.size + len(body), zlib.crc32(body)) + body
+    if len(image) > args.partition_size:
+        sys.exit("image of %d bytes does not fit the %d byte partition" % (len(image), args.partition_size))
+
+    with open(args.output, "wb") as output:
+        output.write(image)
+    print("%d files, %d bytes packed from %d, %d%% of the partition" %
+          (len(files), len(image), raw_size, len(image) * 100 // args.partition_size), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,517 @@
+#!/usr/bin/env python3
+"""Talks to the clock over its USB serial port with the framed protocol of main/clockgusto_wire.h.
+
+Every request is one frame with a sequence number; the answer carries the same one and is sent
+again up to three times when it does not come. Console lines the clock logs in between frames are
+printed with a "|" in front.
+
+    python3 tools/serial_link.py /dev/ttyUSB0 ping
+    python3 tools/serial_link.py /dev/ttyUSB0 settime
+    python3 tools/serial_link.py /dev/ttyUSB0 get tz
+    python3 tools/serial_link.py /dev/ttyUSB0 set alarm 1,6,45,0x1f,1
+    python3 tools/serial_link.py /dev/ttyUSB0 dismiss
+    python3 tools/serial_link.py /dev/ttyUSB0 wifi "Home network"
+    python3 tools/serial_link.py /dev/ttyUSB0 frames 16
+    python3 tools/serial_link.py /dev/ttyUSB0 logs
+    python3 tools/serial_link.py /dev/ttyUSB0 metrics
+    python3 tools/serial_link.py /dev/ttyUSB0 check
+
+Values for set, separated by commas:
+    brightness  0..100
+    mode        0 clock, 1 temperature
+    alarm       enabled, hour, minute, days (bit 0 Sunday), sunrise
+    night       enabled, latitude, longitude (degrees), level, twilight minutes
+    tz          standard and daylight offset in minutes, then start and end as month, week, weekday, minute
+
+dismiss ends a sunrise or a ringing alarm, the next one stays set.
+
+wifi asks for the password and stores both in the clock's NVS, where they replace the build
+defaults from the next restart on. The password is never read back.
+
+settime measures the round trip with pings first. What the round trip takes beyond the bytes on the
+wire is the clock's and this host's latency; half of it counts towards the way there, so the time
+sent is the one when the clock takes the frame in.
+
+With CONFIG_PM_ENABLE the clock sleeps between frames and light sleep stops its UART. Its first
+received bytes only wake it, so after a pause of SESSION_S the link sends a few frame delimiters
+ahead of the next request. The clock then stays awake for 10 s after the last byte it received.
+To check this by hand on a clock with power management on:
+1. Leave it alone for a minute.
+2. Run ping. It has to answer on the first try.
+3. The log shows "host session", and "host session ended" 10 s later.
+
+check runs every request against the clock, a dismiss of the alarm that may be ringing, a bad value, an unknown key and a corrupt frame among
+them, puts the settings back as they were and exits non-zero when anything failed. tools/serial_standin.c
+answers like the clock on a pseudo-terminal.
+"""
+import argparse
+import getpass
+import os
+import select
+import statistics
+import struct
+import sys
+import termios
+import time
+import tty
+import zlib
+
+PING, TIME_GET, TIME_SET, CONFIG_GET, CONFIG_SET, FRAMES, LOGS, METRICS, DISMISS = range(1, 10)
+FRAME_DATA, LOG_LINE, METRICS_TEXT = 0x41, 0x42, 0x43
+RESPONSE = 0x80
+STATUS = ["ok", "unknown", "bad length", "bad value", "failed"]
+ALARM_STATES = ["idle", "sunrise", "ringing"]
+
+KEYS = {
+    "brightness": (1, "<B"),
+    "mode": (2, "<B"),
+    "alarm": (3, "<BBBBB"),
+    "night": (4, "<BiiBB"),
+    "tz": (5, "<hhBBBHBBBH"),
+}
+KEY_WIFI = 6
+NUM_LEDS = 114          # CLOCKGUSTO_NUM_LEDS
+RETRIES = 3
+PINGS = 8
+SESSION_S = 5.0         # well inside the clock's CLOCKGUSTO_SERIAL_SESSION_MS
+WAKE = b"\0" * 8        # a rising edge each, CLOCKGUSTO_SERIAL_WAKE_EDGES wake the clock, the rest are skipped
+WAKE_S = 0.01
+SESSION_IDLE_S = 12.0   # past CLOCKGUSTO_SERIAL_SESSION_MS, the clock sleeps again
+
+
+def cobs_encode(data):
+    out = bytearray()
+    block = bytearray()
+    for byte in data:
+        if byte == 0:
+            out.append(len(block) + 1)
+            out += block
+            block.clear()
+            continue
+        block.append(byte)
+        if len(block) == 254:
+            out.append(255)
+            out += block
+            block.clear()
+    out.append(len(block) + 1)
+    out += block
+    return bytes(out)
+
+
+def cobs_decode(run):
+    out = bytearray()
+    idx = 0
+    while idx < len(run):
+        code = run[idx]
+        if code == 0 or idx + code > len(run):
+            return None
+        out += run[idx + 1:idx + code]
+        idx += code
+        if code < 255 and idx < len(run):
+            out.append(0)
+    return bytes(out)
+
+
+def encode(frame_type, seq, payload):
+    body = bytes([frame_type, seq]) + payload
+    return b"\0" + cobs_encode(body + struct.pack("<I", zlib.crc32(body))) + b"\0"
+
+
+class StatusError(Exception):
+    pass
+
+
+class Link:
+    def __init__(self, path, baud):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        attrs = termios.tcgetattr(self.fd)
+        speed = getattr(termios, "B%d" % baud, None)
+        if speed is not None:
+            attrs[4] = attrs[5] = speed
+            termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        termios.tcflush(self.fd, termios.TCIFLUSH)
+        self.baud = baud
+        self.seq = 0
+        self.pending = bytearray()
+        self.noise = 0
+        self.quiet = False
+        self.retries = 0
+        self.last_sent = None
+
+    def wire_time(self, size):
+        return size * 10.0 / self.baud
+
+    def send_raw(self, data):
+        if self.last_sent is None or time.monotonic() - self.last_sent > SESSION_S:
+            os.write(self.fd, WAKE)
+            time.sleep(WAKE_S)
+        self.last_sent = time.monotonic()
+        view = memoryview(data)
+        while view:
+            view = view[os.write(self.fd, view):]
+
+    def send(self, frame_type, seq, payload=b""):
+        data = encode(frame_type, seq, payload)
+        self.send_raw(data)
+        return len(data)
+
+    def console(self, run):
+        text = "".join(c if c.isprintable() else "." for c in run.decode("latin-1")).strip(".\r\n ")
+        if not text:
+            return
+        self.noise += 1
+        if not self.quiet:
+            for line in text.splitlines():
+                print("  | " + line.strip())
+
+    def receive(self, deadline):
+        """Returns the next valid frame as type, seq, payload, received time, encoded size, or None."""
+        while True:
+            while 0 in self.pending:
+                end = self.pending.index(0)
+                run = bytes(self.pending[:end])
+                del self.pending[:end + 1]
+                if not run:
+                    continue
+                body = cobs_decode(run)
+                if body is not None and len(body) >= 6 and \
+                        zlib.crc32(body[:-4]) == struct.unpack("<I", body[-4:])[0]:
+                    return body[0], body[1], body[2:-4], time.monotonic(), len(run) + 2
+                self.console(run)
+            wait = deadline - time.monotonic()
+            if wait <= 0 or not select.select([self.fd], [], [], wait)[0]:
+                return None
+            self.pending += os.read(self.fd, 4096)
+
+    def request(self, frame_type, payload=b"", timeout=0.5, stream=None):
+        """Sends a request until it is answered, returns the payload after the status byte. Frames of the
+        same sequence number that come before the answer go to stream."""
+        self.seq = (self.seq + 1) & 0xff
+        for attempt in range(RETRIES + 1):
+            self.retries += attempt > 0
+            self.send(frame_type, self.seq, payload)
+            deadline = time.monotonic() + timeout
+            while True:
+                frame = self.receive(deadline)
+                if frame is None:
+                    break
+                answer_type, seq, answer = frame[:3]
+                if seq != self.seq:
+                    continue
+                if answer_type == frame_type | RESPONSE:
+                    if answer[0] != 0:
+                        raise StatusError(STATUS[answer[0]] if answer[0] < len(STATUS) else str(answer[0]))
+                    return answer[1:]
+                if stream is not None:
+                    stream(frame)
+                    deadline = time.monotonic() + timeout
+        raise TimeoutError("no answer to request 0x%02x" % frame_type)
+
+    def config_get(self, name):
+        key, layout = KEYS[name]
+        return struct.unpack(layout, self.request(CONFIG_GET, bytes([key]))[1:])
+
+    def config_set(self, name, values):
+        key, layout = KEYS[name]
+        return struct.unpack(layout, self.request(CONFIG_SET, bytes([key]) + struct.pack(layout, *values))[1:])
+
+    def wifi_get(self):
+        answer = self.request(CONFIG_GET, bytes([KEY_WIFI]))
+        return answer[2:2 + answer[1]].decode("utf-8", "replace")
+
+    def wifi_set(self, ssid, password):
+        ssid = ssid.encode()
+        answer = self.request(CONFIG_SET, bytes([KEY_WIFI, len(ssid)]) + ssid + password.encode())
+        return answer[2:2 + answer[1]].decode("utf-8", "replace")
+
+    def ping(self):
+        version, max_payload = struct.unpack("<BH", self.request(PING))
+        return version, max_payload
+
+    def latency(self):
+        """The round trip of a ping beyond the bytes on the wire, the best of several."""
+        request_size = len(encode(PING, 0, b""))
+        rtts = []
+        for _ in range(PINGS):
+            started = time.monotonic()
+            self.seq = (self.seq + 1) & 0xff
+            self.send(PING, self.seq)
+            deadline = started + 0.5
+            while True:
+                frame = self.receive(deadline)
+                if frame is None or (frame[0] == PING | RESPONSE and frame[1] == self.seq):
+                    break
+            if frame is not None:
+                rtts.append(frame[3] - started - self.wire_time(request_size + frame[4]))
+        if not rtts:
+            raise TimeoutError("no answer to pings")
+        return max(min(rtts), 0.0)
+
+    def set_time(self):
+        fixed = self.latency()
+        self.seq = (self.seq + 1) & 0xff
+        size = len(encode(TIME_SET, self.seq, bytes(8)))
+        for _ in range(RETRIES + 1):
+            # a zero in the timestamp changes the encoded size, so encode again until it settles
+            for _ in range(3):
+                utc_us = int((time.time() + self.wire_time(size) + fixed / 2) * 1e6)
+                data = encode(TIME_SET, self.seq, struct.pack("<q", utc_us))
+                if len(data) == size:
+                    break
+                size = len(data)
+            self.send_raw(data)
+            deadline = time.monotonic() + 0.5
+            while True:
+                frame = self.receive(deadline)
+                if frame is None or (frame[0] == TIME_SET | RESPONSE and frame[1] == self.seq):
+                    break
+            if frame is not None:
+                if frame[2][0] != 0:
+                    raise StatusError(STATUS[frame[2][0]])
+                return fixed
+        raise TimeoutError("no answer to time set")
+
+    def time_error(self, fixed, samples=8):
+        """The clock's time minus this host's, the median of several reads."""
+        request_size = len(encode(TIME_GET, 0, b""))
+        errors = []
+        for _ in range(samples):
+            sent = time.time()
+            utc_us, = struct.unpack("<q", self.request(TIME_GET))
+            errors.append(utc_us / 1e6 - (sent + self.wire_time(request_size) + fixed / 2))
+        return statistics.median(errors)
+
+    def frames(self, count):
+        frames = []
+        received = [0]
+
+        def stream(frame):
+            if frame[0] == FRAME_DATA:
+                frames.append((struct.unpack("<I", frame[2][:4])[0], frame[2][4:]))
+                received[0] += frame[4]
+
+        started = time.monotonic()
+        self.request(FRAMES, struct.pack("<H", count), stream=stream)
+        deadline = time.monotonic() + 2.0
+        while len(frames) < count:
+            frame = self.receive(deadline)
+            if frame is None:
+                break
+            if frame[1] == self.seq:
+                stream(frame)
+                deadline = time.monotonic() + 2.0
+        elapsed = time.monotonic() - started
+        if len(frames) < count:
+            self.request(FRAMES, struct.pack("<H", 0))
+        return frames, received[0], elapsed
+
+    def dismiss(self):
+        state = self.request(DISMISS)[0]
+        return ALARM_STATES[state] if state < len(ALARM_STATES) else str(state)
+
+    def logs(self, first=0):
+        lines = []
+        self.request(LOGS, struct.pack("<I", first), timeout=2.0,
+                     stream=lambda frame: lines.append((struct.unpack("<I", frame[2][:4])[0],
+                                                        frame[2][4:].decode("utf-8", "replace"))))
+        return lines
+
+    def metrics(self):
+        pieces = []
+        received = [0]
+
+        def stream(frame):
+            if frame[0] == METRICS_TEXT:
+                pieces.append(frame[2])
+                received[0] += frame[4]
+
+        started = time.monotonic()
+        self.request(METRICS, timeout=2.0, stream=stream)
+        return b"".join(pieces).decode("utf-8", "replace"), received[0], time.monotonic() - started
+
+
+def parse_value(name, text):
+    fields = [field.strip() for field in text.split(",")]
+    if name == "night":
+        return (int(fields[0], 0), round(float(fields[1]) * 1e4), round(float(fields[2]) * 1e4),
+                int(fields[3], 0), int(fields[4], 0))
+    return tuple(int(field, 0) for field in fields)
+
+
+def format_value(name, values):
+    if name == "night":
+        return "%d,%.4f,%.4f,%d,%d" % (values[0], values[1] / 1e4, values[2] / 1e4, values[3], values[4])
+    if name == "alarm":
+        return "%d,%d,%d,0x%02x,%d" % values
+    return ",".join(str(value) for value in values)
+
+
+def line_share(link, size, elapsed):
+    return size / elapsed, 100.0 * link.wire_time(size) / elapsed
+
+
+def check(link):
+    results = []
+
+    def step(name, passed, detail=""):
+        results.append(passed)
+        print("%-4s %-34s %s" % ("ok" if passed else "FAIL", name, detail))
+
+    def expect_status(name, frame_type, payload, status):
+        try:
+            link.request(frame_type, payload)
+            step(name, False, "accepted")
+        except StatusError as error:
+            step(name, str(error) == status, str(error))
+
+    version, max_payload = link.ping()
+    step("ping", version == 1, "version %d, payloads up to %d bytes" % (version, max_payload))
+
+    saved = {name: link.config_get(name) for name in KEYS}
+    step("wifi network", True, link.wifi_get() or "none stored")
+    step("get every key", True, ", ".join("%s %s" % (name, format_value(name, saved[name])) for name in KEYS))
+    try:
+        changed = {
+            "brightness": ((saved["brightness"][0] + 37) % 101,),
+            "mode": (1 - saved["mode"][0],),
+            "alarm": (1, 6, 45, 0x1f, 1),
+            "night": (1, 525200, 134050, 20, 30),
+            "tz": (-300, -240, 3, 2, 0, 120, 11, 1, 0, 120),
+        }
+        for name, values in changed.items():
+            answer = link.config_set(name, values)
+            read = link.config_get(name)
+            step("set " + name, answer == values and read == values, format_value(name, read))
+
+        before = link.dismiss()
+        after = link.dismiss()
+        step("dismiss", after == "idle", "%s before, %s after" % (before, after))
+
+        expect_status("bad value is refused", CONFIG_SET, bytes([KEYS["alarm"][0], 1, 24, 0, 0, 1]), "bad value")
+        expect_status("unknown key is refused", CONFIG_GET, bytes([99]), "unknown")
+        expect_status("short value is refused", CONFIG_SET, bytes([KEYS["alarm"][0], 1, 6]), "bad length")
+        expect_status("unknown request is refused", 0x3f, b"", "unknown")
+
+        # a flipped bit in the CRC must be dropped without an answer, and the link must go on
+        data = bytearray(encode(PING, 0x55, b""))
+        data[-2] ^= 0x01
+        link.send_raw(bytes(data))
+        answered = False
+        deadline = time.monotonic() + 0.3
+        while True:
+            frame = link.receive(deadline)
+            if frame is None:
+                break
+            answered |= frame[1] == 0x55
+        step("corrupt frame is dropped", not answered and link.ping()[0] == 1)
+
+        fixed = link.set_time()
+        error = link.time_error(fixed)
+        step("set time", abs(error) < 0.002, "%.3f ms latency beyond the wire, clock %+.3f ms off" %
+             (fixed * 1e3, error * 1e3))
+
+        lines = link.logs()
+        step("logs", len(lines) > 0 and all(b[0] == a[0] + 1 for a, b in zip(lines, lines[1:])),
+             "%d lines, the last: %s" % (len(lines), lines[-1][1] if lines else "-"))
+
+        text, size, elapsed = link.metrics()
+        rate, share = line_share(link, size, elapsed)
+        step("metrics", text.endswith("\n") and "# TYPE" in text and share > 80,
+             "%d bytes of text in %.0f ms, %.0f B/s, %.0f%% of the line" % (len(text), elapsed * 1e3, rate, share))
+
+        frames, size, elapsed = link.frames(8)
+        numbers = [number for number, _ in frames]
+        rate, share = line_share(link, size, elapsed)
+        step("frames", len(frames) == 8 and all(len(pixels) == NUM_LEDS * 3 for _, pixels in frames) and
+             numbers == sorted(set(numbers)),
+             "%d frames in %.0f ms, %.0f B/s, %.0f%% of the line (paced by the clock)" %
+             (len(frames), elapsed * 1e3, rate, share))
+
+        # past the clock's session it is back in light sleep, the wake bytes have to get it up
+        time.sleep(SESSION_IDLE_S)
+        retries = link.retries
+        version, _ = link.ping()
+        step("wake after %.0f s idle" % SESSION_IDLE_S, version == 1 and link.retries == retries,
+             "%d retries" % (link.retries - retries))
+    finally:
+        for name, values in saved.items():
+            link.config_set(name, values)
+    step("settings restored", all(link.config_get(name) == values for name, values in saved.items()))
+
+    passed = all(results)
+    print("PASS" if passed else "FAIL")
+    return 0 if passed else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", help="serial device of the clock")
+    parser.add_argument("--baud", type=int, default=115200, help="CONFIG_ESP_CONSOLE_UART_BAUDRATE")
+    parser.add_argument("--quiet", action="store_true", help="do not print console lines")
+    commands = parser.add_subparsers(dest="command", required=True)
+    commands.add_parser("ping")
+    commands.add_parser("time")
+    commands.add_parser("settime")
+    get = commands.add_parser("get")
+    get.add_argument("key", choices=sorted(KEYS) + ["wifi"])
+    set_ = commands.add_parser("set")
+    set_.add_argument("key", choices=sorted(KEYS))
+    set_.add_argument("value")
+    wifi = commands.add_parser("wifi")
+    wifi.add_argument("ssid")
+    frames = commands.add_parser("frames")
+    frames.add_argument("count", type=int)
+    logs = commands.add_parser("logs")
+    logs.add_argument("--from", dest="first", type=int, default=0, help="first sequence number")
+    commands.add_parser("dismiss")
+    commands.add_parser("metrics")
+    commands.add_parser("check")
+    args = parser.parse_args()
+
+    link = Link(args.port, args.baud)
+    link.quiet = args.quiet
+    try:
+        if args.command == "ping":
+            version, max_payload = link.ping()
+            print("version %d, payloads up to %d bytes" % (version, max_payload))
+        elif args.command == "time":
+            print("clock %+.3f ms off this host" % (link.time_error(link.latency()) * 1e3))
+        elif args.command == "settime":
+            fixed = link.set_time()
+            print("%.3f ms latency beyond the wire, clock now %+.3f ms off this host" %
+                  (fixed * 1e3, link.time_error(fixed) * 1e3))
+        elif args.command == "get" and args.key == "wifi":
+            print(link.wifi_get())
+        elif args.command == "get":
+            print(format_value(args.key, link.config_get(args.key)))
+        elif args.command == "wifi":
+            password = getpass.getpass("password for %s: " % args.ssid)
+            print("stored for %s, used from the next restart" % link.wifi_set(args.ssid, password))
+        elif args.command == "set":
+            print(format_value(args.key, link.config_set(args.key, parse_value(args.key, args.value))))
+        elif args.command == "dismiss":
+            print("%s, now idle" % link.dismiss())
+        elif args.command == "frames":
+            frames, size, elapsed = link.frames(args.count)
+            for number, pixels in frames:
+                print("%8d %s" % (number, pixels[:24].hex()))
+            rate, share = line_share(link, size, elapsed)
+            print("%d frames, %.0f B/s, %.0f%% of the line" % (len(frames), rate, share))
+        elif args.command == "logs":
+            for seq, text in link.logs(args.first):
+                print("%6d %s" % (seq, text))
+        elif args.command == "metrics":
+            text, size, elapsed = link.metrics()
+            sys.stdout.write(text)
+            print("# %d bytes in %.0f ms, %.0f%% of the line" % (size, elapsed * 1e3, line_share(link, size, elapsed)[1]))
+        elif args.command == "check":
+            return check(link)
+    except (StatusError, TimeoutError) as error:
+        print("error: %s" % error, file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,489 @@
+/* Stands in for the clock on the serial link, so tools/serial_link.py can be tried without hardware.
+ *
+ *     cc -O2 -Imain tools/serial_standin.c main/clockgusto_wire.c -o serial_standin
+ *     ./serial_standin [baud]                   prints the pseudo-terminal to open
+ *     python3 tools/serial_link.py /dev/pts/N check
+ *
+ * It runs the firmware's codec from main/clockgusto_wire.c on a pseudo-terminal and answers like
+ * main/clockgusto_serial.c: time, configuration with the firmware's range checks, a rainbow frame
+ * every 125 ms, an alarm that rings until dismissed, a log ring and a metrics text of several
+ * chunks. Console lines go out between the frames like ESP_LOG output does on the clock. Like a
+ * clock with power management on it sleeps when the host has been silent for 10 s, and loses the
+ * first bytes that wake it.
+ *
+ * A pseudo-terminal moves bytes at once, so the stand-in makes up the wire: every frame it reads
+ * counts as arrived one byte time per byte after the read, plus the driver's rx timeout, and every
+ * frame it writes leaves only after its bytes would have crossed at the given baud rate. The
+ * stand-in's clock starts up to 3 s off the host's; after a time set it prints how far off it still is,
+ * which is the error of the host's latency compensation. */
+
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "clockgusto_wire.h"
+
+#define NUM_LEDS        114     // CLOCKGUSTO_NUM_LEDS, clockgusto.h needs ESP-IDF
+#define FRAME_SIZE      (NUM_LEDS * 3)
+#define FRAME_MS        125
+#define CONSOLE_MS      700
+#define LOG_LINES       32      // CLOCKGUSTO_LOG_LINES
+#define LOG_LINE_SIZE   96      // CLOCKGUSTO_LOG_LINE_SIZE
+#define RX_TIMEOUT_BITS 10      // the driver's default rx timeout, in bit times
+#define WAKE_BYTES      3       // CLOCKGUSTO_SERIAL_WAKE_EDGES, one edge per byte at the least
+#define SESSION_MS      10000   // CLOCKGUSTO_SERIAL_SESSION_MS
+#define SLEEP_AFTER_MS  30      // CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP at 100 Hz
+
+static int s_fd = -1;
+static long s_baud = 115200;
+static int64_t s_offset_us = 0;     // stand-in UTC minus host UTC
+static int64_t s_awake_until_us = 0;
+
+static uint8_t s_brightness = 80;
+static uint8_t s_mode = 0;
+static uint8_t s_alarm[5] = { 0, 7, 0, 0x3e, 1 };
+static uint8_t s_alarm_state = 2;   // rings until the first dismiss
+static uint8_t s_night[11] = { 0 };
+static uint8_t s_tz[14] = { 0x3c, 0, 0x78, 0, 3, 5, 0, 0x78, 0, 10, 5, 0, 0xb4, 0 };    // central Europe
+static char s_ssid[33] = "";
+
+static char s_log[LOG_LINES][LOG_LINE_SIZE];
+static uint32_t s_log_seq = 0;
+
+static uint16_t s_frames_left = 0;
+static uint8_t s_stream_seq = 0;
+static uint32_t s_frame_number = 0;
+static uint8_t s_frame[FRAME_SIZE];
+
+static uint8_t s_tx[CLOCKGUSTO_WIRE_MAX_ENCODED];
+static uint8_t s_payload[CLOCKGUSTO_WIRE_MAX_PAYLOAD];
+
+static int64_t host_us()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static int64_t wire_us(size_t bytes)
+{
+    return (int64_t)bytes * 10 * 1000000 / s_baud;
+}
+
+static void sleep_until(int64_t until_us)
+{
+    int64_t wait_us = until_us - host_us();
+    if (wait_us > 0)
+    {
+        usleep((useconds_t)wait_us);
+    }
+}
+
+static void write_all(const uint8_t* data, size_t size)
+{
+    // as slow as the wire, the reader sees the last byte when it would have arrived
+    sleep_until(host_us() + wire_us(size));
+    while (size > 0)
+    {
+        ssize_t written = write(s_fd, data, size);
+        if (written <= 0)
+        {
+            return;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+}
+
+static void console(const char* format, ...)
+{
+    char text[LOG_LINE_SIZE / 2];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    s_log_seq++;
+    snprintf(s_log[s_log_seq % LOG_LINES], LOG_LINE_SIZE, "I (%lld) clockgusto stand-in: %s",
+             (long long)(host_us() / 1000 % 10000000), text);
+    char line[LOG_LINE_SIZE + 1];
+    size_t length = (size_t)snprintf(line, sizeof(line), "%s\n", s_log[s_log_seq % LOG_LINES]);
+    write_all((const uint8_t*)line, length);
+}
+
+static void send_frame(uint8_t type, uint8_t seq, const uint8_t* payload, size_t size)
+{
+    size_t length = clockgusto_wire_encode(type, seq, payload, size, s_tx);
+    write_all(s_tx, length);
+}
+
+static size_t config_get(uint8_t key, uint8_t* value)
+{
+    switch (key)
+    {
+    case CLOCKGUSTO_WIRE_KEY_BRIGHTNESS: value[0] = s_brightness; return 1;
+    case CLOCKGUSTO_WIRE_KEY_MODE:       value[0] = s_mode; return 1;
+    case CLOCKGUSTO_WIRE_KEY_ALARM:      memcpy(value, s_alarm, sizeof(s_alarm)); return sizeof(s_alarm);
+    case CLOCKGUSTO_WIRE_KEY_NIGHT:      memcpy(value, s_night, sizeof(s_night)); return sizeof(s_night);
+    case CLOCKGUSTO_WIRE_KEY_TZ:         memcpy(value, s_tz, sizeof(s_tz)); return sizeof(s_tz);
+    case CLOCKGUSTO_WIRE_KEY_WIFI:
+        value[0] = (uint8_t)strlen(s_ssid);
+        memcpy(value + 1, s_ssid, value[0]);
+        return 1 + value[0];
+    default:                             return 0;
+    }
+}
+
+static bool tz_switch_valid(const uint8_t* data)
+{
+    return data[0] >= 1 && data[0] <= 12 && data[1] >= 1 && data[1] <= 5 && data[2] <= 6 &&
+           clockgusto_wire_get_u16(data + 3) < 48 * 60;
+}
+
+/* the same range checks as the setters on the clock */
+static clockgusto_wire_status_t config_set(uint8_t key, const uint8_t* value, size_t size)
+{
+    if (key == CLOCKGUSTO_WIRE_KEY_WIFI)
+    {
+        // the clock keeps the password in NVS, the stand-in forgets it
+        if (size < 1 || size < 1 + (size_t)value[0] || value[0] > 32 || size - 1 - value[0] > 64)
+        {
+            return CLOCKGUSTO_WIRE_BAD_LENGTH;
+        }
+        if (value[0] == 0 || memchr(value + 1, 0, size - 1) != NULL)
+        {
+            return CLOCKGUSTO_WIRE_BAD_VALUE;
+        }
+        memcpy(s_ssid, value + 1, value[0]);
+        s_ssid[value[0]] = '\0';
+        console("wifi credentials stored for %s", s_ssid);
+        return CLOCKGUSTO_WIRE_OK;
+    }
+
+    uint8_t current[40];
+    size_t expected = config_get(key, current);
+    if (expected == 0)
+    {
+        return CLOCKGUSTO_WIRE_UNKNOWN;
+    }
+    if (size != expected)
+    {
+        return CLOCKGUSTO_WIRE_BAD_LENGTH;
+    }
+
+    switch (key)
+    {
+    case CLOCKGUSTO_WIRE_KEY_BRIGHTNESS:
+        if (value[0] > 100)
+        {
+            return CLOCKGUSTO_WIRE_BAD_VALUE;
+        }
+        s_brightness = value[0];
+        break;
+
+    case CLOCKGUSTO_WIRE_KEY_MODE:
+        if (value[0] > 1)   // CLOCKGUSTO_MODE_COUNT
+        {
+            return CLOCKGUSTO_WIRE_BAD_VALUE;
+        }
+        s_mode = value[0];
+        break;
+
+    case CLOCKGUSTO_WIRE_KEY_ALARM:
+        if (value[1] > 23 || value[2] > 59 || value[3] > 0x7f)
+        {
+            return CLOCKGUSTO_WIRE_BAD_VALUE;
+        }
+        memcpy(s_alarm, value, size);
+        break;
+
+    case CLOCKGUSTO_WIRE_KEY_NIGHT:
+    {
+        int32_t latitude = (int32_t)clockgusto_wire_get_u32(value + 1);
+        int32_t longitude = (int32_t)clockgusto_wire_get_u32(value + 5);
+        if (latitude < -900000 || latitude > 900000 || longitude < -1800000 || longitude > 1800000 || value[9] > 100)
+        {
+            return CLOCKGUSTO_WIRE_BAD_VALUE;
+        }
+        memcpy(s_night, value, size);
+        break;
+    }
+
+    case CLOCKGUSTO_WIRE_KEY_TZ:
+        if (!tz_switch_valid(value + 4) || !tz_switch_valid(value + 9))
+        {
+            return CLOCKGUSTO_WIRE_BAD_VALUE;
+        }
+        memcpy(s_tz, value, size);
+        break;
+    }
+    console("config %u set", key);
+    return CLOCKGUSTO_WIRE_OK;
+}
+
+static void send_metrics(uint8_t seq)
+{
+    // the shape of the firmware's text, enough of it for several chunks
+    static const char* names[] = { "frame_render", "rmt_transmit", "i2c_latency" };
+    char text[6144];
+    size_t length = 0;
+    for (int idx = 0; idx < 3; ++idx)
+    {
+        length += (size_t)snprintf(text + length, sizeof(text) - length,
+                                   "# HELP clockgusto_%s_seconds stand-in\n# TYPE clockgusto_%s_seconds histogram\n",
+                                   names[idx], names[idx]);
+        for (int bucket = 0; bucket < 10; ++bucket)
+        {
+            length += (size_t)snprintf(text + length, sizeof(text) - length,
+                                       "clockgusto_%s_seconds_bucket{le=\"%g\"} %u\n", names[idx],
+                                       (bucket + 1) * 0.001, s_frame_number * (bucket + 1) / 10);
+        }
+        length += (size_t)snprintf(text + length, sizeof(text) - length,
+                                   "clockgusto_%s_seconds_bucket{le=\"+Inf\"} %u\nclockgusto_%s_seconds_sum %.6f\n"
+                                   "clockgusto_%s_seconds_count %u\n",
+                                   names[idx], s_frame_number, names[idx], s_frame_number * 0.004, names[idx],
+                                   s_frame_number);
+    }
+    for (int idx = 0; idx < 20; ++idx)
+    {
+        length += (size_t)snprintf(text + length, sizeof(text) - length,
+                                   "# HELP clockgusto_standin_%d_total stand-in\n# TYPE clockgusto_standin_%d_total "
+                                   "counter\nclockgusto_standin_%d_total %d\n", idx, idx, idx, idx * 7);
+    }
+
+    // pieces end at line ends, like the firmware's
+    size_t start = 0;
+    while (start < length)
+    {
+        size_t end = start + CLOCKGUSTO_WIRE_MAX_PAYLOAD < length ? start + CLOCKGUSTO_WIRE_MAX_PAYLOAD : length;
+        while (end < length && text[end - 1] != '\n')
+        {
+            end--;
+        }
+        send_frame(CLOCKGUSTO_WIRE_METRICS_TEXT, seq, (const uint8_t*)text + start, end - start);
+        start = end;
+    }
+}
+
+static void handle(const clockgusto_wire_frame_t* frame, int64_t arrival_us)
+{
+    clockgusto_wire_status_t status = CLOCKGUSTO_WIRE_OK;
+    uint8_t* out = s_payload + 1;
+    size_t size = 0;
+
+    switch (frame->type)
+    {
+    case CLOCKGUSTO_WIRE_PING:
+        out[0] = CLOCKGUSTO_WIRE_VERSION;
+        clockgusto_wire_put_u16(out + 1, CLOCKGUSTO_WIRE_MAX_PAYLOAD);
+        size = 3;
+        break;
+
+    case CLOCKGUSTO_WIRE_TIME_GET:
+    case CLOCKGUSTO_WIRE_TIME_SET:
+        if (frame->type == CLOCKGUSTO_WIRE_TIME_SET)
+        {
+            if (frame->size != 8)
+            {
+                status = CLOCKGUSTO_WIRE_BAD_LENGTH;
+                break;
+            }
+            s_offset_us = clockgusto_wire_get_i64(frame->payload) - arrival_us;
+            console("time set, %+.3f ms off the host", s_offset_us / 1000.0);
+        }
+        clockgusto_wire_put_i64(out, host_us() + s_offset_us);
+        size = 8;
+        break;
+
+    case CLOCKGUSTO_WIRE_CONFIG_GET:
+    case CLOCKGUSTO_WIRE_CONFIG_SET:
+        if (frame->size < 1)
+        {
+            status = CLOCKGUSTO_WIRE_BAD_LENGTH;
+            break;
+        }
+        if (frame->type == CLOCKGUSTO_WIRE_CONFIG_SET)
+        {
+            status = config_set(frame->payload[0], frame->payload + 1, frame->size - 1);
+        }
+        out[0] = frame->payload[0];
+        size = 1 + config_get(out[0], out + 1);
+        status = size == 1 ? CLOCKGUSTO_WIRE_UNKNOWN : status;
+        break;
+
+    case CLOCKGUSTO_WIRE_FRAMES:
+        if (frame->size != 2)
+        {
+            status = CLOCKGUSTO_WIRE_BAD_LENGTH;
+            break;
+        }
+        s_frames_left = clockgusto_wire_get_u16(frame->payload);
+        s_stream_seq = frame->seq;
+        break;
+
+    case CLOCKGUSTO_WIRE_LOGS:
+    {
+        if (frame->size != 4)
+        {
+            status = CLOCKGUSTO_WIRE_BAD_LENGTH;
+            break;
+        }
+        uint32_t oldest = s_log_seq > LOG_LINES ? s_log_seq - LOG_LINES + 1 : 1;
+        uint32_t seq = clockgusto_wire_get_u32(frame->payload);
+        seq = seq < oldest ? oldest : seq;
+        uint8_t line[4 + LOG_LINE_SIZE];
+        for (; seq <= s_log_seq; ++seq)
+        {
+            clockgusto_wire_put_u32(line, seq);
+            size_t length = strlen(s_log[seq % LOG_LINES]);
+            memcpy(line + 4, s_log[seq % LOG_LINES], length);
+            send_frame(CLOCKGUSTO_WIRE_LOG_LINE, frame->seq, line, 4 + length);
+        }
+        clockgusto_wire_put_u32(out, seq);
+        size = 4;
+        break;
+    }
+
+    case CLOCKGUSTO_WIRE_METRICS:
+        send_metrics(frame->seq);
+        break;
+
+    case CLOCKGUSTO_WIRE_DISMISS:
+        out[0] = s_alarm_state;
+        size = 1;
+        if (s_alarm_state != 0)
+        {
+            console("alarm dismissed");
+        }
+        s_alarm_state = 0;
+        break;
+
+    default:
+        status = CLOCKGUSTO_WIRE_UNKNOWN;
+        break;
+    }
+
+    s_payload[0] = status;
+    send_frame(frame->type | CLOCKGUSTO_WIRE_RESPONSE, frame->seq, s_payload, status == CLOCKGUSTO_WIRE_OK ? 1 + size : 1);
+}
+
+static void render()
+{
+    s_frame_number++;
+    for (int led = 0; led < NUM_LEDS; ++led)
+    {
+        // a coarse rainbow in strip order green, blue, red
+        int hue = (led * 256 / NUM_LEDS + (int)s_frame_number) % 256;
+        s_frame[led * 3 + 0] = (uint8_t)(hue < 128 ? hue * 2 : 511 - hue * 2);
+        s_frame[led * 3 + 1] = (uint8_t)(hue >= 128 ? (hue - 128) * 2 : 0);
+        s_frame[led * 3 + 2] = (uint8_t)(255 - hue);
+    }
+    if (s_frames_left > 0)
+    {
+        uint8_t payload[4 + FRAME_SIZE];
+        clockgusto_wire_put_u32(payload, s_frame_number);
+        memcpy(payload + 4, s_frame, FRAME_SIZE);
+        send_frame(CLOCKGUSTO_WIRE_FRAME_DATA, s_stream_seq, payload, sizeof(payload));
+        s_frames_left--;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    s_baud = argc > 1 ? atol(argv[1]) : 115200;
+    srand((unsigned)time(NULL));
+    s_offset_us = (int64_t)(rand() % 6000001) - 3000000;
+
+    s_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (s_fd < 0 || grantpt(s_fd) != 0 || unlockpt(s_fd) != 0)
+    {
+        perror("pseudo-terminal");
+        return 1;
+    }
+    struct termios raw;
+    tcgetattr(s_fd, &raw);
+    cfmakeraw(&raw);
+    tcsetattr(s_fd, TCSANOW, &raw);
+    printf("%s at %ld baud, clock %+.3f s off\n", ptsname(s_fd), s_baud, s_offset_us / 1e6);
+    fflush(stdout);
+
+    clockgusto_wire_reader_t reader;
+    clockgusto_wire_reader_init(&reader);
+    int64_t next_frame_us = host_us();
+    int64_t next_console_us = host_us();
+    uint32_t noise = 0;
+    while (true)
+    {
+        int64_t now_us = host_us();
+        if (now_us >= next_frame_us)
+        {
+            next_frame_us += FRAME_MS * 1000;
+            render();
+        }
+        if (now_us >= next_console_us)
+        {
+            next_console_us += CONSOLE_MS * 1000;
+            console("frame %u, %u bad frames", s_frame_number, noise);
+        }
+
+        int64_t next_us = next_frame_us < next_console_us ? next_frame_us : next_console_us;
+        struct pollfd fds = { .fd = s_fd, .events = POLLIN };
+        int timeout_ms = (int)((next_us - host_us()) / 1000);
+        if (poll(&fds, 1, timeout_ms < 0 ? 0 : timeout_ms) <= 0 || !(fds.revents & POLLIN))
+        {
+            if (fds.revents & POLLHUP)
+            {
+                usleep(50000);  // nobody has the terminal open
+            }
+            continue;
+        }
+
+        uint8_t data[256];
+        ssize_t length = read(s_fd, data, sizeof(data));
+        int64_t read_us = host_us();
+        ssize_t first = 0;
+        if (length > 0 && read_us >= s_awake_until_us)
+        {
+            // light sleep, the first bytes only wake the chip and it goes back unless more follow
+            first = length < WAKE_BYTES ? length : WAKE_BYTES;
+            s_awake_until_us = read_us + SLEEP_AFTER_MS * 1000;
+            console("woken, %zd bytes lost", first);
+        }
+        if (length > first)
+        {
+            s_awake_until_us = read_us + SESSION_MS * 1000LL;
+        }
+        size_t run = 0;         // bytes of the frame being collected
+        for (ssize_t idx = first; idx < length; ++idx)
+        {
+            run++;
+            clockgusto_wire_frame_t frame;
+            clockgusto_wire_result_t result = clockgusto_wire_reader_push(&reader, data[idx], &frame);
+            if (result == CLOCKGUSTO_WIRE_FRAME)
+            {
+                // the last byte arrives a wire time after the first, the driver reports it a timeout later
+                int64_t arrival_us = read_us + wire_us(run) + (int64_t)RX_TIMEOUT_BITS * 1000000 / s_baud;
+                sleep_until(arrival_us);
+                handle(&frame, arrival_us);
+                read_us = host_us();
+                run = 0;
+            }
+            else if (result == CLOCKGUSTO_WIRE_NOISE)
+            {
+                noise++;
+                run = 0;
+            }
+        }
+    }
+}
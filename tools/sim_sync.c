@@ -0,0 +1,278 @@
+/* Simulates a room of clocks running the group sync of main/clockgusto_sync.c over loopback.
+ *
+ *     cc -O2 -pthread -Imain tools/sim_sync.c main/clockgusto_sync.c -o sim_sync
+ *     ./sim_sync [clocks] [seconds] [jitter ms] [second the master leaves, 0 never]
+ *
+ * Every clock is a thread with its own sockets, joined to the sync group on 127.0.0.1 the way the
+ * firmware joins it on the station interface. Each gets a local time line that drifts by up to
+ * 50 ppm and an idea of UTC that is up to 40 ms off, like clocks after SNTP over Wi-Fi. Every packet
+ * waits a random time up to the jitter before it is sent, which stands in for the queues of the
+ * air. Once a second the group time of all clocks is read at the same instant; the spread between
+ * them is how far apart their minute flips and rainbow phases are. */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "clockgusto_sync.h"
+
+#define MAX_CLOCKS      16
+#define SETTLE_S        15      // spreads before this are not in the summary
+
+typedef struct _sim_clock_t
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    clockgusto_sync_node_t node;
+    double drift;               // local rate against real time
+    int64_t local_base_us;
+    int64_t utc_error_us;
+    bool leave;
+    bool gone;
+    int group_sock;             // receives multicast
+    int sock;                   // sends everything, receives unicast
+    struct sockaddr_in master;
+} sim_clock_t;
+
+static sim_clock_t s_clocks[MAX_CLOCKS];
+static int s_count = 4;
+static int s_jitter_ms = 5;
+static int64_t s_start_us;
+static struct sockaddr_in s_group;
+
+static int64_t real_us()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static int64_t local_us(const sim_clock_t* clock, int64_t real)
+{
+    return clock->local_base_us + (int64_t)((real - s_start_us) * clock->drift);
+}
+
+static int64_t utc_us(const sim_clock_t* clock, int64_t real)
+{
+    // the same UTC for everybody apart from each clock's error, drifting with its crystal
+    return 1700000000000000LL + clock->utc_error_us + (int64_t)((real - s_start_us) * clock->drift);
+}
+
+static void send_delayed(sim_clock_t* clock, const uint8_t* packet, size_t size, const struct sockaddr_in* to)
+{
+    if (s_jitter_ms > 0)
+    {
+        usleep(rand() % (s_jitter_ms * 1000));
+    }
+    sendto(clock->sock, packet, size, 0, (const struct sockaddr*)to, sizeof(*to));
+}
+
+static void open_sockets(sim_clock_t* clock)
+{
+    int reuse = 1;
+    clock->group_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    setsockopt(clock->group_sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    setsockopt(clock->group_sock, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+    struct sockaddr_in any = { .sin_family = AF_INET, .sin_port = htons(CLOCKGUSTO_SYNC_PORT) };
+    if (bind(clock->group_sock, (struct sockaddr*)&any, sizeof(any)) != 0)
+    {
+        perror("bind group");
+        exit(1);
+    }
+    struct ip_mreq membership = { 0 };
+    inet_pton(AF_INET, CLOCKGUSTO_SYNC_GROUP, &membership.imr_multiaddr);
+    membership.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+    if (setsockopt(clock->group_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0)
+    {
+        perror("join group");
+        exit(1);
+    }
+
+    clock->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in loopback = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    bind(clock->sock, (struct sockaddr*)&loopback, sizeof(loopback));
+    setsockopt(clock->sock, IPPROTO_IP, IP_MULTICAST_IF, &loopback.sin_addr, sizeof(loopback.sin_addr));
+    unsigned char loop = 1;
+    setsockopt(clock->sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+}
+
+static void* run_clock(void* arg)
+{
+    sim_clock_t* clock = arg;
+    open_sockets(clock);
+
+    int64_t next_tick_us = real_us();
+    uint8_t data[64];
+    uint8_t packet[CLOCKGUSTO_SYNC_PACKET_SIZE];
+    size_t size = 0;
+    while (!clock->leave)
+    {
+        int64_t now = real_us();
+        if (now >= next_tick_us)
+        {
+            next_tick_us += CLOCKGUSTO_SYNC_INTERVAL_MS * 1000LL;
+            pthread_mutex_lock(&clock->lock);
+            clockgusto_sync_action_t action = clockgusto_sync_node_tick(&clock->node, local_us(clock, now),
+                                                                        utc_us(clock, now), packet, &size);
+            struct sockaddr_in master = clock->master;
+            pthread_mutex_unlock(&clock->lock);
+            if (action == CLOCKGUSTO_SYNC_MULTICAST)
+            {
+                send_delayed(clock, packet, size, &s_group);
+            }
+            else if (action == CLOCKGUSTO_SYNC_TO_MASTER)
+            {
+                send_delayed(clock, packet, size, &master);
+            }
+        }
+
+        struct pollfd fds[2] = { { .fd = clock->group_sock, .events = POLLIN }, { .fd = clock->sock, .events = POLLIN } };
+        int timeout_ms = (int)((next_tick_us - real_us()) / 1000) + 1;
+        if (poll(fds, 2, timeout_ms < 0 ? 0 : timeout_ms) <= 0)
+        {
+            continue;
+        }
+        for (int idx = 0; idx < 2; ++idx)
+        {
+            if (!(fds[idx].revents & POLLIN))
+            {
+                continue;
+            }
+            struct sockaddr_in from;
+            socklen_t from_size = sizeof(from);
+            ssize_t length = recvfrom(fds[idx].fd, data, sizeof(data), 0, (struct sockaddr*)&from, &from_size);
+            int64_t arrival = real_us();
+            if (length <= 0)
+            {
+                continue;
+            }
+
+            pthread_mutex_lock(&clock->lock);
+            clockgusto_sync_action_t action = clockgusto_sync_node_receive(&clock->node, data, (size_t)length,
+                                                                           local_us(clock, arrival), packet, &size);
+            if (action == CLOCKGUSTO_SYNC_NEW_MASTER)
+            {
+                clock->master = from;
+            }
+            pthread_mutex_unlock(&clock->lock);
+            if (action == CLOCKGUSTO_SYNC_REPLY)
+            {
+                send_delayed(clock, packet, size, &from);
+            }
+        }
+    }
+
+    close(clock->group_sock);
+    close(clock->sock);
+    clock->gone = true;
+    return NULL;
+}
+
+static const char* role_name(clockgusto_sync_role_t role)
+{
+    return role == CLOCKGUSTO_SYNC_MASTER ? "M" : role == CLOCKGUSTO_SYNC_FOLLOWER ? "f" : "?";
+}
+
+static int compare_i64(const void* a, const void* b)
+{
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+int main(int argc, char** argv)
+{
+    s_count = argc > 1 ? atoi(argv[1]) : 4;
+    int seconds = argc > 2 ? atoi(argv[2]) : 60;
+    s_jitter_ms = argc > 3 ? atoi(argv[3]) : 5;
+    int leave_s = argc > 4 ? atoi(argv[4]) : 0;
+    s_count = s_count < 2 ? 2 : s_count > MAX_CLOCKS ? MAX_CLOCKS : s_count;
+
+    srand((unsigned)time(NULL));
+    s_group.sin_family = AF_INET;
+    s_group.sin_port = htons(CLOCKGUSTO_SYNC_PORT);
+    inet_pton(AF_INET, CLOCKGUSTO_SYNC_GROUP, &s_group.sin_addr);
+    s_start_us = real_us();
+
+    printf("%d clocks, %d s, up to %d ms jitter per packet\n", s_count, seconds, s_jitter_ms);
+    for (int idx = 0; idx < s_count; ++idx)
+    {
+        sim_clock_t* clock = &s_clocks[idx];
+        pthread_mutex_init(&clock->lock, NULL);
+        clock->drift = 1.0 + (rand() % 100001 - 50000) / 1e9;
+        clock->local_base_us = rand() % 100000000;
+        clock->utc_error_us = rand() % 80001 - 40000;
+        int64_t now = real_us();
+        clockgusto_sync_node_init(&clock->node, 100 + (uint32_t)idx, local_us(clock, now), utc_us(clock, now));
+        clock->node.synced = true;
+        printf("clock %u: %+.1f ppm, utc %+.1f ms off\n", clock->node.id, (clock->drift - 1.0) * 1e6,
+               clock->utc_error_us / 1000.0);
+        pthread_create(&clock->thread, NULL, run_clock, clock);
+        usleep(200000);     // clocks come up one after another, the first one leads
+    }
+
+    int64_t spreads[3600];
+    int spread_count = 0;
+    for (int second = 1; second <= seconds; ++second)
+    {
+        sleep(1);
+        if (second == leave_s)
+        {
+            for (int idx = 0; idx < s_count; ++idx)
+            {
+                if (s_clocks[idx].node.role == CLOCKGUSTO_SYNC_MASTER && !s_clocks[idx].gone)
+                {
+                    printf("clock %u leaves\n", s_clocks[idx].node.id);
+                    s_clocks[idx].leave = true;
+                }
+            }
+        }
+
+        int64_t now = real_us();
+        int64_t low = INT64_MAX;
+        int64_t high = INT64_MIN;
+        char roles[MAX_CLOCKS * 24] = "";
+        for (int idx = 0; idx < s_count; ++idx)
+        {
+            sim_clock_t* clock = &s_clocks[idx];
+            if (clock->leave)
+            {
+                continue;
+            }
+            pthread_mutex_lock(&clock->lock);
+            int64_t group_us = clockgusto_sync_node_now(&clock->node, local_us(clock, now));
+            size_t length = strlen(roles);
+            snprintf(roles + length, sizeof(roles) - length, " %u%s%+6.2f", clock->node.id,
+                     role_name(clock->node.role), clock->node.stats.error_us / 1000.0);
+            pthread_mutex_unlock(&clock->lock);
+            low = group_us < low ? group_us : low;
+            high = group_us > high ? group_us : high;
+        }
+
+        int64_t spread_us = high - low;
+        if (second >= SETTLE_S && !(leave_s && second >= leave_s && second < leave_s + SETTLE_S) &&
+            spread_count < (int)(sizeof(spreads) / sizeof(spreads[0])))
+        {
+            spreads[spread_count++] = spread_us;
+        }
+        printf("%4d s  spread %8.3f ms  |%s\n", second, spread_us / 1000.0, roles);
+    }
+
+    if (spread_count > 0)
+    {
+        qsort(spreads, spread_count, sizeof(spreads[0]), compare_i64);
+        printf("settled spread: median %.3f ms, p95 %.3f ms, max %.3f ms over %d s\n",
+               spreads[spread_count / 2] / 1000.0, spreads[spread_count * 95 / 100] / 1000.0,
+               spreads[spread_count - 1] / 1000.0, spread_count);
+    }
+    return 0;
+}
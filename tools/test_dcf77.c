@@ -0,0 +1,323 @@
+/* Replays synthetic DCF77 pulse trains through the decoder of main/dcf77_decoder.c.
+ *
+ *     cc -O2 -Imain tools/test_dcf77.c main/dcf77_decoder.c -o test_dcf77
+ *     ./test_dcf77
+ *
+ * The trains are built the way the transmitter sends them: one reduced carrier pulse per second,
+ * 100 ms for a zero and 200 ms for a one, none in second 59, each minute announcing the next one.
+ * The clean train starts in the middle of a minute, the noisy one adds timing jitter, short
+ * glitches between the pulses and pulses split by dropouts, and both run across the switch to
+ * summer time. Every minute the decoder accepts has to be the one that was sent, starting where it
+ * was sent. Frames with a broken parity bit have to be refused, on their own and in a train. The
+ * first minute of either train has to bring DCF77_PROBE_PULSES on the grid, a minute of random pulses
+ * without a carrier must not. Exits non-zero when anything fails. */
+
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dcf77_decoder.h"
+
+#define BASE_MS     1000
+#define MAX_EDGES   (64 * 4 * 2 * 40)
+
+typedef struct _edge_t
+{
+    uint32_t time_ms;
+    bool level;
+} edge_t;
+
+static edge_t s_edges[MAX_EDGES];
+static int s_edge_count;
+
+static int random_range(int low, int high)
+{
+    return low + rand() % (high - low + 1);
+}
+
+/** Central European time, summer time from the last Sunday of March to the last Sunday of October,
+ *  switching at 01:00 UTC. */
+static bool cest_at(time_t utc)
+{
+    struct tm date;
+    gmtime_r(&utc, &date);
+    if (date.tm_mon < 2 || date.tm_mon > 9)
+    {
+        return false;
+    }
+    if (date.tm_mon > 2 && date.tm_mon < 9)
+    {
+        return true;
+    }
+    int last_sunday = 31 - (date.tm_wday + 31 - date.tm_mday) % 7;
+    bool after = date.tm_mday > last_sunday || (date.tm_mday == last_sunday && date.tm_hour >= 1);
+    return date.tm_mon == 2 ? after : !after;
+}
+
+static void put_bcd(uint64_t* bits, int first, int count, int value)
+{
+    static const int weights[] = { 1, 2, 4, 8, 10, 20, 40, 80 };
+    for (int idx = count - 1; idx >= 0; --idx)
+    {
+        if (value >= weights[idx])
+        {
+            value -= weights[idx];
+            *bits |= 1ULL << (first + idx);
+        }
+    }
+}
+
+static void put_parity(uint64_t* bits, int first, int last)
+{
+    int ones = 0;
+    for (int idx = first; idx < last; ++idx)
+    {
+        ones += (*bits >> idx) & 1;
+    }
+    *bits |= (uint64_t)(ones & 1) << last;
+}
+
+/** The frame sent during the minute before utc, announcing utc. */
+static uint64_t make_frame(time_t utc)
+{
+    bool cest = cest_at(utc);
+    time_t local = utc + (cest ? 7200 : 3600);
+    struct tm date;
+    gmtime_r(&local, &date);
+
+    uint64_t bits = (uint64_t)(rand() & 0x3fff) << 1;  // weather information
+    bits |= (uint64_t)(cest_at(utc + 3600) != cest) << 16;
+    bits |= (uint64_t)cest << 17 | (uint64_t)!cest << 18 | 1ULL << 20;
+    put_bcd(&bits, 21, 7, date.tm_min);
+    put_parity(&bits, 21, 28);
+    put_bcd(&bits, 29, 6, date.tm_hour);
+    put_parity(&bits, 29, 35);
+    put_bcd(&bits, 36, 6, date.tm_mday);
+    put_bcd(&bits, 42, 3, date.tm_wday == 0 ? 7 : date.tm_wday);
+    put_bcd(&bits, 45, 5, date.tm_mon + 1);
+    put_bcd(&bits, 50, 8, date.tm_year % 100);
+    put_parity(&bits, 36, 58);
+    return bits;
+}
+
+static void add_pulse(uint32_t start_ms, uint32_t width_ms)
+{
+    s_edges[s_edge_count++] = (edge_t){ start_ms, true };
+    s_edges[s_edge_count++] = (edge_t){ start_ms + width_ms, false };
+}
+
+/** Builds minutes frames of pulses from the second first_second on. Noise adds jitter, glitches and
+ *  dropouts; broken_minute gets a flipped hour bit, -1 none. */
+static void make_train(time_t utc, int minutes, int first_second, bool noise, int broken_minute)
+{
+    s_edge_count = 0;
+    for (int minute = 0; minute < minutes; ++minute)
+    {
+        uint64_t bits = make_frame(utc + (minute + 1) * 60);
+        if (minute == broken_minute)
+        {
+            bits ^= 1ULL << 30;
+        }
+        for (int second = minute == 0 ? first_second : 0; second < DCF77_FRAME_BITS; ++second)
+        {
+            uint32_t start_ms = BASE_MS + minute * 60000 + second * 1000;
+            uint32_t width_ms = (bits >> second) & 1 ? 200 : 100;
+            if (!noise)
+            {
+                add_pulse(start_ms, width_ms);
+                continue;
+            }
+
+            start_ms += random_range(-30, 30);
+            width_ms += random_range(-25, 25);
+            if (rand() % 8 == 0)
+            {
+                // the receiver lost the carrier for a moment in the middle of the pulse
+                uint32_t split_ms = width_ms / 2;
+                add_pulse(start_ms, split_ms);
+                add_pulse(start_ms + split_ms + random_range(5, 25), width_ms - split_ms);
+            }
+            else
+            {
+                add_pulse(start_ms, width_ms);
+            }
+            if (rand() % 5 == 0)
+            {
+                add_pulse(start_ms + random_range(400, 850), random_range(3, 30));
+            }
+        }
+    }
+}
+
+typedef struct _replay_result_t
+{
+    int accepted;
+    int wrong;
+    int first_minute;           // index of the first accepted minute start
+    dcf77_decoder_t decoder;
+} replay_result_t;
+
+/** A receiver without carrier: pulses of any width the decoder takes, at random intervals. */
+static void make_noise(int seconds)
+{
+    s_edge_count = 0;
+    uint32_t start_ms = BASE_MS;
+    while (start_ms < BASE_MS + seconds * 1000)
+    {
+        uint32_t width_ms = random_range(40, 280);
+        add_pulse(start_ms, width_ms);
+        start_ms += width_ms + random_range(60, 1500);
+    }
+}
+
+/** Pulses on the grid the receiver has seen after the first minute of listening. */
+static uint32_t probe()
+{
+    dcf77_decoder_t decoder;
+    dcf77_decoder_reset(&decoder);
+    for (int idx = 0; idx < s_edge_count && s_edges[idx].time_ms < s_edges[0].time_ms + 60000; ++idx)
+    {
+        dcf77_time_t time;
+        uint32_t minute_start_ms;
+        dcf77_decoder_feed(&decoder, s_edges[idx].level, s_edges[idx].time_ms, &time, &minute_start_ms);
+    }
+    return decoder.pulses;
+}
+
+static bool check_probe()
+{
+    uint32_t clean_min = UINT32_MAX;
+    uint32_t noisy_min = UINT32_MAX;
+    uint32_t noise_max = 0;
+    for (int run = 0; run < 50; ++run)
+    {
+        make_train(1743295800, 2, random_range(0, 58), false, -1);
+        uint32_t pulses = probe();
+        clean_min = pulses < clean_min ? pulses : clean_min;
+        make_train(1743295800, 2, random_range(0, 58), true, -1);
+        pulses = probe();
+        noisy_min = pulses < noisy_min ? pulses : noisy_min;
+        make_noise(60);
+        pulses = probe();
+        noise_max = pulses > noise_max ? pulses : noise_max;
+    }
+    bool ok = clean_min >= DCF77_PROBE_PULSES && noisy_min >= DCF77_PROBE_PULSES && noise_max < DCF77_PROBE_PULSES;
+    printf("%-34s %s  at least %u and %u pulses on the grid, noise at most %u, %u needed\n", "first minute probe",
+           ok ? "ok    " : "FAILED", clean_min, noisy_min, noise_max, DCF77_PROBE_PULSES);
+    return ok;
+}
+
+static time_t utc_of(const dcf77_time_t* time)
+{
+    struct tm date = {
+        .tm_year = 100 + time->year,
+        .tm_mon = time->month - 1,
+        .tm_mday = time->mday,
+        .tm_hour = time->hour,
+        .tm_min = time->minute,
+    };
+    return timegm(&date) - (time->cest ? 7200 : 3600);
+}
+
+static replay_result_t replay(time_t utc, bool verbose)
+{
+    replay_result_t result = { .first_minute = -1 };
+    dcf77_decoder_reset(&result.decoder);
+    for (int idx = 0; idx < s_edge_count; ++idx)
+    {
+        dcf77_time_t time;
+        uint32_t minute_start_ms;
+        if (!dcf77_decoder_feed(&result.decoder, s_edges[idx].level, s_edges[idx].time_ms, &time, &minute_start_ms))
+        {
+            continue;
+        }
+
+        int minute = (int)((minute_start_ms - BASE_MS + 30000) / 60000);
+        int32_t start_error_ms = (int32_t)(minute_start_ms - (BASE_MS + minute * 60000));
+        bool right = utc_of(&time) == utc + minute * 60 && start_error_ms >= -40 && start_error_ms <= 40;
+        if (verbose || !right)
+        {
+            printf("    %02u:%02u %s %02u.%02u.%02u starting at %+d ms%s\n", time.hour, time.minute,
+                   time.cest ? "CEST" : "CET ", time.mday, time.month, time.year, start_error_ms,
+                   right ? "" : "  WRONG");
+        }
+        result.accepted++;
+        result.wrong += !right;
+        result.first_minute = result.first_minute < 0 ? minute : result.first_minute;
+    }
+    return result;
+}
+
+static bool check_frames()
+{
+    // every single bit error in the time fields trips a parity bit
+    time_t utc = 1743296400;    // 2025-03-30 01:00 UTC, summer time begins
+    uint64_t bits = make_frame(utc);
+    dcf77_time_t time;
+    bool ok = dcf77_decoder_decode_frame(bits, &time) && utc_of(&time) == utc && time.cest;
+    int refused = 0;
+    for (int bit = 21; bit < DCF77_FRAME_BITS; ++bit)
+    {
+        refused += !dcf77_decoder_decode_frame(bits ^ (1ULL << bit), &time);
+    }
+    bool framing = !dcf77_decoder_decode_frame(bits & ~(1ULL << 20), &time) &&
+                   !dcf77_decoder_decode_frame(bits | 1ULL, &time) &&
+                   !dcf77_decoder_decode_frame(bits | 1ULL << 18, &time);
+    ok = ok && refused == DCF77_FRAME_BITS - 21 && framing;
+    printf("%-34s %s  %d of %d single bit errors refused, framing errors %s\n", "frame parity",
+           ok ? "ok    " : "FAILED", refused, DCF77_FRAME_BITS - 21, framing ? "refused" : "accepted");
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    srand(1);
+    bool ok = check_frames();
+    ok &= check_probe();
+
+    // 2025-03-30 00:50 UTC, 01:50 CET, the train runs into summer time at 01:00 UTC
+    time_t utc = 1743295800;
+    const int minutes = 20;
+
+    make_train(utc, minutes, 31, false, -1);
+    replay_result_t clean = replay(utc, verbose);
+    // the marker arrives with minute 1, its frame ends with minute 2 and the vote needs minute 3
+    bool clean_ok = clean.wrong == 0 && clean.first_minute == 3 && clean.accepted == minutes - 3;
+    printf("%-34s %s  %d minutes accepted of %d sent, first at minute %d\n", "clean train across DST",
+           clean_ok ? "ok    " : "FAILED", clean.accepted, minutes, clean.first_minute);
+    ok &= clean_ok;
+
+    int noisy_accepted = 0;
+    int noisy_wrong = 0;
+    uint32_t glitches = 0;
+    const int runs = 50;
+    for (int run = 0; run < runs; ++run)
+    {
+        make_train(utc, minutes, random_range(0, 58), true, -1);
+        replay_result_t noisy = replay(utc, false);
+        noisy_accepted += noisy.accepted;
+        noisy_wrong += noisy.wrong;
+        glitches += noisy.decoder.glitches;
+    }
+    // up to four minutes go to finding the marker and the first votes
+    bool noisy_ok = noisy_wrong == 0 && noisy_accepted >= runs * (minutes - 4);
+    printf("%-34s %s  %d minutes accepted of %d sent, %d wrong, %u glitches dropped\n", "noisy trains across DST",
+           noisy_ok ? "ok    " : "FAILED", noisy_accepted, runs * minutes, noisy_wrong, glitches);
+    ok &= noisy_ok;
+
+    make_train(utc, minutes, 31, false, 8);
+    replay_result_t broken = replay(utc, verbose);
+    // only the minute the broken frame announces is lost, the frames around it still agree
+    bool broken_ok = broken.wrong == 0 && broken.decoder.frames_bad >= 1 && broken.accepted == minutes - 4;
+    printf("%-34s %s  %d minutes accepted, %u frames refused\n", "train with a parity error",
+           broken_ok ? "ok    " : "FAILED", broken.accepted, broken.decoder.frames_bad);
+    ok &= broken_ok;
+
+    return ok ? 0 : 1;
+}
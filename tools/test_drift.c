@@ -0,0 +1,107 @@
+/* Replays synthetic DS3231 drift traces through the estimator of main/clockgusto_drift.c.
+ *
+ *     cc -O2 -Imain tools/test_drift.c main/clockgusto_drift.c -lm -o test_drift
+ *     ./test_drift
+ *
+ * Every trace is an hourly offset measurement like the time task takes after each SNTP sync: a
+ * constant rate, network jitter, a daily temperature swing and now and then a sync that went wrong
+ * by a few hundred ms. The estimate has to appear once two days are covered, land within 0.05 ppm
+ * of the true rate and leave the bad syncs out. Exits non-zero when a trace fails. */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "clockgusto_drift.h"
+
+#define SYNC_INTERVAL_S 3600    // CLOCKGUSTO_CALIBRATION_SYNC_DEFAULT_S
+#define DAYS            10
+#define TOLERANCE_PPM   0.05
+
+typedef struct _trace_t
+{
+    const char* name;
+    double ppm;
+    double jitter_us;           // standard deviation
+    double swing_us;            // daily temperature swing, amplitude
+    int outlier_every;          // every nth sync is off by 300 ms, 0 never
+} trace_t;
+
+static const trace_t s_traces[] = {
+    { "clean +2.5 ppm",              2.5,    500.0,    0.0,  0 },
+    { "jittery -1.2 ppm",           -1.2,   8000.0,    0.0,  0 },
+    { "temperature swing +0.8 ppm",  0.8,   2000.0, 4000.0,  0 },
+    { "bad syncs -6.0 ppm",         -6.0,   2000.0,    0.0,  7 },
+    { "all at once +0.3 ppm",        0.3,   6000.0, 3000.0,  5 },
+};
+
+static double gaussian()
+{
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static bool replay(const trace_t* trace)
+{
+    clockgusto_drift_t drift;
+    clockgusto_drift_reset(&drift);
+
+    const uint32_t start_s = 1700000000;
+    uint32_t first_estimate_s = 0;
+    uint32_t kept = 0;
+    clockgusto_drift_estimate_t estimate = { 0 };
+    bool early = false;
+    for (uint32_t elapsed_s = 0; elapsed_s <= DAYS * 24 * 3600; elapsed_s += SYNC_INTERVAL_S)
+    {
+        double offset_us = trace->ppm * elapsed_s + trace->jitter_us * gaussian() +
+                           trace->swing_us * sin(2.0 * M_PI * elapsed_s / 86400.0);
+        if (trace->outlier_every && elapsed_s / SYNC_INTERVAL_S % trace->outlier_every == 3)
+        {
+            offset_us += 300000.0;
+        }
+        kept += clockgusto_drift_add(&drift, start_s + elapsed_s, (int32_t)lround(offset_us));
+
+        bool estimated = clockgusto_drift_estimate(&drift, &estimate);
+        if (estimated && first_estimate_s == 0)
+        {
+            first_estimate_s = elapsed_s;
+            early = elapsed_s < CLOCKGUSTO_DRIFT_MIN_SPAN_S;
+        }
+    }
+
+    bool ok = first_estimate_s != 0 && !early && first_estimate_s <= CLOCKGUSTO_DRIFT_MIN_SPAN_S + 4 * 3600 &&
+              fabs(estimate.ppm - trace->ppm) <= TOLERANCE_PPM &&
+              drift.count == CLOCKGUSTO_DRIFT_MAX_SAMPLES && estimate.span_s >= 7 * 24 * 3600;
+    printf("%-28s %s  first estimate after %5.1f h, %+.3f ppm (error %+.3f), span %.1f d, %u of %u syncs kept, "
+           "%u used, %u rejected, residual %.1f ms\n",
+           trace->name, ok ? "ok    " : "FAILED", first_estimate_s / 3600.0, estimate.ppm, estimate.ppm - trace->ppm,
+           estimate.span_s / 86400.0, kept, DAYS * 24 + 1, estimate.used, estimate.rejected,
+           estimate.residual_us / 1000.0);
+    return ok;
+}
+
+int main()
+{
+    srand(1);
+    bool ok = true;
+    for (size_t idx = 0; idx < sizeof(s_traces) / sizeof(s_traces[0]); ++idx)
+    {
+        ok &= replay(&s_traces[idx]);
+    }
+
+    // too short a span must not give an estimate however many samples there are
+    clockgusto_drift_t drift;
+    clockgusto_drift_reset(&drift);
+    for (uint32_t sample = 0; sample < 12; ++sample)
+    {
+        clockgusto_drift_add(&drift, sample * CLOCKGUSTO_DRIFT_MIN_INTERVAL_S, (int32_t)(sample * 1000));
+    }
+    clockgusto_drift_estimate_t estimate;
+    bool short_ok = !clockgusto_drift_estimate(&drift, &estimate);
+    printf("%-28s %s\n", "44 h span refused", short_ok ? "ok" : "FAILED");
+
+    return ok && short_ok ? 0 : 1;
+}
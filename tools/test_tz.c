@@ -0,0 +1,195 @@
+/* Checks the time zone engine of main/clockgusto_tz.c against the C library's POSIX TZ rules.
+ *
+ *     cc -O2 -Itools/host -Imain tools/test_tz.c main/clockgusto_tz.c -o test_tz
+ *     ./test_tz
+ *
+ * For every zone the whole table range is walked hour by hour. Each DST switch the C library
+ * reports is pinned to the second, and the local time of day the clock would show is compared
+ * one second before, at and after it and half an hour on either side, in both hemispheres.
+ * clockgusto_tz_make_utc is compared with timegm over random dates, and rules with offsets beyond
+ * 14 h have to be refused. tools/host holds the stand-ins for the ESP-IDF headers. Exits non-zero
+ * on the first zone that disagrees. */
+
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "clockgusto_tz.h"
+#include "clockgusto_tz_table.h"
+
+typedef struct _zone_t
+{
+    const char* name;
+    const char* posix;          // the same rule for the C library
+    clockgusto_tz_rule_t rule;
+    bool table;                 // the generated default table, no rule is set
+} zone_t;
+
+static const zone_t s_zones[] = {
+    { "Europe/Berlin (table)", "CET-1CEST,M3.5.0,M10.5.0/3", { 60, 120, { 3, 5, 0, 120 }, { 10, 5, 0, 180 } }, true },
+    { "Europe/London", "GMT0BST,M3.5.0/1,M10.5.0", { 0, 60, { 3, 5, 0, 60 }, { 10, 5, 0, 120 } }, false },
+    { "America/New_York", "EST5EDT,M3.2.0,M11.1.0", { -300, -240, { 3, 2, 0, 120 }, { 11, 1, 0, 120 } }, false },
+    { "Australia/Sydney", "AEST-10AEDT,M10.1.0,M4.1.0/3", { 600, 660, { 10, 1, 0, 120 }, { 4, 1, 0, 180 } }, false },
+    { "Pacific/Auckland", "NZST-12NZDT,M9.5.0,M4.1.0/3", { 720, 780, { 9, 5, 0, 120 }, { 4, 1, 0, 180 } }, false },
+    { "America/Santiago", "<-04>4<-03>,M9.1.6/24,M4.1.6/24", { -240, -180, { 9, 1, 6, 1440 }, { 4, 1, 6, 1440 } }, false },
+    { "Asia/Kolkata", "IST-5:30", { 330, 330, { 3, 5, 0, 120 }, { 10, 5, 0, 180 } }, false },
+};
+
+static int s_mismatches;
+
+static void compare(const zone_t* zone, time_t utc)
+{
+    struct tm expected;
+    localtime_r(&utc, &expected);
+    uint8_t hours;
+    uint8_t minutes;
+    uint8_t seconds;
+    clockgusto_tz_to_local_hms(utc, &hours, &minutes, &seconds);
+    struct tm local;
+    clockgusto_tz_to_local(utc, &local);
+
+    if (hours != expected.tm_hour || minutes != expected.tm_min || seconds != expected.tm_sec ||
+        local.tm_mday != expected.tm_mday || local.tm_mon != expected.tm_mon || local.tm_year != expected.tm_year ||
+        clockgusto_tz_get_offset_s(utc) != expected.tm_gmtoff)
+    {
+        if (s_mismatches++ < 5)
+        {
+            printf("    %s at %lld: %02u:%02u:%02u, expected %04d-%02d-%02d %02d:%02d:%02d\n", zone->name,
+                   (long long)utc, hours, minutes, seconds, expected.tm_year + 1900, expected.tm_mon + 1,
+                   expected.tm_mday, expected.tm_hour, expected.tm_min, expected.tm_sec);
+        }
+    }
+}
+
+static long offset_at(time_t utc)
+{
+    struct tm local;
+    localtime_r(&utc, &local);
+    return local.tm_gmtoff;
+}
+
+static bool check_zone(const zone_t* zone)
+{
+    setenv("TZ", zone->posix, 1);
+    tzset();
+    if (!zone->table && clockgusto_tz_set_rule(&zone->rule) != ESP_OK)
+    {
+        printf("%-24s FAILED  rule refused\n", zone->name);
+        return false;
+    }
+
+    struct tm first = { .tm_year = CLOCKGUSTO_TZ_TABLE_FIRST_YEAR - 1900, .tm_mday = 1 };
+    struct tm last = { .tm_year = CLOCKGUSTO_TZ_TABLE_LAST_YEAR + 1 - 1900, .tm_mday = 1 };
+    time_t begin = timegm(&first);
+    time_t end = timegm(&last);
+
+    s_mismatches = 0;
+    int forward = 0;
+    int back = 0;
+    for (time_t utc = begin; utc < end; utc += 3600)
+    {
+        compare(zone, utc);
+        if (offset_at(utc) == offset_at(utc + 3600))
+        {
+            continue;
+        }
+
+        // the switch lies within this hour, find its second
+        time_t low = utc;
+        time_t high = utc + 3600;
+        while (high - low > 1)
+        {
+            time_t mid = low + (high - low) / 2;
+            if (offset_at(mid) == offset_at(low))
+            {
+                low = mid;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        forward += offset_at(high) > offset_at(low);
+        back += offset_at(high) < offset_at(low);
+        static const int probes[] = { -1800, -1, 0, 1, 1800 };
+        for (size_t idx = 0; idx < sizeof(probes) / sizeof(probes[0]); ++idx)
+        {
+            compare(zone, high + probes[idx]);
+        }
+    }
+
+    int years = CLOCKGUSTO_TZ_TABLE_LAST_YEAR - CLOCKGUSTO_TZ_TABLE_FIRST_YEAR + 1;
+    bool dst = zone->rule.std_offset_min != zone->rule.dst_offset_min;
+    bool ok = s_mismatches == 0 && forward == (dst ? years : 0) && back == (dst ? years : 0);
+    printf("%-24s %s  %d years, %d forward and %d back switches, %d mismatches\n", zone->name,
+           ok ? "ok    " : "FAILED", years, forward, back, s_mismatches);
+    return ok;
+}
+
+static bool check_make_utc()
+{
+    srand(1);
+    int mismatches = 0;
+    for (int sample = 0; sample < 1000000; ++sample)
+    {
+        time_t utc = (time_t)(((uint64_t)rand() << 31 | (uint64_t)rand()) % 4102444800ULL);  // 1970 .. 2100
+        struct tm date;
+        gmtime_r(&utc, &date);
+        mismatches += clockgusto_tz_make_utc(&date) != utc;
+    }
+    // the DS3231 century starts on the first of January 2000, that and the leap days around it
+    static const char* edges[] = { "2000-01-01 00:00:00", "2000-02-29 12:00:00", "2024-02-29 23:59:59",
+                                   "2099-12-31 23:59:59", "2100-03-01 00:00:00" };
+    for (size_t idx = 0; idx < sizeof(edges) / sizeof(edges[0]); ++idx)
+    {
+        struct tm date = { 0 };
+        strptime(edges[idx], "%Y-%m-%d %H:%M:%S", &date);
+        mismatches += clockgusto_tz_make_utc(&date) != timegm(&date);
+    }
+    printf("%-24s %s  %d mismatches against timegm\n", "make_utc", mismatches == 0 ? "ok    " : "FAILED",
+           mismatches);
+    return mismatches == 0;
+}
+
+/** Offsets beyond 14 h and switches outside the calendar are refused, the rule in force stays. */
+static bool check_refused()
+{
+    clockgusto_tz_rule_t before;
+    clockgusto_tz_get_rule(&before);
+
+    static const int16_t offsets[][2] = { { 14 * 60 + 1, 0 }, { 0, -14 * 60 - 1 }, { INT16_MAX, INT16_MIN } };
+    int accepted = 0;
+    for (size_t idx = 0; idx < sizeof(offsets) / sizeof(offsets[0]); ++idx)
+    {
+        clockgusto_tz_rule_t rule = before;
+        rule.std_offset_min = offsets[idx][0];
+        rule.dst_offset_min = offsets[idx][1];
+        accepted += clockgusto_tz_set_rule(&rule) != ESP_ERR_INVALID_ARG;
+    }
+    clockgusto_tz_rule_t rule = before;
+    rule.dst_start.month = 13;
+    accepted += clockgusto_tz_set_rule(&rule) != ESP_ERR_INVALID_ARG;
+
+    clockgusto_tz_rule_t after;
+    clockgusto_tz_get_rule(&after);
+    bool ok = accepted == 0 && memcmp(&before, &after, sizeof(before)) == 0;
+    printf("%-24s %s  %d bad rules accepted\n", "bad rules", ok ? "ok    " : "FAILED", accepted);
+    return ok;
+}
+
+int main()
+{
+    bool ok = check_make_utc();
+    ok &= check_refused();
+    for (size_t idx = 0; idx < sizeof(s_zones) / sizeof(s_zones[0]); ++idx)
+    {
+        ok &= check_zone(&s_zones[idx]);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+"use strict";
+
+const DAYS = ["So", "Mo", "Di", "Mi", "Do", "Fr", "Sa"];
+const LOG_LINES = 100;
+
+const $ = (id) => document.getElementById(id);
+
+async function api(path, body, method = "PUT") {
+  const options = body === undefined ? {} : {
+    method,
+    headers: { "Content-Type": "application/json" },
+    body: JSON.stringify(body),
+  };
+  const response = await fetch("/api/" + path, options);
+  if (!response.ok) {
+    throw new Error(path + ": " + (await response.text()));
+  }
+  return response.json();
+}
+
+function report(error) {
+  $("status").textContent = String(error);
+}
+
+async function loadDisplay() {
+  const [brightness, mode] = await Promise.all([api("brightness"), api("mode")]);
+  $("brightness").value = brightness.brightness;
+  $("brightness-value").value = brightness.brightness + " %";
+  $("mode").value = mode.mode;
+}
+
+async function loadTime() {
+  const time = await api("time");
+  $("clock").textContent = time.local.slice(11, 16);
+  $("time-state").textContent = (time.synced ? "synchronisiert" : "nicht synchronisiert") +
+    (time.degraded ? ", keine Zeitquelle" : "") + ", Genauigkeit " + time.accuracy_ms + " ms";
+}
+
+async function loadAlarm() {
+  const alarm = await api("alarm");
+  const form = $("alarm");
+  form.enabled.checked = alarm.enabled;
+  form.time.value = String(alarm.hour).padStart(2, "0") + ":" + String(alarm.minute).padStart(2, "0");
+  form.sunrise.checked = alarm.sunrise;
+  DAYS.forEach((_, day) => { form["day" + day].checked = (alarm.days >> day) & 1; });
+  $("alarm-dismiss").disabled = alarm.state === "idle";
+}
+
+async function loadNight() {
+  const night = await api("night");
+  const form = $("night");
+  form.enabled.checked = night.enabled;
+  for (const key of ["latitude", "longitude", "night_level", "twilight_min"]) {
+    form[key].value = night[key];
+  }
+}
+
+async function loadStatus() {
+  $("status").textContent = JSON.stringify(await api("status"), null, 1);
+}
+
+function appendLog(lines) {
+  const log = $("log");
+  const kept = log.textContent ? log.textContent.split("\n") : [];
+  log.textContent = kept.concat(lines).slice(-LOG_LINES).join("\n");
+  log.scrollTop = log.scrollHeight;
+}
+
+/** One stream replaces all polling, every message only carries what changed. */
+function listen() {
+  let mask = null;
+  const events = new EventSource("/api/events");
+  events.onmessage = (message) => {
+    const delta = JSON.parse(message.data);
+    if (delta.lines) {
+      appendLog(delta.lines);
+    }
+    if (delta.mode !== undefined) {
+      $("mode").value = delta.mode;
+      $("brightness").value = delta.brightness;
+      $("brightness-value").value = delta.brightness + " %";
+      loadAlarm().catch(report);
+      loadNight().catch(report);
+    }
+    if (delta.mask !== mask) {
+      mask = delta.mask;
+      loadTime().catch(report);
+    }
+  };
+}
+
+function setup() {
+  const days = $("alarm-days");
+  DAYS.forEach((name, day) => {
+    const label = document.createElement("label");
+    label.innerHTML = '<input type="checkbox" name="day' + day + '"> ' + name;
+    days.appendChild(label);
+  });
+
+  $("brightness").addEventListener("input", (event) => {
+    $("brightness-value").value = event.target.value + " %";
+  });
+  $("brightness").addEventListener("change", (event) => {
+    api("brightness", { brightness: Number(event.target.value) }).catch(report);
+  });
+  $("mode").addEventListener("change", (event) => {
+    api("mode", { mode: event.target.value }).catch(report);
+  });
+  $("time-sync").addEventListener("click", () => {
+    api("time", { utc: Math.round(Date.now() / 1000) }).then(loadTime).catch(report);
+  });
+
+  $("alarm").addEventListener("submit", (event) => {
+    event.preventDefault();
+    const form = event.target;
+    const [hour, minute] = form.time.value.split(":").map(Number);
+    const days = DAYS.reduce((mask, _, day) => mask | (form["day" + day].checked ? 1 << day : 0), 0);
+    api("alarm", { enabled: form.enabled.checked, hour, minute, days, sunrise: form.sunrise.checked })
+      .catch(report);
+  });
+  $("alarm-dismiss").addEventListener("click", () => {
+    api("alarm/dismiss", {}, "POST").then(loadAlarm).catch(report);
+  });
+
+  $("night").addEventListener("submit", (event) => {
+    event.preventDefault();
+    const form = event.target;
+    api("night", {
+      enabled: form.enabled.checked,
+      latitude: Number(form.latitude.value),
+      longitude: Number(form.longitude.value),
+      night_level: Number(form.night_level.value),
+      twilight_min: Number(form.twilight_min.value),
+    }).catch(report);
+  });
+
+  Promise.all([loadDisplay(), loadTime(), loadAlarm(), loadNight(), loadStatus()]).catch(report);
+  setInterval(() => loadStatus().catch(report), 30000);
+  listen();
+}
+
+setup();